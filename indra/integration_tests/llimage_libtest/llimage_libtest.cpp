@@ -97,6 +97,10 @@ static const char USAGE[] = "\n"
 "        Results in <metric>_report.csv\n"
 " -s, --image-stats\n"
 "        Output stats for each input and output image.\n"
+" -bk, --benchmark-kernels\n"
+"        Time the image scaling, compositing and mip generation kernels at each SIMD level\n"
+"        supported by this CPU and check their output matches the scalar versions.\n"
+"        Runs on generated images, no input file is needed.\n"
 "\n";
 
 // true when all image loading is done. Used by metric logging thread to know when to stop the thread.
@@ -313,6 +317,116 @@ void store_output_file(std::list<std::string> &output_filenames, std::list<std::
 	}
 }
 
+// Image filled with noise so that no kernel gets an easy ride
+LLPointer<LLImageRaw> create_noise_image(S32 width, S32 height, S8 components)
+{
+	LLPointer<LLImageRaw> raw_image = new LLImageRaw(width, height, components);
+	U8* data = raw_image->getData();
+	for (S32 i = 0; i < raw_image->getDataSize(); ++i)
+	{
+		data[i] = (U8)(rand() & 0xff);
+	}
+	return raw_image;
+}
+
+// One kernel run on a fresh copy of the source, returns the image it produced
+typedef LLPointer<LLImageRaw> (*kernel_func_t)(LLImageRaw* src, S32 param);
+
+LLPointer<LLImageRaw> kernel_generate_mip(LLImageRaw* src, S32 param)
+{
+	LLPointer<LLImageRaw> mip = new LLImageRaw(src->getWidth() / 2, src->getHeight() / 2, src->getComponents());
+	LLImageBase::generateMip(src->getData(), mip->getData(), mip->getWidth(), mip->getHeight(), mip->getComponents());
+	return mip;
+}
+
+LLPointer<LLImageRaw> kernel_scale(LLImageRaw* src, S32 param)
+{
+	// param is the destination size in percent of the source
+	return src->scaled(src->getWidth() * param / 100, src->getHeight() * param / 100);
+}
+
+LLPointer<LLImageRaw> kernel_composite(LLImageRaw* src, S32 param)
+{
+	LLPointer<LLImageRaw> dst = new LLImageRaw(src->getWidth() * param / 100, src->getHeight() * param / 100, 3);
+	dst->clear(32, 64, 128);
+	dst->composite(src);
+	return dst;
+}
+
+// Time each kernel at every SIMD level this CPU has and compare the output
+// against the scalar version. Returns false if any output differs.
+bool benchmark_kernels()
+{
+	struct kernel_test
+	{
+		const char*		mName;
+		kernel_func_t	mFunc;
+		S32				mWidth;
+		S32				mHeight;
+		S8				mComponents;
+		S32				mParam;
+	};
+	static const kernel_test tests[] =
+	{
+		{ "generateMip 1 channel",		kernel_generate_mip,	2048, 2048, 1, 0 },
+		{ "generateMip 2 channels",		kernel_generate_mip,	2048, 2048, 2, 0 },
+		{ "generateMip 3 channels",		kernel_generate_mip,	2048, 2048, 3, 0 },
+		{ "generateMip 4 channels",		kernel_generate_mip,	2048, 2048, 4, 0 },
+		{ "scale down 4 channels",		kernel_scale,			2048, 2048, 4, 37 },
+		{ "scale up 4 channels",		kernel_scale,			512, 512, 4, 290 },
+		{ "scale down 3 channels",		kernel_scale,			2048, 2048, 3, 37 },
+		{ "composite 4 onto 3",			kernel_composite,		1024, 1024, 4, 70 },
+	};
+	const S32 ITERATIONS = 10;
+
+	const LLImage::ESIMDLevel max_level = LLImage::getMaxSIMDLevel();
+	bool all_match = true;
+	srand(1);
+
+	for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); ++t)
+	{
+		const kernel_test& test = tests[t];
+		LLPointer<LLImageRaw> src = create_noise_image(test.mWidth, test.mHeight, test.mComponents);
+		LLPointer<LLImageRaw> reference;
+		F64 scalar_ms = 0.0;
+
+		std::cout << test.mName << " (" << test.mWidth << "x" << test.mHeight << ")" << std::endl;
+		for (S32 level = LLImage::SIMD_SCALAR; level <= max_level; ++level)
+		{
+			LLImage::setSIMDLevel((LLImage::ESIMDLevel)level);
+
+			LLPointer<LLImageRaw> result;
+			LLTimer timer;
+			for (S32 i = 0; i < ITERATIONS; ++i)
+			{
+				result = test.mFunc(src, test.mParam);
+			}
+			const F64 ms = timer.getElapsedTimeF64() * 1000.0 / ITERATIONS;
+
+			bool match = true;
+			if (level == LLImage::SIMD_SCALAR)
+			{
+				reference = result;
+				scalar_ms = ms;
+			}
+			else
+			{
+				match = result->getDataSize() == reference->getDataSize()
+					&& !memcmp(result->getData(), reference->getData(), result->getDataSize());
+				all_match = all_match && match;
+			}
+
+			std::cout << "    " << LLImage::getSIMDLevelName((LLImage::ESIMDLevel)level)
+					  << " : " << ms << " ms"
+					  << ", speedup : " << (ms > 0.0 ? scalar_ms / ms : 0.0)
+					  << (match ? "" : ", OUTPUT DIFFERS FROM SCALAR") << std::endl;
+		}
+	}
+
+	LLImage::setSIMDLevel(max_level);
+	return all_match;
+}
+
 // Holds the metric gathering output in a thread safe way
 class LogThread : public LLThread
 {
@@ -356,6 +470,7 @@ int main(int argc, char** argv)
 	int blocks_size = -1;
 	int levels = 0;
 	bool reversible = false;
+	bool benchmark = false;
     std::string filter_name = "";
 
 	// Init whatever is necessary
@@ -557,6 +672,17 @@ int main(int argc, char** argv)
 		{
 			image_stats = true;
 		}
+		else if (!strcmp(argv[arg], "--benchmark-kernels") || !strcmp(argv[arg], "-bk"))
+		{
+			benchmark = true;
+		}
+	}
+
+	if (benchmark)
+	{
+		bool success = benchmark_kernels();
+		SUBSYSTEM_CLEANUP(LLImage);
+		return success ? 0 : 1;
 	}
 		
 	// Check arguments consistency. Exit with proper message if inconsistent.
@@ -32,6 +32,84 @@
 #include <string>
 
 #include "apr_base64.h"
+#include "llsimdscan.h"
+
+namespace
+{
+	const U8 BASE64_INVALID = 64;
+
+	// 6 bit value of each base64 character, BASE64_INVALID for the rest
+	struct DecodeTable
+	{
+		U8 mValues[256];
+
+		DecodeTable()
+		{
+			memset(mValues, BASE64_INVALID, sizeof(mValues));
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (U8 i = 0; i < 64; ++i)
+			{
+				mValues[(U8)alphabet[i]] = i;
+			}
+		}
+	};
+	const DecodeTable sDecodeTable;
+
+#if LL_SIMD_SCAN
+	// Decodes 16 characters into 12 bytes, writing 13. Returns false,
+	// writing nothing, unless all 16 are base64.
+	inline bool decode_block_sse2(const char* input, U8* output)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)input);
+
+		// Bytes from 0x80 up compare as negative and so are in no range
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+									  _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+		__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+									  _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+									  _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+		__m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+		__m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+		__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+									 _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+		if (_mm_movemask_epi8(valid) != 0xffff)
+		{
+			return false;
+		}
+
+		// Character to 6 bit value
+		__m128i offset = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+						 _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+			_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+						 _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+									  _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+		__m128i values = _mm_add_epi8(c, offset);
+
+		// Pairs of 6 bit values to 12 bits, pairs of those to 24
+		__m128i bits12 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 6),
+									  _mm_srli_epi16(values, 8));
+		__m128i bits24 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(bits12, _mm_set1_epi32(0xffff)), 12),
+									  _mm_srli_epi32(bits12, 16));
+
+		// Most significant byte first
+		const __m128i low_byte = _mm_set1_epi32(0xff);
+		__m128i bytes = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi32(bits24, 16), low_byte),
+						 _mm_and_si128(bits24, _mm_set1_epi32(0xff00))),
+			_mm_slli_epi32(_mm_and_si128(bits24, low_byte), 16));
+
+		U32 words[4];
+		_mm_storeu_si128((__m128i*)words, bytes);
+		memcpy(output, &words[0], 4);
+		memcpy(output + 3, &words[1], 4);
+		memcpy(output + 6, &words[2], 4);
+		memcpy(output + 9, &words[3], 4);
+		return true;
+	}
+#endif
+}
 
 
 // static
@@ -59,3 +137,65 @@ std::string LLBase64::encode(const U8* input, size_t input_size)
 	return output;
 }
 
+// static
+void LLBase64::decode(const char* input, size_t input_size, std::vector<U8>& output,
+					  bool skip_whitespace)
+{
+	// 1 byte of slack for the block decoder
+	output.resize(input_size / 4 * 3 + 4);
+	U8* out = output.empty() ? NULL : &output[0];
+
+	const char* p = input;
+	const char* end = input + input_size;
+	U32 group = 0;
+	S32 count = 0;
+	while (p < end)
+	{
+#if LL_SIMD_SCAN
+		if (count == 0)
+		{
+			while (end - p >= 16 && decode_block_sse2(p, out))
+			{
+				p += 16;
+				out += 12;
+			}
+			if (p == end)
+			{
+				break;
+			}
+		}
+#endif
+		U8 value = sDecodeTable.mValues[(U8)*p];
+		if (value == BASE64_INVALID)
+		{
+			if (skip_whitespace && ll_is_space(*p))
+			{
+				++p;
+				continue;
+			}
+			break;
+		}
+		++p;
+		group = (group << 6) | value;
+		if (++count == 4)
+		{
+			*out++ = (U8)(group >> 16);
+			*out++ = (U8)(group >> 8);
+			*out++ = (U8)group;
+			group = 0;
+			count = 0;
+		}
+	}
+
+	// A single leftover character carries no whole byte
+	if (count == 2)
+	{
+		*out++ = (U8)(group >> 4);
+	}
+	else if (count == 3)
+	{
+		*out++ = (U8)(group >> 10);
+		*out++ = (U8)(group >> 2);
+	}
+	output.resize(out ? out - &output[0] : 0);
+}
@@ -28,10 +28,20 @@
 #ifndef LLBASE64_H
 #define LLBASE64_H
 
+#include <vector>
+
 class LL_COMMON_API LLBase64
 {
 public:
 	static std::string encode(const U8* input, size_t input_size);
+
+	// Decodes into output the way apr_base64_decode_binary() does: input
+	// ends at the first character that is not base64, '=' padding
+	// included, and a trailing partial group gives the bytes it can. With
+	// skip_whitespace, whitespace is dropped first instead of ending the
+	// input, as for base64 split over lines.
+	static void decode(const char* input, size_t input_size, std::vector<U8>& output,
+					   bool skip_whitespace = false);
 };
 
 #endif
@@ -38,7 +38,11 @@ LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool shou
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mStatsCompleted(0),
+	mStatsQueueWaitTotal(0),
+	mStatsQueueWaitMax(0),
+	mStatsRunTotal(0)
 {
 	if (mThreaded)
 	{
@@ -198,13 +202,21 @@ void LLQueuedThread::printQueueStats()
 	lockData();
 	if (!mRequestQueue.empty())
 	{
-		QueuedRequest *req = *mRequestQueue.begin();
+		QueuedRequest *req = mRequestQueue.top();
 		LL_INFOS() << llformat("Pending Requests:%d Current status:%d", mRequestQueue.size(), req->getStatus()) << LL_ENDL;
 	}
 	else
 	{
 		LL_INFOS() << "Queued Thread Idle" << LL_ENDL;
 	}
+	if (mStatsCompleted)
+	{
+		LL_INFOS() << llformat("Completed:%u Queue wait avg:%.2fms max:%.2fms Run avg:%.2fms",
+							   mStatsCompleted,
+							   mStatsQueueWaitTotal * .001 / mStatsCompleted,
+							   mStatsQueueWaitMax * .001,
+							   mStatsRunTotal * .001 / mStatsCompleted) << LL_ENDL;
+	}
 	unlockData();
 }
 
@@ -231,6 +243,7 @@ bool LLQueuedThread::addRequest(QueuedRequest* req)
 	
 	lockData();
 	req->setStatus(STATUS_QUEUED);
+	req->mQueuedAt = totalTime();
 	mRequestQueue.insert(req);
 	mRequestHash.insert(req);
 #if _DEBUG
@@ -344,17 +357,23 @@ void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 			// not in list
 			req->setPriority(priority);
 		}
-		else if(req->getStatus() == STATUS_QUEUED)
+		else if(req->getStatus() == STATUS_QUEUED && req->getPriority() != priority)
 		{
-			// remove from list then re-insert
-			llverify(mRequestQueue.erase(req) == 1);
-			req->setPriority(priority);
-			mRequestQueue.insert(req);
+			mRequestQueue.setPriority(req, priority);
 		}
 	}
 	unlockData();
 }
 
+// mDataLock must be locked
+void LLQueuedThread::recordCompleted(const QueuedRequest* req)
+{
+	++mStatsCompleted;
+	mStatsQueueWaitTotal += req->mQueueWaitTime;
+	mStatsQueueWaitMax = llmax(mStatsQueueWaitMax, req->mQueueWaitTime);
+	mStatsRunTotal += req->mRunTime;
+}
+
 bool LLQueuedThread::completeRequest(handle_t handle)
 {
 	bool res = false;
@@ -407,13 +426,11 @@ S32 LLQueuedThread::processNextRequest()
 	
 	while(1)
 	{
-		req = NULL;
-		if (mRequestQueue.empty())
+		req = mRequestQueue.pop();
+		if (!req)
 		{
 			break;
 		}
-		req = *mRequestQueue.begin();
-		mRequestQueue.erase(mRequestQueue.begin());
 		if ((req->getFlags() & FLAG_ABORT) || (mStatus == QUITTING))
 		{
 			req->setStatus(STATUS_ABORTED);
@@ -430,10 +447,13 @@ S32 LLQueuedThread::processNextRequest()
 		break;
 	}
 	U32 start_priority = 0 ;
+	U64 start_time = 0;
 	if (req)
 	{
 		req->setStatus(STATUS_INPROGRESS);
 		start_priority = req->getPriority();
+		start_time = totalTime();
+		req->mQueueWaitTime += start_time - req->mQueuedAt;
 	}
 	unlockData();
 
@@ -444,11 +464,14 @@ S32 LLQueuedThread::processNextRequest()
 	{
 		// process request		
 		bool complete = req->processRequest();
+		U64 end_time = totalTime();
+		req->mRunTime += end_time - start_time;
 
 		if (complete)
 		{
 			lockData();
 			req->setStatus(STATUS_COMPLETE);
+			recordCompleted(req);
 			req->finishRequest(true);
 			if (req->getFlags() & FLAG_AUTO_COMPLETE)
 			{
@@ -462,6 +485,7 @@ S32 LLQueuedThread::processNextRequest()
 		{
 			lockData();
 			req->setStatus(STATUS_QUEUED);
+			req->mQueuedAt = end_time;
 			mRequestQueue.insert(req);
 			unlockData();
 			if (mThreaded && start_priority < PRIORITY_NORMAL)
@@ -544,7 +568,12 @@ LLQueuedThread::QueuedRequest::QueuedRequest(LLQueuedThread::handle_t handle, U3
 	LLSimpleHashEntry<LLQueuedThread::handle_t>(handle),
 	mStatus(STATUS_UNKNOWN),
 	mPriority(priority),
-	mFlags(flags)
+	mFlags(flags),
+	mQueuePos(request_queue_t::NOT_QUEUED),
+	mPriorityChanged(false),
+	mQueuedAt(0),
+	mQueueWaitTime(0),
+	mRunTime(0)
 {
 }
 
@@ -565,3 +594,151 @@ void LLQueuedThread::QueuedRequest::deleteRequest()
 	setStatus(STATUS_DELETE);
 	delete this;
 }
+
+//============================================================================
+
+LLQueuedThread::QueuedRequest* LLQueuedThread::request_queue_t::top()
+{
+	applyChanges();
+	return mHeap.empty() ? NULL : mHeap.front().mRequest;
+}
+
+LLQueuedThread::QueuedRequest* LLQueuedThread::request_queue_t::pop()
+{
+	applyChanges();
+	if (mHeap.empty())
+	{
+		return NULL;
+	}
+	QueuedRequest* req = mHeap.front().mRequest;
+	req->mQueuePos = NOT_QUEUED;
+	Entry last = mHeap.back();
+	mHeap.pop_back();
+	if (!mHeap.empty())
+	{
+		place(last, 0);
+		siftDown(0);
+	}
+	return req;
+}
+
+void LLQueuedThread::request_queue_t::insert(QueuedRequest* req)
+{
+	llassert(req->mQueuePos == NOT_QUEUED);
+	applyChanges();
+	Entry entry = { req->getPriority(), req->getHashKey(), req };
+	mHeap.push_back(entry);
+	req->mQueuePos = mHeap.size() - 1;
+	siftUp(req->mQueuePos);
+}
+
+void LLQueuedThread::request_queue_t::setPriority(QueuedRequest* req, U32 priority)
+{
+	llassert(req->mQueuePos != NOT_QUEUED);
+	req->setPriority(priority);
+	if (!req->mPriorityChanged)
+	{
+		req->mPriorityChanged = true;
+		mChanged.push_back(req);
+	}
+}
+
+void LLQueuedThread::request_queue_t::applyChanges()
+{
+	if (mChanged.empty())
+	{
+		return;
+	}
+	// A sift costs about 4 compares per level, a rebuild about 2 per entry:
+	// past a few percent of the queue, rebuilding wins.
+	if (mChanged.size() * 16 > mHeap.size())
+	{
+		for (QueuedRequest* req : mChanged)
+		{
+			req->mPriorityChanged = false;
+		}
+		for (Entry& entry : mHeap)
+		{
+			entry.mPriority = entry.mRequest->getPriority();
+		}
+		for (size_t pos = mHeap.size() / 4 + 1; pos-- > 0; )
+		{
+			siftDown(pos);
+		}
+	}
+	else
+	{
+		for (QueuedRequest* req : mChanged)
+		{
+			req->mPriorityChanged = false;
+			size_t pos = req->mQueuePos;
+			U32 old_priority = mHeap[pos].mPriority;
+			mHeap[pos].mPriority = req->getPriority();
+			if (req->getPriority() > old_priority)
+			{
+				siftUp(pos);
+			}
+			else
+			{
+				siftDown(pos);
+			}
+		}
+	}
+	mChanged.clear();
+}
+
+void LLQueuedThread::request_queue_t::siftUp(size_t pos)
+{
+	Entry entry = mHeap[pos];
+	while (pos > 0)
+	{
+		size_t parent = (pos - 1) / 4;
+		if (!(entry < mHeap[parent]))
+		{
+			break;
+		}
+		place(mHeap[parent], pos);
+		pos = parent;
+	}
+	place(entry, pos);
+}
+
+void LLQueuedThread::request_queue_t::siftDown(size_t pos)
+{
+	const size_t count = mHeap.size();
+	if (pos >= count)
+	{
+		return;
+	}
+	Entry entry = mHeap[pos];
+	while (true)
+	{
+		size_t first = pos * 4 + 1;
+		if (first >= count)
+		{
+			break;
+		}
+		size_t best = first;
+		size_t last = llmin(first + 4, count);
+		for (size_t child = first + 1; child < last; ++child)
+		{
+			if (mHeap[child] < mHeap[best])
+			{
+				best = child;
+			}
+		}
+		if (!(mHeap[best] < entry))
+		{
+			break;
+		}
+		place(mHeap[best], pos);
+		pos = best;
+	}
+	place(entry, pos);
+}
+
+void LLQueuedThread::request_queue_t::place(const Entry& entry, size_t pos)
+{
+	mHeap[pos] = entry;
+	entry.mRequest->mQueuePos = pos;
+}
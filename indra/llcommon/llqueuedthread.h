@@ -31,6 +31,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "llatomic.h"
 
@@ -96,6 +97,16 @@ public:
 		{
 			return mFlags;
 		}
+		// Latency stats, in microseconds: time spent waiting in the queue,
+		// and time spent in processRequest(), over all attempts so far
+		U64 getQueueWaitTime() const
+		{
+			return mQueueWaitTime;
+		}
+		U64 getRunTime() const
+		{
+			return mRunTime;
+		}
 		bool higherPriority(const QueuedRequest& second) const
 		{
 			if ( mPriority == second.mPriority)
@@ -131,15 +142,78 @@ public:
 		LLAtomicBase<status_t> mStatus;
 		U32 mPriority;
 		U32 mFlags;
+
+	private:
+		// Managed by LLQueuedThread under its data lock
+		size_t mQueuePos;		// index in the request heap, or request_queue_t::NOT_QUEUED
+		bool mPriorityChanged;	// already on the heap's list of changes
+		U64 mQueuedAt;
+		U64 mQueueWaitTime;
+		U64 mRunTime;
 	};
 
 protected:
-	struct queued_request_less
+	// Queued requests, highest priority first, in the same order the old
+	// std::set used. A 4-ary heap indexed by position: each request remembers
+	// where it sits, so changing a priority never searches. Changes are only
+	// written down until the next insert() or pop() sorts them out together,
+	// making setPriority() O(1) and a frame's worth of priority churn cost at
+	// most one O(N) rebuild instead of an erase and insert per change.
+	class request_queue_t
 	{
-		bool operator()(const QueuedRequest* lhs, const QueuedRequest* rhs) const
+	private:
+		// The heap keeps its own copy of the sort key, the request's
+		// priority may have moved on since
+		struct Entry
 		{
-			return lhs->higherPriority(*rhs); // higher priority in front of queue (set)
-		}
+			U32 mPriority;
+			handle_t mHandle;
+			QueuedRequest* mRequest;
+
+			bool operator<(const Entry& rhs) const
+			{
+				// same as QueuedRequest::higherPriority()
+				if (mPriority == rhs.mPriority)
+					return mHandle < rhs.mHandle;
+				return mPriority > rhs.mPriority;
+			}
+		};
+
+	public:
+		static const size_t NOT_QUEUED = ~size_t(0);
+
+		// Visits the queued requests in heap order, not priority order
+		class const_iterator
+		{
+		public:
+			const_iterator(std::vector<Entry>::const_iterator iter): mIter(iter) {}
+			QueuedRequest* operator*() const { return mIter->mRequest; }
+			const_iterator& operator++() { ++mIter; return *this; }
+			bool operator==(const const_iterator& rhs) const { return mIter == rhs.mIter; }
+			bool operator!=(const const_iterator& rhs) const { return mIter != rhs.mIter; }
+		private:
+			std::vector<Entry>::const_iterator mIter;
+		};
+
+		const_iterator begin() const { return const_iterator(mHeap.begin()); }
+		const_iterator end() const { return const_iterator(mHeap.end()); }
+		bool empty() const { return mHeap.empty(); }
+		size_t size() const { return mHeap.size(); }
+		// The highest priority request, NULL if empty
+		QueuedRequest* top();
+		QueuedRequest* pop();
+		void insert(QueuedRequest* req);
+		// req must be queued
+		void setPriority(QueuedRequest* req, U32 priority);
+
+	private:
+		void applyChanges();
+		void siftUp(size_t pos);
+		void siftDown(size_t pos);
+		void place(const Entry& entry, size_t pos);
+
+		std::vector<Entry> mHeap;
+		std::vector<QueuedRequest*> mChanged;
 	};
 
 
@@ -200,7 +274,6 @@ protected:
 	BOOL mStarted;  // required when mThreaded is false to call startThread() from update()
 	LLAtomicBool mIdleThread; // request queue is empty (or we are quitting) and the thread is idle
 	
-	typedef std::set<QueuedRequest*, queued_request_less> request_queue_t;
 	request_queue_t mRequestQueue;
 
 	enum { REQUEST_HASH_SIZE = 512 }; // must be power of 2
@@ -208,6 +281,15 @@ protected:
 	request_hash_t mRequestHash;
 
 	handle_t mNextHandle;
+
+	// Latency stats over completed requests, in microseconds
+	U32 mStatsCompleted;
+	U64 mStatsQueueWaitTotal;
+	U64 mStatsQueueWaitMax;
+	U64 mStatsRunTotal;
+
+private:
+	void recordCompleted(const QueuedRequest* req);
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
@@ -0,0 +1,830 @@
+/**
+ * @file llsdarena.cpp
+ * @brief Immutable, arena allocated LLSD documents
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llsdarena.h"
+
+#include <algorithm>
+
+#include "llerror.h"
+
+namespace
+{
+	const size_t ALIGNMENT = 8;
+	const size_t INITIAL_CAPACITY = 4096;
+	// Relative key offsets are 32 bit
+	const size_t MAX_DOCUMENT_BYTES = 0x7fffffff;
+	// Maps at most this big are sorted in place, larger ones with stable_sort
+	const size_t INSERTION_SORT_MAX = 16;
+
+	inline size_t align(size_t bytes)
+	{
+		return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	// Same ordering as std::string::compare(), so maps iterate in the same
+	// order as LLSD's std::map
+	inline int compare_keys(const char* a, size_t a_len, const char* b, size_t b_len)
+	{
+		int cmp = memcmp(a, b, llmin(a_len, b_len));
+		if (cmp)
+		{
+			return cmp;
+		}
+		return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+	}
+
+	inline U32 hash_key(const char* key, size_t length)
+	{
+		// FNV-1a
+		U32 hash = 2166136261u;
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= (U8)key[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+}
+
+//============================================================================
+// LLSDArena
+
+LLSDArena::LLSDArena(U8* data, size_t size, size_t root)
+:	mData(data),
+	mSize(size),
+	mRoot(root)
+{
+}
+
+LLSDArena::~LLSDArena()
+{
+	free(mData);
+}
+
+//static
+LLPointer<LLSDArena> LLSDArena::fromLLSD(const LLSD& value)
+{
+	Builder builder;
+	builder.addLLSD(value);
+	return builder.finish();
+}
+
+//============================================================================
+// LLSDArena::Key
+
+bool LLSDArena::Key::operator==(const char* other) const
+{
+	return other && strcmp(c_str(), other) == 0 && strlen(other) == mLength;
+}
+
+bool LLSDArena::Key::operator==(const LLSD::String& other) const
+{
+	return other.size() == mLength && memcmp(c_str(), other.data(), mLength) == 0;
+}
+
+//============================================================================
+// LLSDArena::Value
+
+//static
+const LLSDArena::Value& LLSDArena::Value::undef()
+{
+	// TypeUndefined is 0, so all zeroes is an undefined value
+	static const U64 sUndefined[sizeof(Value) / sizeof(U64)] = { 0 };
+	return *(const Value*)sUndefined;
+}
+
+// Conversions between types follow LLSD. The uncommon ones go through a
+// temporary LLSD scalar so that they cannot drift from it.
+
+LLSD::Boolean LLSDArena::Value::asBoolean() const
+{
+	switch (type())
+	{
+	case LLSD::TypeBoolean:	return mBoolean;
+	case LLSD::TypeInteger:	return mInteger != 0;
+	case LLSD::TypeString:
+	case LLSD::TypeMap:
+	case LLSD::TypeArray:	return mSize != 0;
+	case LLSD::TypeReal:	return toLLSD().asBoolean();
+	default:				return false;
+	}
+}
+
+LLSD::Integer LLSDArena::Value::asInteger() const
+{
+	switch (type())
+	{
+	case LLSD::TypeBoolean:	return mBoolean ? 1 : 0;
+	case LLSD::TypeInteger:	return mInteger;
+	case LLSD::TypeReal:
+	case LLSD::TypeString:
+	case LLSD::TypeDate:	return toLLSD().asInteger();
+	default:				return 0;
+	}
+}
+
+LLSD::Real LLSDArena::Value::asReal() const
+{
+	switch (type())
+	{
+	case LLSD::TypeBoolean:	return mBoolean ? 1 : 0;
+	case LLSD::TypeInteger:	return mInteger;
+	case LLSD::TypeReal:
+	case LLSD::TypeDate:	return mReal;
+	case LLSD::TypeString:	return toLLSD().asReal();
+	default:				return 0.0;
+	}
+}
+
+LLSD::String LLSDArena::Value::asString() const
+{
+	switch (type())
+	{
+	case LLSD::TypeString:
+	case LLSD::TypeURI:		return LLSD::String((const char*)data(), mSize);
+	case LLSD::TypeBoolean:
+	case LLSD::TypeInteger:
+	case LLSD::TypeReal:
+	case LLSD::TypeUUID:
+	case LLSD::TypeDate:	return toLLSD().asString();
+	default:				return LLSD::String();
+	}
+}
+
+LLSD::UUID LLSDArena::Value::asUUID() const
+{
+	switch (type())
+	{
+	case LLSD::TypeUUID:
+	{
+		LLUUID id;
+		memcpy(id.mData, mUUID, UUID_BYTES);
+		return id;
+	}
+	case LLSD::TypeString:	return LLUUID(asString());
+	default:				return LLUUID();
+	}
+}
+
+LLSD::Date LLSDArena::Value::asDate() const
+{
+	switch (type())
+	{
+	case LLSD::TypeDate:	return LLDate(mReal);
+	case LLSD::TypeString:	return LLDate(asString());
+	default:				return LLDate();
+	}
+}
+
+LLSD::URI LLSDArena::Value::asURI() const
+{
+	switch (type())
+	{
+	case LLSD::TypeURI:
+	case LLSD::TypeString:	return LLURI(asString());
+	default:				return LLURI();
+	}
+}
+
+LLSD::Binary LLSDArena::Value::asBinary() const
+{
+	if (!isBinary())
+	{
+		return LLSD::Binary();
+	}
+	return LLSD::Binary(data(), data() + mSize);
+}
+
+const char* LLSDArena::Value::asCString() const
+{
+	if (isString() || isURI())
+	{
+		return (const char*)data();
+	}
+	return "";
+}
+
+const U8* LLSDArena::Value::getBinaryData() const
+{
+	return isBinary() ? data() : NULL;
+}
+
+size_t LLSDArena::Value::getBinarySize() const
+{
+	return isBinary() ? mSize : 0;
+}
+
+int LLSDArena::Value::size() const
+{
+	switch (type())
+	{
+	case LLSD::TypeString:
+	case LLSD::TypeMap:
+	case LLSD::TypeArray:	return (int)mSize;
+	default:				return 0;
+	}
+}
+
+const LLSDArena::Entry* LLSDArena::Value::find(const char* k, size_t length) const
+{
+	if (!isMap())
+	{
+		return NULL;
+	}
+
+	const Entry* first = beginMap();
+	size_t count = mSize;
+	while (count > 0)
+	{
+		size_t half = count / 2;
+		const Entry* mid = first + half;
+		if (compare_keys(mid->first.c_str(), mid->first.size(), k, length) < 0)
+		{
+			first = mid + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+
+	if (first != endMap() && compare_keys(first->first.c_str(), first->first.size(), k, length) == 0)
+	{
+		return first;
+	}
+	return NULL;
+}
+
+bool LLSDArena::Value::has(const char* k) const
+{
+	return k && find(k, strlen(k)) != NULL;
+}
+
+const LLSDArena::Value& LLSDArena::Value::operator[](const LLSD::String& k) const
+{
+	const Entry* entry = find(k.c_str(), k.size());
+	return entry ? entry->second : undef();
+}
+
+const LLSDArena::Value& LLSDArena::Value::operator[](const char* k) const
+{
+	const Entry* entry = k ? find(k, strlen(k)) : NULL;
+	return entry ? entry->second : undef();
+}
+
+const LLSDArena::Value& LLSDArena::Value::operator[](LLSD::Integer i) const
+{
+	if (!isArray() || i < 0 || (U32)i >= mSize)
+	{
+		return undef();
+	}
+	return beginArray()[i];
+}
+
+LLSDArena::Value::map_const_iterator LLSDArena::Value::beginMap() const
+{
+	return isMap() ? (const Entry*)data() : NULL;
+}
+
+LLSDArena::Value::map_const_iterator LLSDArena::Value::endMap() const
+{
+	return isMap() ? (const Entry*)data() + mSize : NULL;
+}
+
+LLSDArena::Value::array_const_iterator LLSDArena::Value::beginArray() const
+{
+	return isArray() ? (const Value*)data() : NULL;
+}
+
+LLSDArena::Value::array_const_iterator LLSDArena::Value::endArray() const
+{
+	return isArray() ? (const Value*)data() + mSize : NULL;
+}
+
+LLSD LLSDArena::Value::toLLSD() const
+{
+	switch (type())
+	{
+	case LLSD::TypeBoolean:	return LLSD(mBoolean);
+	case LLSD::TypeInteger:	return LLSD(mInteger);
+	case LLSD::TypeReal:	return LLSD(mReal);
+	case LLSD::TypeString:	return LLSD(asString());
+	case LLSD::TypeUUID:	return LLSD(asUUID());
+	case LLSD::TypeDate:	return LLSD(LLDate(mReal));
+	case LLSD::TypeURI:		return LLSD(LLURI(asString()));
+	case LLSD::TypeBinary:	return LLSD(asBinary());
+	case LLSD::TypeMap:
+	{
+		LLSD map = LLSD::emptyMap();
+		for (map_const_iterator iter = beginMap(); iter != endMap(); ++iter)
+		{
+			map.insert(iter->first.asString(), iter->second.toLLSD());
+		}
+		return map;
+	}
+	case LLSD::TypeArray:
+	{
+		LLSD array = LLSD::emptyArray();
+		for (array_const_iterator iter = beginArray(); iter != endArray(); ++iter)
+		{
+			array.append(iter->toLLSD());
+		}
+		return array;
+	}
+	default:
+		return LLSD();
+	}
+}
+
+//============================================================================
+// LLSDArena::Builder
+
+LLSDArena::Builder::Builder()
+:	mData(NULL),
+	mSize(0),
+	mCapacity(0),
+	mKeyCount(0),
+	mNextKey(0),
+	mFailed(false)
+{
+}
+
+LLSDArena::Builder::~Builder()
+{
+	free(mData);
+}
+
+void LLSDArena::Builder::reset()
+{
+	free(mData);
+	mData = NULL;
+	mSize = 0;
+	mCapacity = 0;
+
+	mPending.clear();
+	mContainers.clear();
+
+	// Don't hang onto a huge table because of one big document
+	if (mKeyTable.size() > 1024)
+	{
+		std::vector<U32>().swap(mKeyTable);
+	}
+	else
+	{
+		std::fill(mKeyTable.begin(), mKeyTable.end(), 0);
+	}
+	mKeyCount = 0;
+	mNextKey = 0;
+	mFailed = false;
+}
+
+size_t LLSDArena::Builder::allocate(size_t bytes)
+{
+	size_t offset = mSize;
+	size_t size = align(mSize + bytes);
+	if (size > MAX_DOCUMENT_BYTES)
+	{
+		mFailed = true;
+		return 0;
+	}
+
+	if (size > mCapacity)
+	{
+		size_t capacity = llmax(mCapacity * 2, INITIAL_CAPACITY);
+		while (capacity < size)
+		{
+			capacity *= 2;
+		}
+		U8* data = (U8*)realloc(mData, capacity);
+		if (!data)
+		{
+			LL_WARNS() << "Out of memory building a " << capacity << " byte LLSD document" << LL_ENDL;
+			mFailed = true;
+			return 0;
+		}
+		mData = data;
+		mCapacity = capacity;
+	}
+
+	mSize = size;
+	return offset;
+}
+
+U32 LLSDArena::Builder::intern(const char* key, size_t length)
+{
+	if (mKeyCount * 2 >= mKeyTable.size())
+	{
+		// Rehash into a table twice the size
+		std::vector<U32> table(llmax(mKeyTable.size() * 2, (size_t)64), 0);
+		const size_t mask = table.size() - 1;
+		for (U32 slot : mKeyTable)
+		{
+			if (slot)
+			{
+				const char* text = (const char*)mData + slot - 1;
+				U32 text_length = *(const U32*)(text - sizeof(U32));
+				size_t index = hash_key(text, text_length) & mask;
+				while (table[index])
+				{
+					index = (index + 1) & mask;
+				}
+				table[index] = slot;
+			}
+		}
+		mKeyTable.swap(table);
+	}
+
+	const size_t mask = mKeyTable.size() - 1;
+	size_t index = hash_key(key, length) & mask;
+	while (U32 slot = mKeyTable[index])
+	{
+		const char* text = (const char*)mData + slot - 1;
+		if (*(const U32*)(text - sizeof(U32)) == length && memcmp(text, key, length) == 0)
+		{
+			return slot - 1;
+		}
+		index = (index + 1) & mask;
+	}
+
+	// New key: length then nul terminated text
+	size_t offset = allocate(sizeof(U32) + length + 1);
+	if (mFailed)
+	{
+		return 0;
+	}
+	*(U32*)(mData + offset) = (U32)length;
+	memcpy(mData + offset + sizeof(U32), key, length);
+	mData[offset + sizeof(U32) + length] = 0;
+
+	U32 text = (U32)(offset + sizeof(U32));
+	mKeyTable[index] = text + 1;
+	++mKeyCount;
+	return text;
+}
+
+bool LLSDArena::Builder::takeKey(U32& key)
+{
+	key = 0;
+	if (mFailed)
+	{
+		return false;
+	}
+
+	if (mContainers.empty())
+	{
+		// Only one top level value
+		if (!mPending.empty())
+		{
+			mFailed = true;
+		}
+		return !mFailed;
+	}
+
+	if (mContainers.back().mType == LLSD::TypeMap)
+	{
+		if (!mNextKey)
+		{
+			// Value without a key
+			mFailed = true;
+			return false;
+		}
+		key = mNextKey - 1;
+		mNextKey = 0;
+	}
+	return true;
+}
+
+LLSDArena::Builder::Pending& LLSDArena::Builder::push(U8 type)
+{
+	U32 key = 0;
+	takeKey(key);
+
+	mPending.push_back(Pending());
+	Pending& pending = mPending.back();
+	pending.mKey = key;
+	pending.mType = type;
+	pending.mSize = 0;
+	memset(pending.mUUID, 0, UUID_BYTES);
+	return pending;
+}
+
+void LLSDArena::Builder::pushData(U8 type, const void* data, size_t length, bool terminate)
+{
+	size_t offset = allocate(length + (terminate ? 1 : 0));
+	if (!mFailed)
+	{
+		if (length)
+		{
+			memcpy(mData + offset, data, length);
+		}
+		if (terminate)
+		{
+			mData[offset + length] = 0;
+		}
+	}
+
+	Pending& pending = push(type);
+	pending.mSize = (U32)length;
+	pending.mOffset = offset;
+}
+
+void LLSDArena::Builder::addUndefined()
+{
+	push(LLSD::TypeUndefined);
+}
+
+void LLSDArena::Builder::addBoolean(LLSD::Boolean value)
+{
+	push(LLSD::TypeBoolean).mBoolean = value;
+}
+
+void LLSDArena::Builder::addInteger(LLSD::Integer value)
+{
+	push(LLSD::TypeInteger).mInteger = value;
+}
+
+void LLSDArena::Builder::addReal(LLSD::Real value)
+{
+	push(LLSD::TypeReal).mReal = value;
+}
+
+void LLSDArena::Builder::addString(const char* value, size_t length)
+{
+	pushData(LLSD::TypeString, value, length, true);
+}
+
+void LLSDArena::Builder::addUUID(const LLSD::UUID& value)
+{
+	memcpy(push(LLSD::TypeUUID).mUUID, value.mData, UUID_BYTES);
+}
+
+void LLSDArena::Builder::addDate(const LLSD::Date& value)
+{
+	push(LLSD::TypeDate).mReal = value.secondsSinceEpoch();
+}
+
+void LLSDArena::Builder::addURI(const char* value, size_t length)
+{
+	pushData(LLSD::TypeURI, value, length, true);
+}
+
+void LLSDArena::Builder::addBinary(const U8* value, size_t length)
+{
+	pushData(LLSD::TypeBinary, value, length, false);
+}
+
+void LLSDArena::Builder::addLLSD(const LLSD& value)
+{
+	switch (value.type())
+	{
+	case LLSD::TypeBoolean:	addBoolean(value.asBoolean()); break;
+	case LLSD::TypeInteger:	addInteger(value.asInteger()); break;
+	case LLSD::TypeReal:	addReal(value.asReal()); break;
+	case LLSD::TypeString:	addString(value.asStringRef()); break;
+	case LLSD::TypeUUID:	addUUID(value.asUUID()); break;
+	case LLSD::TypeDate:	addDate(value.asDate()); break;
+	case LLSD::TypeURI:		addURI(value.asString()); break;
+	case LLSD::TypeBinary:
+	{
+		const LLSD::Binary& binary = value.asBinary();
+		addBinary(binary.empty() ? NULL : &binary[0], binary.size());
+		break;
+	}
+	case LLSD::TypeMap:
+		beginMap();
+		for (LLSD::map_const_iterator iter = value.beginMap(); iter != value.endMap(); ++iter)
+		{
+			addKey(iter->first);
+			addLLSD(iter->second);
+		}
+		endMap();
+		break;
+	case LLSD::TypeArray:
+		beginArray();
+		for (LLSD::array_const_iterator iter = value.beginArray(); iter != value.endArray(); ++iter)
+		{
+			addLLSD(*iter);
+		}
+		endArray();
+		break;
+	default:
+		addUndefined();
+		break;
+	}
+}
+
+void LLSDArena::Builder::beginMap()
+{
+	Container container;
+	container.mType = LLSD::TypeMap;
+	takeKey(container.mKey);
+	container.mFirst = mPending.size();
+	mContainers.push_back(container);
+}
+
+void LLSDArena::Builder::addKey(const char* key, size_t length)
+{
+	if (mContainers.empty() || mContainers.back().mType != LLSD::TypeMap)
+	{
+		mFailed = true;
+		return;
+	}
+	U32 text = intern(key, length);
+	mNextKey = mFailed ? 0 : text + 1;
+}
+
+void LLSDArena::Builder::beginArray()
+{
+	Container container;
+	container.mType = LLSD::TypeArray;
+	takeKey(container.mKey);
+	container.mFirst = mPending.size();
+	mContainers.push_back(container);
+}
+
+bool LLSDArena::Builder::keyLess(const Pending& a, const Pending& b) const
+{
+	const char* a_text = (const char*)mData + a.mKey;
+	const char* b_text = (const char*)mData + b.mKey;
+	return compare_keys(a_text, *(const U32*)(a_text - sizeof(U32)),
+						b_text, *(const U32*)(b_text - sizeof(U32))) < 0;
+}
+
+void LLSDArena::Builder::place(Value& value, const Pending& pending)
+{
+	value.mType = pending.mType;
+	value.mSize = pending.mSize;
+	switch (pending.mType)
+	{
+	case LLSD::TypeString:
+	case LLSD::TypeURI:
+	case LLSD::TypeBinary:
+	case LLSD::TypeMap:
+	case LLSD::TypeArray:
+		value.mOffset = (S64)pending.mOffset - (S64)((U8*)&value - mData);
+		break;
+	default:
+		memcpy(value.mUUID, pending.mUUID, UUID_BYTES);
+		break;
+	}
+}
+
+void LLSDArena::Builder::endMap()
+{
+	if (mContainers.empty() || mContainers.back().mType != LLSD::TypeMap)
+	{
+		mFailed = true;
+		return;
+	}
+	const Container container = mContainers.back();
+	mContainers.pop_back();
+	mNextKey = 0;
+
+	std::vector<Pending>::iterator first = mPending.begin() + container.mFirst;
+	std::vector<Pending>::iterator last = mPending.end();
+	if (!mFailed)
+	{
+		auto less = [this](const Pending& a, const Pending& b) { return keyLess(a, b); };
+		// Maps that were serialized from LLSD come sorted already
+		if (!std::is_sorted(first, last, less))
+		{
+			if ((size_t)(last - first) <= INSERTION_SORT_MAX)
+			{
+				for (std::vector<Pending>::iterator i = first + 1; i < last; ++i)
+				{
+					Pending pending = *i;
+					std::vector<Pending>::iterator j = i;
+					for (; j > first && less(pending, *(j - 1)); --j)
+					{
+						*j = *(j - 1);
+					}
+					*j = pending;
+				}
+			}
+			else
+			{
+				std::stable_sort(first, last, less);
+			}
+		}
+
+		// Keys are interned so duplicates have the same offset. The sort
+		// is stable, keep the last one.
+		std::vector<Pending>::iterator out = first;
+		for (std::vector<Pending>::iterator i = first; i < last; ++i)
+		{
+			if (i + 1 < last && (i + 1)->mKey == i->mKey)
+			{
+				continue;
+			}
+			*out++ = *i;
+		}
+		last = out;
+	}
+
+	const size_t count = last - first;
+	const size_t offset = allocate(count * sizeof(Entry));
+	if (!mFailed)
+	{
+		Entry* entries = (Entry*)(mData + offset);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Pending& pending = *(first + i);
+			Entry& entry = entries[i];
+			entry.first.mOffset = (S32)((S64)pending.mKey - (S64)((U8*)&entry.first - mData));
+			entry.first.mLength = *(const U32*)(mData + pending.mKey - sizeof(U32));
+			place(entry.second, pending);
+		}
+	}
+
+	mPending.resize(container.mFirst);
+	mPending.push_back(Pending());
+	Pending& map = mPending.back();
+	map.mKey = container.mKey;
+	map.mType = LLSD::TypeMap;
+	map.mSize = (U32)count;
+	map.mOffset = offset;
+}
+
+void LLSDArena::Builder::endArray()
+{
+	if (mContainers.empty() || mContainers.back().mType != LLSD::TypeArray)
+	{
+		mFailed = true;
+		return;
+	}
+	const Container container = mContainers.back();
+	mContainers.pop_back();
+
+	const size_t count = mPending.size() - container.mFirst;
+	const size_t offset = allocate(count * sizeof(Value));
+	if (!mFailed)
+	{
+		Value* values = (Value*)(mData + offset);
+		for (size_t i = 0; i < count; ++i)
+		{
+			place(values[i], mPending[container.mFirst + i]);
+		}
+	}
+
+	mPending.resize(container.mFirst);
+	mPending.push_back(Pending());
+	Pending& array = mPending.back();
+	array.mKey = container.mKey;
+	array.mType = LLSD::TypeArray;
+	array.mSize = (U32)count;
+	array.mOffset = offset;
+}
+
+bool LLSDArena::Builder::isComplete() const
+{
+	return !mFailed && mContainers.empty() && mPending.size() == 1;
+}
+
+LLPointer<LLSDArena> LLSDArena::Builder::finish()
+{
+	LLPointer<LLSDArena> document;
+	if (isComplete())
+	{
+		size_t root = allocate(sizeof(Value));
+		if (!mFailed)
+		{
+			place(*(Value*)(mData + root), mPending.back());
+
+			// Give back the slack from growing
+			U8* data = (U8*)realloc(mData, mSize);
+			if (data)
+			{
+				mData = data;
+			}
+			document = new LLSDArena(mData, mSize, root);
+			mData = NULL;
+		}
+	}
+	reset();
+	return document;
+}
@@ -0,0 +1,343 @@
+/**
+ * @file llsdarena.h
+ * @brief Immutable, arena allocated LLSD documents
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDARENA_H
+#define LL_LLSDARENA_H
+
+#include <vector>
+
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "llsd.h"
+
+/**
+	LLSDArena is a read only LLSD document that lives in a single block of
+	memory.
+
+	Every LLSD value is its own reference counted heap object, and every
+	map entry another node of a std::map, so a large response such as an
+	inventory fetch turns into millions of small allocations that are all
+	freed again one at a time. An LLSDArena holds the same data packed into
+	one allocation:
+		- scalars are stored inline
+		- strings, URIs and binary data are copied into the block once
+		- map keys are interned, each distinct key is stored once per
+		  document however many maps use it
+		- maps are flat arrays of entries sorted by key, looked up with a
+		  binary search, arrays are flat arrays of values
+
+	Values are read with the same accessors as LLSD (type(), isMap(),
+	asInteger(), asString(), has(), operator[], size(), beginMap() ...)
+	and with the same conversion rules between types, so code that only
+	reads a response can usually switch by changing the type it holds.
+	Lookups that miss return an undefined value, never throw. toLLSD()
+	converts the whole or part of a document for code that needs to modify
+	it or hold onto it.
+
+	Documents are built with LLSDArena::Builder, which the XML and binary
+	LLSD parsers can drive directly (see LLSDParser::parse() and
+	LLSDSerialize::fromXML()), so a response never exists as an LLSD tree
+	at all.
+
+	Documents are immutable once built and so are safe to read from any
+	number of threads. References to values are only valid while the
+	document is referenced.
+*/
+class LL_COMMON_API LLSDArena : public LLThreadSafeRefCount
+{
+public:
+	class Value;
+	class Builder;
+
+	/**
+	 * @brief A map key, stored once in the document.
+	 *
+	 * Keys are nul terminated.
+	 */
+	class LL_COMMON_API Key
+	{
+	public:
+		const char* c_str() const	{ return (const char*)this + mOffset; }
+		U32 size() const			{ return mLength; }
+		LLSD::String asString() const	{ return LLSD::String(c_str(), mLength); }
+		operator LLSD::String() const	{ return asString(); }
+
+		bool operator==(const char* other) const;
+		bool operator==(const LLSD::String& other) const;
+		bool operator!=(const char* other) const			{ return !(*this == other); }
+		bool operator!=(const LLSD::String& other) const	{ return !(*this == other); }
+
+	private:
+		friend class Builder;
+
+		// Offsets are relative to the object itself so a document can be
+		// moved and reallocated while it is built
+		S32 mOffset;
+		U32 mLength;
+	};
+
+	struct Entry;
+
+	/**
+	 * @brief One value in a document.
+	 *
+	 * Mirrors the read only half of the LLSD interface.
+	 */
+	class LL_COMMON_API Value
+	{
+	public:
+		typedef const Entry* map_const_iterator;
+		typedef const Value* array_const_iterator;
+
+		LLSD::Type type() const		{ return (LLSD::Type)mType; }
+
+		bool isUndefined() const	{ return type() == LLSD::TypeUndefined; }
+		bool isDefined() const		{ return type() != LLSD::TypeUndefined; }
+		bool isBoolean() const		{ return type() == LLSD::TypeBoolean; }
+		bool isInteger() const		{ return type() == LLSD::TypeInteger; }
+		bool isReal() const			{ return type() == LLSD::TypeReal; }
+		bool isString() const		{ return type() == LLSD::TypeString; }
+		bool isUUID() const			{ return type() == LLSD::TypeUUID; }
+		bool isDate() const			{ return type() == LLSD::TypeDate; }
+		bool isURI() const			{ return type() == LLSD::TypeURI; }
+		bool isBinary() const		{ return type() == LLSD::TypeBinary; }
+		bool isMap() const			{ return type() == LLSD::TypeMap; }
+		bool isArray() const		{ return type() == LLSD::TypeArray; }
+
+		LLSD::Boolean	asBoolean() const;
+		LLSD::Integer	asInteger() const;
+		LLSD::Real		asReal() const;
+		LLSD::String	asString() const;
+		LLSD::UUID		asUUID() const;
+		LLSD::Date		asDate() const;
+		LLSD::URI		asURI() const;
+		LLSD::Binary	asBinary() const;
+
+		/**
+		 * @brief Text of a string or URI without copying it, "" otherwise.
+		 */
+		const char* asCString() const;
+
+		/**
+		 * @brief Bytes of a binary value without copying them, NULL for
+		 * other types.
+		 */
+		const U8* getBinaryData() const;
+		size_t getBinarySize() const;
+
+		/**
+		 * @brief Number of entries of a map or array, length of a string,
+		 * 0 otherwise.
+		 */
+		int size() const;
+
+		bool has(const LLSD::String& k) const	{ return find(k.c_str(), k.size()) != NULL; }
+		bool has(const char* k) const;
+
+		const Value& operator[](const LLSD::String& k) const;
+		const Value& operator[](const char* k) const;
+		const Value& operator[](LLSD::Integer i) const;
+		const Value& get(const LLSD::String& k) const	{ return (*this)[k]; }
+		const Value& get(LLSD::Integer i) const			{ return (*this)[i]; }
+
+		map_const_iterator beginMap() const;
+		map_const_iterator endMap() const;
+		array_const_iterator beginArray() const;
+		array_const_iterator endArray() const;
+
+		/**
+		 * @brief Deep copy into a regular, modifiable LLSD.
+		 */
+		LLSD toLLSD() const;
+
+		static const Value& undef();
+
+	private:
+		friend class Builder;
+
+		const Entry* find(const char* k, size_t length) const;
+		const U8* data() const	{ return (const U8*)this + mOffset; }
+
+		// Maps and arrays: number of children. Strings, URIs and binary:
+		// length in bytes.
+		U8	mType;
+		U32	mSize;
+		union
+		{
+			LLSD::Boolean	mBoolean;
+			LLSD::Integer	mInteger;
+			LLSD::Real		mReal;		// also dates, seconds since epoch
+			U8				mUUID[UUID_BYTES];
+			S64				mOffset;	// relative to this
+		};
+	};
+
+	/**
+	 * @brief A key and value of a map, named like std::map's value_type
+	 */
+	struct Entry
+	{
+		Key		first;
+		Value	second;
+	};
+
+	/**
+	 * @brief Assembles a document from a sequence of parse events.
+	 *
+	 * Containers are opened and closed with begin/end calls. Inside a map
+	 * every value must be preceded by addKey(). If a map has the same key
+	 * more than once the last value wins, like assigning to LLSD::operator[].
+	 *
+	 * A Builder can be reused after finish() and keeps its scratch
+	 * buffers, so parsing many documents in a row does not allocate beyond
+	 * the documents themselves.
+	 */
+	class LL_COMMON_API Builder
+	{
+	public:
+		Builder();
+		~Builder();
+
+		void addUndefined();
+		void addBoolean(LLSD::Boolean value);
+		void addInteger(LLSD::Integer value);
+		void addReal(LLSD::Real value);
+		void addString(const char* value, size_t length);
+		void addString(const LLSD::String& value)	{ addString(value.data(), value.size()); }
+		void addUUID(const LLSD::UUID& value);
+		void addDate(const LLSD::Date& value);
+		void addURI(const char* value, size_t length);
+		void addURI(const LLSD::String& value)		{ addURI(value.data(), value.size()); }
+		void addBinary(const U8* value, size_t length);
+		void addLLSD(const LLSD& value);
+
+		void beginMap();
+		void addKey(const char* key, size_t length);
+		void addKey(const LLSD::String& key)		{ addKey(key.data(), key.size()); }
+		void endMap();
+
+		void beginArray();
+		void endArray();
+
+		/**
+		 * @brief True once a complete top level value has been added
+		 */
+		bool isComplete() const;
+
+		/**
+		 * @brief Hand over the document.
+		 *
+		 * Returns NULL if the events did not describe exactly one
+		 * complete value. Either way the builder is reset.
+		 */
+		LLPointer<LLSDArena> finish();
+
+		/**
+		 * @brief Discard everything added so far.
+		 */
+		void reset();
+
+	private:
+		// A value whose children and text are in the document but which
+		// is not placed yet; offsets are absolute until it is
+		struct Pending
+		{
+			U32		mKey;		// absolute offset of the interned key, maps only
+			U8		mType;
+			U32		mSize;
+			union
+			{
+				LLSD::Boolean	mBoolean;
+				LLSD::Integer	mInteger;
+				LLSD::Real		mReal;
+				U8				mUUID[UUID_BYTES];
+				size_t			mOffset;
+			};
+		};
+
+		struct Container
+		{
+			U8		mType;
+			U32		mKey;		// of the container itself, in its parent map
+			size_t	mFirst;		// first child in mPending
+		};
+
+		bool takeKey(U32& key);
+		Pending& push(U8 type);
+		void pushData(U8 type, const void* data, size_t length, bool terminate);
+		size_t allocate(size_t bytes);
+		U32 intern(const char* key, size_t length);
+		void place(Value& value, const Pending& pending);
+		bool keyLess(const Pending& a, const Pending& b) const;
+
+		U8*		mData;
+		size_t	mSize;
+		size_t	mCapacity;
+
+		std::vector<Pending>	mPending;
+		std::vector<Container>	mContainers;
+
+		// Open addressed table of absolute key offsets + 1, 0 when free
+		std::vector<U32>		mKeyTable;
+		U32						mKeyCount;
+		U32						mNextKey;	// key for the next map value, 0 if none
+		bool					mFailed;
+	};
+
+	/**
+	 * @brief Copy an LLSD into a new document
+	 */
+	static LLPointer<LLSDArena> fromLLSD(const LLSD& value);
+
+	const Value& root() const	{ return *(const Value*)(mData + mRoot); }
+
+	// Shortcuts through root()
+	LLSD::Type type() const							{ return root().type(); }
+	const Value& operator[](const LLSD::String& k) const	{ return root()[k]; }
+	const Value& operator[](const char* k) const	{ return root()[k]; }
+	const Value& operator[](LLSD::Integer i) const	{ return root()[i]; }
+	LLSD toLLSD() const								{ return root().toLLSD(); }
+
+	/**
+	 * @brief Bytes used by the document
+	 */
+	size_t getMemoryBytes() const	{ return mSize; }
+
+protected:
+	~LLSDArena();
+
+private:
+	LLSDArena(U8* data, size_t size, size_t root);
+
+	LLSDArena(const LLSDArena&) = delete;
+	LLSDArena& operator=(const LLSDArena&) = delete;
+
+	U8*		mData;
+	size_t	mSize;
+	size_t	mRoot;
+};
+
+#endif // LL_LLSDARENA_H
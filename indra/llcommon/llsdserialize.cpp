@@ -30,9 +30,9 @@
 #include "llsdserialize.h"
 #include "llpointer.h"
 #include "llstreamtools.h" // for fullread
+#include "llmemorystream.h"
 
 #include <iostream>
-#include "apr_base64.h"
 
 #ifdef LL_USESYSTEMLIBS
 # include <zlib.h>
@@ -44,8 +44,10 @@
 #include <netinet/in.h> // htonl & ntohl
 #endif
 
+#include "llbase64.h"
 #include "lldate.h"
 #include "llsd.h"
+#include "llsimdscan.h"
 #include "llstring.h"
 #include "lluri.h"
 
@@ -345,6 +347,294 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 	return doParse(istr, data);
 }
 
+namespace
+{
+	// Feeds parse events into an arena document
+	class ArenaHandler : public LLSDStreamHandler
+	{
+	public:
+		ArenaHandler(LLSDArena::Builder& builder) : mBuilder(builder) {}
+
+		virtual void onUndefined()						{ mBuilder.addUndefined(); }
+		virtual void onBoolean(LLSD::Boolean value)		{ mBuilder.addBoolean(value); }
+		virtual void onInteger(LLSD::Integer value)		{ mBuilder.addInteger(value); }
+		virtual void onReal(LLSD::Real value)			{ mBuilder.addReal(value); }
+		virtual void onString(const LLSD::String& value)	{ mBuilder.addString(value); }
+		virtual void onUUID(const LLSD::UUID& value)	{ mBuilder.addUUID(value); }
+		virtual void onDate(const LLSD::Date& value)	{ mBuilder.addDate(value); }
+		virtual void onURI(const LLSD::String& value)	{ mBuilder.addURI(value); }
+		virtual void onBinary(const U8* value, size_t length)	{ mBuilder.addBinary(value, length); }
+		virtual void onMapBegin()						{ mBuilder.beginMap(); }
+		virtual void onKey(const LLSD::String& key)		{ mBuilder.addKey(key); }
+		virtual void onMapEnd()							{ mBuilder.endMap(); }
+		virtual void onArrayBegin()						{ mBuilder.beginArray(); }
+		virtual void onArrayEnd()						{ mBuilder.endArray(); }
+		virtual void onLLSD(const LLSD& value)			{ mBuilder.addLLSD(value); }
+
+	private:
+		LLSDArena::Builder& mBuilder;
+	};
+}
+
+S32 LLSDParser::parse(std::istream& istr, LLSDArena::Builder& builder, S32 max_bytes, S32 max_depth)
+{
+	builder.reset();
+	ArenaHandler handler(builder);
+	S32 parse_count = parse(istr, handler, max_bytes, max_depth);
+	if (PARSE_FAILURE == parse_count)
+	{
+		builder.reset();
+	}
+	else if (!builder.isComplete())
+	{
+		// Nothing on the stream, same as parse() leaving data undefined
+		builder.reset();
+		builder.addUndefined();
+	}
+	return parse_count;
+}
+
+S32 LLSDParser::parse(std::istream& istr, LLSDStreamHandler& handler, S32 max_bytes, S32 max_depth)
+{
+	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
+	mMaxBytesLeft = max_bytes;
+	handler.reset();
+	S32 parse_count = doParseEvents(istr, handler, max_depth);
+	if (handler.isStopped())
+	{
+		parse_count = PARSE_FAILURE;
+	}
+	return parse_count;
+}
+
+// virtual
+S32 LLSDParser::doParseEvents(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const
+{
+	LLSD data;
+	S32 parse_count = doParse(istr, data, max_depth);
+	if (parse_count > 0)
+	{
+		handler.onLLSD(data);
+	}
+	return parse_count;
+}
+
+
+/**
+ * LLSDStreamHandler
+ */
+// virtual
+void LLSDStreamHandler::onLLSD(const LLSD& value)
+{
+	switch (value.type())
+	{
+	case LLSD::TypeBoolean:
+		onBoolean(value.asBoolean());
+		break;
+	case LLSD::TypeInteger:
+		onInteger(value.asInteger());
+		break;
+	case LLSD::TypeReal:
+		onReal(value.asReal());
+		break;
+	case LLSD::TypeString:
+		onString(value.asString());
+		break;
+	case LLSD::TypeUUID:
+		onUUID(value.asUUID());
+		break;
+	case LLSD::TypeDate:
+		onDate(value.asDate());
+		break;
+	case LLSD::TypeURI:
+		onURI(value.asString());
+		break;
+	case LLSD::TypeBinary:
+	{
+		const LLSD::Binary& binary = value.asBinary();
+		onBinary(binary.empty() ? NULL : &binary[0], binary.size());
+		break;
+	}
+	case LLSD::TypeMap:
+		onMapBegin();
+		for (LLSD::map_const_iterator iter = value.beginMap();
+			 iter != value.endMap() && !isStopped(); ++iter)
+		{
+			onKey(iter->first);
+			onLLSD(iter->second);
+		}
+		onMapEnd();
+		break;
+	case LLSD::TypeArray:
+		onArrayBegin();
+		for (LLSD::array_const_iterator iter = value.beginArray();
+			 iter != value.endArray() && !isStopped(); ++iter)
+		{
+			onLLSD(*iter);
+		}
+		onArrayEnd();
+		break;
+	default:
+		onUndefined();
+		break;
+	}
+}
+
+
+/**
+ * LLSDStreamCollector
+ */
+LLSDStreamCollector::LLSDStreamCollector(S32 depth, const callback_t& callback)
+	: mDepth(depth), mCallback(callback)
+{
+}
+
+// virtual
+void LLSDStreamCollector::reset()
+{
+	LLSDStreamHandler::reset();
+	// Left over when the last parse failed or was stopped
+	mLevels.clear();
+	mBuilding.clear();
+	mValue.clear();
+	mKey.clear();
+}
+
+// virtual
+void LLSDStreamCollector::onLLSD(const LLSD& value)
+{
+	if (mBuilding.empty() && (S32)mLevels.size() < mDepth && (value.isMap() || value.isArray()))
+	{
+		// Walk down to mDepth
+		LLSDStreamHandler::onLLSD(value);
+	}
+	else
+	{
+		// Already built, no need to copy it
+		addValue(value);
+	}
+}
+
+// virtual
+void LLSDStreamCollector::onURI(const LLSD::String& value)
+{
+	addValue(LLSD(LLURI(value)));
+}
+
+// virtual
+void LLSDStreamCollector::onBinary(const U8* value, size_t length)
+{
+	addValue(LLSD::Binary(value, value + length));
+}
+
+// virtual
+void LLSDStreamCollector::onKey(const LLSD::String& key)
+{
+	if (!mBuilding.empty())
+	{
+		mKey = key;
+	}
+	else if (!mLevels.empty())
+	{
+		mLevels.back().mKey = key;
+	}
+}
+
+void LLSDStreamCollector::addValue(const LLSD& value)
+{
+	if (!mBuilding.empty())
+	{
+		addChild(value);
+	}
+	else
+	{
+		// At or above mDepth, complete already
+		deliver(value);
+	}
+}
+
+void LLSDStreamCollector::beginContainer(const LLSD& value)
+{
+	if (!mBuilding.empty())
+	{
+		mBuilding.push_back(&addChild(value));
+	}
+	else if ((S32)mLevels.size() >= mDepth)
+	{
+		mValue = value;
+		mBuilding.push_back(&mValue);
+	}
+	else
+	{
+		Level level;
+		level.mIsMap = value.isMap();
+		level.mIndex = 0;
+		mLevels.push_back(level);
+	}
+}
+
+void LLSDStreamCollector::endContainer()
+{
+	if (!mBuilding.empty())
+	{
+		mBuilding.pop_back();
+		if (mBuilding.empty())
+		{
+			// Release the value before the next one is built
+			LLSD value = mValue;
+			mValue.clear();
+			deliver(value);
+		}
+	}
+	else if (!mLevels.empty())
+	{
+		mLevels.pop_back();
+		if (!mLevels.empty())
+		{
+			++mLevels.back().mIndex;
+		}
+	}
+}
+
+LLSD& LLSDStreamCollector::addChild(const LLSD& value)
+{
+	// Only the last child of a container is ever open, so references into
+	// an array stay valid until the next append to it
+	LLSD& parent = *mBuilding.back();
+	if (parent.isMap())
+	{
+		LLSD& child = parent[mKey];
+		child = value;
+		return child;
+	}
+	return parent.append(value);
+}
+
+void LLSDStreamCollector::deliver(const LLSD& value)
+{
+	LLSD path = LLSD::emptyArray();
+	for (const Level& level : mLevels)
+	{
+		if (level.mIsMap)
+		{
+			path.append(level.mKey);
+		}
+		else
+		{
+			path.append(level.mIndex);
+		}
+	}
+	if (!mLevels.empty())
+	{
+		++mLevels.back().mIndex;
+	}
+
+	if (!mCallback(path, value))
+	{
+		stop();
+	}
+}
+
 
 int LLSDParser::get(std::istream& istr) const
 {
@@ -823,14 +1113,8 @@ bool LLSDNotationParser::parseBinary(std::istream& istr, LLSD& data) const
 		get(istr, *(coded_stream.rdbuf()), '\"');
 		c = get(istr);
 		std::string encoded(coded_stream.str());
-		S32 len = apr_base64_decode_len(encoded.c_str());
 		std::vector<U8> value;
-		if(len)
-		{
-			value.resize(len);
-			len = apr_base64_decode_binary(&value[0], encoded.c_str());
-			value.resize(len);
-		}
+		LLBase64::decode(encoded.data(), encoded.size(), value);
 		data = value;
 	}
 	else if(0 == strncmp("b16", buf, 3))
@@ -864,45 +1148,929 @@ bool LLSDNotationParser::parseBinary(std::istream& istr, LLSD& data) const
 		}
 		data = value;
 	}
-	else
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Notation held in memory
+ */
+namespace
+{
+	// Reads notation from a buffer value for value the way
+	// LLSDNotationParser::doParse() reads it from a stream, but scans for
+	// delimiters instead of going through the stream a character at a
+	// time. Whenever it can not be sure to read something exactly like
+	// doParse(), malformed input included, it gives up and the caller
+	// hands the buffer to LLSDNotationParser instead. So it only ever has
+	// to agree with doParse() on input doParse() accepts.
+	class NotationBufferParser
+	{
+	public:
+		NotationBufferParser(const char* buf, size_t len)
+			: mPos(buf), mEnd(buf + len)
+		{
+		}
+
+		// Returns false to leave the buffer to the stream parser
+		bool parse(LLSD& data, S32 max_depth, S32& parse_count);
+
+	private:
+		bool parseMap(LLSD& map, S32 max_depth, S32& parse_count);
+		bool parseArray(LLSD& array, S32 max_depth, S32& parse_count);
+		bool parseString(std::string& value);
+		bool parseDelimited(char delim, std::string& value);
+		bool parseBoolean(const char* word);
+		bool parseInteger(LLSD& data);
+		bool parseReal(LLSD& data);
+		bool parseBinary(LLSD& data);
+
+		const char* mPos;
+		const char* mEnd;
+	};
+
+	inline bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline bool is_alpha(char c)
+	{
+		c |= 0x20;
+		return c >= 'a' && c <= 'z';
+	}
+
+	bool NotationBufferParser::parse(LLSD& data, S32 max_depth, S32& parse_count)
+	{
+		if (max_depth == 0)
+		{
+			return false;
+		}
+		mPos = ll_skip_space(mPos, mEnd);
+		if (mPos == mEnd)
+		{
+			parse_count = 0;
+			return true;
+		}
+
+		parse_count = 1;
+		switch (*mPos)
+		{
+		case '{':
+		{
+			S32 child_count = 0;
+			if (!parseMap(data, max_depth - 1, child_count))
+			{
+				return false;
+			}
+			parse_count += child_count;
+			break;
+		}
+
+		case '[':
+		{
+			S32 child_count = 0;
+			if (!parseArray(data, max_depth - 1, child_count))
+			{
+				return false;
+			}
+			parse_count += child_count;
+			break;
+		}
+
+		case '!':
+			++mPos;
+			data.clear();
+			break;
+
+		case '0':
+			++mPos;
+			data = false;
+			break;
+
+		case '1':
+			++mPos;
+			data = true;
+			break;
+
+		case 'F':
+		case 'f':
+			if (!parseBoolean("false"))
+			{
+				return false;
+			}
+			data = false;
+			break;
+
+		case 'T':
+		case 't':
+			if (!parseBoolean("true"))
+			{
+				return false;
+			}
+			data = true;
+			break;
+
+		case 'i':
+			++mPos;
+			if (!parseInteger(data))
+			{
+				return false;
+			}
+			break;
+
+		case 'r':
+			++mPos;
+			if (!parseReal(data))
+			{
+				return false;
+			}
+			break;
+
+		case 'u':
+		{
+			++mPos;
+			const S32 length = UUID_STR_LENGTH - 1;
+			if (mEnd - mPos < length)
+			{
+				return false;
+			}
+			for (S32 i = 0; i < length; ++i)
+			{
+				// operator>>(LLUUID) would skip it
+				if (ll_is_space(mPos[i]))
+				{
+					return false;
+				}
+			}
+			LLUUID id;
+			id.set(std::string(mPos, length));
+			mPos += length;
+			data = id;
+			break;
+		}
+
+		case '"':
+		case '\'':
+		case 's':
+		{
+			std::string value;
+			if (!parseString(value))
+			{
+				return false;
+			}
+			data = value;
+			break;
+		}
+
+		case 'l':
+		case 'd':
+		{
+			char type = *mPos++;
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			char delim = *mPos++;
+			std::string value;
+			if (!parseDelimited(delim, value))
+			{
+				return false;
+			}
+			if (type == 'l')
+			{
+				data = LLURI(value);
+			}
+			else
+			{
+				data = LLDate(value);
+			}
+			break;
+		}
+
+		case 'b':
+			if (!parseBinary(data))
+			{
+				return false;
+			}
+			break;
+
+		default:
+			return false;
+		}
+		return true;
+	}
+
+	// As LLSDNotationParser::parseMap(): before a key anything but the
+	// start of a string is skipped, between key and value whitespace and
+	// ':'. The first of repeated keys wins.
+	bool NotationBufferParser::parseMap(LLSD& map, S32 max_depth, S32& parse_count)
+	{
+		map = LLSD::emptyMap();
+		++mPos;
+		bool found_name = false;
+		std::string name;
+		while (mPos != mEnd)
+		{
+			char c = *mPos;
+			if (c == '}')
+			{
+				++mPos;
+				return true;
+			}
+			if (!found_name)
+			{
+				if (c == '"' || c == '\'' || c == 's')
+				{
+					if (!parseString(name))
+					{
+						return false;
+					}
+					found_name = true;
+				}
+				else
+				{
+					++mPos;
+				}
+			}
+			else if (ll_is_space(c) || c == ':')
+			{
+				++mPos;
+			}
+			else
+			{
+				LLSD child;
+				S32 count = 0;
+				if (!parse(child, max_depth, count) || count <= 0)
+				{
+					return false;
+				}
+				parse_count += count;
+				map.insert(name, child);
+				found_name = false;
+			}
+		}
+		return false;
+	}
+
+	bool NotationBufferParser::parseArray(LLSD& array, S32 max_depth, S32& parse_count)
+	{
+		array = LLSD::emptyArray();
+		++mPos;
+		while (true)
+		{
+			mPos = ll_skip_space(mPos, mEnd);
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			char c = *mPos;
+			if (c == ']')
+			{
+				++mPos;
+				return true;
+			}
+			if (c == ',')
+			{
+				++mPos;
+				continue;
+			}
+			LLSD child;
+			S32 count = 0;
+			if (!parse(child, max_depth, count))
+			{
+				return false;
+			}
+			parse_count += count;
+			array.append(child);
+		}
+	}
+
+	// deserialize_string(): "quoted", 'quoted' or s(size)"raw"
+	bool NotationBufferParser::parseString(std::string& value)
+	{
+		char c = *mPos++;
+		if (c == '"' || c == '\'')
+		{
+			return parseDelimited(c, value);
+		}
+
+		// deserialize_string_raw() looks for the ')' in the next 19
+		// characters
+		const char* close = (const char*)memchr(mPos, ')', llmin<size_t>(mEnd - mPos, 19));
+		if (!close || *mPos != '(' || mEnd - close < 2)
+		{
+			return false;
+		}
+		char quote = close[1];
+		if (quote != '"' && quote != '\'')
+		{
+			return false;
+		}
+		S32 len = strtol(std::string(mPos + 1, close).c_str(), NULL, 0);
+		mPos = close + 2;
+		// The text and the closing quote
+		if (len < 0 || len >= mEnd - mPos)
+		{
+			return false;
+		}
+		if (len)
+		{
+			// Like deserialize_string_raw(), an empty string leaves value
+			// as it was
+			value.assign(mPos, len);
+		}
+		mPos += len;
+		quote = *mPos++;
+		return quote == '"' || quote == '\'';
+	}
+
+	// deserialize_string_delim()
+	bool NotationBufferParser::parseDelimited(char delim, std::string& value)
+	{
+		if (delim == '\\')
+		{
+			// Can never close the string, an escape comes first
+			return false;
+		}
+		value.clear();
+		while (true)
+		{
+			const char* stop = ll_find_either(mPos, mEnd, delim, '\\');
+			value.append(mPos, stop);
+			mPos = stop;
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			if (*mPos++ == delim)
+			{
+				return true;
+			}
+			if (mPos == mEnd)
+			{
+				return false;
+			}
+			char c = *mPos++;
+			switch (c)
+			{
+			case 'x':
+				if (mEnd - mPos < 2)
+				{
+					return false;
+				}
+				value += (char)((hex_as_nybble(mPos[0]) << 4) | hex_as_nybble(mPos[1]));
+				mPos += 2;
+				break;
+			case 'a':
+				value += '\a';
+				break;
+			case 'b':
+				value += '\b';
+				break;
+			case 'f':
+				value += '\f';
+				break;
+			case 'n':
+				value += '\n';
+				break;
+			case 'r':
+				value += '\r';
+				break;
+			case 't':
+				value += '\t';
+				break;
+			case 'v':
+				value += '\v';
+				break;
+			default:
+				value += c;
+				break;
+			}
+		}
+	}
+
+	// t, T, true, TRUE, tRuE ... and the same for false: the rest of the
+	// word is only checked when a letter follows the first one
+	bool NotationBufferParser::parseBoolean(const char* word)
+	{
+		++mPos;
+		if (mPos == mEnd || !is_alpha(*mPos))
+		{
+			return mPos == mEnd || (U8)*mPos < 0x80;
+		}
+		for (S32 i = 1; word[i]; ++i)
+		{
+			if (mPos == mEnd || (*mPos | 0x20) != word[i])
+			{
+				return false;
+			}
+			++mPos;
+		}
+		return true;
+	}
+
+	// operator>>(S32) with no leading whitespace
+	bool NotationBufferParser::parseInteger(LLSD& data)
+	{
+		const char* p = mPos;
+		bool negative = false;
+		if (p != mEnd && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+		const char* digits = p;
+		S64 value = 0;
+		while (p != mEnd && is_digit(*p) && p - digits < 11)
+		{
+			value = value * 10 + (*p - '0');
+			++p;
+		}
+		if (p == digits || (p != mEnd && is_digit(*p)))
+		{
+			return false;
+		}
+		if (negative)
+		{
+			value = -value;
+		}
+		if (value < S32_MIN || value > S32_MAX)
+		{
+			return false;
+		}
+		data = (S32)value;
+		mPos = p;
+		return true;
+	}
+
+	// operator>>(F64): [sign] digits [. digits] [e [sign] digits], which
+	// the stream then converts with strtod()
+	bool NotationBufferParser::parseReal(LLSD& data)
+	{
+		F64 real;
+		const char* p = ll_scan_real(mPos, mEnd, real);
+		if (!p)
+		{
+			return false;
+		}
+		data = real;
+		mPos = p;
+		return true;
+	}
+
+	// LLSDNotationParser::parseBinary(): b(size)"raw", b64"base64" or
+	// b16"hex", the prefix ends at the first '"' within 255 characters
+	bool NotationBufferParser::parseBinary(LLSD& data)
+	{
+		const char* quote = (const char*)memchr(mPos, '"', llmin<size_t>(mEnd - mPos, 255));
+		if (!quote)
+		{
+			return false;
+		}
+		std::string prefix(mPos, quote);
+		mPos = quote + 1;
+
+		if (0 == strncmp("b(", prefix.c_str(), 2))
+		{
+			S32 len = strtol(prefix.c_str() + 2, NULL, 0);
+			// The data and a closing character that is not checked
+			if (len < 0 || len >= mEnd - mPos)
+			{
+				return false;
+			}
+			data = LLSD::Binary((const U8*)mPos, (const U8*)mPos + len);
+			mPos += len + 1;
+			return true;
+		}
+
+		const char* close = ll_find_either(mPos, mEnd, '"', '"');
+		if (close == mEnd)
+		{
+			return false;
+		}
+		if (0 == strncmp("b64", prefix.c_str(), 3))
+		{
+			if (close == mPos)
+			{
+				// Nothing to read fails the stream
+				return false;
+			}
+			LLSD::Binary value;
+			LLBase64::decode(mPos, close - mPos, value);
+			data = value;
+		}
+		else if (0 == strncmp("b16", prefix.c_str(), 3))
+		{
+			size_t length = close - mPos;
+			if (length % 2 || memchr(mPos, '\0', length))
+			{
+				return false;
+			}
+			LLSD::Binary value(length / 2);
+			for (size_t i = 0; i < value.size(); ++i)
+			{
+				value[i] = (hex_as_nybble(mPos[2 * i]) << 4) | hex_as_nybble(mPos[2 * i + 1]);
+			}
+			data = value;
+		}
+		else
+		{
+			return false;
+		}
+		mPos = close + 1;
+		return true;
+	}
+}
+
+// static
+S32 LLSDSerialize::fromNotation(LLSD& sd, const char* buf, size_t len, S32 max_depth)
+{
+	NotationBufferParser parser(buf, len);
+	LLSD data;
+	S32 parse_count = 0;
+	if (parser.parse(data, max_depth, parse_count))
+	{
+		if (parse_count > 0)
+		{
+			sd = data;
+		}
+		return parse_count;
+	}
+
+	LLMemoryStream stream((const U8*)buf, (S32)len);
+	LLPointer<LLSDNotationParser> p = new LLSDNotationParser;
+	return p->parse(stream, sd, (S32)len, max_depth);
+}
+
+
+/**
+ * LLSDBinaryParser
+ */
+LLSDBinaryParser::LLSDBinaryParser()
+{
+}
+
+// virtual
+LLSDBinaryParser::~LLSDBinaryParser()
+{
+}
+
+// virtual
+S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) const
+{
+/**
+ * Undefined: '!'<br>
+ * Boolean: '1' for true '0' for false<br>
+ * Integer: 'i' + 4 bytes network byte order<br>
+ * Real: 'r' + 8 bytes IEEE double<br>
+ * UUID: 'u' + 16 byte unsigned integer<br>
+ * String: 's' + 4 byte integer size + string<br>
+ *  strings also secretly support the notation format
+ * Date: 'd' + 8 byte IEEE double for seconds since epoch<br>
+ * URI: 'l' + 4 byte integer size + string uri<br>
+ * Binary: 'b' + 4 byte integer size + binary data<br>
+ * Array: '[' + 4 byte integer size  + all values + ']'<br>
+ * Map: '{' + 4 byte integer size  every(key + value) + '}'<br>
+ *  map keys are serialized as s + 4 byte integer size + string or in the
+ *  notation format.
+ */
+	char c;
+	c = get(istr);
+	if(!istr.good())
+	{
+		return 0;
+	}
+	if (max_depth == 0)
+	{
+		return PARSE_FAILURE;
+	}
+	S32 parse_count = 1;
+	switch(c)
+	{
+	case '{':
+	{
+		S32 child_count = parseMap(istr, data, max_depth - 1);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary map." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case '[':
+	{
+		S32 child_count = parseArray(istr, data, max_depth - 1);
+		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			parse_count += child_count;
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary array." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case '!':
+		data.clear();
+		break;
+
+	case '0':
+		data = false;
+		break;
+
+	case '1':
+		data = true;
+		break;
+
+	case 'i':
+	{
+		U32 value_nbo = 0;
+		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
+		data = (S32)ntohl(value_nbo);
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary integer." << LL_ENDL;
+		}
+		break;
+	}
+
+	case 'r':
+	{
+		F64 real_nbo = 0.0;
+		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
+		data = ll_ntohd(real_nbo);
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary real." << LL_ENDL;
+		}
+		break;
+	}
+
+	case 'u':
+	{
+		LLUUID id;
+		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
+		data = id;
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary uuid." << LL_ENDL;
+		}
+		break;
+	}
+
+	case '\'':
+	case '"':
+	{
+		std::string value;
+		int cnt = deserialize_string_delim(istr, value, c);
+		if(PARSE_FAILURE == cnt)
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			data = value;
+			account(cnt);
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary (notation-style) string."
+				<< LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 's':
+	{
+		std::string value;
+		if(parseString(istr, value))
+		{
+			data = value;
+		}
+		else
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary string." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'l':
+	{
+		std::string value;
+		if(parseString(istr, value))
+		{
+			data = LLURI(value);
+		}
+		else
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary link." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'd':
+	{
+		F64 real = 0.0;
+		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
+		data = LLDate(real);
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary date." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	case 'b':
+	{
+		// We probably have a valid raw binary stream. determine
+		// the size, and read it.
+		U32 size_nbo = 0;
+		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
+		S32 size = (S32)ntohl(size_nbo);
+		if(mCheckLimits && (size > mMaxBytesLeft))
+		{
+			parse_count = PARSE_FAILURE;
+		}
+		else
+		{
+			std::vector<U8> value;
+			if(size > 0)
+			{
+				value.resize(size);
+				account((int)fullread(istr, (char*)&value[0], size));
+			}
+			data = value;
+		}
+		if(istr.fail())
+		{
+			LL_INFOS() << "STREAM FAILURE reading binary." << LL_ENDL;
+			parse_count = PARSE_FAILURE;
+		}
+		break;
+	}
+
+	default:
+		parse_count = PARSE_FAILURE;
+		LL_INFOS() << "Unrecognized character while parsing: int(" << (int)c
+			<< ")" << LL_ENDL;
+		break;
+	}
+	if(PARSE_FAILURE == parse_count)
+	{
+		data.clear();
+	}
+	return parse_count;
+}
+
+S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map, S32 max_depth) const
+{
+	map = LLSD::emptyMap();
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	S32 parse_count = 0;
+	S32 count = 0;
+	char c = get(istr);
+	while(c != '}' && (count < size) && istr.good())
+	{
+		std::string name;
+		switch(c)
+		{
+		case 'k':
+			if(!parseString(istr, name))
+			{
+				return PARSE_FAILURE;
+			}
+			break;
+		case '\'':
+		case '"':
+		{
+			int cnt = deserialize_string_delim(istr, name, c);
+			if(PARSE_FAILURE == cnt) return PARSE_FAILURE;
+			account(cnt);
+			break;
+		}
+		}
+		LLSD child;
+		S32 child_count = doParse(istr, child, max_depth);
+		if(child_count > 0)
+		{
+			// There must be a value for every key, thus child_count
+			// must be greater than 0.
+			parse_count += child_count;
+			map.insert(name, child);
+		}
+		else
+		{
+			return PARSE_FAILURE;
+		}
+		++count;
+		c = get(istr);
+	}
+	if((c != '}') || (count < size))
 	{
-		return false;
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
 	}
-	return true;
+	return parse_count;
 }
 
-
-/**
- * LLSDBinaryParser
- */
-LLSDBinaryParser::LLSDBinaryParser()
+S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array, S32 max_depth) const
 {
+	array = LLSD::emptyArray();
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+
+	// *FIX: This would be a good place to reserve some space in the
+	// array...
+
+	S32 parse_count = 0;
+	S32 count = 0;
+	char c = istr.peek();
+	while((c != ']') && (count < size) && istr.good())
+	{
+		LLSD child;
+		S32 child_count = doParse(istr, child, max_depth);
+		if(PARSE_FAILURE == child_count)
+		{
+			return PARSE_FAILURE;
+		}
+		if(child_count)
+		{
+			parse_count += child_count;
+			array.append(child);
+		}
+		++count;
+		c = istr.peek();
+	}
+	c = get(istr);
+	if((c != ']') || (count < size))
+	{
+		// Make sure it is correctly terminated and we parsed as many
+		// as were said to be there.
+		return PARSE_FAILURE;
+	}
+	return parse_count;
 }
 
-// virtual
-LLSDBinaryParser::~LLSDBinaryParser()
+bool LLSDBinaryParser::parseString(
+	std::istream& istr,
+	std::string& value) const
 {
+	// *FIX: This is memory inefficient.
+	U32 value_nbo = 0;
+	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	S32 size = (S32)ntohl(value_nbo);
+	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
+	if(size < 0) return false;
+	std::vector<char> buf;
+	if(size)
+	{
+		buf.resize(size);
+		account((int)fullread(istr, &buf[0], size));
+		value.assign(buf.begin(), buf.end());
+	}
+	return true;
 }
 
+
 // virtual
-S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) const
+S32 LLSDBinaryParser::doParseEvents(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const
 {
-/**
- * Undefined: '!'<br>
- * Boolean: '1' for true '0' for false<br>
- * Integer: 'i' + 4 bytes network byte order<br>
- * Real: 'r' + 8 bytes IEEE double<br>
- * UUID: 'u' + 16 byte unsigned integer<br>
- * String: 's' + 4 byte integer size + string<br>
- *  strings also secretly support the notation format
- * Date: 'd' + 8 byte IEEE double for seconds since epoch<br>
- * URI: 'l' + 4 byte integer size + string uri<br>
- * Binary: 'b' + 4 byte integer size + binary data<br>
- * Array: '[' + 4 byte integer size  + all values + ']'<br>
- * Map: '{' + 4 byte integer size  every(key + value) + '}'<br>
- *  map keys are serialized as s + 4 byte integer size + string or in the
- *  notation format.
- */
+	// Same format and checks as doParse()
 	char c;
 	c = get(istr);
 	if(!istr.good())
@@ -918,8 +2086,8 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 	{
 	case '{':
 	{
-		S32 child_count = parseMap(istr, data, max_depth - 1);
-		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		S32 child_count = parseEventMap(istr, handler, max_depth - 1);
+		if(child_count == PARSE_FAILURE || istr.fail())
 		{
 			parse_count = PARSE_FAILURE;
 		}
@@ -927,18 +2095,13 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary map." << LL_ENDL;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case '[':
 	{
-		S32 child_count = parseArray(istr, data, max_depth - 1);
-		if((child_count == PARSE_FAILURE) || data.isUndefined())
+		S32 child_count = parseEventArray(istr, handler, max_depth - 1);
+		if(child_count == PARSE_FAILURE || istr.fail())
 		{
 			parse_count = PARSE_FAILURE;
 		}
@@ -946,35 +2109,26 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary array." << LL_ENDL;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case '!':
-		data.clear();
+		handler.onUndefined();
 		break;
 
 	case '0':
-		data = false;
+		handler.onBoolean(false);
 		break;
 
 	case '1':
-		data = true;
+		handler.onBoolean(true);
 		break;
 
 	case 'i':
 	{
 		U32 value_nbo = 0;
 		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
-		data = (S32)ntohl(value_nbo);
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary integer." << LL_ENDL;
-		}
+		handler.onInteger((S32)ntohl(value_nbo));
 		break;
 	}
 
@@ -982,11 +2136,7 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 	{
 		F64 real_nbo = 0.0;
 		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = ll_ntohd(real_nbo);
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary real." << LL_ENDL;
-		}
+		handler.onReal(ll_ntohd(real_nbo));
 		break;
 	}
 
@@ -994,11 +2144,7 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 	{
 		LLUUID id;
 		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
-		data = id;
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary uuid." << LL_ENDL;
-		}
+		handler.onUUID(id);
 		break;
 	}
 
@@ -1007,59 +2153,37 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 	{
 		std::string value;
 		int cnt = deserialize_string_delim(istr, value, c);
-		if(PARSE_FAILURE == cnt)
+		if(PARSE_FAILURE == cnt || istr.fail())
 		{
 			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
-			data = value;
+			handler.onString(value);
 			account(cnt);
 		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary (notation-style) string."
-				<< LL_ENDL;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case 's':
-	{
-		std::string value;
-		if(parseString(istr, value))
-		{
-			data = value;
-		}
-		else
-		{
-			parse_count = PARSE_FAILURE;
-		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary string." << LL_ENDL;
-			parse_count = PARSE_FAILURE;
-		}
-		break;
-	}
-
 	case 'l':
 	{
 		std::string value;
-		if(parseString(istr, value))
+		if(parseString(istr, value) && !istr.fail())
 		{
-			data = LLURI(value);
+			if (c == 's')
+			{
+				handler.onString(value);
+			}
+			else
+			{
+				handler.onURI(LLURI(value).asString());
+			}
 		}
 		else
 		{
 			parse_count = PARSE_FAILURE;
 		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary link." << LL_ENDL;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
@@ -1067,19 +2191,19 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 	{
 		F64 real = 0.0;
 		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = LLDate(real);
 		if(istr.fail())
 		{
-			LL_INFOS() << "STREAM FAILURE reading binary date." << LL_ENDL;
 			parse_count = PARSE_FAILURE;
 		}
+		else
+		{
+			handler.onDate(LLDate(real));
+		}
 		break;
 	}
 
 	case 'b':
 	{
-		// We probably have a valid raw binary stream. determine
-		// the size, and read it.
 		U32 size_nbo = 0;
 		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
 		S32 size = (S32)ntohl(size_nbo);
@@ -1095,12 +2219,14 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 				value.resize(size);
 				account((int)fullread(istr, (char*)&value[0], size));
 			}
-			data = value;
-		}
-		if(istr.fail())
-		{
-			LL_INFOS() << "STREAM FAILURE reading binary." << LL_ENDL;
-			parse_count = PARSE_FAILURE;
+			if(istr.fail())
+			{
+				parse_count = PARSE_FAILURE;
+			}
+			else
+			{
+				handler.onBinary(value.empty() ? NULL : &value[0], value.size());
+			}
 		}
 		break;
 	}
@@ -1111,25 +2237,27 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data, S32 max_depth) con
 			<< ")" << LL_ENDL;
 		break;
 	}
-	if(PARSE_FAILURE == parse_count)
+	if (handler.isStopped())
 	{
-		data.clear();
+		// Propagates up through parseEventMap() and parseEventArray()
+		return PARSE_FAILURE;
 	}
 	return parse_count;
 }
 
-S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map, S32 max_depth) const
+S32 LLSDBinaryParser::parseEventMap(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const
 {
-	map = LLSD::emptyMap();
+	handler.onMapBegin();
 	U32 value_nbo = 0;
 	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
 	S32 size = (S32)ntohl(value_nbo);
 	S32 parse_count = 0;
 	S32 count = 0;
+	std::string name;
 	char c = get(istr);
 	while(c != '}' && (count < size) && istr.good())
 	{
-		std::string name;
+		name.clear();
 		switch(c)
 		{
 		case 'k':
@@ -1147,14 +2275,11 @@ S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map, S32 max_depth) con
 			break;
 		}
 		}
-		LLSD child;
-		S32 child_count = doParse(istr, child, max_depth);
+		handler.onKey(name);
+		S32 child_count = doParseEvents(istr, handler, max_depth);
 		if(child_count > 0)
 		{
-			// There must be a value for every key, thus child_count
-			// must be greater than 0.
 			parse_count += child_count;
-			map.insert(name, child);
 		}
 		else
 		{
@@ -1165,72 +2290,42 @@ S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map, S32 max_depth) con
 	}
 	if((c != '}') || (count < size))
 	{
-		// Make sure it is correctly terminated and we parsed as many
-		// as were said to be there.
 		return PARSE_FAILURE;
 	}
+	handler.onMapEnd();
 	return parse_count;
 }
 
-S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array, S32 max_depth) const
+S32 LLSDBinaryParser::parseEventArray(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const
 {
-	array = LLSD::emptyArray();
+	handler.onArrayBegin();
 	U32 value_nbo = 0;
 	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
 	S32 size = (S32)ntohl(value_nbo);
 
-	// *FIX: This would be a good place to reserve some space in the
-	// array...
-
 	S32 parse_count = 0;
 	S32 count = 0;
 	char c = istr.peek();
 	while((c != ']') && (count < size) && istr.good())
 	{
-		LLSD child;
-		S32 child_count = doParse(istr, child, max_depth);
+		S32 child_count = doParseEvents(istr, handler, max_depth);
 		if(PARSE_FAILURE == child_count)
 		{
 			return PARSE_FAILURE;
 		}
-		if(child_count)
-		{
-			parse_count += child_count;
-			array.append(child);
-		}
+		parse_count += child_count;
 		++count;
 		c = istr.peek();
 	}
 	c = get(istr);
 	if((c != ']') || (count < size))
 	{
-		// Make sure it is correctly terminated and we parsed as many
-		// as were said to be there.
 		return PARSE_FAILURE;
 	}
+	handler.onArrayEnd();
 	return parse_count;
 }
 
-bool LLSDBinaryParser::parseString(
-	std::istream& istr,
-	std::string& value) const
-{
-	// *FIX: This is memory inefficient.
-	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
-	S32 size = (S32)ntohl(value_nbo);
-	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
-	if(size < 0) return false;
-	std::vector<char> buf;
-	if(size)
-	{
-		buf.resize(size);
-		account((int)fullread(istr, &buf[0], size));
-		value.assign(buf.begin(), buf.end());
-	}
-	return true;
-}
-
 
 /**
  * LLSDFormatter
@@ -2172,12 +3267,6 @@ std::string zip_llsd(LLSD& data)
 // and deserializes from that copy using LLSDSerialize
 LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is, S32 size)
 {
-	U8* result = NULL;
-	U32 cur_size = 0;
-	z_stream strm;
-		
-	const U32 CHUNK = 65536;
-
 	U8 *in = new(std::nothrow) U8[size];
 	if (!in)
 	{
@@ -2185,13 +3274,26 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 	}
 	is.read((char*) in, size); 
 
+	EZipRresult result = unzip_llsd(data, in, size);
+	delete [] in;
+	return result;
+}
+
+LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, const U8* in, S32 size)
+{
+	U8* result = NULL;
+	U32 cur_size = 0;
+	z_stream strm;
+		
+	const U32 CHUNK = 65536;
+
 	U8 out[CHUNK];
 		
 	strm.zalloc = Z_NULL;
 	strm.zfree = Z_NULL;
 	strm.opaque = Z_NULL;
 	strm.avail_in = size;
-	strm.next_in = in;
+	strm.next_in = const_cast<U8*>(in); // zlib never writes to its input
 
 	S32 ret = inflateInit(&strm);
 	
@@ -2204,7 +3306,6 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 		{
 			inflateEnd(&strm);
 			free(result);
-			delete [] in;
 			return ZR_DATA_ERROR;
 		}
 		
@@ -2216,7 +3317,6 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 		case Z_MEM_ERROR:
 			inflateEnd(&strm);
 			free(result);
-			delete [] in;
 			return ZR_MEM_ERROR;
 			break;
 		}
@@ -2231,7 +3331,6 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 			{
 				free(result);
 			}
-			delete[] in;
 			return ZR_MEM_ERROR;
 		}
 		result = new_result;
@@ -2241,7 +3340,6 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 	} while (ret == Z_OK);
 
 	inflateEnd(&strm);
-	delete [] in;
 
 	if (ret != Z_STREAM_END)
 	{
@@ -2251,37 +3349,18 @@ LLUZipHelper::EZipRresult LLUZipHelper::unzip_llsd(LLSD& data, std::istream& is,
 
 	//result now points to the decompressed LLSD block
 	{
-		std::istringstream istr;
-		// Since we are using this for meshes, data we are dealing with tend to be large.
-		// So string can potentially fail to allocate, make sure this won't cause problems
-		try
-		{
-			std::string res_str((char*)result, cur_size);
-
-			std::string deprecated_header("<? LLSD/Binary ?>");
-
-			if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
-			{
-				res_str = res_str.substr(deprecated_header.size() + 1, cur_size);
-			}
-			cur_size = res_str.size();
-
-			istr.str(res_str);
-		}
-#ifdef LL_WINDOWS
-		catch (std::length_error)
-		{
-			free(result);
-			return ZR_SIZE_ERROR;
-		}
-#endif
-		catch (std::bad_alloc&)
+		// Parse straight out of the decompressed block rather than copying
+		// it into a string first - these tend to be large for meshes
+		const std::string deprecated_header("<? LLSD/Binary ?>");
+		U32 start = 0;
+		if (cur_size >= deprecated_header.size() &&
+			memcmp(result, deprecated_header.data(), deprecated_header.size()) == 0)
 		{
-			free(result);
-			return ZR_MEM_ERROR;
+			start = llmin((U32)deprecated_header.size() + 1, cur_size);
 		}
 
-		if (!LLSDSerialize::fromBinary(data, istr, cur_size, UNZIP_LLSD_MAX_DEPTH))
+		LLMemoryStream istr(result + start, cur_size - start);
+		if (!LLSDSerialize::fromBinary(data, istr, cur_size - start, UNZIP_LLSD_MAX_DEPTH))
 		{
 			free(result);
 			return ZR_PARSE_ERROR;
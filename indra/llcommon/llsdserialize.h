@@ -29,10 +29,138 @@
 #ifndef LL_LLSDSERIALIZE_H
 #define LL_LLSDSERIALIZE_H
 
+#include <functional>
 #include <iosfwd>
+#include <vector>
 #include "llpointer.h"
 #include "llrefcount.h"
 #include "llsd.h"
+#include "llsdarena.h"
+
+/** 
+ * @class LLSDStreamHandler
+ * @brief Receives a document from a parser one value at a time.
+ *
+ * Instead of building an LLSD, LLSDParser::parse() can report what it
+ * reads as a sequence of events: scalars as they are read, maps and
+ * arrays as a begin, their children and an end. Inside a map each value
+ * is preceded by its key. Nothing is kept by the parser, so a handler
+ * that consumes values as they arrive can read a document of any size in
+ * bounded memory, and sees the first values long before the end of the
+ * stream.
+ *
+ * A handler can call stop() from any event to abandon the parse, in which
+ * case parse() returns PARSE_FAILURE.
+ */
+class LL_COMMON_API LLSDStreamHandler
+{
+public:
+	LLSDStreamHandler() : mStopped(false) {}
+	virtual ~LLSDStreamHandler() {}
+
+	virtual void onUndefined() = 0;
+	virtual void onBoolean(LLSD::Boolean value) = 0;
+	virtual void onInteger(LLSD::Integer value) = 0;
+	virtual void onReal(LLSD::Real value) = 0;
+	virtual void onString(const LLSD::String& value) = 0;
+	virtual void onUUID(const LLSD::UUID& value) = 0;
+	virtual void onDate(const LLSD::Date& value) = 0;
+	virtual void onURI(const LLSD::String& value) = 0;
+	virtual void onBinary(const U8* value, size_t length) = 0;
+
+	virtual void onMapBegin() = 0;
+	virtual void onKey(const LLSD::String& key) = 0;
+	virtual void onMapEnd() = 0;
+
+	virtual void onArrayBegin() = 0;
+	virtual void onArrayEnd() = 0;
+
+	/** 
+	 * @brief A whole value at once.
+	 *
+	 * Used by parsers that can only produce LLSD. The default replays
+	 * value as events, handlers that would build an LLSD anyway can
+	 * take it as is.
+	 */
+	virtual void onLLSD(const LLSD& value);
+
+	/** 
+	 * @brief Called by LLSDParser::parse() before each parse, also
+	 * clears stop(). Overrides must call this.
+	 */
+	virtual void reset()	{ mStopped = false; }
+
+	void stop()				{ mStopped = true; }
+	bool isStopped() const	{ return mStopped; }
+
+private:
+	bool mStopped;
+};
+
+/** 
+ * @class LLSDStreamCollector
+ * @brief Hands the values found at one depth of a document to a callback,
+ * one at a time.
+ *
+ * Everything above depth is only walked, each value at depth is built
+ * into an LLSD, passed to the callback and released before the next one
+ * is read. Scalars above depth are passed too. With a depth of 1 an
+ * inventory response arrives map entry by map entry, with 0 each top
+ * level value of a stream holding several.
+ *
+ * The callback gets the path from the top level value down to the value:
+ * an array of map keys (strings) and array indices (integers). It
+ * returns false to stop the parse.
+ */
+class LL_COMMON_API LLSDStreamCollector : public LLSDStreamHandler
+{
+public:
+	typedef std::function<bool(const LLSD& path, const LLSD& value)> callback_t;
+
+	LLSDStreamCollector(S32 depth, const callback_t& callback);
+
+	virtual void onUndefined()						{ addValue(LLSD()); }
+	virtual void onBoolean(LLSD::Boolean value)		{ addValue(value); }
+	virtual void onInteger(LLSD::Integer value)		{ addValue(value); }
+	virtual void onReal(LLSD::Real value)			{ addValue(value); }
+	virtual void onString(const LLSD::String& value)	{ addValue(value); }
+	virtual void onUUID(const LLSD::UUID& value)	{ addValue(value); }
+	virtual void onDate(const LLSD::Date& value)	{ addValue(value); }
+	virtual void onURI(const LLSD::String& value);
+	virtual void onBinary(const U8* value, size_t length);
+
+	virtual void onMapBegin()						{ beginContainer(LLSD::emptyMap()); }
+	virtual void onKey(const LLSD::String& key);
+	virtual void onMapEnd()							{ endContainer(); }
+
+	virtual void onArrayBegin()						{ beginContainer(LLSD::emptyArray()); }
+	virtual void onArrayEnd()						{ endContainer(); }
+
+	virtual void onLLSD(const LLSD& value);
+
+	virtual void reset();
+
+private:
+	struct Level
+	{
+		bool			mIsMap;
+		LLSD::Integer	mIndex;
+		LLSD::String	mKey;
+	};
+
+	void addValue(const LLSD& value);
+	void beginContainer(const LLSD& value);
+	void endContainer();
+	LLSD& addChild(const LLSD& value);
+	void deliver(const LLSD& value);
+
+	S32					mDepth;
+	callback_t			mCallback;
+	std::vector<Level>	mLevels;	// walked containers above mDepth
+	LLSD				mValue;		// value at mDepth being built
+	std::vector<LLSD*>	mBuilding;	// open containers in mValue
+	LLSD::String		mKey;		// key of the next child in mBuilding
+};
 
 /** 
  * @class LLSDParser
@@ -85,6 +213,26 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/**
+	 * @brief Parse a stream into an arena document.
+	 *
+	 * Like parse(), but the value is added to builder instead of an LLSD.
+	 * On success builder holds exactly one complete value, ready for
+	 * LLSDArena::Builder::finish(). On failure builder is reset.
+	 * @return Returns the number of LLSD objects parsed or PARSE_FAILURE.
+	 */
+	S32 parse(std::istream& istr, LLSDArena::Builder& builder, S32 max_bytes, S32 max_depth = -1);
+
+	/**
+	 * @brief Parse a stream as a sequence of events.
+	 *
+	 * Like parse(), but each value is reported to handler as it is read
+	 * and nothing is built. Calls LLSDStreamHandler::reset() first.
+	 * @return Returns the number of LLSD objects parsed or PARSE_FAILURE,
+	 * also when handler stopped the parse.
+	 */
+	S32 parse(std::istream& istr, LLSDStreamHandler& handler, S32 max_bytes, S32 max_depth = -1);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
@@ -110,6 +258,15 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data, S32 max_depth = -1) const = 0;
 
+	/** 
+	 * @brief Virtual base for parsing into events.
+	 *
+	 * The default parses into an LLSD with doParse() and passes that to
+	 * LLSDStreamHandler::onLLSD(). Parsers override it to report values
+	 * as they read them.
+	 */
+	virtual S32 doParseEvents(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth = -1) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -327,6 +484,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data, S32 max_depth = -1) const;
 
+	/** 
+	 * @brief Report values to handler as they are read
+	 */
+	virtual S32 doParseEvents(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth = -1) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -377,6 +539,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data, S32 max_depth = -1) const;
 
+	/** 
+	 * @brief Report values to handler as they are read
+	 */
+	virtual S32 doParseEvents(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth = -1) const;
+
 private:
 	/** 
 	 * @brief Parse a map from the istream
@@ -406,6 +573,15 @@ private:
 	 * @return Retuns true if a complete string was parsed.
 	 */
 	bool parseString(std::istream& istr, std::string& value) const;
+
+	/** 
+	 * @brief Report a map or array body to handler, after its opening
+	 * character.
+	 *
+	 * @return Returns The number of LLSD objects parsed.
+	 */
+	S32 parseEventMap(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const;
+	S32 parseEventArray(std::istream& istr, LLSDStreamHandler& handler, S32 max_depth) const;
 };
 
 
@@ -790,6 +966,10 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	// Parse one value from notation held in memory. Same result as
+	// parsing a stream of the same bytes, but scans the buffer instead of
+	// reading it a character at a time.
+	static S32 fromNotation(LLSD& sd, const char* buf, size_t len, S32 max_depth = -1);
 	
 	/*
 	 * XML Methods
@@ -825,6 +1005,21 @@ public:
 		return fromXMLEmbedded(sd, str, emit_errors);
 //		return fromXMLDocument(sd, str, emit_errors);
 	}
+	// Parse a complete document held in memory. Same result as
+	// fromXML() on a stream of the same bytes, but several times faster
+	// on the documents LLSD formatters write. Documents using other XML
+	// features, and malformed ones, go through expat as before.
+	static S32 fromXML(LLSD& sd, const char* buf, size_t len, bool emit_errors=true);
+	// Parse into an immutable arena document rather than an LLSD tree,
+	// for large responses that are only read. doc is NULL on failure.
+	static S32 fromXML(LLPointer<LLSDArena>& doc, std::istream& str, bool emit_errors=true)
+	{
+		LLPointer<LLSDXMLParser> p = new LLSDXMLParser(emit_errors);
+		LLSDArena::Builder builder;
+		S32 count = p->parse(str, builder, LLSDSerialize::SIZE_UNLIMITED);
+		doc = builder.finish();
+		return count;
+	}
 
 	/*
 	 * Binary Methods
@@ -861,6 +1056,8 @@ public:
     } EZipRresult;
     // return OK or reason for failure
     static EZipRresult unzip_llsd(LLSD& data, std::istream& is, S32 size);
+    // inflate straight from memory the caller already holds, eg. a mapped cache file
+    static EZipRresult unzip_llsd(LLSD& data, const U8* in, S32 size);
 };
 
 //dirty little zip functions -- yell at davep
@@ -31,7 +31,9 @@
 #include <deque>
 
 #include "apr_base64.h"
-#include <boost/regex.hpp>
+#include "llbase64.h"
+#include "llmemorystream.h"
+#include "llsimdscan.h"
 
 extern "C"
 {
@@ -264,6 +266,14 @@ public:
 	
 	void reset();
 
+	// Parse a complete document held in memory without expat. Returns
+	// false, leaving data alone, for anything BufferParser does not handle
+	static bool parseBuffer(const char* buf, size_t len, LLSD& data, S32& parse_count);
+
+	// Report values to handler instead of building an LLSD until set back
+	// to NULL
+	void setHandler(LLSDStreamHandler* handler)	{ mHandler = handler; }
+
 private:
 	void startElementHandler(const XML_Char* name, const XML_Char** attributes);
 	void endElementHandler(const XML_Char* name);
@@ -295,8 +305,15 @@ private:
 		ELEMENT_UNKNOWN
 	};
 	static Element readElement(const XML_Char* name);
+
+	class BufferParser;
 	
 	static const XML_Char* findAttribute(const XML_Char* name, const XML_Char** pairs);
+
+	bool inMap() const;
+	void startEventElement(Element element);
+	void endEventElement(Element element);
+	void checkStopped();
 	
 	bool mEmitErrors;
 
@@ -310,6 +327,9 @@ private:
 	
 	typedef std::deque<LLSD*> LLSDRefStack;
 	LLSDRefStack mStack;
+
+	LLSDStreamHandler* mHandler;
+	std::vector<Element> mEventStack;	// open values when reporting to mHandler
 	
 	int mDepth;
 	bool mSkipping;
@@ -321,7 +341,8 @@ private:
 
 
 LLSDXMLParser::Impl::Impl(bool emit_errors)
-	: mEmitErrors(emit_errors)
+	: mEmitErrors(emit_errors),
+	  mHandler(NULL)
 {
 	mParser = XML_ParserCreate(NULL);
 	reset();
@@ -405,7 +426,7 @@ S32 LLSDXMLParser::Impl::parse(std::istream& input, LLSD& data)
 		{
 			((char*) buffer)[count ? count - 1 : 0] = '\0';
 		}
-		if (mEmitErrors)
+		if (mEmitErrors && !(mHandler && mHandler->isStopped()))
 		{
 		LL_INFOS() << "LLSDXMLParser::Impl::parse: XML_STATUS_ERROR parsing:" << (char*) buffer << LL_ENDL;
 		}
@@ -486,7 +507,7 @@ S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
 	if (status == XML_STATUS_ERROR  
 		&& !mGracefullStop)
 	{
-		if (mEmitErrors)
+		if (mEmitErrors && !(mHandler && mHandler->isStopped()))
 		{
 		LL_INFOS() << "LLSDXMLParser::Impl::parseLines: XML_STATUS_ERROR" << LL_ENDL;
 		}
@@ -510,6 +531,7 @@ void LLSDXMLParser::Impl::reset()
 	mGracefullStop = false;
 
 	mStack.clear();
+	mEventStack.clear();
 	
 	mSkipping = false;
 	
@@ -584,6 +606,67 @@ public:
 };
 #endif // XML_PARSER_PERFORMANCE_TESTS
 
+static S32 content_as_integer(const std::string& content)
+{
+	// Plain decimal numbers, as the formatters write them
+	const char* p = content.c_str();
+	bool negative = (*p == '-');
+	if (negative || *p == '+')
+	{
+		++p;
+	}
+	size_t digits = content.size() - (p - content.c_str());
+	if (digits > 0 && digits <= 9)
+	{
+		S32 value = 0;
+		for (; *p >= '0' && *p <= '9'; ++p)
+		{
+			value = value * 10 + (*p - '0');
+		}
+		if (!*p)
+		{
+			return negative ? -value : value;
+		}
+	}
+
+	S32 i;
+	// sscanf okay here with different locales - ints don't change for different locale settings like floats do.
+	if ( sscanf(content.c_str(), "%d", &i ) == 1 )
+	{	// See if sscanf works - it's faster
+		return i;
+	}
+	return LLSD(content).asInteger();
+}
+
+static F64 content_as_real(const std::string& content)
+{
+	// ll_scan_real() only handles plain numbers and gives up unless the
+	// locale's decimal separator is '.', LLSD.asReal() covers the rest
+	const char* end = content.data() + content.size();
+	F64 r;
+	if (ll_scan_real(content.data(), end, r) == end)
+	{
+		return r;
+	}
+	return LLSD(content).asReal();
+}
+
+static void content_as_binary(const std::string& content, std::vector<U8>& data)
+{
+	// Whitespace in base64 is skipped, python and other non-linden
+	// systems wrap it - DEV-39358
+	LLBase64::decode(content.data(), content.size(), data, true);
+}
+
+bool LLSDXMLParser::Impl::inMap() const
+{
+	if (mHandler)
+	{
+		return !mEventStack.empty() && mEventStack.back() == ELEMENT_MAP;
+	}
+	return !mStack.empty() && mStack.back()->isMap();
+}
+
 void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Char** attributes)
 {
 	#ifdef XML_PARSER_PERFORMANCE_TESTS
@@ -608,7 +691,7 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 			return;
 	
 		case ELEMENT_KEY:
-			if (mStack.empty()  ||  !(mStack.back()->isMap()))
+			if (!inMap())
 			{
 				return startSkipping();
 			}
@@ -628,6 +711,11 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	
 
 	if (!mInLLSDElement) { return startSkipping(); }
+
+	if (mHandler)
+	{
+		return startEventElement(element);
+	}
 	
 	if (mStack.empty())
 	{
@@ -712,6 +800,11 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	
 	if (!mInLLSDElement) { return; }
 
+	if (mHandler)
+	{
+		return endEventElement(element);
+	}
+
 	LLSD& value = *mStack.back();
 	mStack.pop_back();
 	
@@ -726,36 +819,11 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			break;
 		
 		case ELEMENT_INTEGER:
-			{
-				S32 i;
-				// sscanf okay here with different locales - ints don't change for different locale settings like floats do.
-				if ( sscanf(mCurrentContent.c_str(), "%d", &i ) == 1 )
-				{	// See if sscanf works - it's faster
-					value = i;
-				}
-				else
-				{
-					value = LLSD(mCurrentContent).asInteger();
-				}
-			}
+			value = content_as_integer(mCurrentContent);
 			break;
 		
 		case ELEMENT_REAL:
-			{
-				value = LLSD(mCurrentContent).asReal();
-				// removed since this breaks when locale has decimal separator that isn't '.'
-				// investigated changing local to something compatible each time but deemed higher
-				// risk that just using LLSD.asReal() each time.
-				//F64 r;
-				//if ( sscanf(mCurrentContent.c_str(), "%lf", &r ) == 1 )
-				//{	// See if sscanf works - it's faster
-				//	value = r;
-				//}
-				//else
-				//{
-				//	value = LLSD(mCurrentContent).asReal();
-				//}
-			}
+			value = content_as_real(mCurrentContent);
 			break;
 		
 		case ELEMENT_STRING:
@@ -776,18 +844,8 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 		
 		case ELEMENT_BINARY:
 		{
-			// Regex is expensive, but only fix for whitespace in base64,
-			// created by python and other non-linden systems - DEV-39358
-			// Fortunately we have very little binary passing now,
-			// so performance impact shold be negligible. + poppy 2009-09-04
-			boost::regex r;
-			r.assign("\\s");
-			std::string stripped = boost::regex_replace(mCurrentContent, r, "");
-			S32 len = apr_base64_decode_len(stripped.c_str());
 			std::vector<U8> data;
-			data.resize(len);
-			len = apr_base64_decode_binary(&data[0], stripped.c_str());
-			data.resize(len);
+			content_as_binary(mCurrentContent, data);
 			value = data;
 			break;
 		}
@@ -804,6 +862,123 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 	mCurrentContent.clear();
 }
 
+// Mirrors the LLSD building in startElementHandler() and
+// endElementHandler(), value for value
+void LLSDXMLParser::Impl::startEventElement(Element element)
+{
+	if (mEventStack.empty())
+	{
+		if (mParseCount > 0)
+		{
+			// Only one top level value
+			return startSkipping();
+		}
+	}
+	else if (mEventStack.back() == ELEMENT_MAP)
+	{
+		if (mCurrentKey.empty()) { return startSkipping(); }
+
+		mHandler->onKey(mCurrentKey);
+		mCurrentKey.clear();
+	}
+	else if (mEventStack.back() != ELEMENT_ARRAY)
+	{
+		// improperly nested value in a non-structure
+		return startSkipping();
+	}
+
+	++mParseCount;
+	mEventStack.push_back(element);
+	switch (element)
+	{
+		case ELEMENT_MAP:
+			mHandler->onMapBegin();
+			break;
+
+		case ELEMENT_ARRAY:
+			mHandler->onArrayBegin();
+			break;
+
+		default:
+			// all the other values are added in endEventElement()
+			;
+	}
+	checkStopped();
+}
+
+void LLSDXMLParser::Impl::endEventElement(Element element)
+{
+	if (mEventStack.empty())
+	{
+		return;
+	}
+	mEventStack.pop_back();
+
+	switch (element)
+	{
+		case ELEMENT_MAP:
+			mHandler->onMapEnd();
+			break;
+
+		case ELEMENT_ARRAY:
+			mHandler->onArrayEnd();
+			break;
+
+		case ELEMENT_BOOL:
+			mHandler->onBoolean(mCurrentContent == "true" || mCurrentContent == "1");
+			break;
+
+		case ELEMENT_INTEGER:
+			mHandler->onInteger(content_as_integer(mCurrentContent));
+			break;
+
+		case ELEMENT_REAL:
+			mHandler->onReal(content_as_real(mCurrentContent));
+			break;
+
+		case ELEMENT_STRING:
+			mHandler->onString(mCurrentContent);
+			break;
+
+		case ELEMENT_UUID:
+			mHandler->onUUID(LLUUID(mCurrentContent));
+			break;
+
+		case ELEMENT_DATE:
+			mHandler->onDate(LLDate(mCurrentContent));
+			break;
+
+		case ELEMENT_URI:
+			mHandler->onURI(LLURI(mCurrentContent).asString());
+			break;
+
+		case ELEMENT_BINARY:
+		{
+			std::vector<U8> data;
+			content_as_binary(mCurrentContent, data);
+			mHandler->onBinary(data.empty() ? NULL : &data[0], data.size());
+			break;
+		}
+
+		default:
+			// undef and unknown elements
+			mHandler->onUndefined();
+			break;
+	}
+
+	mCurrentContent.clear();
+	checkStopped();
+}
+
+void LLSDXMLParser::Impl::checkStopped()
+{
+	if (mHandler->isStopped())
+	{
+		// Fails the parse like any other XML error
+		XML_StopParser(mParser, false);
+	}
+}
+
 void LLSDXMLParser::Impl::characterDataHandler(const XML_Char* data, int length)
 {
 	#ifdef XML_PARSER_PERFORMANCE_TESTS
@@ -900,44 +1075,995 @@ LLSDXMLParser::Impl::Element LLSDXMLParser::Impl::readElement(const XML_Char* na
 }
 
 
+inline bool is_xml_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char* skip_xml_space(const char* p, const char* end)
+{
+	while (p < end && is_xml_space(*p))
+	{
+		++p;
+	}
+	return p;
+}
+
+// End of the ASCII name at p, NULL if there is none. Names with other
+// characters are left to expat.
+static const char* scan_xml_name(const char* p, const char* end)
+{
+	if (p == end || !(isalpha((U8)*p) || *p == '_' || *p == ':'))
+	{
+		return NULL;
+	}
+	while (++p < end && (isalnum((U8)*p) || *p == '_' || *p == ':' || *p == '-' || *p == '.'))
+	{
+	}
+	return p;
+}
 
+// First character of [p, end) that can not be copied straight into the
+// content: markup, ']', '\r', other control characters and non-ASCII
+static const char* find_text_special(const char* p, const char* end)
+{
+#if LL_SIMD_SCAN
+	const __m128i lt = _mm_set1_epi8('<');
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i bracket = _mm_set1_epi8(']');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	while (end - p >= 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)p);
+		// Signed compare, bytes >= 0x80 are below ' ' too
+		__m128i control = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(c, tab),
+														_mm_cmpeq_epi8(c, newline)),
+										   _mm_cmplt_epi8(c, space));
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, lt),
+													_mm_cmpeq_epi8(c, amp)),
+									   _mm_or_si128(_mm_cmpeq_epi8(c, bracket), control));
+		U32 mask = (U32)_mm_movemask_epi8(special);
+		if (mask)
+		{
+			return p + ll_lowest_bit(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end)
+	{
+		U8 c = (U8)*p;
+		if (c == '<' || c == '&' || c == ']' || c >= 0x80 || (c < 0x20 && c != '\t' && c != '\n'))
+		{
+			break;
+		}
+		++p;
+	}
+	return p;
+}
 
+inline bool is_xml_char(U32 code)
+{
+	return code == 0x9 || code == 0xA || code == 0xD
+		|| (code >= 0x20 && code <= 0xD7FF)
+		|| (code >= 0xE000 && code <= 0xFFFD)
+		|| (code >= 0x10000 && code <= 0x10FFFF);
+}
 
-/**
- * LLSDXMLParser
- */
-LLSDXMLParser::LLSDXMLParser(bool emit_errors /* = true */) : impl(* new Impl(emit_errors))
+// Length of the UTF-8 sequence at p if it is well formed and encodes an
+// XML character, 0 otherwise
+static size_t xml_utf8_length(const char* p, const char* end)
 {
+	const U8* u = (const U8*)p;
+	size_t left = end - p;
+	if (u[0] < 0xC2)
+	{
+		// continuation byte or overlong
+		return 0;
+	}
+	if (u[0] < 0xE0)
+	{
+		return (left >= 2 && (u[1] & 0xC0) == 0x80) ? 2 : 0;
+	}
+	if (u[0] < 0xF0)
+	{
+		if (left < 3 || (u[1] & 0xC0) != 0x80 || (u[2] & 0xC0) != 0x80)
+		{
+			return 0;
+		}
+		U32 code = ((u[0] & 0x0F) << 12) | ((u[1] & 0x3F) << 6) | (u[2] & 0x3F);
+		return (code >= 0x800 && is_xml_char(code)) ? 3 : 0;
+	}
+	if (u[0] < 0xF5)
+	{
+		if (left < 4 || (u[1] & 0xC0) != 0x80 || (u[2] & 0xC0) != 0x80 || (u[3] & 0xC0) != 0x80)
+		{
+			return 0;
+		}
+		U32 code = ((u[0] & 0x07) << 18) | ((u[1] & 0x3F) << 12) | ((u[2] & 0x3F) << 6) | (u[3] & 0x3F);
+		return (code >= 0x10000 && code <= 0x10FFFF) ? 4 : 0;
+	}
+	return 0;
 }
 
-LLSDXMLParser::~LLSDXMLParser()
+static void append_utf8(std::string& out, U32 code)
 {
-	delete &impl;
+	if (code < 0x80)
+	{
+		out.push_back((char)code);
+	}
+	else if (code < 0x800)
+	{
+		out.push_back((char)(0xC0 | (code >> 6)));
+		out.push_back((char)(0x80 | (code & 0x3F)));
+	}
+	else if (code < 0x10000)
+	{
+		out.push_back((char)(0xE0 | (code >> 12)));
+		out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+		out.push_back((char)(0x80 | (code & 0x3F)));
+	}
+	else
+	{
+		out.push_back((char)(0xF0 | (code >> 18)));
+		out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+		out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+		out.push_back((char)(0x80 | (code & 0x3F)));
+	}
 }
 
-void LLSDXMLParser::parsePart(const char *buf, int len)
+/**
+ * LLSDXMLParser::Impl::BufferParser
+ *
+ * Reads a document held in memory without expat and builds the same LLSD,
+ * with the same parse count, as Impl's handlers do for it. It covers what
+ * the LLSD formatters and the servers write: elements and attributes with
+ * ASCII names, character data, the predefined entities, character
+ * references, comments and the XML declaration. Character data is scanned
+ * 16 bytes at a time for the few characters that need attention.
+ *
+ * Anything else - DTDs, CDATA sections, processing instructions, text
+ * around elements nested in a scalar, a second top level value - and
+ * anything malformed makes parse() give up, and the caller hands the same
+ * bytes to expat. Results and errors are therefore always expat's.
+ */
+class LLSDXMLParser::Impl::BufferParser
+{
+public:
+	BufferParser(const char* buf, size_t len);
+
+	bool parse(LLSD& data, S32& parse_count);
+
+private:
+	struct Tag
+	{
+		const char*	mName;
+		size_t		mNameLength;
+		Element		mElement;
+		bool		mEmpty;		// <tag/>
+		bool		mBase64;	// false for binary with any other encoding
+	};
+
+	static Element readElement(const char* name, size_t length);
+	static bool isSkipped(const Tag& tag, bool in_map);
+
+	bool readDeclaration();
+	bool readStartTag(Tag& tag);
+	bool readEndTag(const Tag& tag);
+	bool readText(std::string* content);
+	bool readEntity(std::string* content);
+	bool skipComment();
+	bool atEndTag() const	{ return mEnd - mPos >= 2 && mPos[1] == '/'; }
+
+	bool parseValue(const Tag& tag, LLSD& value);
+	bool parseMap(const Tag& tag, LLSD& map);
+	bool parseArray(const Tag& tag, LLSD& array);
+	bool skipElement(const Tag& tag);
+
+	// Deeper documents go through expat, which does not recurse
+	static const S32 MAX_DEPTH = 256;
+	static const S32 MAX_ATTRIBUTES = 8;
+
+	const char* mPos;
+	const char* mEnd;
+	S32 mDepth;
+	S32 mParseCount;
+
+	std::string mCurrentKey;		// like Impl's, outlives the map it was read in
+	std::string mCurrentContent;
+};
+
+LLSDXMLParser::Impl::BufferParser::BufferParser(const char* buf, size_t len)
+:	mPos(buf),
+	mEnd(buf + len),
+	mDepth(0),
+	mParseCount(0)
 {
-	impl.parsePart(buf, len);
 }
 
-// virtual
-S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data, S32 max_depth) const
+bool LLSDXMLParser::Impl::BufferParser::parse(LLSD& data, S32& parse_count)
 {
-	#ifdef XML_PARSER_PERFORMANCE_TESTS
-	XML_Timer timer( &parseTime );
-	#endif	// XML_PARSER_PERFORMANCE_TESTS
+	if (mEnd - mPos >= 3 && memcmp(mPos, "\xEF\xBB\xBF", 3) == 0)
+	{
+		mPos += 3;
+	}
+	if (mEnd - mPos >= 6 && memcmp(mPos, "<?xml", 5) == 0 && is_xml_space(mPos[5])
+		&& !readDeclaration())
+	{
+		return false;
+	}
 
-	if (mParseLines)
+	// Whitespace and comments before the root element
+	while (true)
 	{
-		// Use line-based reading (faster code)
-		return impl.parseLines(input, data);
+		mPos = skip_xml_space(mPos, mEnd);
+		if (mEnd - mPos < 4 || memcmp(mPos, "<!--", 4) != 0)
+		{
+			break;
+		}
+		if (!skipComment())
+		{
+			return false;
+		}
 	}
 
-	return impl.parse(input, data);
+	// Impl skips any other root element entirely, rare enough to leave to it
+	Tag root;
+	if (mPos == mEnd || *mPos != '<' || !readStartTag(root) || root.mElement != ELEMENT_LLSD)
+	{
+		return false;
+	}
+
+	// Impl stops at </llsd>, whatever follows is never looked at
+	LLSD result;
+	if (!root.mEmpty)
+	{
+		bool has_value = false;
+		while (true)
+		{
+			if (!readText(NULL))
+			{
+				return false;
+			}
+			if (atEndTag())
+			{
+				if (!readEndTag(root))
+				{
+					return false;
+				}
+				break;
+			}
+
+			Tag tag;
+			if (!readStartTag(tag))
+			{
+				return false;
+			}
+			if (isSkipped(tag, false))
+			{
+				if (!skipElement(tag))
+				{
+					return false;
+				}
+			}
+			else if (has_value || !parseValue(tag, result))
+			{
+				// Impl lets a second value overwrite the first
+				return false;
+			}
+			has_value = true;
+		}
+	}
+
+	data = result;
+	parse_count = mParseCount;
+	return true;
 }
 
-//	virtual 
-void LLSDXMLParser::doReset()
+//static
+LLSDXMLParser::Impl::Element LLSDXMLParser::Impl::BufferParser::readElement(const char* name, size_t length)
 {
-	impl.reset();
+	char text[8];
+	if (length >= sizeof(text))
+	{
+		return ELEMENT_UNKNOWN;
+	}
+	memcpy(text, name, length);
+	text[length] = '\0';
+	return Impl::readElement(text);
+}
+
+// Elements Impl::startElementHandler() skips with everything in them
+//static
+bool LLSDXMLParser::Impl::BufferParser::isSkipped(const Tag& tag, bool in_map)
+{
+	return tag.mElement == ELEMENT_LLSD
+		|| (tag.mElement == ELEMENT_KEY && !in_map)
+		|| !tag.mBase64;
+}
+
+// <?xml version="1.0" encoding="UTF-8" standalone="yes"?>, only in that
+// form, other versions and encodings go to expat
+bool LLSDXMLParser::Impl::BufferParser::readDeclaration()
+{
+	static const char* const NAMES[] = { "version", "encoding", "standalone" };
+	const char* p = mPos + 5;
+	S32 next = 0;
+	while (true)
+	{
+		const char* after_space = skip_xml_space(p, mEnd);
+		bool spaced = (after_space != p);
+		p = after_space;
+		if (mEnd - p >= 2 && p[0] == '?' && p[1] == '>')
+		{
+			mPos = p + 2;
+			return next > 0;
+		}
+
+		const char* name_end = spaced ? scan_xml_name(p, mEnd) : NULL;
+		if (!name_end)
+		{
+			return false;
+		}
+		size_t name_length = name_end - p;
+		S32 which = next;
+		while (which < 3
+			   && (strlen(NAMES[which]) != name_length || strncmp(NAMES[which], p, name_length) != 0))
+		{
+			++which;
+		}
+		if (which == 3 || (which > 0 && next == 0))
+		{
+			return false;
+		}
+		next = which + 1;
+
+		p = skip_xml_space(name_end, mEnd);
+		if (p == mEnd || *p != '=')
+		{
+			return false;
+		}
+		p = skip_xml_space(p + 1, mEnd);
+		if (p == mEnd || (*p != '"' && *p != '\''))
+		{
+			return false;
+		}
+		const char* value = p + 1;
+		const char* value_end = (const char*)memchr(value, *p, mEnd - value);
+		if (!value_end)
+		{
+			return false;
+		}
+		std::string text(value, value_end);
+		p = value_end + 1;
+
+		bool valid = false;
+		switch (which)
+		{
+			case 0:
+				valid = (text == "1.0");
+				break;
+			case 1:
+				LLStringUtil::toLower(text);
+				valid = (text == "utf-8");
+				break;
+			default:
+				valid = (text == "yes" || text == "no");
+				break;
+		}
+		if (!valid)
+		{
+			return false;
+		}
+	}
+}
+
+// At '<' of a start tag
+bool LLSDXMLParser::Impl::BufferParser::readStartTag(Tag& tag)
+{
+	const char* p = mPos + 1;
+	const char* name_end = scan_xml_name(p, mEnd);
+	if (!name_end)
+	{
+		return false;
+	}
+	tag.mName = p;
+	tag.mNameLength = name_end - p;
+	tag.mElement = readElement(tag.mName, tag.mNameLength);
+	tag.mEmpty = false;
+	tag.mBase64 = true;
+	p = name_end;
+
+	const char* names[MAX_ATTRIBUTES];
+	size_t lengths[MAX_ATTRIBUTES];
+	S32 count = 0;
+	while (true)
+	{
+		const char* after_space = skip_xml_space(p, mEnd);
+		bool spaced = (after_space != p);
+		p = after_space;
+		if (p == mEnd)
+		{
+			return false;
+		}
+		if (*p == '>')
+		{
+			++p;
+			break;
+		}
+		if (*p == '/')
+		{
+			if (mEnd - p < 2 || p[1] != '>')
+			{
+				return false;
+			}
+			tag.mEmpty = true;
+			p += 2;
+			break;
+		}
+
+		const char* attribute_end = spaced ? scan_xml_name(p, mEnd) : NULL;
+		if (!attribute_end || count == MAX_ATTRIBUTES)
+		{
+			return false;
+		}
+		size_t length = attribute_end - p;
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (lengths[i] == length && memcmp(names[i], p, length) == 0)
+			{
+				return false;
+			}
+		}
+		names[count] = p;
+		lengths[count] = length;
+		++count;
+
+		p = skip_xml_space(attribute_end, mEnd);
+		if (p == mEnd || *p != '=')
+		{
+			return false;
+		}
+		p = skip_xml_space(p + 1, mEnd);
+		if (p == mEnd || (*p != '"' && *p != '\''))
+		{
+			return false;
+		}
+		char quote = *p++;
+		const char* value = p;
+		// Values with references or whitespace expat would normalize go
+		// to it
+		while (p != mEnd && *p != quote)
+		{
+			U8 c = (U8)*p;
+			if (c < 0x20 || c >= 0x80 || c == '<' || c == '&')
+			{
+				return false;
+			}
+			++p;
+		}
+		if (p == mEnd)
+		{
+			return false;
+		}
+		if (tag.mElement == ELEMENT_BINARY && length == 8 && memcmp(names[count - 1], "encoding", 8) == 0)
+		{
+			tag.mBase64 = (p - value == 6 && memcmp(value, "base64", 6) == 0);
+		}
+		++p;
+	}
+
+	if (!tag.mEmpty && ++mDepth > MAX_DEPTH)
+	{
+		return false;
+	}
+	mPos = p;
+	return true;
+}
+
+// At "</", must close tag
+bool LLSDXMLParser::Impl::BufferParser::readEndTag(const Tag& tag)
+{
+	const char* p = mPos + 2;
+	if ((size_t)(mEnd - p) < tag.mNameLength || memcmp(p, tag.mName, tag.mNameLength) != 0)
+	{
+		return false;
+	}
+	p = skip_xml_space(p + tag.mNameLength, mEnd);
+	if (p == mEnd || *p != '>')
+	{
+		return false;
+	}
+	mPos = p + 1;
+	--mDepth;
+	return true;
+}
+
+// Character data up to the next start or end tag, appended to content
+// unless it is NULL. Comments in between are dropped, like expat does
+// without a comment handler.
+bool LLSDXMLParser::Impl::BufferParser::readText(std::string* content)
+{
+	const char* p = mPos;
+	while (true)
+	{
+		const char* special = find_text_special(p, mEnd);
+		if (content)
+		{
+			content->append(p, special);
+		}
+		p = special;
+		if (p == mEnd)
+		{
+			return false;
+		}
+
+		U8 c = (U8)*p;
+		if (c == '<')
+		{
+			if (mEnd - p >= 4 && memcmp(p, "<!--", 4) == 0)
+			{
+				mPos = p;
+				if (!skipComment())
+				{
+					return false;
+				}
+				p = mPos;
+				continue;
+			}
+			if (mEnd - p >= 2 && (p[1] == '!' || p[1] == '?'))
+			{
+				// CDATA or processing instruction
+				return false;
+			}
+			mPos = p;
+			return true;
+		}
+		else if (c == '&')
+		{
+			mPos = p;
+			if (!readEntity(content))
+			{
+				return false;
+			}
+			p = mPos;
+		}
+		else if (c == ']')
+		{
+			if (mEnd - p >= 3 && p[1] == ']' && p[2] == '>')
+			{
+				return false;
+			}
+			if (content)
+			{
+				content->push_back(']');
+			}
+			++p;
+		}
+		else if (c == '\r')
+		{
+			// Line ends are normalized, "\r\n" and a lone '\r' to '\n'
+			if (content)
+			{
+				content->push_back('\n');
+			}
+			if (++p != mEnd && *p == '\n')
+			{
+				++p;
+			}
+		}
+		else if (c >= 0x80)
+		{
+			size_t length = xml_utf8_length(p, mEnd);
+			if (!length)
+			{
+				return false;
+			}
+			if (content)
+			{
+				content->append(p, length);
+			}
+			p += length;
+		}
+		else
+		{
+			// Control character
+			return false;
+		}
+	}
+}
+
+// At '&'
+bool LLSDXMLParser::Impl::BufferParser::readEntity(std::string* content)
+{
+	const char* name = mPos + 1;
+	const char* semicolon = (const char*)memchr(name, ';', llmin<size_t>(mEnd - name, 12));
+	if (!semicolon)
+	{
+		return false;
+	}
+	size_t length = semicolon - name;
+
+	U32 code = 0;
+	if (length == 2 && memcmp(name, "lt", 2) == 0)
+	{
+		code = '<';
+	}
+	else if (length == 2 && memcmp(name, "gt", 2) == 0)
+	{
+		code = '>';
+	}
+	else if (length == 3 && memcmp(name, "amp", 3) == 0)
+	{
+		code = '&';
+	}
+	else if (length == 4 && memcmp(name, "quot", 4) == 0)
+	{
+		code = '"';
+	}
+	else if (length == 4 && memcmp(name, "apos", 4) == 0)
+	{
+		code = '\'';
+	}
+	else if (length >= 2 && name[0] == '#')
+	{
+		const char* p = name + 1;
+		U32 base = 10;
+		if (*p == 'x')
+		{
+			base = 16;
+			++p;
+		}
+		if (p == semicolon)
+		{
+			return false;
+		}
+		for (; p != semicolon; ++p)
+		{
+			U32 digit;
+			if (*p >= '0' && *p <= '9')
+			{
+				digit = *p - '0';
+			}
+			else if (base == 16 && *p >= 'a' && *p <= 'f')
+			{
+				digit = *p - 'a' + 10;
+			}
+			else if (base == 16 && *p >= 'A' && *p <= 'F')
+			{
+				digit = *p - 'A' + 10;
+			}
+			else
+			{
+				return false;
+			}
+			code = code * base + digit;
+			if (code > 0x10FFFF)
+			{
+				return false;
+			}
+		}
+		if (!is_xml_char(code))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Anything else would need a DTD
+		return false;
+	}
+
+	if (content)
+	{
+		append_utf8(*content, code);
+	}
+	mPos = semicolon + 1;
+	return true;
+}
+
+// At "<!--"
+bool LLSDXMLParser::Impl::BufferParser::skipComment()
+{
+	const char* p = mPos + 4;
+	while (p < mEnd)
+	{
+		U8 c = (U8)*p;
+		if (c == '-' && mEnd - p >= 2 && p[1] == '-')
+		{
+			// "--" may only end the comment
+			if (mEnd - p < 3 || p[2] != '>')
+			{
+				return false;
+			}
+			mPos = p + 3;
+			return true;
+		}
+		if (c >= 0x80)
+		{
+			size_t length = xml_utf8_length(p, mEnd);
+			if (!length)
+			{
+				return false;
+			}
+			p += length;
+		}
+		else if (c < 0x20 && !is_xml_space(c))
+		{
+			return false;
+		}
+		else
+		{
+			++p;
+		}
+	}
+	return false;
+}
+
+// After the start tag of a value that is not skipped, like
+// Impl::startElementHandler() and endElementHandler() together
+bool LLSDXMLParser::Impl::BufferParser::parseValue(const Tag& tag, LLSD& value)
+{
+	++mParseCount;
+	switch (tag.mElement)
+	{
+		case ELEMENT_MAP:
+			return parseMap(tag, value);
+
+		case ELEMENT_ARRAY:
+			return parseArray(tag, value);
+
+		case ELEMENT_UNDEF:
+		case ELEMENT_UNKNOWN:
+			// Anything nested in a value that is not a map or array is
+			// skipped
+			value.clear();
+			return skipElement(tag);
+
+		default:
+			break;
+	}
+
+	mCurrentContent.clear();
+	if (!tag.mEmpty
+		&& (!readText(&mCurrentContent) || !atEndTag() || !readEndTag(tag)))
+	{
+		return false;
+	}
+
+	switch (tag.mElement)
+	{
+		case ELEMENT_BOOL:
+			value = (mCurrentContent == "true" || mCurrentContent == "1");
+			break;
+
+		case ELEMENT_INTEGER:
+			value = content_as_integer(mCurrentContent);
+			break;
+
+		case ELEMENT_REAL:
+			value = content_as_real(mCurrentContent);
+			break;
+
+		case ELEMENT_STRING:
+			value = mCurrentContent;
+			break;
+
+		case ELEMENT_UUID:
+			value = LLUUID(mCurrentContent);
+			break;
+
+		case ELEMENT_DATE:
+			value = LLDate(mCurrentContent);
+			break;
+
+		case ELEMENT_URI:
+			value = LLURI(mCurrentContent);
+			break;
+
+		case ELEMENT_BINARY:
+		{
+			std::vector<U8> data;
+			content_as_binary(mCurrentContent, data);
+			value = data;
+			break;
+		}
+
+		default:
+			break;
+	}
+	return true;
+}
+
+bool LLSDXMLParser::Impl::BufferParser::parseMap(const Tag& tag, LLSD& map)
+{
+	map = LLSD::emptyMap();
+	if (tag.mEmpty)
+	{
+		return true;
+	}
+	while (true)
+	{
+		if (!readText(NULL))
+		{
+			return false;
+		}
+		if (atEndTag())
+		{
+			return readEndTag(tag);
+		}
+
+		Tag child;
+		if (!readStartTag(child))
+		{
+			return false;
+		}
+		if (child.mElement == ELEMENT_KEY)
+		{
+			mCurrentKey.clear();
+			if (!child.mEmpty
+				&& (!readText(&mCurrentKey) || !atEndTag() || !readEndTag(child)))
+			{
+				return false;
+			}
+		}
+		else if (isSkipped(child, true) || mCurrentKey.empty())
+		{
+			if (!skipElement(child))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			LLSD& value = map[mCurrentKey];
+			mCurrentKey.clear();
+			if (!parseValue(child, value))
+			{
+				return false;
+			}
+		}
+	}
+}
+
+bool LLSDXMLParser::Impl::BufferParser::parseArray(const Tag& tag, LLSD& array)
+{
+	array = LLSD::emptyArray();
+	if (tag.mEmpty)
+	{
+		return true;
+	}
+	while (true)
+	{
+		if (!readText(NULL))
+		{
+			return false;
+		}
+		if (atEndTag())
+		{
+			return readEndTag(tag);
+		}
+
+		Tag child;
+		if (!readStartTag(child))
+		{
+			return false;
+		}
+		if (isSkipped(child, false))
+		{
+			if (!skipElement(child))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			array.append(LLSD());
+			if (!parseValue(child, array[array.size() - 1]))
+			{
+				return false;
+			}
+		}
+	}
+}
+
+// Checks the element is well formed without looking at what is in it
+bool LLSDXMLParser::Impl::BufferParser::skipElement(const Tag& tag)
+{
+	if (tag.mEmpty)
+	{
+		return true;
+	}
+	while (true)
+	{
+		if (!readText(NULL))
+		{
+			return false;
+		}
+		if (atEndTag())
+		{
+			return readEndTag(tag);
+		}
+
+		Tag child;
+		if (!readStartTag(child) || !skipElement(child))
+		{
+			return false;
+		}
+	}
+}
+
+//static
+bool LLSDXMLParser::Impl::parseBuffer(const char* buf, size_t len, LLSD& data, S32& parse_count)
+{
+	BufferParser parser(buf, len);
+	return parser.parse(data, parse_count);
+}
+
+
+
+
+
+/**
+ * LLSDXMLParser
+ */
+LLSDXMLParser::LLSDXMLParser(bool emit_errors /* = true */) : impl(* new Impl(emit_errors))
+{
+}
+
+LLSDXMLParser::~LLSDXMLParser()
+{
+	delete &impl;
+}
+
+void LLSDXMLParser::parsePart(const char *buf, int len)
+{
+	impl.parsePart(buf, len);
+}
+
+// virtual
+S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data, S32 max_depth) const
+{
+	#ifdef XML_PARSER_PERFORMANCE_TESTS
+	XML_Timer timer( &parseTime );
+	#endif	// XML_PARSER_PERFORMANCE_TESTS
+
+	if (mParseLines)
+	{
+		// Use line-based reading (faster code)
+		return impl.parseLines(input, data);
+	}
+
+	return impl.parse(input, data);
+}
+
+// virtual
+S32 LLSDXMLParser::doParseEvents(std::istream& input, LLSDStreamHandler& handler, S32 max_depth) const
+{
+	LLSD unused;
+	impl.setHandler(&handler);
+	S32 parse_count = mParseLines ? impl.parseLines(input, unused) : impl.parse(input, unused);
+	impl.setHandler(NULL);
+	return parse_count;
+}
+
+//	virtual 
+void LLSDXMLParser::doReset()
+{
+	impl.reset();
+}
+
+// static
+S32 LLSDSerialize::fromXML(LLSD& sd, const char* buf, size_t len, bool emit_errors)
+{
+	S32 parse_count = 0;
+	if (LLSDXMLParser::Impl::parseBuffer(buf, len, sd, parse_count))
+	{
+		return parse_count;
+	}
+
+	LLMemoryStream stream((const U8*)buf, (S32)len);
+	return fromXMLEmbedded(sd, stream, emit_errors);
 }
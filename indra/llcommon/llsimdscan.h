@@ -0,0 +1,194 @@
+/**
+ * @file llsimdscan.h
+ * @brief Helpers for scanning text buffers, SSE2 where it pays
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSIMDSCAN_H
+#define LL_LLSIMDSCAN_H
+
+// The x86 builds require SSE2, other targets use the scalar loops. All
+// helpers look at 16 bytes at a time and never read outside [p, end).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LL_SIMD_SCAN 1
+#include <emmintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+#else
+#define LL_SIMD_SCAN 0
+#endif
+
+#include <cerrno>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+
+// Index of the lowest set bit, mask must not be 0
+inline U32 ll_lowest_bit(U32 mask)
+{
+#if LL_WINDOWS
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (U32)index;
+#else
+	return (U32)__builtin_ctz(mask);
+#endif
+}
+
+// isspace() in the "C" locale: space, \t, \n, \v, \f and \r
+inline bool ll_is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// First character of [p, end) that is not ll_is_space(), or end
+inline const char* ll_skip_space(const char* p, const char* end)
+{
+	// Most runs are a single separator
+	if (p == end || !ll_is_space(*p))
+	{
+		return p;
+	}
+#if LL_SIMD_SCAN
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i below_tab = _mm_set1_epi8('\t' - 1);
+	const __m128i above_cr = _mm_set1_epi8('\r' + 1);
+	while (end - p >= 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)p);
+		__m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(c, space),
+										_mm_and_si128(_mm_cmpgt_epi8(c, below_tab),
+													  _mm_cmplt_epi8(c, above_cr)));
+		U32 mask = ~(U32)_mm_movemask_epi8(is_space) & 0xffff;
+		if (mask)
+		{
+			return p + ll_lowest_bit(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && ll_is_space(*p))
+	{
+		++p;
+	}
+	return p;
+}
+
+// First a or b in [p, end), or end
+inline const char* ll_find_either(const char* p, const char* end, char a, char b)
+{
+#if LL_SIMD_SCAN
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	while (end - p >= 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)p);
+		U32 mask = (U32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, va),
+													   _mm_cmpeq_epi8(c, vb)));
+		if (mask)
+		{
+			return p + ll_lowest_bit(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && *p != a && *p != b)
+	{
+		++p;
+	}
+	return p;
+}
+
+// Reads a plain decimal real, [+-]digits[.digits][e[+-]digits], at p the
+// way std::istream >> F64 would. Returns the end of the number, or NULL for
+// anything else (inf, nan, hex, out of range, a locale whose decimal point
+// is not '.') so the caller can fall back to the stream.
+inline const char* ll_scan_real(const char* p, const char* end, F64& value)
+{
+	const char* start = p;
+	if (p != end && (*p == '-' || *p == '+'))
+	{
+		++p;
+	}
+	bool has_digits = false;
+	while (p != end && *p >= '0' && *p <= '9')
+	{
+		++p;
+		has_digits = true;
+	}
+	if (p != end && *p == '.')
+	{
+		++p;
+		while (p != end && *p >= '0' && *p <= '9')
+		{
+			++p;
+			has_digits = true;
+		}
+	}
+	if (!has_digits)
+	{
+		return NULL;
+	}
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		if (p != end && (*p == '-' || *p == '+'))
+		{
+			++p;
+		}
+		if (p == end || *p < '0' || *p > '9')
+		{
+			return NULL;
+		}
+		while (p != end && *p >= '0' && *p <= '9')
+		{
+			++p;
+		}
+	}
+
+	// The stream always uses a '.', strtod() the C locale's separator
+	const char* point = localeconv()->decimal_point;
+	if (point[0] != '.' || point[1] != '\0')
+	{
+		return NULL;
+	}
+	char text[64];
+	size_t length = p - start;
+	if (length >= sizeof(text))
+	{
+		return NULL;
+	}
+	memcpy(text, start, length);
+	text[length] = '\0';
+	errno = 0;
+	char* stop = NULL;
+	value = strtod(text, &stop);
+	if (errno == ERANGE || stop != text + length)
+	{
+		return NULL;
+	}
+	return p;
+}
+
+#endif // LL_LLSIMDSCAN_H
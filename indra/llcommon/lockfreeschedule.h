@@ -0,0 +1,645 @@
+/**
+ * @file   lockfreeschedule.h
+ * @date   2022-03-14
+ * @brief  LockFreeSchedule is a timestamped multi-producer, multi-consumer
+ *         queue whose immediate items never take a lock.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Copyright (c) 2022, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+#if ! defined(LL_LOCKFREESCHEDULE_H)
+#define LL_LOCKFREESCHEDULE_H
+
+#include "llcoros.h"
+#include LLCOROS_MUTEX_HEADER
+#include LLCOROS_CONDVAR_HEADER
+#include "llexception.h"
+#include "llthreadsafequeue.h"      // LLThreadSafeQueueInterrupt
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace LL
+{
+    /**
+     * LockFreeSchedule makes the same promises as a ThreadSafeSchedule with
+     * a single data type: no item is popped before its timestamp, push()
+     * blocks while the queue is full, and after close() consumers drain
+     * whatever is left before pop() throws. But pushing and popping work
+     * that is due right away never locks, so any number of threads can post
+     * to a busy consumer without contending with it or with each other.
+     *
+     * Items that are due when pushed go into a bounded ring. Each slot
+     * carries a sequence number saying whether it is a producer's or a
+     * consumer's turn next, and producers and consumers claim slots by
+     * bumping their own position counter with a compare-and-swap (Dmitry
+     * Vyukov's MPMC queue). The ring never has more than MAX_RING_CELLS
+     * cells, so a generous capacity costs nothing up front. Past that,
+     * immediate items wait in an overflow list under a mutex, and once
+     * anything has overflowed later items queue behind it until consumers
+     * have moved it into the ring as room frees up.
+     *
+     * Items for later go into a timer wheel: an array of slots, one per
+     * millisecond modulo the wheel size, each holding the items that fall
+     * into it. Scheduling appends to a slot, and expiry only visits the
+     * slots time has moved past. The wheel has a mutex, but timed items are
+     * rare next to immediate ones, and consumers only lock it when an atomic
+     * "next due" time says something in it is ready.
+     *
+     * Immediate items pop in the order they were pushed. Timed items pop in
+     * timestamp order, ahead of immediate items once they are due. Only the
+     * immediate items are bounded by the capacity.
+     *
+     * Consumers and producers only sleep, on a fiber aware condition
+     * variable, when the queue is empty or full; the other side only touches
+     * that condition's mutex when it sees somebody sleeping.
+     */
+    template <typename T>
+    class LockFreeSchedule
+    {
+    public:
+        using TimePoint = std::chrono::steady_clock::time_point;
+        using Clock = TimePoint::clock;
+        using Closed = LLThreadSafeQueueInterrupt;
+
+        LockFreeSchedule(U32 capacity=1024);
+        ~LockFreeSchedule();
+
+        LockFreeSchedule(const LockFreeSchedule&) = delete;
+        LockFreeSchedule& operator=(const LockFreeSchedule&) = delete;
+
+        /// push value to be popped no earlier than time, blocking while the
+        /// queue is full; throws Closed if the queue is or becomes closed
+        void push(const TimePoint& time, T&& value);
+        /// like push(), but return false instead of throwing
+        bool pushIfOpen(const TimePoint& time, T&& value);
+        /// never blocks: return false if the queue is full or closed, in
+        /// which case value is left alone
+        bool tryPush(const TimePoint& time, T&& value);
+
+        /// pop the next ready item, waiting for one if need be; throws
+        /// Closed once the queue is closed and drained
+        T pop();
+        /// pop the next ready item if there is one
+        bool tryPop(T& value);
+
+        /// items queued, including timed items not yet due
+        size_t size() const;
+        /// immediate items the queue holds, the requested capacity rounded
+        /// up to a power of 2
+        size_t capacity() const { return mCapacity; }
+        /// cells allocated up front, at most MAX_RING_CELLS
+        size_t ringCapacity() const { return mMask + 1; }
+
+        static const size_t MAX_RING_CELLS = 4096;
+
+        /// producer end: are we prevented from pushing any additional items?
+        bool isClosed() const { return mClosed.load(std::memory_order_acquire); }
+        /// consumer end: are we done, is the queue entirely drained?
+        bool done() const { return isClosed() && size() == 0; }
+        void close();
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> mSequence;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage;
+
+            T* value() { return reinterpret_cast<T*>(&mStorage); }
+        };
+
+        struct Timed
+        {
+            TimePoint mTime;
+            T mValue;
+        };
+
+        // Timer wheel resolution and size: a full turn covers a quarter of a
+        // second, items further out stay in their slot for more turns.
+        using Tick = std::chrono::milliseconds;
+        static const size_t WHEEL_SLOTS = 256;
+        static const TimePoint::rep NOTHING_DUE = std::numeric_limits<TimePoint::rep>::max();
+
+        static size_t roundCapacity(U32 capacity);
+        static size_t ringCells(U32 capacity)
+        {
+            size_t rounded = roundCapacity(capacity);
+            return rounded < MAX_RING_CELLS ? rounded : MAX_RING_CELLS;
+        }
+        static Tick::rep tickOf(const TimePoint& time)
+        {
+            return std::chrono::duration_cast<Tick>(time.time_since_epoch()).count();
+        }
+
+        bool enqueue(T& value);
+        bool dequeue(T& value);
+        bool ringEmpty() const;
+        bool ringFull() const;
+        bool empty() const;
+        bool full() const;
+
+        bool pushNow(T& value);
+        bool overflow(T& value);
+        void refill();
+
+        void schedule(const TimePoint& time, T& value);
+        bool popDue(T& value);
+        // the following need mWheelLock
+        void expire(const TimePoint& now);
+        void insertDue(Timed&& timed);
+        void updateNextDue();
+
+        void wakeConsumers(bool all);
+        void wakeProducers();
+
+        // The positions each get a cache line of their own, producers and
+        // consumers hammer them from different threads
+        std::unique_ptr<Cell[]> mCells;
+        const size_t mCapacity;
+        const size_t mMask;
+        char mPad0[64];
+        std::atomic<size_t> mPushPos;
+        char mPad1[64];
+        std::atomic<size_t> mPopPos;
+        char mPad2[64];
+        std::atomic<size_t> mTimedCount;
+        std::atomic<TimePoint::rep> mNextDue;
+        std::atomic<U32> mSleepingConsumers;
+        std::atomic<U32> mSleepingProducers;
+        std::atomic<bool> mClosed;
+        std::atomic<size_t> mOverflowCount;
+
+        LLCoros::Mutex mOverflowLock;
+        std::deque<T> mOverflow;    // pushed while the ring was full, oldest first
+
+        LLCoros::Mutex mWheelLock;
+        std::vector<Timed> mWheel[WHEEL_SLOTS];
+        std::deque<Timed> mDue;     // expired, in time order
+        Tick::rep mWheelTick;       // last tick expire() looked at
+
+        LLCoros::Mutex mSleepLock;
+        LLCoros::ConditionVariable mNotEmpty;
+        LLCoros::ConditionVariable mNotFull;
+    };
+
+    /*************************************************************************
+    *   LockFreeSchedule implementation
+    *************************************************************************/
+    template <typename T>
+    LockFreeSchedule<T>::LockFreeSchedule(U32 capacity):
+        mCells(new Cell[ringCells(capacity)]),
+        mCapacity(roundCapacity(capacity)),
+        mMask(ringCells(capacity) - 1),
+        mPushPos(0),
+        mPopPos(0),
+        mTimedCount(0),
+        mNextDue(NOTHING_DUE),
+        mSleepingConsumers(0),
+        mSleepingProducers(0),
+        mClosed(false),
+        mOverflowCount(0),
+        mWheelTick(tickOf(Clock::now()))
+    {
+        for (size_t i = 0; i <= mMask; ++i)
+        {
+            mCells[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T>
+    LockFreeSchedule<T>::~LockFreeSchedule()
+    {
+        // Nobody else is looking any more, destroy what was never popped
+        for (size_t pos = mPopPos.load(); pos != mPushPos.load(); ++pos)
+        {
+            Cell& cell = mCells[pos & mMask];
+            if (cell.mSequence.load() == pos + 1)
+            {
+                cell.value()->~T();
+            }
+        }
+    }
+
+    //static
+    template <typename T>
+    size_t LockFreeSchedule<T>::roundCapacity(U32 capacity)
+    {
+        size_t rounded = 2;
+        while (rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::push(const TimePoint& time, T&& value)
+    {
+        if (! pushIfOpen(time, std::move(value)))
+        {
+            LLTHROW(Closed());
+        }
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::pushIfOpen(const TimePoint& time, T&& value)
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+        while (true)
+        {
+            if (tryPush(time, std::move(value)))
+                return true;
+            if (isClosed())
+                return false;
+
+            // The queue is full: wait for a consumer to make room. Announce
+            // ourselves before rechecking, a consumer that pops after the
+            // recheck is then sure to see us and wake us.
+            LLCoros::LockType lock(mSleepLock);
+            mSleepingProducers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (! isClosed() && full())
+            {
+                mNotFull.wait(lock);
+            }
+            mSleepingProducers.fetch_sub(1);
+        }
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::tryPush(const TimePoint& time, T&& value)
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+        if (isClosed())
+            return false;
+
+        if (time > Clock::now())
+        {
+            schedule(time, value);
+            // sleeping consumers may need to wake sooner than they planned
+            wakeConsumers(true);
+            return true;
+        }
+
+        if (! pushNow(value))
+            return false;
+        wakeConsumers(false);
+        return true;
+    }
+
+    template <typename T>
+    T LockFreeSchedule<T>::pop()
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+        T value;
+        while (true)
+        {
+            if (tryPop(value))
+                return value;
+            if (done())
+            {
+                LLTHROW(Closed());
+            }
+
+            // Same dance as pushIfOpen(): announce, recheck, then sleep,
+            // until the next timed item is due if there is one.
+            LLCoros::LockType lock(mSleepLock);
+            mSleepingConsumers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (empty())
+            {
+                TimePoint::rep next_due = mNextDue.load(std::memory_order_acquire);
+                if (next_due == NOTHING_DUE)
+                {
+                    // once closed nothing more can come
+                    if (! isClosed())
+                    {
+                        mNotEmpty.wait(lock);
+                    }
+                }
+                else if (Clock::now().time_since_epoch().count() < next_due)
+                {
+                    mNotEmpty.wait_until(lock, TimePoint(TimePoint::duration(next_due)));
+                }
+            }
+            mSleepingConsumers.fetch_sub(1);
+        }
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::tryPop(T& value)
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+        if (popDue(value))
+            return true;
+        bool popped = dequeue(value);
+        if (mOverflowCount.load(std::memory_order_acquire))
+        {
+            // Top the ring back up. This is also what empties the overflow
+            // when the ring drained before a producer could add to it.
+            refill();
+            popped = popped || dequeue(value);
+        }
+        if (! popped)
+            return false;
+        wakeProducers();
+        return true;
+    }
+
+    template <typename T>
+    size_t LockFreeSchedule<T>::size() const
+    {
+        // mPopPos never passes mPushPos, read it first so the difference
+        // can't go negative
+        size_t pop_pos = mPopPos.load(std::memory_order_acquire);
+        size_t push_pos = mPushPos.load(std::memory_order_acquire);
+        return (push_pos - pop_pos) + mOverflowCount.load(std::memory_order_acquire)
+            + mTimedCount.load(std::memory_order_acquire);
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::close()
+    {
+        mClosed.store(true, std::memory_order_release);
+        LLCoros::LockType lock(mSleepLock);
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    // Vyukov's enqueue: a slot whose sequence equals our position is free
+    // for us, one behind it is still waiting for a consumer
+    template <typename T>
+    bool LockFreeSchedule<T>::enqueue(T& value)
+    {
+        Cell* cell;
+        size_t pos = mPushPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &mCells[pos & mMask];
+            size_t sequence = cell->mSequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // full
+                return false;
+            }
+            else
+            {
+                // another producer got there first
+                pos = mPushPos.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->value()) T(std::move(value));
+        cell->mSequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::dequeue(T& value)
+    {
+        Cell* cell;
+        size_t pos = mPopPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &mCells[pos & mMask];
+            size_t sequence = cell->mSequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (mPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // empty
+                return false;
+            }
+            else
+            {
+                pos = mPopPos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(*cell->value());
+        cell->value()->~T();
+        // free for the producer one lap ahead
+        cell->mSequence.store(pos + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::ringEmpty() const
+    {
+        return mPushPos.load() == mPopPos.load();
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::ringFull() const
+    {
+        size_t pop_pos = mPopPos.load();
+        return mPushPos.load() - pop_pos > mMask;
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::empty() const
+    {
+        return ringEmpty() && ! mOverflowCount.load();
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::full() const
+    {
+        return ringFull() && mOverflowCount.load() >= mCapacity - (mMask + 1);
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::pushNow(T& value)
+    {
+        // Once anything has overflowed, later items go behind it so each
+        // producer's items still pop in the order it pushed them
+        if (! mOverflowCount.load(std::memory_order_acquire) && enqueue(value))
+            return true;
+        return overflow(value);
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::overflow(T& value)
+    {
+        if (mCapacity == mMask + 1)
+            return false;
+
+        LLCoros::LockType lock(mOverflowLock);
+        // the ring may have drained since
+        if (mOverflow.empty() && enqueue(value))
+            return true;
+        if (mOverflow.size() >= mCapacity - (mMask + 1))
+            return false;
+        mOverflow.push_back(std::move(value));
+        mOverflowCount.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    // Move overflowed items into the ring as far as there is room. The count
+    // only drops once an item is in the ring, a producer that sees it at zero
+    // can't get ahead of its own earlier items.
+    template <typename T>
+    void LockFreeSchedule<T>::refill()
+    {
+        LLCoros::LockType lock(mOverflowLock);
+        while (! mOverflow.empty() && enqueue(mOverflow.front()))
+        {
+            mOverflow.pop_front();
+            mOverflowCount.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::schedule(const TimePoint& time, T& value)
+    {
+        LLCoros::LockType lock(mWheelLock);
+        Timed timed{ time, std::move(value) };
+        Tick::rep tick = tickOf(time);
+        if (tick < mWheelTick)
+        {
+            // expire() has been past its slot already
+            insertDue(std::move(timed));
+        }
+        else
+        {
+            mWheel[tick % WHEEL_SLOTS].push_back(std::move(timed));
+        }
+        mTimedCount.fetch_add(1, std::memory_order_release);
+        if (time.time_since_epoch().count() < mNextDue.load(std::memory_order_relaxed))
+        {
+            mNextDue.store(time.time_since_epoch().count(), std::memory_order_release);
+        }
+    }
+
+    template <typename T>
+    bool LockFreeSchedule<T>::popDue(T& value)
+    {
+        // The unlocked checks are the whole point: with nothing timed, or
+        // nothing due yet, this costs two atomic loads and a clock read
+        if (! mTimedCount.load(std::memory_order_acquire))
+            return false;
+        TimePoint now = Clock::now();
+        if (now.time_since_epoch().count() < mNextDue.load(std::memory_order_acquire))
+            return false;
+
+        LLCoros::LockType lock(mWheelLock);
+        expire(now);
+        if (mDue.empty())
+            return false;
+        value = std::move(mDue.front().mValue);
+        mDue.pop_front();
+        mTimedCount.fetch_sub(1, std::memory_order_release);
+        updateNextDue();
+        return true;
+    }
+
+    // Move everything due by now from the slots time has passed to mDue
+    template <typename T>
+    void LockFreeSchedule<T>::expire(const TimePoint& now)
+    {
+        Tick::rep now_tick = tickOf(now);
+        if (now_tick < mWheelTick)
+            return;
+
+        // Revisit the current tick next time, it may still hold items due
+        // later within it. A long gap means a full turn, once.
+        Tick::rep slots = std::min<Tick::rep>(now_tick - mWheelTick + 1, WHEEL_SLOTS);
+        for (Tick::rep i = 0; i < slots; ++i)
+        {
+            std::vector<Timed>& slot = mWheel[(mWheelTick + i) % WHEEL_SLOTS];
+            for (size_t j = 0; j < slot.size(); )
+            {
+                if (slot[j].mTime <= now)
+                {
+                    insertDue(std::move(slot[j]));
+                    slot[j] = std::move(slot.back());
+                    slot.pop_back();
+                }
+                else
+                {
+                    // a later turn of the wheel
+                    ++j;
+                }
+            }
+        }
+        mWheelTick = now_tick;
+        updateNextDue();
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::insertDue(Timed&& timed)
+    {
+        // usually lands at the end
+        auto where = std::upper_bound(mDue.begin(), mDue.end(), timed.mTime,
+                                      [](const TimePoint& time, const Timed& other)
+                                      { return time < other.mTime; });
+        mDue.insert(where, std::move(timed));
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::updateNextDue()
+    {
+        TimePoint::rep next_due = NOTHING_DUE;
+        if (! mDue.empty())
+        {
+            next_due = mDue.front().mTime.time_since_epoch().count();
+        }
+        else if (mTimedCount.load(std::memory_order_relaxed))
+        {
+            // Only runs when something expired, and timed items are few
+            for (const std::vector<Timed>& slot : mWheel)
+            {
+                for (const Timed& timed : slot)
+                {
+                    next_due = std::min(next_due, timed.mTime.time_since_epoch().count());
+                }
+            }
+        }
+        mNextDue.store(next_due, std::memory_order_release);
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::wakeConsumers(bool all)
+    {
+        // pairs with the fence in pop(): either the sleeper sees our item
+        // or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleepingConsumers.load(std::memory_order_relaxed))
+        {
+            LLCoros::LockType lock(mSleepLock);
+            if (all)
+                mNotEmpty.notify_all();
+            else
+                mNotEmpty.notify_one();
+        }
+    }
+
+    template <typename T>
+    void LockFreeSchedule<T>::wakeProducers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleepingProducers.load(std::memory_order_relaxed))
+        {
+            LLCoros::LockType lock(mSleepLock);
+            mNotFull.notify_all();
+        }
+    }
+
+} // namespace LL
+
+#endif /* ! defined(LL_LOCKFREESCHEDULE_H) */
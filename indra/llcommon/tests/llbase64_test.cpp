@@ -25,7 +25,9 @@
  * $/LicenseInfo$
  */
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "linden_common.h"
 
@@ -74,4 +76,40 @@ namespace tut
 				(result == "c9+s/4xGMX3smy3HZRGkg+YTUEBwNYdi7QwaSH4OkY92xAuxhKnDhg==") );
 	}
 
+	template<> template<>
+	void base64_object::test<3>()
+	{
+		std::vector<U8> result;
+
+		LLBase64::decode("", 0, result);
+		ensure("decode nothing", result.empty());
+
+		// Long enough for the 16 character blocks and a tail of each length
+		std::vector<U8> blob;
+		for (int i = 0; i < 200; ++i)
+		{
+			blob.push_back((U8)(i * 37 + 11));
+		}
+		for (size_t size = 0; size <= blob.size(); size += 7)
+		{
+			std::string encoded = LLBase64::encode(blob.data(), (S32)size);
+			LLBase64::decode(encoded.data(), encoded.size(), result);
+			ensure_equals("decoded size", result.size(), size);
+			ensure("decode round trip", std::equal(result.begin(), result.end(), blob.begin()));
+		}
+
+		std::string text("UmoeB6Gd\nuu2ExP8I pIjRXg==");
+		LLBase64::decode(text.data(), text.size(), result);
+		ensure_equals("decode stops at whitespace", result.size(), 6);
+		LLBase64::decode(text.data(), text.size(), result, true);
+		ensure_equals("decode skipping whitespace", result.size(), UUID_BYTES);
+		LLUUID id;
+		memcpy(id.mData, result.data(), UUID_BYTES);
+		ensure_equals("decoded uuid", id.asString(), "526a1e07-a19d-baed-84c4-ff08a488d15e");
+
+		text = "aGVsbG8=d29ybGQ=";
+		LLBase64::decode(text.data(), text.size(), result);
+		ensure_equals("decode stops at padding", std::string(result.begin(), result.end()), "hello");
+	}
+
 }
@@ -0,0 +1,220 @@
+/**
+ * @file llqueuedthread_test.cpp
+ * @brief Tests for the LLQueuedThread request queue.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../llqueuedthread.h"
+
+#include <algorithm>
+#include <random>
+
+#include "stringize.h"
+#include "../test/lltut.h"
+
+namespace
+{
+    class TestRequest : public LLQueuedThread::QueuedRequest
+    {
+    public:
+        TestRequest(LLQueuedThread::handle_t handle, U32 priority):
+            LLQueuedThread::QueuedRequest(handle, priority)
+        {}
+
+        using LLQueuedThread::QueuedRequest::deleteRequest;
+
+    protected:
+        bool processRequest() override { return true; }
+    };
+
+    // Only here to reach the protected queue type
+    class TestQueuedThread : public LLQueuedThread
+    {
+    public:
+        typedef LLQueuedThread::request_queue_t queue_t;
+    };
+
+    bool higher_priority(const TestRequest* lhs, const TestRequest* rhs)
+    {
+        return lhs->higherPriority(*rhs);
+    }
+}
+
+namespace tut
+{
+    struct llqueuedthread_data
+    {
+        TestQueuedThread::queue_t mQueue;
+        std::vector<TestRequest*> mRequests;
+
+        ~llqueuedthread_data()
+        {
+            for (TestRequest* req : mRequests)
+            {
+                req->deleteRequest();
+            }
+        }
+
+        TestRequest* add(U32 priority)
+        {
+            TestRequest* req = new TestRequest(mRequests.size() + 1, priority);
+            mRequests.push_back(req);
+            mQueue.insert(req);
+            return req;
+        }
+
+        // Pops everything, checking it comes out in the same order as
+        // sorting the requests by QueuedRequest::higherPriority()
+        void ensurePopOrder(const std::string& msg, std::vector<TestRequest*> expected)
+        {
+            std::sort(expected.begin(), expected.end(), higher_priority);
+            ensure_equals(msg + " size", mQueue.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                ensure(STRINGIZE(msg << " pop " << i), mQueue.pop() == expected[i]);
+            }
+            ensure(msg + " empty", mQueue.empty());
+            ensure(msg + " pop when empty", mQueue.pop() == NULL);
+        }
+    };
+    typedef test_group<llqueuedthread_data> llqueuedthread_group;
+    typedef llqueuedthread_group::object object;
+    llqueuedthread_group llqueuedthreadgrp("LLQueuedThread");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("pop order");
+        ensure("top when empty", mQueue.top() == NULL);
+        const U32 priorities[] = { 5, 9, 1, 9, 3, 7, 5, 0, 8, 9, 2, 6 };
+        for (U32 priority : priorities)
+        {
+            add(priority);
+        }
+        // Equal priorities go by handle, lowest first
+        ensure("top", mQueue.top() == mRequests[1]);
+        ensure("top leaves the request queued", mQueue.size() == mRequests.size());
+        ensurePopOrder("pop order", mRequests);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("reprioritize");
+        for (U32 i = 0; i < 64; ++i)
+        {
+            add(i * 10);
+        }
+        // Few enough changes to be sifted in place
+        mQueue.setPriority(mRequests[63], 5);
+        mQueue.setPriority(mRequests[0], 1000);
+        mQueue.setPriority(mRequests[31], 315);
+        ensure("raised request on top", mQueue.top() == mRequests[0]);
+        mQueue.setPriority(mRequests[0], 0);
+        ensure("lowered request off the top", mQueue.top() == mRequests[62]);
+        ensurePopOrder("after reprioritize", mRequests);
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("deferred changes");
+        TestRequest* a = add(10);
+        TestRequest* b = add(5);
+        mQueue.setPriority(b, 20);
+        ensure_equals("priority stored at once", b->getPriority(), 20U);
+        // The heap isn't touched until the next insert, pop or top
+        ensure("heap unchanged", *mQueue.begin() == a);
+
+        // Several changes to one request before they're applied
+        mQueue.setPriority(a, 30);
+        mQueue.setPriority(a, 1);
+        mQueue.setPriority(a, 15);
+        add(17);
+        ensure("changes applied on insert", *mQueue.begin() == b);
+        ensurePopOrder("after deferred changes", mRequests);
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("rebuild");
+        std::mt19937 rng(1234);
+        for (U32 i = 0; i < 200; ++i)
+        {
+            add(rng() % 50);
+        }
+        // Changing most of the queue takes the rebuild path
+        for (TestRequest* req : mRequests)
+        {
+            if (rng() % 4)
+            {
+                mQueue.setPriority(req, rng() % 50);
+            }
+        }
+        ensurePopOrder("after rebuild", mRequests);
+    }
+
+    template<> template<>
+    void object::test<5>()
+    {
+        set_test_name("interleaved changes, inserts and pops");
+        std::mt19937 rng(42);
+        std::vector<TestRequest*> queued;
+        for (U32 i = 0; i < 300; ++i)
+        {
+            queued.push_back(add(rng() % 50));
+        }
+        for (S32 step = 0; step < 2000 && !queued.empty(); ++step)
+        {
+            U32 op = rng() % 10;
+            if (op < 6)
+            {
+                mQueue.setPriority(queued[rng() % queued.size()], rng() % 50);
+            }
+            else if (op < 8)
+            {
+                TestRequest* expected = *std::min_element(queued.begin(), queued.end(), higher_priority);
+                ensure(STRINGIZE("pop at step " << step), mQueue.pop() == expected);
+                queued.erase(std::find(queued.begin(), queued.end(), expected));
+            }
+            else if (op < 9)
+            {
+                queued.push_back(add(rng() % 50));
+            }
+            else
+            {
+                // A burst of changes
+                for (TestRequest* req : queued)
+                {
+                    if (rng() % 2)
+                    {
+                        mQueue.setPriority(req, rng() % 50);
+                    }
+                }
+            }
+        }
+        ensurePopOrder("remaining", queued);
+    }
+} // namespace tut
@@ -56,6 +56,7 @@ using namespace boost::phoenix;
 #include "../llsdserialize.h"
 #include "llsdutil.h"
 #include "../llformat.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 #include "../test/namedtempfile.h"
@@ -1694,6 +1695,492 @@ namespace tut
 		ensureBinaryAndXML("map", test);
 	}
 
+	/**
+	 * @class TestLLSDArena
+	 * @brief Arena documents read back the same as the LLSD they came from
+	 */
+	class TestLLSDArena
+	{
+	public:
+		TestLLSDArena()
+		{
+			mSD = LLSD::emptyMap();
+			mSD["name"] = "folder";
+			mSD["version"] = 12;
+			mSD["scale"] = 2.5;
+			mSD["owner_id"] = LLUUID("01234567-89ab-cdef-0123-456789abcdef");
+			mSD["created"] = LLDate(12345.0);
+			mSD["link"] = LLURI("http://www.secondlife.com/");
+			mSD["flag"] = true;
+			mSD["nothing"] = LLSD();
+			mSD["empty"] = LLSD::emptyMap();
+			std::vector<U8> bytes;
+			for (int i = 0; i < 50; ++i)
+			{
+				bytes.push_back(i * 3);
+			}
+			mSD["bytes"] = bytes;
+			LLSD items = LLSD::emptyArray();
+			for (int i = 0; i < 20; ++i)
+			{
+				LLSD item;
+				item["name"] = llformat("item %d", i);
+				item["type"] = i % 4;
+				items.append(item);
+			}
+			mSD["items"] = items;
+		}
+
+		void ensureSame(const std::string& msg, const LLPointer<LLSDArena>& doc, const LLSD& expected)
+		{
+			ensure((msg + " parsed").c_str(), doc.notNull());
+			std::ostringstream expected_str, actual_str;
+			LLSDSerialize::toNotation(expected, expected_str);
+			LLSDSerialize::toNotation(doc->toLLSD(), actual_str);
+			ensure_equals(msg.c_str(), actual_str.str(), expected_str.str());
+		}
+
+		LLSD mSD;
+	};
+
+	typedef tut::test_group<TestLLSDArena> TestLLSDArenaGroup;
+	typedef TestLLSDArenaGroup::object TestLLSDArenaObject;
+	TestLLSDArenaGroup gTestLLSDArenaGroup("llsd arena");
+
+	template<> template<>
+	void TestLLSDArenaObject::test<1>()
+	{
+		LLPointer<LLSDArena> doc = LLSDArena::fromLLSD(mSD);
+		ensureSame("fromLLSD", doc, mSD);
+
+		const LLSDArena::Value& root = doc->root();
+		ensure("map", root.isMap());
+		ensure_equals("size", root.size(), mSD.size());
+		ensure_equals("string", root["name"].asString(), std::string("folder"));
+		ensure_equals("integer", root["version"].asInteger(), 12);
+		ensure_equals("nested", root["items"][7]["name"].asString(), std::string("item 7"));
+		ensure_equals("uuid", root["owner_id"].asUUID(), mSD["owner_id"].asUUID());
+		ensure_equals("binary", root["bytes"].asBinary(), mSD["bytes"].asBinary());
+		ensure("missing key", root["missing"].isUndefined() && !root.has("missing"));
+		ensure("missing index", root["items"][20].isUndefined());
+		ensure("wrong type", root["name"][0].isUndefined());
+		ensure_equals("conversion", root["version"].asString(), mSD["version"].asString());
+		ensure_equals("real conversion", root["scale"].asInteger(), mSD["scale"].asInteger());
+
+		LLSD::map_const_iterator expected = mSD.beginMap();
+		for (LLSDArena::Value::map_const_iterator iter = root.beginMap(); iter != root.endMap(); ++iter, ++expected)
+		{
+			ensure_equals("key order", iter->first.asString(), expected->first);
+		}
+	}
+
+	template<> template<>
+	void TestLLSDArenaObject::test<2>()
+	{
+		std::stringstream xml;
+		LLSDSerialize::toXML(mSD, xml);
+		LLPointer<LLSDArena> doc;
+		S32 count = LLSDSerialize::fromXML(doc, xml);
+		ensure("xml count", count > 0);
+		ensureSame("xml", doc, mSD);
+
+		std::stringstream binary;
+		LLSDSerialize::toBinary(mSD, binary);
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		LLSDArena::Builder builder;
+		count = parser->parse(binary, builder, binary.str().size());
+		doc = builder.finish();
+		ensure("binary count", count > 0);
+		ensureSame("binary", doc, mSD);
+
+		std::istringstream truncated("<llsd><map><key>a</key><integer>1</integer>");
+		count = LLSDSerialize::fromXML(doc, truncated, false);
+		ensure_equals("truncated xml", count, (S32)LLSDParser::PARSE_FAILURE);
+		ensure("truncated xml document", doc.isNull());
+	}
+
+	template<> template<>
+	void TestLLSDArenaObject::test<3>()
+	{
+		// Unsorted and repeated keys, last value wins like LLSD::operator[]
+		LLSDArena::Builder builder;
+		builder.beginMap();
+		const char* keys[] = { "q", "b", "zz", "a", "b", "c", "d", "e", "f", "g",
+							   "h", "i", "j", "k", "l", "m", "n", "o", "p" };
+		LLSD expected = LLSD::emptyMap();
+		for (S32 i = 0; i < (S32)LL_ARRAY_SIZE(keys); ++i)
+		{
+			builder.addKey(keys[i], strlen(keys[i]));
+			builder.addInteger(i);
+			expected[keys[i]] = i;
+		}
+		builder.endMap();
+		ensureSame("unsorted", builder.finish(), expected);
+
+		// Malformed sequences produce no document
+		builder.beginMap();
+		builder.addInteger(1);
+		builder.endMap();
+		ensure("value without key", builder.finish().isNull());
+		builder.beginArray();
+		ensure("unclosed array", builder.finish().isNull());
+		builder.addInteger(1);
+		builder.addInteger(2);
+		ensure("two top level values", builder.finish().isNull());
+	}
+
+	/**
+	 * @class TestLLSDStream
+	 * @brief Values collected from a parse stream match the parsed LLSD
+	 */
+	class TestLLSDStream
+	{
+	public:
+		TestLLSDStream()
+		{
+			mSD = LLSD::emptyMap();
+			mSD["version"] = 3;
+			LLSD items = LLSD::emptyMap();
+			for (int i = 0; i < 10; ++i)
+			{
+				LLSD item;
+				item["name"] = llformat("item %d", i);
+				item["type"] = i;
+				item["tags"].append("a");
+				item["tags"].append(LLSD::emptyMap());
+				items[llformat("id%d", i)] = item;
+			}
+			mSD["items"] = items;
+			mSD["empty"] = LLSD::emptyArray();
+		}
+
+		// Rebuilds a document from what a collector at depth 2 passed on
+		LLSD collect(LLSDParser* parser, std::istream& istr, S32& count)
+		{
+			LLSD result = LLSD::emptyMap();
+			result["items"] = LLSD::emptyMap();
+			result["empty"] = LLSD::emptyArray();
+			LLSDStreamCollector collector(2, [&](const LLSD& path, const LLSD& value)
+				{
+					if (path.size() == 1)
+					{
+						result[path[0].asString()] = value;
+					}
+					else
+					{
+						result[path[0].asString()][path[1].asString()] = value;
+					}
+					return true;
+				});
+			count = parser->parse(istr, collector, LLSDSerialize::SIZE_UNLIMITED);
+			return result;
+		}
+
+		void ensureSame(const std::string& msg, const LLSD& actual, const LLSD& expected)
+		{
+			std::ostringstream expected_str, actual_str;
+			LLSDSerialize::toNotation(expected, expected_str);
+			LLSDSerialize::toNotation(actual, actual_str);
+			ensure_equals(msg.c_str(), actual_str.str(), expected_str.str());
+		}
+
+		LLSD mSD;
+	};
+
+	typedef tut::test_group<TestLLSDStream> TestLLSDStreamGroup;
+	typedef TestLLSDStreamGroup::object TestLLSDStreamObject;
+	TestLLSDStreamGroup gTestLLSDStreamGroup("llsd stream");
+
+	template<> template<>
+	void TestLLSDStreamObject::test<1>()
+	{
+		S32 count = 0;
+
+		std::stringstream xml;
+		LLSDSerialize::toXML(mSD, xml);
+		LLPointer<LLSDParser> xml_parser = new LLSDXMLParser();
+		ensureSame("xml", collect(xml_parser, xml, count), mSD);
+		ensure("xml count", count > 0);
+
+		std::stringstream binary;
+		LLSDSerialize::toBinary(mSD, binary);
+		LLPointer<LLSDParser> binary_parser = new LLSDBinaryParser();
+		ensureSame("binary", collect(binary_parser, binary, count), mSD);
+		ensure("binary count", count > 0);
+
+		// Parsed as a whole and passed through
+		std::stringstream notation;
+		LLSDSerialize::toNotation(mSD, notation);
+		LLPointer<LLSDParser> notation_parser = new LLSDNotationParser();
+		ensureSame("notation", collect(notation_parser, notation, count), mSD);
+		ensure("notation count", count > 0);
+	}
+
+	template<> template<>
+	void TestLLSDStreamObject::test<2>()
+	{
+		// Stopping from the callback fails the parse
+		std::stringstream binary;
+		LLSDSerialize::toBinary(mSD, binary);
+		int seen = 0;
+		LLSDStreamCollector collector(2, [&](const LLSD& path, const LLSD& value)
+			{
+				return ++seen < 3;
+			});
+		LLPointer<LLSDParser> parser = new LLSDBinaryParser();
+		S32 count = parser->parse(binary, collector, LLSDSerialize::SIZE_UNLIMITED);
+		ensure_equals("stopped count", count, (S32)LLSDParser::PARSE_FAILURE);
+		ensure_equals("stopped after", seen, 3);
+		ensure("stopped", collector.isStopped());
+
+		std::stringstream xml;
+		LLSDSerialize::toXML(mSD, xml);
+		seen = 0;
+		parser = new LLSDXMLParser();
+		count = parser->parse(xml, collector, LLSDSerialize::SIZE_UNLIMITED);
+		ensure_equals("xml stopped count", count, (S32)LLSDParser::PARSE_FAILURE);
+		ensure_equals("xml stopped after", seen, 3);
+	}
+
+	template<> template<>
+	void TestLLSDStreamObject::test<3>()
+	{
+		// Depth 0 hands over one top level value per parse
+		std::stringstream stream;
+		for (int i = 0; i < 3; ++i)
+		{
+			LLSD value;
+			value["index"] = i;
+			stream << LLSDOStreamer<LLSDNotationFormatter>(value) << std::endl;
+		}
+		LLSD values = LLSD::emptyArray();
+		LLSDStreamCollector collector(0, [&](const LLSD& path, const LLSD& value)
+			{
+				ensure_equals("top level path", path.size(), 0);
+				values.append(value);
+				return true;
+			});
+		LLPointer<LLSDParser> parser = new LLSDNotationParser();
+		while (parser->parse(stream, collector, LLSDSerialize::SIZE_UNLIMITED) > 0)
+		{
+		}
+		ensure_equals("values", values.size(), 3);
+		ensure_equals("last value", values[2]["index"].asInteger(), 2);
+	}
+
+	/**
+	 * @class TestLLSDBufferParse
+	 * @brief Parsing from memory gives what parsing a stream does
+	 */
+	class TestLLSDBufferParse
+	{
+	public:
+		// Binary is the one format that writes every value exactly
+		void ensureSame(const std::string& msg, const LLSD& actual, const LLSD& expected)
+		{
+			std::ostringstream expected_str, actual_str;
+			LLSDSerialize::toBinary(expected, expected_str);
+			LLSDSerialize::toBinary(actual, actual_str);
+			ensure_equals(msg.c_str(), actual_str.str(), expected_str.str());
+		}
+
+		void ensureSameXML(const std::string& text)
+		{
+			std::istringstream istr(text);
+			LLSD expected;
+			S32 expected_count = LLSDSerialize::fromXML(expected, istr, false);
+			LLSD actual;
+			S32 count = LLSDSerialize::fromXML(actual, text.data(), text.size(), false);
+			ensure_equals(("count of " + text).c_str(), count, expected_count);
+			ensureSame(text, actual, expected);
+		}
+
+		void ensureSameNotation(const std::string& text)
+		{
+			std::istringstream istr(text);
+			LLSD expected;
+			S32 expected_count = LLSDSerialize::fromNotation(expected, istr, text.size());
+			LLSD actual;
+			S32 count = LLSDSerialize::fromNotation(actual, text.data(), text.size());
+			ensure_equals(("count of " + text).c_str(), count, expected_count);
+			ensureSame(text, actual, expected);
+		}
+
+		static LLSD makeDocument(int objects)
+		{
+			LLSD sd = LLSD::emptyArray();
+			for (int i = 0; i < objects; ++i)
+			{
+				LLSD object;
+				object["name"] = llformat("object %d <&>", i);
+				object["local_id"] = i * 1013;
+				object["scale"] = i * 0.25 - 7.5;
+				LLUUID owner_id;
+				owner_id.generate(llformat("owner %d", i % 100));
+				object["owner_id"] = owner_id;
+				object["physical"] = (i % 3 == 0);
+				object["texture_entry"] = std::vector<U8>(40 + i % 17, (U8)i);
+				object["position"].append(i * 1.5);
+				object["position"].append(128.0);
+				object["position"].append(i * -0.125);
+				sd.append(object);
+			}
+			return sd;
+		}
+	};
+
+	typedef tut::test_group<TestLLSDBufferParse> TestLLSDBufferParseGroup;
+	typedef TestLLSDBufferParseGroup::object TestLLSDBufferParseObject;
+	TestLLSDBufferParseGroup gTestLLSDBufferParseGroup("llsd buffer parse");
+
+	template<> template<>
+	void TestLLSDBufferParseObject::test<1>()
+	{
+		LLSD sd = makeDocument(50);
+		sd.append(LLSD());
+		sd.append(LLSD::emptyMap());
+		sd.append(LLSD::emptyArray());
+		sd.append(LLDate(1234567.0));
+		sd.append(LLURI("http://example.com/a?b=c&d=e"));
+		sd.append("line\nbreaks\r\nand \"quotes\" and 'ticks' and \\ and ]]> and caf\xC3\xA9");
+
+		std::ostringstream xml, pretty_xml, notation, pretty_notation;
+		LLSDSerialize::toXML(sd, xml);
+		LLSDSerialize::toPrettyXML(sd, pretty_xml);
+		LLSDSerialize::toNotation(sd, notation);
+		LLSDSerialize::toPrettyNotation(sd, pretty_notation);
+
+		ensureSameXML(xml.str());
+		ensureSameXML(pretty_xml.str());
+		ensureSameNotation(notation.str());
+		ensureSameNotation(pretty_notation.str());
+	}
+
+	template<> template<>
+	void TestLLSDBufferParseObject::test<2>()
+	{
+		static const char* const XML[] = {
+			"<llsd><map><key>a</key><integer>1</integer><key>b</key><real>-2.5e3</real></map></llsd>",
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<llsd>\r\n<array>"
+				"<string>a &lt;&amp;&gt;&quot;&apos; &#65;&#x263A; b\r\nc\rd</string><string/></array></llsd>",
+			"\xEF\xBB\xBF<llsd><!-- comment --><map>"
+				"<key>x</key><binary encoding=\"base64\">aGVs\n  bG8=</binary>"
+				"<key>y</key><binary encoding='base16'>00</binary>"
+				"<key>z</key><uuid>6f3a5e62-0e1e-4b23-8c39-5b2b2dd7f7c9</uuid></map></llsd>",
+			"<llsd><map><key>a</key><integer>1</integer><key>a</key><integer>2</integer>"
+				"<key></key><string>skipped</string><integer>3</integer></map></llsd>",
+			"<llsd><map><key>k</key><map><key>dangling</key></map><string>v</string></map></llsd>",
+			"<llsd><array><undef/><unknown><x>1</x></unknown><boolean>true</boolean><boolean>0</boolean>"
+				"<date>2006-02-01T14:29:53Z</date><uri>http://example.com/</uri><key>ignored</key></array></llsd>",
+			"<llsd><array><real>1,5</real><real> 2</real><integer> 12 </integer><integer>+7</integer>"
+				"<integer>12345678901</integer><integer>1.9</integer></array></llsd>",
+			"<llsd><string>caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80</string></llsd>",
+			"<llsd/>",
+			"<llsd></llsd> trailing junk <",
+			// Left to expat
+			"<llsd><string><![CDATA[<raw>]]></string></llsd>",
+			"<!DOCTYPE llsd><llsd><integer>1</integer></llsd>",
+			"<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><llsd><string>\xE9</string></llsd>",
+			"<llsd><string>a<b/>c</string></llsd>",
+			"<llsd><integer>1</integer><integer>2</integer></llsd>",
+			"<other><llsd><integer>1</integer></llsd></other>",
+			"<llsd><string>&bogus;</string></llsd>",
+			"<llsd><string a=\"1\" a=\"2\">x</string></llsd>",
+			// Malformed
+			"<llsd><map><key>a</key><integer>1</integer></llsd>",
+			"<llsd><string>\x01</string></llsd>",
+			"<llsd><string>\xC3</string></llsd>",
+			"<llsd><string>\xED\xA0\x80</string></llsd>",
+			"<llsd><string>a]]>b</string></llsd>",
+			"<llsd><string>&#0;</string></llsd>",
+			"<llsd><array>",
+			"",
+		};
+		for (const char* text : XML)
+		{
+			ensureSameXML(text);
+		}
+	}
+
+	template<> template<>
+	void TestLLSDBufferParseObject::test<3>()
+	{
+		static const char* const NOTATION[] = {
+			"{'a':i1,'b':r-2.5e3,\"c\":s(3)\"xyz\",'d':u6f3a5e62-0e1e-4b23-8c39-5b2b2dd7f7c9}",
+			"[!,1,0,t,f,true,false,TRUE,i-7,'esc\\'aped\\x41\\n\\t',d\"2006-02-01T14:29:53Z\",l\"http://example.com/\"]",
+			"[b64\"aGVsbG8=\",b16\"68656C6C6F\",b(5)\"hello\",b64\"\"]",
+			"{'a':i1,'a':i2}",
+			" \n [ i1 , i2 ] ",
+			"{'a':[i1,{'b':!}],'c':{}}",
+			"[r1,5,rnan,r1e400]",
+			"[s(0)\"\",i12345678901]",
+			// Malformed
+			"[i1",
+			"{'a' i1}",
+			"[b16\"123\"]",
+			"",
+		};
+		for (const char* text : NOTATION)
+		{
+			ensureSameNotation(text);
+		}
+	}
+
+	template<> template<>
+	void TestLLSDBufferParseObject::test<4>()
+	{
+		set_test_name("buffer parse benchmark");
+
+		// Times depend too much on the machine to check, they are only
+		// reported when LL_TEST_BENCHMARKS is set
+		const S32 PASSES = 5;
+		LLSD sd = makeDocument(5000);
+		std::ostringstream xml_str, notation_str;
+		LLSDSerialize::toXML(sd, xml_str);
+		LLSDSerialize::toNotation(sd, notation_str);
+		const std::string xml = xml_str.str();
+		const std::string notation = notation_str.str();
+
+		LLSD stream_result, buffer_result;
+		LLTimer timer;
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			std::istringstream istr(xml);
+			LLSDSerialize::fromXML(stream_result, istr);
+		}
+		F64 xml_stream_time = timer.getElapsedTimeAndResetF64();
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			LLSDSerialize::fromXML(buffer_result, xml.data(), xml.size());
+		}
+		F64 xml_buffer_time = timer.getElapsedTimeAndResetF64();
+		ensureSame("xml", buffer_result, stream_result);
+
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			std::istringstream istr(notation);
+			LLSDSerialize::fromNotation(stream_result, istr, notation.size());
+		}
+		F64 notation_stream_time = timer.getElapsedTimeAndResetF64();
+		for (S32 i = 0; i < PASSES; ++i)
+		{
+			LLSDSerialize::fromNotation(buffer_result, notation.data(), notation.size());
+		}
+		F64 notation_buffer_time = timer.getElapsedTimeAndResetF64();
+		ensureSame("notation", buffer_result, stream_result);
+
+		if (LLStringUtil::getenv("LL_TEST_BENCHMARKS").empty())
+		{
+			return;
+		}
+		std::cout << "\nLLSD parse of " << xml.size() << " bytes of XML, " << notation.size()
+				  << " bytes of notation, ms per pass:\n"
+				  << "  xml       stream " << xml_stream_time * 1000.0 / PASSES
+				  << ", buffer " << xml_buffer_time * 1000.0 / PASSES << "\n"
+				  << "  notation  stream " << notation_stream_time * 1000.0 / PASSES
+				  << ", buffer " << notation_buffer_time * 1000.0 / PASSES << std::endl;
+	}
+
     struct TestPythonCompatible
     {
         TestPythonCompatible():
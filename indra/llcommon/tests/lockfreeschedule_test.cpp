@@ -0,0 +1,198 @@
+/**
+ * @file   lockfreeschedule_test.cpp
+ * @date   2022-03-14
+ * @brief  Test for lockfreeschedule.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Copyright (c) 2022, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "lockfreeschedule.h"
+// STL headers
+#include <string>
+#include <vector>
+// std headers
+#include <chrono>
+#include <thread>
+// external library headers
+// other Linden headers
+#include "stringize.h"
+#include "../test/lltut.h"
+
+using namespace std::literals::chrono_literals; // ms suffix
+using namespace std::literals::string_literals; // s suffix
+using Queue = LL::LockFreeSchedule<std::string>;
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct lockfreeschedule_data
+    {
+        Queue queue;
+
+        // Several threads push at once, each producer's items must come out
+        // in the order it pushed them
+        void manyProducers(Queue& shared)
+        {
+            const int PRODUCERS = 4;
+            const int ITEMS = 20000;
+            std::vector<std::thread> producers;
+            for (int p = 0; p < PRODUCERS; ++p)
+            {
+                producers.emplace_back([&shared, p, ITEMS]()
+                    {
+                        for (int i = 0; i < ITEMS; ++i)
+                        {
+                            shared.push(Queue::Clock::now(), std::to_string(p) + ":" + std::to_string(i));
+                        }
+                    });
+            }
+
+            std::vector<int> next(PRODUCERS, 0);
+            std::thread consumer([&shared, &next]()
+                {
+                    try
+                    {
+                        for (;;)
+                        {
+                            std::string item(shared.pop());
+                            size_t colon = item.find(':');
+                            int p = std::stoi(item.substr(0, colon));
+                            int i = std::stoi(item.substr(colon + 1));
+                            if (i != next[p])
+                            {
+                                return;
+                            }
+                            ++next[p];
+                        }
+                    }
+                    catch (const Queue::Closed&)
+                    {
+                    }
+                });
+
+            for (auto& producer : producers)
+            {
+                producer.join();
+            }
+            shared.close();
+            consumer.join();
+            for (int p = 0; p < PRODUCERS; ++p)
+            {
+                ensure_equals(STRINGIZE("items from producer " << p), next[p], ITEMS);
+            }
+            ensure("not done", shared.done());
+        }
+    };
+    typedef test_group<lockfreeschedule_data> lockfreeschedule_group;
+    typedef lockfreeschedule_group::object object;
+    lockfreeschedule_group lockfreeschedulegrp("lockfreeschedule");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("push");
+        auto now = Queue::Clock::now();
+        queue.push(now + 200ms, "ghi"s);
+        queue.push(now, "abc"s);
+        queue.push(now + 100ms, "def"s);
+        queue.push(now, "abd"s);
+        ensure_equals("size", queue.size(), 4);
+        queue.close();
+        ensure("queue not closed", queue.isClosed());
+        ensure("closed queue took a push", ! queue.pushIfOpen(now, "jkl"s));
+        // immediate items in push order, then timed ones as they come due
+        ensure_equals("failed to pop first", queue.pop(), "abc"s);
+        ensure_equals("failed to pop second", queue.pop(), "abd"s);
+        ensure_equals("failed to pop third", queue.pop(), "def"s);
+        ensure("third popped early", Queue::Clock::now() >= now + 100ms);
+        ensure("queue prematurely done", ! queue.done());
+        ensure_equals("failed to pop fourth", queue.pop(), "ghi"s);
+        ensure("fourth popped early", Queue::Clock::now() >= now + 200ms);
+        std::string s;
+        ensure("queue not empty", ! queue.tryPop(s));
+        ensure("queue not done", queue.done());
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("full");
+        Queue small(4);
+        ensure_equals("capacity", small.capacity(), 4);
+        auto now = Queue::Clock::now();
+        for (int i = 0; i < 4; ++i)
+        {
+            ensure("tryPush() failed", small.tryPush(now, std::to_string(i)));
+        }
+        std::string value("kept");
+        ensure("tryPush() to full queue", ! small.tryPush(now, std::move(value)));
+        ensure_equals("failed tryPush() took value", value, "kept"s);
+
+        // a blocked push() goes through once there is room
+        std::thread producer([&small, now]() { small.push(now, "4"s); });
+        std::this_thread::sleep_for(20ms);
+        ensure_equals("pop while full", small.pop(), "0"s);
+        producer.join();
+        for (int i = 1; i <= 4; ++i)
+        {
+            ensure_equals("pop after full", small.pop(), std::to_string(i));
+        }
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("many producers");
+        Queue shared(256);
+        manyProducers(shared);
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("overflow");
+        // A big capacity doesn't mean a big ring
+        Queue big(1024 * 1024);
+        ensure_equals("big capacity", big.capacity(), 1024 * 1024);
+        ensure("big ring", big.ringCapacity() <= Queue::MAX_RING_CELLS);
+
+        Queue overflowing(2 * Queue::MAX_RING_CELLS);
+        const int ITEMS = int(overflowing.capacity());
+        auto now = Queue::Clock::now();
+        for (int i = 0; i < ITEMS; ++i)
+        {
+            ensure("tryPush() failed", overflowing.tryPush(now, std::to_string(i)));
+        }
+        ensure_equals("size", overflowing.size(), ITEMS);
+        std::string value("kept");
+        ensure("tryPush() to full queue", ! overflowing.tryPush(now, std::move(value)));
+        ensure_equals("failed tryPush() took value", value, "kept"s);
+
+        // popping makes room, and later items still come out last
+        ensure_equals("pop while full", overflowing.pop(), "0"s);
+        ensure("tryPush() after pop", overflowing.tryPush(now, std::to_string(ITEMS)));
+        for (int i = 1; i <= ITEMS; ++i)
+        {
+            ensure_equals("pop after overflow", overflowing.pop(), std::to_string(i));
+        }
+        std::string s;
+        ensure("queue not empty", ! overflowing.tryPop(s));
+        ensure_equals("size after overflow", overflowing.size(), 0);
+    }
+
+    template<> template<>
+    void object::test<5>()
+    {
+        set_test_name("many producers with overflow");
+        // producers outrun the consumer and spill past the ring
+        Queue shared(1024 * 1024);
+        manyProducers(shared);
+    }
+} // namespace tut
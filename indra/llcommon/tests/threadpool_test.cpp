@@ -0,0 +1,157 @@
+/**
+ * @file   threadpool_test.cpp
+ * @date   2022-03-21
+ * @brief  Test for threadpool.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Copyright (c) 2022, Linden Research, Inc.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "threadpool.h"
+// STL headers
+#include <stdexcept>
+#include <vector>
+// std headers
+#include <atomic>
+// external library headers
+// other Linden headers
+#include "llcond.h"
+#include "../test/lltut.h"
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+    struct threadpool_data
+    {
+        // Each index gets bumped exactly once if parallelFor() is right
+        void checkCovered(LL::ThreadPool& pool, size_t count, size_t grain)
+        {
+            std::vector<std::atomic<int>> hits(count);
+            for (auto& hit : hits)
+            {
+                hit = 0;
+            }
+            pool.parallelFor(0, count,
+                             [&hits](size_t first, size_t last)
+                             {
+                                 for (size_t i = first; i < last; ++i)
+                                 {
+                                     ++hits[i];
+                                 }
+                             },
+                             grain);
+            for (size_t i = 0; i < count; ++i)
+            {
+                ensure_equals(STRINGIZE("hits[" << i << "]"), hits[i].load(), 1);
+            }
+        }
+    };
+    typedef test_group<threadpool_data> threadpool_group;
+    typedef threadpool_group::object object;
+    threadpool_group threadpoolgrp("threadpool");
+
+    template<> template<>
+    void object::test<1>()
+    {
+        set_test_name("parallelFor");
+        LL::ThreadPool shared("shared", 3);
+        shared.start();
+        checkCovered(shared, 1000, 0);
+        checkCovered(shared, 1000, 7);
+        checkCovered(shared, 1, 0);
+        shared.close();
+
+        LL::ThreadPool stealing("stealing", 3, 1024, true);
+        ensure("not work stealing", stealing.isWorkStealing());
+        stealing.start();
+        checkCovered(stealing, 1000, 0);
+        checkCovered(stealing, 1000, 7);
+        checkCovered(stealing, 1, 0);
+        stealing.close();
+
+        // once closed, the caller does all the work itself
+        checkCovered(stealing, 100, 1);
+    }
+
+    template<> template<>
+    void object::test<2>()
+    {
+        set_test_name("nested parallelFor");
+        // Two threads each running an outer chunk that waits on an inner
+        // parallelFor() would deadlock if waiting didn't mean helping.
+        LL::ThreadPool pool("nested", 2, 1024, true);
+        pool.start();
+        std::atomic<int> total(0);
+        pool.parallelFor(0, 8,
+                         [&pool, &total](size_t first, size_t last)
+                         {
+                             for (size_t i = first; i < last; ++i)
+                             {
+                                 pool.parallelFor(0, 100,
+                                                  [&total](size_t f, size_t l)
+                                                  { total += int(l - f); },
+                                                  10);
+                             }
+                         },
+                         1);
+        ensure_equals("nested total", total.load(), 800);
+        pool.close();
+    }
+
+    template<> template<>
+    void object::test<3>()
+    {
+        set_test_name("post");
+        LL::ThreadPool pool("post", 4, 1024, true);
+        pool.start();
+        const int COUNT = 1000;
+        LLScalarCond<int> done(0);
+        std::vector<LL::ThreadPool::Work> batch;
+        for (int i = 0; i < COUNT; ++i)
+        {
+            batch.emplace_back([&done](){ done.update_all([](int& n){ ++n; }); });
+        }
+        ensure("postBatch() failed", pool.postBatch(std::move(batch)));
+        ensure("post() failed",
+               pool.post([&done](){ done.update_all([](int& n){ ++n; }); }));
+        // work posted to the WorkQueue directly still runs
+        pool.getQueue().post([&done](){ done.update_all([](int& n){ ++n; }); });
+        done.wait_equal(COUNT + 2);
+        pool.close();
+        ensure("post() to closed pool", ! pool.post([](){}));
+    }
+
+    template<> template<>
+    void object::test<4>()
+    {
+        set_test_name("parallelFor exception");
+        LL::ThreadPool pool("throw", 2, 1024, true);
+        pool.start();
+        std::atomic<int> ran(0);
+        std::string threw;
+        try
+        {
+            pool.parallelFor(0, 10,
+                             [&ran](size_t first, size_t)
+                             {
+                                 ++ran;
+                                 if (first == 3)
+                                     throw std::runtime_error("chunk 3");
+                             },
+                             1);
+        }
+        catch (const std::runtime_error& e)
+        {
+            threw = e.what();
+        }
+        ensure_equals("exception", threw, "chunk 3");
+        ensure_equals("chunks run", ran.load(), 10);
+        pool.close();
+    }
+} // namespace tut
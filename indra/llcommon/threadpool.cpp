@@ -15,28 +15,76 @@
 #include "threadpool.h"
 // STL headers
 // std headers
+#include <deque>
+#if LL_DARWIN
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#elif LL_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
 // external library headers
 // other Linden headers
+#include "llcoros.h"
+#include LLCOROS_MUTEX_HEADER
 #include "llerror.h"
 #include "llevents.h"
+#include "llexception.h"
 #include "stringize.h"
+#if LL_WINDOWS
+#include "llwin32headers.h"
+#endif
 
-LL::ThreadPool::ThreadPool(const std::string& name, size_t threads, size_t capacity):
+/**
+ * A work stealing thread's deque. The owner pushes and pops at the back, so
+ * it runs what it queued most recently while that is still in its caches;
+ * thieves take the oldest work from the front. The lock is held for a
+ * handful of instructions and only contended when somebody is stealing.
+ */
+struct LL::ThreadPool::Worker
+{
+    Worker(ThreadPool* pool, size_t index): mPool(pool), mIndex(index) {}
+
+    ThreadPool* const mPool;
+    const size_t mIndex;
+    LLCoros::Mutex mMutex;
+    std::deque<Work> mDeque;
+};
+
+thread_local LL::ThreadPool::Worker* LL::ThreadPool::sWorker = nullptr;
+
+LL::ThreadPool::ThreadPool(const std::string& name, size_t threads, size_t capacity,
+                           bool work_stealing):
     super(name),
     mQueue(name, capacity),
     mName("ThreadPool:" + name),
-    mThreadCount(threads)
-{}
+    mThreadCount(threads),
+    mNextWorker(0),
+    mIdle(0),
+    mFirstCore(-1)
+{
+    if (work_stealing)
+    {
+        for (size_t i = 0; i < mThreadCount; ++i)
+        {
+            mWorkers.emplace_back(new Worker(this, i));
+        }
+    }
+}
 
 void LL::ThreadPool::start()
 {
     for (size_t i = 0; i < mThreadCount; ++i)
     {
         std::string tname{ stringize(mName, ':', (i+1), '/', mThreadCount) };
-        mThreads.emplace_back(tname, [this, tname]()
+        mThreads.emplace_back(tname, [this, tname, i]()
             {
                 LL_PROFILER_SET_THREAD_NAME(tname.c_str());
-                run(tname);
+                if (mFirstCore >= 0)
+                {
+                    setThreadAffinity(U32(mFirstCore + i));
+                }
+                run(tname, i);
             });
     }
     // Listen on "LLApp", and when the app is shutting down, close the queue
@@ -76,14 +124,199 @@ void LL::ThreadPool::close()
     }
 }
 
-void LL::ThreadPool::run(const std::string& name)
+void LL::ThreadPool::run(const std::string& name, size_t index)
 {
     LL_DEBUGS("ThreadPool") << name << " starting" << LL_ENDL;
+    if (isWorkStealing())
+    {
+        sWorker = mWorkers[index].get();
+    }
     run();
+    sWorker = nullptr;
     LL_DEBUGS("ThreadPool") << name << " stopping" << LL_ENDL;
 }
 
 void LL::ThreadPool::run()
 {
-    mQueue.runUntilClose();
+    if (isWorkStealing())
+    {
+        runWorkStealing();
+    }
+    else
+    {
+        mQueue.runUntilClose();
+    }
+}
+
+void LL::ThreadPool::runWorkStealing()
+{
+    Worker* self = currentWorker();
+    llassert_always(self);
+    Work work;
+    for (;;)
+    {
+        LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+        if (popLocal(*self, work) || steal(self->mIndex, work))
+        {
+            callWork(work);
+            continue;
+        }
+
+        // Nothing to do but the shared queue. Count ourselves idle before
+        // looking at the deques one last time: anyone who pushes after that
+        // look sees the count and posts a wakeup to the queue.
+        mIdle.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (steal(self->mIndex, work))
+        {
+            mIdle.fetch_sub(1);
+            callWork(work);
+            continue;
+        }
+        // runs either real work or a wakeup that sends us back to stealing
+        bool open = mQueue.runNext();
+        mIdle.fetch_sub(1);
+        if (! open)
+            break;
+    }
+
+    // The queue is closed and drained, finish whatever is left on the
+    // deques so nobody's work is silently dropped.
+    while (popLocal(*self, work) || steal(self->mIndex, work))
+    {
+        callWork(work);
+    }
+}
+
+LL::ThreadPool::Worker* LL::ThreadPool::currentWorker() const
+{
+    return (sWorker && sWorker->mPool == this)? sWorker : nullptr;
+}
+
+bool LL::ThreadPool::postBatch(std::vector<Work>&& batch)
+{
+    if (! isWorkStealing())
+    {
+        for (auto& work : batch)
+        {
+            if (! mQueue.postIfOpen(std::move(work)))
+                return false;
+        }
+        return true;
+    }
+
+    if (mQueue.isClosed())
+        return false;
+    if (batch.empty())
+        return true;
+
+    if (Worker* self = currentWorker())
+    {
+        // Our own work: keep it local, idle threads will come and steal it.
+        LLCoros::LockType lock(self->mMutex);
+        for (auto& work : batch)
+        {
+            self->mDeque.emplace_back(std::move(work));
+        }
+    }
+    else
+    {
+        // Deal the batch out round robin, one lock per deque touched.
+        size_t width = mWorkers.size();
+        size_t first = mNextWorker.fetch_add(batch.size());
+        size_t deques = std::min(width, batch.size());
+        for (size_t d = 0; d < deques; ++d)
+        {
+            Worker& worker = *mWorkers[(first + d) % width];
+            LLCoros::LockType lock(worker.mMutex);
+            for (size_t i = d; i < batch.size(); i += width)
+            {
+                worker.mDeque.emplace_back(std::move(batch[i]));
+            }
+        }
+    }
+    wakeIdle(batch.size());
+    return true;
+}
+
+bool LL::ThreadPool::popLocal(Worker& worker, Work& work)
+{
+    LLCoros::LockType lock(worker.mMutex);
+    if (worker.mDeque.empty())
+        return false;
+    work = std::move(worker.mDeque.back());
+    worker.mDeque.pop_back();
+    return true;
+}
+
+bool LL::ThreadPool::steal(size_t thief, Work& work)
+{
+    // Start with the next thread along so thieves spread out over victims
+    size_t width = mWorkers.size();
+    for (size_t i = 1; i <= width; ++i)
+    {
+        Worker& victim = *mWorkers[(thief + i) % width];
+        LLCoros::LockType lock(victim.mMutex);
+        if (! victim.mDeque.empty())
+        {
+            work = std::move(victim.mDeque.front());
+            victim.mDeque.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void LL::ThreadPool::wakeIdle(size_t count)
+{
+    // Pairs with the fence in runWorkStealing(): either an idle thread sees
+    // the work we just pushed, or we see it counted idle.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t idle = std::min(count, mIdle.load());
+    for (size_t i = 0; i < idle; ++i)
+    {
+        // Running the wakeup does nothing; popping it returns the thread
+        // to its stealing loop.
+        if (! mQueue.tryPost([](){}))
+            break;
+    }
+}
+
+void LL::ThreadPool::callWork(const Work& work)
+{
+    LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
+    try
+    {
+        work();
+    }
+    catch (...)
+    {
+        // As in WorkQueue::callWork(): one bad work item must not take the
+        // thread down with it.
+        LOG_UNHANDLED_EXCEPTION(mName);
+    }
+}
+
+//static
+void LL::ThreadPool::setThreadAffinity(U32 core)
+{
+    U32 cores = std::max(std::thread::hardware_concurrency(), 1u);
+    core %= cores;
+#if LL_WINDOWS
+    if (core < sizeof(DWORD_PTR) * 8)
+    {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+    }
+#elif LL_DARWIN
+    // Threads with the same tag share an L2 where possible, different tags
+    // are spread out. The closest macOS gets to pinning.
+    thread_affinity_policy_data_t policy = { integer_t(core + 1) };
+    thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY,
+                      (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#elif LL_LINUX
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
 }
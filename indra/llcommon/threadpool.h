@@ -13,7 +13,12 @@
 #if ! defined(LL_THREADPOOL_H)
 #define LL_THREADPOOL_H
 
+#include "llcond.h"
 #include "workqueue.h"
+#include <algorithm>                // std::min
+#include <atomic>
+#include <exception>                // std::exception_ptr
+#include <memory>                   // std::unique_ptr
 #include <string>
 #include <thread>
 #include <utility>                  // std::pair
@@ -27,13 +32,31 @@ namespace LL
     private:
         using super = LLInstanceTracker<ThreadPool, std::string>;
     public:
+        using Work = WorkQueue::Work;
+
         /**
          * Pass ThreadPool a string name. This can be used to look up the
          * relevant WorkQueue.
+         *
+         * With work_stealing, each thread also gets a deque of its own.
+         * Work that post() or postBatch() hands a worker thread goes onto
+         * that thread's deque, work from anywhere else is dealt out across
+         * the deques, and a thread that runs out steals from the others
+         * before it waits on the shared WorkQueue. Short tasks then rarely
+         * contend with each other. Work posted straight to getQueue() runs
+         * as before.
          */
-        ThreadPool(const std::string& name, size_t threads=1, size_t capacity=1024);
+        ThreadPool(const std::string& name, size_t threads=1, size_t capacity=1024,
+                   bool work_stealing=false);
         virtual ~ThreadPool();
 
+        /**
+         * Ask that thread i prefer core (first_core + i) modulo the number of
+         * cores. This is a hint: the OS may ignore it, and macOS only treats
+         * it as a request to share caches. Call before start().
+         */
+        void setAffinity(U32 first_core) { mFirstCore = first_core; }
+
         /**
          * Launch the ThreadPool. Until this call, a constructed ThreadPool
          * launches no threads. That permits coders to derive from ThreadPool,
@@ -52,6 +75,41 @@ namespace LL
         size_t getWidth() const { return mThreads.size(); }
         /// obtain a non-const reference to the WorkQueue to post work to it
         WorkQueue& getQueue() { return mQueue; }
+        bool isWorkStealing() const { return ! mWorkers.empty(); }
+
+        /**
+         * Post work to this pool, to the posting thread's own deque when
+         * that is one of our work stealing threads. Returns false if the
+         * pool is closed.
+         */
+        template <typename CALLABLE>
+        bool post(CALLABLE&& callable)
+        {
+            if (! isWorkStealing())
+                return mQueue.postIfOpen(std::forward<CALLABLE>(callable));
+            std::vector<Work> batch;
+            batch.emplace_back(std::forward<CALLABLE>(callable));
+            return postBatch(std::move(batch));
+        }
+
+        /**
+         * Post several items at once. Without work stealing they simply go
+         * to the WorkQueue; with it, each deque is locked once per batch
+         * rather than once per item.
+         */
+        bool postBatch(std::vector<Work>&& batch);
+
+        /**
+         * Call func(first, last) for consecutive half-open chunks covering
+         * [begin, end), spread across the pool, and return when all of them
+         * have run. The calling thread runs chunks too, so it is fine to
+         * call parallelFor() from one of this pool's own threads, or on a
+         * pool that is busy. grain is the chunk size, 0 picks one giving
+         * each thread a few chunks. The first exception func throws is
+         * rethrown here, after the remaining chunks have finished.
+         */
+        template <typename FUNC>
+        void parallelFor(size_t begin, size_t end, FUNC&& func, size_t grain=0);
 
         /**
          * Override run() if you need special processing. The default run()
@@ -60,14 +118,117 @@ namespace LL
         virtual void run();
 
     private:
-        void run(const std::string& name);
+        struct Worker;
+        class ParallelFor;
+
+        void run(const std::string& name, size_t index);
+        void runWorkStealing();
+        // the pool's Worker if the calling thread is one, else NULL
+        Worker* currentWorker() const;
+        bool popLocal(Worker& worker, Work& work);
+        bool steal(size_t thief, Work& work);
+        void wakeIdle(size_t count);
+        void callWork(const Work& work);
+        static void setThreadAffinity(U32 core);
+
+        // the calling thread's Worker, in whichever pool it belongs to
+        static thread_local Worker* sWorker;
 
         WorkQueue mQueue;
         std::string mName;
         size_t mThreadCount;
         std::vector<std::pair<std::string, std::thread>> mThreads;
+        // empty unless work stealing
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        std::atomic<size_t> mNextWorker;
+        std::atomic<size_t> mIdle;
+        S32 mFirstCore;
     };
 
+    /**
+     * Shared by the chunks of one parallelFor() call: each participant
+     * claims chunks off mNext until there are none left.
+     */
+    class ThreadPool::ParallelFor
+    {
+    public:
+        ParallelFor(size_t begin, size_t end, size_t grain):
+            mBegin(begin), mEnd(end), mGrain(grain),
+            mChunks((end - begin + grain - 1) / grain),
+            mNext(0),
+            mRemaining(mChunks)
+        {}
+
+        size_t chunks() const { return mChunks; }
+
+        template <typename FUNC>
+        void runChunks(FUNC& func)
+        {
+            for (size_t chunk; (chunk = mNext.fetch_add(1)) < mChunks; )
+            {
+                size_t first = mBegin + chunk * mGrain;
+                try
+                {
+                    func(first, std::min(first + mGrain, mEnd));
+                }
+                catch (...)
+                {
+                    mError.update_one([](std::exception_ptr& error)
+                        {
+                            if (! error)
+                                error = std::current_exception();
+                        });
+                }
+                mRemaining.update_all([](size_t& remaining){ --remaining; });
+            }
+        }
+
+        void wait()
+        {
+            mRemaining.wait_equal(0);
+            std::exception_ptr error(mError.get());
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        const size_t mBegin, mEnd, mGrain, mChunks;
+        std::atomic<size_t> mNext;
+        LLScalarCond<size_t> mRemaining;
+        LLCond<std::exception_ptr> mError;
+    };
+
+    template <typename FUNC>
+    void ThreadPool::parallelFor(size_t begin, size_t end, FUNC&& func, size_t grain)
+    {
+        if (end <= begin)
+            return;
+        size_t width = std::max<size_t>(getWidth(), 1);
+        if (! grain)
+        {
+            // a few chunks per thread evens out chunks of uneven cost
+            grain = std::max<size_t>((end - begin) / (width * 4), 1);
+        }
+        auto state = std::make_shared<ParallelFor>(begin, end, grain);
+        // Helpers only claim chunks, the last to finish doesn't matter: if
+        // the pool is closed or slow to get to them, we run the rest.
+        size_t helpers = std::min(width, state->chunks() - 1);
+        std::vector<Work> batch;
+        batch.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            batch.emplace_back([state, &func](){ state->runChunks(func); });
+        }
+        if (! batch.empty())
+        {
+            postBatch(std::move(batch));
+        }
+        state->runChunks(func);
+        state->wait();
+    }
+
 } // namespace LL
 
 #endif /* ! defined(LL_THREADPOOL_H) */
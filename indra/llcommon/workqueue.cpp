@@ -89,6 +89,19 @@ bool LL::WorkQueue::runOne()
     return ! mQueue.done();
 }
 
+bool LL::WorkQueue::runNext()
+{
+    try
+    {
+        callWork(mQueue.pop());
+        return true;
+    }
+    catch (const Queue::Closed&)
+    {
+        return false;
+    }
+}
+
 bool LL::WorkQueue::runUntil(const TimePoint& until)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
@@ -120,13 +133,6 @@ std::string LL::WorkQueue::makeName(const std::string& name)
     return STRINGIZE("WorkQueue" << num);
 }
 
-void LL::WorkQueue::callWork(const Queue::DataTuple& work)
-{
-    // ThreadSafeSchedule::pop() always delivers a tuple, even when
-    // there's only one data field per item, as for us.
-    callWork(std::get<0>(work));
-}
-
 void LL::WorkQueue::callWork(const Work& work)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_THREAD;
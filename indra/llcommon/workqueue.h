@@ -15,7 +15,7 @@
 #include "llcoros.h"
 #include "llexception.h"
 #include "llinstancetracker.h"
-#include "threadsafeschedule.h"
+#include "lockfreeschedule.h"
 #include <chrono>
 #include <exception>                // std::current_exception
 #include <functional>               // std::function
@@ -35,14 +35,16 @@ namespace LL
         using Work = std::function<void()>;
 
     private:
-        using Queue = ThreadSafeSchedule<Work>;
+        // Posting from many threads to one busy consumer, often the main
+        // thread, is the common case: LockFreeSchedule never locks for work
+        // that is due right away.
+        using Queue = LockFreeSchedule<Work>;
         // helper for postEvery()
         template <typename Rep, typename Period, typename CALLABLE>
         class BackJack;
 
     public:
         using TimePoint = Queue::TimePoint;
-        using TimedWork = Queue::TimeTuple;
         using Closed    = Queue::Closed;
 
         struct Error: public LLException
@@ -94,7 +96,7 @@ namespace LL
             // postIfOpen(). All other methods should accept CALLABLEs of
             // arbitrary type to avoid multiple levels of std::function
             // indirection.
-            mQueue.push(TimedWork(time, std::move(callable)));
+            mQueue.push(time, Work(std::move(callable)));
         }
 
         /// fire-and-forget
@@ -118,7 +120,7 @@ namespace LL
             // Defer reifying an arbitrary CALLABLE until we hit this or
             // post(). All other methods should accept CALLABLEs of arbitrary
             // type to avoid multiple levels of std::function indirection.
-            return mQueue.pushIfOpen(TimedWork(time, std::move(callable)));
+            return mQueue.pushIfOpen(time, Work(std::move(callable)));
         }
 
         /**
@@ -164,7 +166,7 @@ namespace LL
         template <typename CALLABLE>
         bool tryPost(CALLABLE&& callable)
         {
-            return mQueue.tryPush(TimedWork(TimePoint::clock::now(), std::move(callable)));
+            return mQueue.tryPush(TimePoint::clock::now(), Work(std::move(callable)));
         }
 
         /*------------------------- handshake API --------------------------*/
@@ -249,6 +251,13 @@ namespace LL
          */
         bool runOne();
 
+        /**
+         * runNext() runs exactly one TimedWork item, waiting for one to
+         * become ready if need be. It returns false, having run nothing, once
+         * the queue has been closed and drained.
+         */
+        bool runNext();
+
         /**
          * runFor() runs a subset of ready TimedWork items, until the
          * timeslice has been exceeded. It returns true if the queue remains
@@ -290,7 +299,6 @@ namespace LL
         static void checkCoroutine(const std::string& method);
         static void error(const std::string& msg);
         static std::string makeName(const std::string& name);
-        void callWork(const Queue::DataTuple& work);
         void callWork(const Work& work);
         Queue mQueue;
     };
@@ -96,8 +96,10 @@
 // requests by priority, instead it's first-come-first-served.
 // Reprioritization requests have the side-effect of then
 // putting the modified request at the back of the ready queue.
+// If '0', higher priority values are served first and equal
+// priorities first-come-first-served.
 
-#define	LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY		1
+#define	LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY		0
 
 
 namespace LLCore
@@ -153,6 +155,18 @@ const int HTTP_CONNECTION_LIMIT_MAX = 256;
 const long HTTP_PIPELINING_DEFAULT = 0L;
 const long HTTP_PIPELINING_MAX = 20L;
 
+// HTTP/2 concurrent streams per connection
+const long HTTP_HTTP2_STREAMS_DEFAULT = 0L;
+const long HTTP_HTTP2_STREAMS_MAX = 100L;
+
+// Cross-class scheduler.  Classes with a weight of zero are
+// left out of it.  Requests without a Range: length are
+// taken to be about HTTP_SCHEDULER_BYTES_DEFAULT long.
+const long HTTP_SCHEDULER_BYTE_LIMIT_DEFAULT = 0L;
+const long HTTP_SCHEDULER_WEIGHT_DEFAULT = 0L;
+const long HTTP_SCHEDULER_WEIGHT_MAX = 100L;
+const size_t HTTP_SCHEDULER_BYTES_DEFAULT = 64 * 1024;
+
 // Miscellaneous defaults
 const bool HTTP_USE_RETRY_AFTER_DEFAULT = true;
 const long HTTP_THROTTLE_RATE_DEFAULT = 0L;
@@ -160,12 +174,19 @@ const long HTTP_THROTTLE_RATE_DEFAULT = 0L;
 // Tuning parameters
 
 // Time worker thread sleeps after a pass through the
-// request, ready and active queues.
+// request, ready and active queues.  An event-driven
+// transport only uses it as the longest wait while policy
+// has retries or throttled requests pending.
 const int HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS = 2;
 
 // Block allocation size (a tuning parameter) is found
 // in bufferarray.h.
 
+// Largest Content-Length for which a response body is sized
+// up front in a single block.  Bigger bodies, or a header that
+// isn't to be believed, are collected in standard blocks.
+const size_t HTTP_BODY_PRESIZE_MAX = 16 * 1024 * 1024;
+
 }  // end namespace LLCore
 
 #endif	// _LLCORE_HTTP_INTERNAL_H_
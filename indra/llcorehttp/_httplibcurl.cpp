@@ -27,11 +27,20 @@
 #include "_httplibcurl.h"
 
 #include "httpheaders.h"
+#include "httpstats.h"
 #include "bufferarray.h"
 #include "_httpoprequest.h"
 #include "_httppolicy.h"
 
+#include "_httprequestqueue.h"
+
 #include "llhttpconstants.h"
+#include "lltimer.h"
+
+#if LL_LINUX
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 namespace
 {
@@ -51,6 +60,14 @@ void check_curl_multi_setopt(CURLM* handle, CURLMoption option, ARG argument)
 
 static const char * const LOG_CORE("CoreHttp");
 
+// Most events taken from the epoll set per wait.  Anything
+// beyond is picked up by the next wait.
+const int EPOLL_EVENT_MAX = 64;
+
+// Marks the request queue's wakeup descriptor in epoll data,
+// sockets carry their policy class there instead.
+const U32 EPOLL_WAKE_CLASS = 0xffffffffU;
+
 } // end anonymous namespace
 
 
@@ -61,10 +78,13 @@ namespace LLCore
 HttpLibcurl::HttpLibcurl(HttpService * service)
 	: mService(service),
 	  mHandleCache(),
+	  mActiveBytes(0),
 	  mPolicyCount(0),
 	  mMultiHandles(NULL),
 	  mActiveHandles(NULL),
-	  mDirtyPolicy(NULL)
+	  mDirtyPolicy(NULL),
+	  mClassEvents(NULL),
+	  mEpollFd(-1)
 {}
 
 
@@ -82,6 +102,7 @@ void HttpLibcurl::shutdown()
 	{
 		HttpOpRequest::ptr_t op(* mActiveOps.begin());
 		mActiveOps.erase(mActiveOps.begin());
+		mActiveBytes -= op->mPolicyBytes;
 
 		cancelRequest(op);
 	}
@@ -105,8 +126,20 @@ void HttpLibcurl::shutdown()
 
 		delete [] mDirtyPolicy;
 		mDirtyPolicy = NULL;
+
+		delete [] mClassEvents;
+		mClassEvents = NULL;
 	}
 
+#if LL_LINUX
+	if (mEpollFd >= 0)
+	{
+		close(mEpollFd);
+		mEpollFd = -1;
+	}
+#endif
+	mReadySockets.clear();
+
 	mPolicyCount = 0;
 }
 
@@ -120,6 +153,32 @@ void HttpLibcurl::start(int policy_count)
 	mMultiHandles = new CURLM * [mPolicyCount];
 	mActiveHandles = new int [mPolicyCount];
 	mDirtyPolicy = new bool [mPolicyCount];
+	mClassEvents = new ClassEvents [mPolicyCount];
+
+#if LL_LINUX
+	// Event-driven only if the request queue can wake us up as well
+	const int wake_fd(mService->getRequestQueue().getWakeDescriptor());
+	if (wake_fd >= 0)
+	{
+		mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (mEpollFd >= 0)
+		{
+			struct epoll_event event;
+			event.events = EPOLLIN;
+			event.data.u64 = U64(EPOLL_WAKE_CLASS) << 32;
+			if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, wake_fd, &event))
+			{
+				close(mEpollFd);
+				mEpollFd = -1;
+			}
+		}
+		if (mEpollFd < 0)
+		{
+			LL_WARNS(LOG_CORE) << "Unable to set up epoll, polling libcurl instead.  errno:  "
+							   << errno << LL_ENDL;
+		}
+	}
+#endif
 	
 	for (int policy_class(0); policy_class < mPolicyCount; ++policy_class)
 	{
@@ -130,6 +189,18 @@ void HttpLibcurl::start(int policy_count)
 		}
 		mActiveHandles[policy_class] = 0;
 		mDirtyPolicy[policy_class] = false;
+
+		ClassEvents & events(mClassEvents[policy_class]);
+		events.mTransport = this;
+		events.mPolicyClass = policy_class;
+		events.mTimeoutAt = 0;
+		if (isEventDriven())
+		{
+			check_curl_multi_setopt(mMultiHandles[policy_class], CURLMOPT_SOCKETFUNCTION, socketCallback);
+			check_curl_multi_setopt(mMultiHandles[policy_class], CURLMOPT_SOCKETDATA, &events);
+			check_curl_multi_setopt(mMultiHandles[policy_class], CURLMOPT_TIMERFUNCTION, timerCallback);
+			check_curl_multi_setopt(mMultiHandles[policy_class], CURLMOPT_TIMERDATA, &events);
+		}
 		policyUpdated(policy_class);
 	}
 }
@@ -143,6 +214,11 @@ void HttpLibcurl::start(int policy_count)
 // sleep otherwise ask for a normal polling interval.
 HttpService::ELoopSpeed HttpLibcurl::processTransport()
 {
+	if (isEventDriven())
+	{
+		return processEvents();
+	}
+
 	HttpService::ELoopSpeed	ret(HttpService::REQUEST_SLEEP);
 
 	// Give libcurl some cycles to do I/O & callbacks
@@ -174,32 +250,10 @@ HttpService::ELoopSpeed HttpLibcurl::processTransport()
 		while (0 != running && CURLM_CALL_MULTI_PERFORM == status);
 
 		// Run completion on anything done
-		CURLMsg * msg(NULL);
-		int msgs_in_queue(0);
-		while ((msg = curl_multi_info_read(mMultiHandles[policy_class], &msgs_in_queue)))
+		if (readCompletions(policy_class))
 		{
-			if (CURLMSG_DONE == msg->msg)
-			{
-				CURL * handle(msg->easy_handle);
-				CURLcode result(msg->data.result);
-
-				completeRequest(mMultiHandles[policy_class], handle, result);
-				handle = NULL;					// No longer valid on return
-				ret = HttpService::NORMAL;		// If anything completes, we may have a free slot.
+			ret = HttpService::NORMAL;			// If anything completes, we may have a free slot.
 												// Turning around quickly reduces connection gap by 7-10mS.
-			}
-			else if (CURLMSG_NONE == msg->msg)
-			{
-				// Ignore this... it shouldn't mean anything.
-				;
-			}
-			else
-			{
-				LL_WARNS_ONCE(LOG_CORE) << "Unexpected message from libcurl.  Msg code:  "
-										<< msg->msg
-										<< LL_ENDL;
-			}
-			msgs_in_queue = 0;
 		}
 	}
 
@@ -211,6 +265,224 @@ HttpService::ELoopSpeed HttpLibcurl::processTransport()
 }
 
 
+// Event-driven version of processTransport().  Only sockets
+// found ready by waitForEvents() and classes whose timer has
+// expired get cycles.  Active requests on their own don't
+// keep us polling, the next socket event will wake us.
+HttpService::ELoopSpeed HttpLibcurl::processEvents()
+{
+	HttpService::ELoopSpeed	ret(HttpService::REQUEST_SLEEP);
+
+	// Sockets first, the timers may have been satisfied by them
+	ready_socket_t ready;
+	ready.swap(mReadySockets);
+	for (ready_socket_t::const_iterator it(ready.begin()); ready.end() != it; ++it)
+	{
+		if ((*it).mPolicyClass >= mPolicyCount || ! mMultiHandles[(*it).mPolicyClass])
+		{
+			continue;
+		}
+
+		int running(0);
+		check_curl_multi_code(curl_multi_socket_action(mMultiHandles[(*it).mPolicyClass],
+													   (*it).mSocket,
+													   (*it).mEvents,
+													   &running));
+	}
+	ready.clear();
+	ready.swap(mReadySockets);			// Keep the capacity
+
+	const HttpTime now(totalTime());
+	for (int policy_class(0); policy_class < mPolicyCount; ++policy_class)
+	{
+		if (! mMultiHandles[policy_class])
+		{
+			continue;
+		}
+
+		ClassEvents & events(mClassEvents[policy_class]);
+		if (events.mTimeoutAt && events.mTimeoutAt <= now)
+		{
+			events.mTimeoutAt = 0;
+			int running(0);
+			check_curl_multi_code(curl_multi_socket_action(mMultiHandles[policy_class],
+														   CURL_SOCKET_TIMEOUT,
+														   0,
+														   &running));
+		}
+
+		if (readCompletions(policy_class))
+		{
+			ret = HttpService::NORMAL;
+		}
+
+		if (! mActiveHandles[policy_class] && mDirtyPolicy[policy_class])
+		{
+			// Gone quiet with a dirty update, apply it
+			policyUpdated(policy_class);
+		}
+	}
+
+	return ret;
+}
+
+
+bool HttpLibcurl::readCompletions(int policy_class)
+{
+	bool completed(false);
+	CURLMsg * msg(NULL);
+	int msgs_in_queue(0);
+	while ((msg = curl_multi_info_read(mMultiHandles[policy_class], &msgs_in_queue)))
+	{
+		if (CURLMSG_DONE == msg->msg)
+		{
+			CURL * handle(msg->easy_handle);
+			CURLcode result(msg->data.result);
+
+			completeRequest(mMultiHandles[policy_class], handle, result);
+			handle = NULL;					// No longer valid on return
+			completed = true;
+		}
+		else if (CURLMSG_NONE == msg->msg)
+		{
+			// Ignore this... it shouldn't mean anything.
+			;
+		}
+		else
+		{
+			LL_WARNS_ONCE(LOG_CORE) << "Unexpected message from libcurl.  Msg code:  "
+									<< msg->msg
+									<< LL_ENDL;
+		}
+		msgs_in_queue = 0;
+	}
+	return completed;
+}
+
+
+void HttpLibcurl::waitForEvents(int timeout_ms)
+{
+#if LL_LINUX
+	if (! isEventDriven())
+	{
+		return;
+	}
+
+	// Don't sleep past libcurl's earliest timer
+	const HttpTime now(totalTime());
+	for (int policy_class(0); policy_class < mPolicyCount; ++policy_class)
+	{
+		const HttpTime timeout_at(mClassEvents[policy_class].mTimeoutAt);
+		if (timeout_at)
+		{
+			// Round up so we don't wake just before it's due
+			const int timer_ms(timeout_at > now ? int((timeout_at - now + 999) / 1000) : 0);
+			if (timeout_ms < 0 || timer_ms < timeout_ms)
+			{
+				timeout_ms = timer_ms;
+			}
+		}
+	}
+
+	struct epoll_event events[EPOLL_EVENT_MAX];
+	const int count(epoll_wait(mEpollFd, events, EPOLL_EVENT_MAX, timeout_ms));
+	for (int i(0); i < count; ++i)
+	{
+		const U32 policy_class(U32(events[i].data.u64 >> 32));
+		if (EPOLL_WAKE_CLASS == policy_class)
+		{
+			// New requests, processRequestQueue() will pick them up
+			mService->getRequestQueue().clearWake();
+			continue;
+		}
+
+		ReadySocket ready;
+		ready.mPolicyClass = int(policy_class);
+		ready.mSocket = curl_socket_t(events[i].data.u64 & 0xffffffffU);
+		ready.mEvents = 0;
+		if (events[i].events & EPOLLIN)
+		{
+			ready.mEvents |= CURL_CSELECT_IN;
+		}
+		if (events[i].events & EPOLLOUT)
+		{
+			ready.mEvents |= CURL_CSELECT_OUT;
+		}
+		if (events[i].events & (EPOLLERR | EPOLLHUP))
+		{
+			ready.mEvents |= CURL_CSELECT_ERR;
+		}
+		mReadySockets.push_back(ready);
+	}
+#endif
+}
+
+
+int HttpLibcurl::socketCallback(CURL * /* handle */, curl_socket_t sock, int what,
+								void * userp, void * socketp)
+{
+#if LL_LINUX
+	ClassEvents * events(static_cast<ClassEvents *>(userp));
+	HttpLibcurl * transport(events->mTransport);
+	CURLM * multi_handle(transport->mMultiHandles[events->mPolicyClass]);
+
+	if (CURL_POLL_REMOVE == what)
+	{
+		// May fail if libcurl already closed the socket, which
+		// also took it out of the set.
+		epoll_ctl(transport->mEpollFd, EPOLL_CTL_DEL, sock, NULL);
+		return 0;
+	}
+
+	struct epoll_event event;
+	event.events = 0;
+	if (CURL_POLL_IN == what || CURL_POLL_INOUT == what)
+	{
+		event.events |= EPOLLIN;
+	}
+	if (CURL_POLL_OUT == what || CURL_POLL_INOUT == what)
+	{
+		event.events |= EPOLLOUT;
+	}
+	event.data.u64 = (U64(events->mPolicyClass) << 32) | U64(U32(sock));
+
+	// socketp is our marker that the socket is already in the set
+	if (socketp)
+	{
+		epoll_ctl(transport->mEpollFd, EPOLL_CTL_MOD, sock, &event);
+	}
+	else if (! epoll_ctl(transport->mEpollFd, EPOLL_CTL_ADD, sock, &event))
+	{
+		curl_multi_assign(multi_handle, sock, events);
+	}
+	else
+	{
+		LL_WARNS(LOG_CORE) << "Unable to watch libcurl socket " << sock
+						   << ", errno:  " << errno << LL_ENDL;
+	}
+#endif
+	return 0;
+}
+
+
+int HttpLibcurl::timerCallback(CURLM * /* multi_handle */, long timeout_ms, void * userp)
+{
+	ClassEvents * events(static_cast<ClassEvents *>(userp));
+	if (timeout_ms < 0)
+	{
+		events->mTimeoutAt = 0;
+	}
+	else
+	{
+		// Zero means right away, processEvents() does that
+		// on its next pass.
+		const HttpTime now(totalTime());
+		events->mTimeoutAt = (std::max)(now + HttpTime(timeout_ms) * 1000U, HttpTime(1));
+	}
+	return 0;
+}
+
+
 // Caller has provided us with a ref count on op.
 void HttpLibcurl::addOp(const HttpOpRequest::ptr_t &op)
 {
@@ -237,6 +509,7 @@ void HttpLibcurl::addOp(const HttpOpRequest::ptr_t &op)
 	op->mCurlActive = true;
 	mActiveOps.insert(op);
 	++mActiveHandles[op->mReqPolicy];
+	mActiveBytes += op->mPolicyBytes;
 	
 	if (op->mTracing > HTTP_TRACE_OFF)
 	{
@@ -270,6 +543,7 @@ bool HttpLibcurl::cancel(HttpHandle handle)
 	// Drop references
 	mActiveOps.erase(it);
 	--mActiveHandles[op->mReqPolicy];
+	mActiveBytes -= op->mPolicyBytes;
 
 	return true;
 }
@@ -346,6 +620,7 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
 	// Deactivate request
 	mActiveOps.erase(it);
 	--mActiveHandles[op->mReqPolicy];
+	mActiveBytes -= op->mPolicyBytes;
 	op->mCurlActive = false;
 
 	// Set final status of request if it hasn't failed by other mechanisms yet
@@ -379,6 +654,15 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
                         LL_WARNS(LOG_CORE) << "CURL error:" << ccode << " Attempting to get content type." << LL_ENDL;
                     }
                     op->mStatus = HttpStatus(http_status);
+
+                    // How the transfer got its connection, for stream reuse stats
+                    long http_version(0L);
+                    long connects(0L);
+                    if (curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version) == CURLE_OK
+                        && curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK)
+                    {
+                        HTTPStats::instance().recordConnectionUse(http_version >= CURL_HTTP_VERSION_2_0, connects > 0);
+                    }
                 }
                 else
                 {
@@ -476,7 +760,27 @@ void HttpLibcurl::policyUpdated(int policy_class)
 		policy.stallPolicy(policy_class, false);
 		mDirtyPolicy[policy_class] = false;
 
-		if (options.mPipelining > 1)
+		if (options.mHttp2Streams > 0)
+		{
+			// Multiplex HTTP/2 streams, libcurl manages connections
+			// within the limits and adds streams to them up to the
+			// stream limit.
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_PIPELINING,
+									 long(CURLPIPE_MULTIPLEX));
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_HOST_CONNECTIONS,
+									 long(options.mPerHostConnectionLimit));
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_TOTAL_CONNECTIONS,
+									 long(options.mConnectionLimit));
+#if LIBCURL_VERSION_NUM >= 0x074300
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_CONCURRENT_STREAMS,
+									 long(options.mHttp2Streams));
+#endif
+		}
+		else if (options.mPipelining > 1)
 		{
 			// We'll try to do pipelining on this multihandle
 			check_curl_multi_setopt(multi_handle,
@@ -33,6 +33,7 @@
 #include <curl/multi.h>
 
 #include <set>
+#include <vector>
 
 #include "httprequest.h"
 #include "_httpservice.h"
@@ -77,6 +78,28 @@ public:
 	/// Threading:  called by worker thread.
 	HttpService::ELoopSpeed processTransport();
 
+	/// True when libcurl is driven by socket readiness through
+	/// @waitForEvents() rather than by polling every multi handle
+	/// on each pass.  Only Linux (epoll) at this time.  In this
+	/// mode, @processTransport() returns NORMAL only when requests
+	/// completed and the policy layer should get another pass right
+	/// away.  Active requests alone don't need polling.
+	///
+	/// Threading:  called by worker thread.
+	bool isEventDriven() const
+		{
+			return mEpollFd >= 0;
+		}
+
+	/// Sleep until one of libcurl's sockets is ready, new requests
+	/// are queued, libcurl's own timer expires or @timeout_ms passes,
+	/// whichever comes first.  A negative @timeout_ms waits for
+	/// one of the others.  Ready sockets are handed to libcurl on
+	/// the next @processTransport() call.
+	///
+	/// Threading:  called by worker thread.
+	void waitForEvents(int timeout_ms);
+
 	/// Add request to the active list.  Caller is expected to have
 	/// provided us with a reference count on the op to hold the
 	/// request.  (No additional references will be added.)
@@ -109,6 +132,15 @@ public:
 	int getActiveCount() const;
 	int getActiveCountInClass(int policy_class) const;
 
+	/// Return the estimated response bytes of active requests
+	/// charged to the cross-class scheduler.  @see HttpPolicy.
+	///
+	/// Threading:  called by worker thread.
+	size_t getActiveBytes() const
+		{
+			return mActiveBytes;
+		}
+
 	/// Attempt to cancel a request identified by handle.
 	///
 	/// Interface shadows HttpService's method.
@@ -151,6 +183,22 @@ protected:
 	/// Invoked to cancel an active request, mainly during shutdown
 	/// and destroy.
     void cancelRequest(const opReqPtr_t &op);
+
+	/// Run completion on anything libcurl has finished in a class.
+	///
+	/// @return			True if any request completed.
+	bool readCompletions(int policy_class);
+
+	/// Give libcurl cycles only for the sockets and timers that
+	/// need them.  Event-driven form of @processTransport().
+	HttpService::ELoopSpeed processEvents();
+
+	/// libcurl callbacks for the event-driven transport.  Both
+	/// only record what libcurl asks for, the epoll set for sockets
+	/// and a deadline for the timer.
+	static int socketCallback(CURL * handle, curl_socket_t sock, int what,
+							  void * userp, void * socketp);
+	static int timerCallback(CURLM * multi_handle, long timeout_ms, void * userp);
 	
 protected:
     typedef std::set<opReqPtr_t> active_set_t;
@@ -207,14 +255,37 @@ protected:
 		handle_cache_t		mCache;					// Cache of old handles
 	}; // end class HandleCache
 	
+	/// Per-class state for the event-driven transport.  Also
+	/// serves as the user data for the libcurl callbacks.
+	struct ClassEvents
+	{
+		HttpLibcurl *	mTransport;
+		int				mPolicyClass;
+		HttpTime		mTimeoutAt;			// When libcurl's timer fires, 0 if not set
+	};
+
+	/// A socket reported ready by @waitForEvents(), waiting
+	/// to be passed to libcurl.
+	struct ReadySocket
+	{
+		int				mPolicyClass;
+		curl_socket_t	mSocket;
+		int				mEvents;			// CURL_CSELECT_* bits
+	};
+	typedef std::vector<ReadySocket> ready_socket_t;
+
 protected:
 	HttpService *		mService;			// Simple reference, not owner
 	HandleCache			mHandleCache;		// Handle allocator, owner
 	active_set_t		mActiveOps;
+	size_t				mActiveBytes;		// Sum of mPolicyBytes over mActiveOps
 	int					mPolicyCount;
 	CURLM **			mMultiHandles;		// One handle per policy class
 	int *				mActiveHandles;		// Active count per policy class
 	bool *				mDirtyPolicy;		// Dirty policy update waiting for stall (per pc)
+	ClassEvents *		mClassEvents;		// Event-driven state (per pc)
+	int					mEpollFd;			// Sockets and wakeup, -1 when polling
+	ready_socket_t		mReadySockets;
 	
 }; // end class HttpLibcurl
 
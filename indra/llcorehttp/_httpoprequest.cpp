@@ -153,6 +153,8 @@ HttpOpRequest::HttpOpRequest()
 	  mPolicyRetryLimit(HTTP_RETRY_COUNT_DEFAULT),
 	  mPolicyMinRetryBackoff(HttpTime(HTTP_RETRY_BACKOFF_MIN_DEFAULT)),
 	  mPolicyMaxRetryBackoff(HttpTime(HTTP_RETRY_BACKOFF_MAX_DEFAULT)),
+	  mPolicyReadyAt(HttpTime(0)),
+	  mPolicyBytes(0),
 	  mCallbackSSLVerify(NULL)
 {
 	// *NOTE:  As members are added, retry initialization/cleanup
@@ -704,7 +706,16 @@ HttpStatus HttpOpRequest::prepareRequest(HttpService * service)
 	{
 		xfer_timeout = timeout;
 	}
-	if (cpolicy.mPipelining > 1L)
+	if (cpolicy.mHttp2Streams > 0L)
+	{
+		// Ask for HTTP/2 where TLS can negotiate it and, rather than
+		// opening a connection of our own, wait for one that is still
+		// being set up so the request can go on it as another stream.
+		// Plain http and servers without h2 stay on HTTP/1.1.
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_PIPEWAIT, 1L);
+	}
+	else if (cpolicy.mPipelining > 1L)
 	{
 		// Pipelining affects both connection and transfer timeout values.
 		// Requests that are added to a pipeling immediately have completed
@@ -778,6 +789,22 @@ size_t HttpOpRequest::writeCallback(void * data, size_t size, size_t nmemb, void
 	if (! op->mReplyBody)
 	{
 		op->mReplyBody = new BufferArray();
+
+		// With the body size known from Content-Length (the range
+		// length for a 206), collect it in one block so consumers
+		// can use it in place rather than copying it out.
+#if LIBCURL_VERSION_NUM >= 0x073700
+		curl_off_t content_length(-1);
+		if (curl_easy_getinfo(op->mCurlHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length) == CURLE_OK
+#else
+		double content_length(-1.0);
+		if (curl_easy_getinfo(op->mCurlHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &content_length) == CURLE_OK
+#endif
+			&& content_length > 0
+			&& content_length <= HTTP_BODY_PRESIZE_MAX)
+		{
+			op->mReplyBody->reserve(size_t(content_length));
+		}
 	}
 	const size_t req_size(size * nmemb);
 	const size_t write_size(op->mReplyBody->append(static_cast<char *>(data), req_size));
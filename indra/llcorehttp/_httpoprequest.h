@@ -39,6 +39,7 @@
 #include "httpcommon.h"
 #include "httprequest.h"
 #include "_httpoperation.h"
+#include "_httpinternal.h"
 #include "_refcounted.h"
 
 #include "httpheaders.h"
@@ -235,19 +236,31 @@ public:
 	int					mPolicyRetryLimit;
 	HttpTime			mPolicyMinRetryBackoff; // initial delay between retries (mcs)
 	HttpTime			mPolicyMaxRetryBackoff;
+	HttpTime			mPolicyReadyAt;			// when it joined the ready queue
+	size_t				mPolicyBytes;			// charged to the scheduler while active
+
+	// Expected size of the response as far as scheduling goes:
+	// the length of the Range: when there is one, otherwise a
+	// typical body.
+	size_t getByteEstimate() const
+		{
+			return mReqLength ? mReqLength : HTTP_SCHEDULER_BYTES_DEFAULT;
+		}
 };  // end class HttpOpRequest
 
 
 
 /// HttpOpRequestCompare isn't an operation but a uniform comparison
 /// functor for STL containers that order by priority.  Mainly
-/// used for the ready queue container but defined here.
+/// used for the ready queue container but defined here.  True
+/// when lhs is to be served after rhs, i.e. has the lower value
+/// in the Indra scheme where higher priority values go first.
 class HttpOpRequestCompare
 {
 public:
-	bool operator()(const HttpOpRequest * lhs, const HttpOpRequest * rhs)
+	bool operator()(const HttpOpRequest::ptr_t & lhs, const HttpOpRequest::ptr_t & rhs) const
 		{
-			return lhs->mReqPriority > rhs->mReqPriority;
+			return lhs->mReqPriority < rhs->mReqPriority;
 		}
 };  // end class HttpOpRequestCompare
 
@@ -60,7 +60,9 @@ public:
 		: mThrottleEnd(0),
 		  mThrottleLeft(0L),
 		  mRequestCount(0L),
-		  mStallStaging(false)
+		  mStallStaging(false),
+		  mSchedulerFinish(0.0),
+		  mSchedulerSlots(0)
 		{}
 	
 	HttpReadyQueue		mReadyQueue;
@@ -71,11 +73,15 @@ public:
 	long				mThrottleLeft;
 	long				mRequestCount;
 	bool				mStallStaging;
+
+	F64					mSchedulerFinish;		// Virtual finish of the last request scheduled
+	int					mSchedulerSlots;		// Requests the class may still start this pass
 };
 
 
 HttpPolicy::HttpPolicy(HttpService * service)
-	: mService(service)
+	: mService(service),
+	  mSchedulerTime(0.0)
 {
 	// Create default class
 	mClasses.push_back(new ClassState());
@@ -146,6 +152,7 @@ void HttpPolicy::addOp(const HttpOpRequest::ptr_t &op)
 	
 	op->mPolicyRetries = 0;
 	op->mPolicy503Retries = 0;
+	op->mPolicyReadyAt = totalTime();
 	mClasses[policy_class]->mReadyQueue.push(op);
 }
 
@@ -211,11 +218,17 @@ void HttpPolicy::retryOp(const HttpOpRequest::ptr_t &op)
 // viewer and server that makes it hard to change parameters
 // and I hope we can make this go away with pipelining.
 //
+// With a scheduler byte limit set, classes with a scheduler
+// weight only work through their retry queues here.  Their
+// ready queues are left to scheduleReadyQueues() which runs
+// after all the classes have been looked at.
+//
 HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 {
 	const HttpTime now(totalTime());
 	HttpService::ELoopSpeed result(HttpService::REQUEST_SLEEP);
 	HttpLibcurl & transport(mService->getTransport());
+	const bool scheduling(mGlobalOptions.mSchedulerByteLimit > 0L);
 	
 	for (int policy_class(0); policy_class < mClasses.size(); ++policy_class)
 	{
@@ -223,6 +236,8 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		HttpRetryQueue & retryq(state.mRetryQueue);
 		HttpReadyQueue & readyq(state.mReadyQueue);
 
+		state.mSchedulerSlots = 0;
+
 		if (state.mStallStaging)
 		{
 			// Stalling but don't sleep.  Need to complete operations
@@ -248,10 +263,15 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		}
 
 		int active(transport.getActiveCountInClass(policy_class));
-		int active_limit(state.mOptions.mPipelining > 1L
-						 ? (state.mOptions.mPerHostConnectionLimit
-							* state.mOptions.mPipelining)
-						 : state.mOptions.mConnectionLimit);
+		int active_limit(state.mOptions.mConnectionLimit);
+		if (state.mOptions.mHttp2Streams > 0L)
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mHttp2Streams;
+		}
+		else if (state.mOptions.mPipelining > 1L)
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mPipelining;
+		}
 		int needed(active_limit - active);		// Expect negatives here
 
 		if (needed > 0)
@@ -264,29 +284,22 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 					break;
 			
 				retryq.pop();
-				
-				op->stageFromReady(mService);
-                op.reset();
 
-				++state.mRequestCount;
 				--needed;
-				if (throttle_enabled)
+				const bool more(stageOp(policy_class, op, now));
+				op.reset();
+				if (! more)
 				{
-					if (now >= state.mThrottleEnd)
-					{
-						// Throttle expired, move to next window
-						LL_DEBUGS(LOG_CORE) << "Throttle expired with " << state.mThrottleLeft
-											<< " requests to go and " << state.mRequestCount
-											<< " requests issued." << LL_ENDL;
-						state.mThrottleLeft = state.mOptions.mThrottleRate;
-						state.mThrottleEnd = now + HttpTime(1000000);
-					}
-					if (--state.mThrottleLeft <= 0)
-					{
-						goto throttle_on;
-					}
+					goto throttle_on;
 				}
 			}
+
+			if (scheduling && state.mOptions.mSchedulerWeight > 0L)
+			{
+				// New requests wait for the scheduler
+				state.mSchedulerSlots = needed;
+				needed = 0;
+			}
 			
 			// Now go on to the new requests...
 			while (needed > 0 && ! readyq.empty())
@@ -294,26 +307,12 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 				HttpOpRequest::ptr_t op(readyq.top());
 				readyq.pop();
 
-				op->stageFromReady(mService);
-				op.reset();
-					
-				++state.mRequestCount;
 				--needed;
-				if (throttle_enabled)
+				const bool more(stageOp(policy_class, op, now));
+				op.reset();
+				if (! more)
 				{
-					if (now >= state.mThrottleEnd)
-					{
-						// Throttle expired, move to next window
-						LL_DEBUGS(LOG_CORE) << "Throttle expired with " << state.mThrottleLeft
-											<< " requests to go and " << state.mRequestCount
-											<< " requests issued." << LL_ENDL;
-						state.mThrottleLeft = state.mOptions.mThrottleRate;
-						state.mThrottleEnd = now + HttpTime(1000000);
-					}
-					if (--state.mThrottleLeft <= 0)
-					{
-						goto throttle_on;
-					}
+					goto throttle_on;
 				}
 			}
 		}
@@ -327,10 +326,117 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		}
 	} // end foreach policy_class
 
+	if (scheduling)
+	{
+		scheduleReadyQueues(now);
+	}
+
 	return result;
 }
 
 
+bool HttpPolicy::stageOp(int policy_class, const HttpOpRequest::ptr_t & op, const HttpTime & now)
+{
+	ClassState & state(*mClasses[policy_class]);
+
+	if (! op->mPolicyRetries)
+	{
+		HTTPStats::instance().recordQueueDelay(policy_class, now - op->mPolicyReadyAt);
+	}
+
+	// Only requests of scheduled classes count against the byte limit
+	op->mPolicyBytes = ((mGlobalOptions.mSchedulerByteLimit > 0L && state.mOptions.mSchedulerWeight > 0L)
+						? op->getByteEstimate()
+						: 0);
+	op->stageFromReady(mService);
+
+	++state.mRequestCount;
+	if (state.mOptions.mThrottleRate > 0L)
+	{
+		if (now >= state.mThrottleEnd)
+		{
+			// Throttle expired, move to next window
+			LL_DEBUGS(LOG_CORE) << "Throttle expired with " << state.mThrottleLeft
+								<< " requests to go and " << state.mRequestCount
+								<< " requests issued." << LL_ENDL;
+			state.mThrottleLeft = state.mOptions.mThrottleRate;
+			state.mThrottleEnd = now + HttpTime(1000000);
+		}
+		if (--state.mThrottleLeft <= 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Start-time fair queuing across the scheduled classes.  Each
+// request is tagged with a virtual start, the later of the
+// scheduler's virtual time and its class's last finish, and a
+// virtual finish, the start plus its byte estimate over the
+// class weight.  The class whose next request starts first goes
+// next, ties going to the earlier finish.  That gives each class
+// with work waiting its weighted share of the bytes whatever its
+// request sizes.  Picking by finish alone would starve a light
+// class behind a heavy one, as the heavy class's finish keeps
+// landing before the light one's.  A
+// class that has been idle restarts at the current virtual
+// time so it can't build up credit.
+//
+// Classes still honor their own connection limits (the slots
+// found by processReadyQueue()) and throttles.  The byte limit
+// is checked before each request so the last one may go over.
+void HttpPolicy::scheduleReadyQueues(const HttpTime & now)
+{
+	HttpLibcurl & transport(mService->getTransport());
+	const size_t byte_limit(mGlobalOptions.mSchedulerByteLimit);
+	
+	while (transport.getActiveBytes() < byte_limit)
+	{
+		int next_class(-1);
+		F64 next_start(0.0), next_finish(0.0);
+		for (int policy_class(0); policy_class < mClasses.size(); ++policy_class)
+		{
+			ClassState & state(*mClasses[policy_class]);
+			if (state.mSchedulerSlots <= 0 || state.mReadyQueue.empty())
+			{
+				continue;
+			}
+			
+			const F64 start((std::max)(mSchedulerTime, state.mSchedulerFinish));
+			const F64 finish(start + F64(state.mReadyQueue.top()->getByteEstimate())
+							 / F64(state.mOptions.mSchedulerWeight));
+			if (next_class < 0
+				|| start < next_start
+				|| (start == next_start && finish < next_finish))
+			{
+				next_class = policy_class;
+				next_start = start;
+				next_finish = finish;
+			}
+		}
+		if (next_class < 0)
+		{
+			// Nothing waiting that can go
+			break;
+		}
+
+		ClassState & state(*mClasses[next_class]);
+		HttpOpRequest::ptr_t op(state.mReadyQueue.top());
+		state.mReadyQueue.pop();
+
+		mSchedulerTime = next_start;
+		state.mSchedulerFinish = next_finish;
+		--state.mSchedulerSlots;
+		if (! stageOp(next_class, op, now))
+		{
+			state.mSchedulerSlots = 0;
+		}
+	}
+}
+
+
 bool HttpPolicy::changePriority(HttpHandle handle, HttpRequest::priority_t priority)
 {
 	for (int policy_class(0); policy_class < mClasses.size(); ++policy_class)
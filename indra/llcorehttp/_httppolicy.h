@@ -111,6 +111,7 @@ public:
     void retryOp(const opReqPtr_t &);
 
 	/// Attempt to change the priority of an earlier request.
+	/// The request moves to its new place in its ready queue.
 	/// Request that Shadows HttpService's method
 	///
 	/// Threading:  called by worker thread
@@ -171,10 +172,28 @@ public:
 protected:
 	struct ClassState;
 	typedef std::vector<ClassState *>	class_list_t;
+
+	/// Hand a ready or retry request to the transport and do
+	/// the class's request accounting.
+	///
+	/// @return			false if the class's throttle has now
+	///					closed and nothing more is to be started
+	///					for it this pass.
+	///
+	/// Threading:  called by worker thread
+	bool stageOp(int policy_class, const opReqPtr_t & op, const HttpTime & now);
+
+	/// Start ready requests of the classes taking part in
+	/// scheduling, in weighted fair order between them, while
+	/// the scheduler's byte limit allows.
+	///
+	/// Threading:  called by worker thread
+	void scheduleReadyQueues(const HttpTime & now);
 	
 	HttpPolicyGlobal					mGlobalOptions;
 	class_list_t						mClasses;
 	HttpService *						mService;				// Naked pointer, not refcounted, not owner
+	F64									mSchedulerTime;			// Scheduler's virtual time
 };  // end class HttpPolicy
 
 }  // end namespace LLCore
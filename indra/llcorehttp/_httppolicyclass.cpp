@@ -37,7 +37,9 @@ HttpPolicyClass::HttpPolicyClass()
 	: mConnectionLimit(HTTP_CONNECTION_LIMIT_DEFAULT),
 	  mPerHostConnectionLimit(HTTP_CONNECTION_LIMIT_DEFAULT),
 	  mPipelining(HTTP_PIPELINING_DEFAULT),
-	  mThrottleRate(HTTP_THROTTLE_RATE_DEFAULT)
+	  mHttp2Streams(HTTP_HTTP2_STREAMS_DEFAULT),
+	  mThrottleRate(HTTP_THROTTLE_RATE_DEFAULT),
+	  mSchedulerWeight(HTTP_SCHEDULER_WEIGHT_DEFAULT)
 {}
 
 
@@ -52,7 +54,9 @@ HttpPolicyClass & HttpPolicyClass::operator=(const HttpPolicyClass & other)
 		mConnectionLimit = other.mConnectionLimit;
 		mPerHostConnectionLimit = other.mPerHostConnectionLimit;
 		mPipelining = other.mPipelining;
+		mHttp2Streams = other.mHttp2Streams;
 		mThrottleRate = other.mThrottleRate;
+		mSchedulerWeight = other.mSchedulerWeight;
 	}
 	return *this;
 }
@@ -62,7 +66,9 @@ HttpPolicyClass::HttpPolicyClass(const HttpPolicyClass & other)
 	: mConnectionLimit(other.mConnectionLimit),
 	  mPerHostConnectionLimit(other.mPerHostConnectionLimit),
 	  mPipelining(other.mPipelining),
-	  mThrottleRate(other.mThrottleRate)
+	  mHttp2Streams(other.mHttp2Streams),
+	  mThrottleRate(other.mThrottleRate),
+	  mSchedulerWeight(other.mSchedulerWeight)
 {}
 
 
@@ -86,6 +92,14 @@ HttpStatus HttpPolicyClass::set(HttpRequest::EPolicyOption opt, long value)
 		mThrottleRate = llclamp(value, 0L, 1000000L);
 		break;
 
+	case HttpRequest::PO_HTTP2_STREAM_LIMIT:
+		mHttp2Streams = llclamp(value, 0L, HTTP_HTTP2_STREAMS_MAX);
+		break;
+
+	case HttpRequest::PO_SCHEDULER_WEIGHT:
+		mSchedulerWeight = llclamp(value, 0L, HTTP_SCHEDULER_WEIGHT_MAX);
+		break;
+
 	default:
 		return HttpStatus(HttpStatus::LLCORE, HE_INVALID_ARG);
 	}
@@ -114,6 +128,14 @@ HttpStatus HttpPolicyClass::get(HttpRequest::EPolicyOption opt, long * value) co
 		*value = mThrottleRate;
 		break;
 
+	case HttpRequest::PO_HTTP2_STREAM_LIMIT:
+		*value = mHttp2Streams;
+		break;
+
+	case HttpRequest::PO_SCHEDULER_WEIGHT:
+		*value = mSchedulerWeight;
+		break;
+
 	default:
 		return HttpStatus(HttpStatus::LLCORE, HE_INVALID_ARG);
 	}
@@ -28,7 +28,7 @@
 #define	_LLCORE_HTTP_READY_QUEUE_H_
 
 
-#include <queue>
+#include <deque>
 
 #include "_httpinternal.h"
 #include "_httpoprequest.h"
@@ -39,33 +39,25 @@ namespace LLCore
 
 /// HttpReadyQueue provides a simple priority queue for HttpOpRequest objects.
 ///
-/// This uses the priority_queue adaptor class to provide the queue
-/// as well as the ordering scheme while allowing us access to the
-/// raw container if we follow a few simple rules.  One of the more
+/// This implements a std::priority_queue interface on a std::deque
+/// kept in service order while allowing us access to the raw
+/// container if we follow a few simple rules.  One of the more
 /// important of those rules is that any iterator becomes invalid
 /// on element erasure.  So pay attention.
 ///
+/// Requests of equal priority are served first-come-first-served,
+/// which a std::priority_queue wouldn't guarantee.  Most classes
+/// issue everything at one priority so insertion is normally at
+/// the back.
+///
 /// If LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY tests true, the class
-/// implements a std::priority_queue interface but on std::deque
-/// behavior to eliminate sensitivity to priority.  In the future,
-/// this will likely become the only behavior or it may become
-/// a run-time election.
+/// ignores priority altogether and is a plain FIFO.
 ///
 /// Threading:  not thread-safe.  Expected to be used entirely by
 /// a single thread, typically a worker thread of some sort.
 
-#if LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
-
 typedef std::deque<HttpOpRequest::ptr_t> HttpReadyQueueBase;
 
-#else
-
-typedef std::priority_queue<HttpOpRequest::ptr_t,
-							std::deque<HttpOpRequest::ptr_t>,
-							LLCore::HttpOpRequestCompare> HttpReadyQueueBase;
-
-#endif // LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
-
 class HttpReadyQueue : public HttpReadyQueueBase
 {
 public:
@@ -82,7 +74,6 @@ protected:
 
 public:
 
-#if LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
 	// Types and methods needed to make a std::deque look
 	// more like a std::priority_queue, at least for our
 	// purposes.
@@ -100,10 +91,18 @@ public:
 
 	void push(const value_type & v)
 		{
+#if LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
 			push_back(v);
-		}
-	
+#else
+			// Goes behind everything of the same or higher priority
+			iterator pos(end());
+			while (begin() != pos && HttpOpRequestCompare()(*(pos - 1), v))
+			{
+				--pos;
+			}
+			insert(pos, v);
 #endif // LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
+		}
 	
 	const container_type & get_container() const
 		{
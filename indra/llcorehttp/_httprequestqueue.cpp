@@ -29,6 +29,11 @@
 #include "_httpoperation.h"
 #include "_mutex.h"
 
+#if LL_LINUX
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 
 using namespace LLCoreInt;
 
@@ -40,14 +45,25 @@ HttpRequestQueue * HttpRequestQueue::sInstance(NULL);
 
 HttpRequestQueue::HttpRequestQueue()
 	: RefCounted(true),
-	  mQueueStopped(false)
+	  mQueueStopped(false),
+	  mWakeFd(-1)
 {
+#if LL_LINUX
+	mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
 }
 
 
 HttpRequestQueue::~HttpRequestQueue()
 {
     mQueue.clear();
+#if LL_LINUX
+	if (mWakeFd >= 0)
+	{
+		close(mWakeFd);
+		mWakeFd = -1;
+	}
+#endif
 }
 
 
@@ -85,6 +101,7 @@ HttpStatus HttpRequestQueue::addOp(const HttpRequestQueue::opPtr_t &op)
 	if (wake)
 	{
 		mQueueCV.notify_all();
+		signalWake();
 	}
 	return HttpStatus();
 }
@@ -139,6 +156,35 @@ void HttpRequestQueue::fetchAll(bool wait, OpContainer & ops)
 void HttpRequestQueue::wakeAll()
 {
 	mQueueCV.notify_all();
+	signalWake();
+}
+
+
+void HttpRequestQueue::signalWake()
+{
+#if LL_LINUX
+	if (mWakeFd >= 0)
+	{
+		// Only fails when the counter would overflow and it's
+		// readable then anyway.
+		const uint64_t one(1);
+		ssize_t ret(write(mWakeFd, &one, sizeof(one)));
+		(void) ret;
+	}
+#endif
+}
+
+
+void HttpRequestQueue::clearWake()
+{
+#if LL_LINUX
+	if (mWakeFd >= 0)
+	{
+		uint64_t count(0);
+		ssize_t ret(read(mWakeFd, &count, sizeof(count)));
+		(void) ret;
+	}
+#endif
 }
 
 
@@ -125,6 +125,28 @@ public:
 	///
 	/// Threading:  callable by any thread.
 	bool stopQueue();
+
+	/// Descriptor that turns readable when an operation is queued
+	/// or the queue is stopped.  Lets the servicing thread sleep
+	/// in a poll on its sockets instead of on the condition
+	/// variable.  Returns -1 where not supported (only Linux at
+	/// this time) in which case callers must use the waiting forms
+	/// of the fetch calls.
+	///
+	/// Threading:  callable by any thread.
+	int getWakeDescriptor() const
+		{
+			return mWakeFd;
+		}
+
+	/// Consume pending wakeups so that the descriptor from
+	/// @getWakeDescriptor() is quiet again.
+	///
+	/// Threading:  callable by servicing thread.
+	void clearWake();
+	
+protected:
+	void signalWake();
 	
 protected:
 	static HttpRequestQueue *			sInstance;
@@ -134,6 +156,7 @@ protected:
 	LLCoreInt::HttpMutex				mQueueMutex;
 	LLCoreInt::HttpConditionVariable	mQueueCV;
 	bool								mQueueStopped;
+	int									mWakeFd;
 	
 }; // end class HttpRequestQueue
 
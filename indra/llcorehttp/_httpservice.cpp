@@ -63,7 +63,10 @@ const HttpService::OptionDescriptor HttpService::sOptionDesc[] =
 	{	true,		true,		true,		false,		false	},		// PO_TRACE
 	{	true,		true,		false,		true,		false	},		// PO_ENABLE_PIPELINING
 	{	true,		true,		false,		true,		false	},		// PO_THROTTLE_RATE
-	{   false,		false,		true,		false,		true	}		// PO_SSL_VERIFY_CALLBACK
+	{   false,		false,		true,		false,		true	},		// PO_SSL_VERIFY_CALLBACK
+	{	true,		true,		false,		true,		false	},		// PO_HTTP2_STREAM_LIMIT
+	{	true,		true,		true,		false,		false	},		// PO_SCHEDULER_BYTE_LIMIT
+	{	true,		true,		false,		true,		false	}		// PO_SCHEDULER_WEIGHT
 };
 HttpService * HttpService::sInstance(NULL);
 volatile HttpService::EState HttpService::sState(NOT_INITIALIZED);
@@ -298,22 +301,42 @@ void HttpService::threadRun(LLCoreInt::HttpThread * thread)
 	LLThread::registerThreadID();
 	
 	ELoopSpeed loop(REQUEST_SLEEP);
+	const bool event_driven(mTransport->isEventDriven());
 	while (! mExitRequested)
 	{
         try
         {
-		    loop = processRequestQueue(loop);
+			// An event-driven transport does the sleeping, never block
+			// on the request queue itself.
+		    loop = processRequestQueue(event_driven ? NORMAL : loop);
 
 		    // Process ready queue issuing new requests as needed
 		    ELoopSpeed new_loop = mPolicy->processReadyQueue();
 		    loop = (std::min)(loop, new_loop);
 		
 		    // Give libcurl some cycles
-		    new_loop = mTransport->processTransport();
-		    loop = (std::min)(loop, new_loop);
+		    const ELoopSpeed transport_loop(mTransport->processTransport());
+		    loop = (std::min)(loop, transport_loop);
 		
 		    // Determine whether to spin, sleep briefly or sleep for next request
-		    if (REQUEST_SLEEP != loop)
+			if (event_driven)
+			{
+				// Sockets, new requests and libcurl's timers all end
+				// the wait.  Completions turn around immediately so
+				// policy can fill the free slots, retries and throttles
+				// in policy still need the short poll.
+				int timeout_ms(-1);
+				if (NORMAL == transport_loop)
+				{
+					timeout_ms = 0;
+				}
+				else if (NORMAL == new_loop)
+				{
+					timeout_ms = HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS;
+				}
+				mTransport->waitForEvents(timeout_ms);
+			}
+		    else if (REQUEST_SLEEP != loop)
 		    {
 			    ms_sleep(HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS);
 		    }
@@ -27,6 +27,7 @@
 #include "bufferarray.h"
 #include "llexception.h"
 #include "llmemory.h"
+#include "_mutex.h"
 
 
 // BufferArray is a list of chunks, each a BufferArray::Block, of contiguous
@@ -34,6 +35,13 @@
 // in length and can be larger.  Any chunk may be partially filled or even
 // empty.
 //
+// Standard-size chunks go back to a pool when their BufferArray is
+// released and are handed out again before anything new is allocated.
+// A burst of texture and mesh responses then mostly reuses the same
+// few megabytes instead of churning the heap with 64K allocations.
+// Larger chunks, from reserve() and appendBufferAlloc(), are sized for
+// one body and simply freed.
+//
 // The BufferArray itself is sharable as a RefCounted entity.  As shared
 // reads don't work with the concept of a current position/seek value,
 // none is kept with the object.  Instead, the read and write operations
@@ -68,8 +76,18 @@ protected:
 	void * operator new(size_t len, size_t addl_len);
 	
 public:
-	// Only public entry to get a block.
+	// Only public entries to get a block and to let it go.
 	static Block * alloc(size_t len);
+	static void release(Block * block);
+
+private:
+	struct Pool
+	{
+		LLCoreInt::HttpMutex	mMutex;
+		std::vector<Block *>	mFree;
+	};
+
+	static Pool & getPool();
 
 public:
 	size_t mUsed;
@@ -89,6 +107,7 @@ public:
 
 #if	! LL_WINDOWS
 const size_t BufferArray::BLOCK_ALLOC_SIZE;
+const size_t BufferArray::BLOCK_POOL_MAX;
 #endif	// ! LL_WINDOWS
 
 BufferArray::BufferArray()
@@ -103,7 +122,7 @@ BufferArray::~BufferArray()
 		 it != mBlocks.end();
 		 ++it)
 	{
-		delete *it;
+		Block::release(*it);
 		*it = NULL;
 	}
 	mBlocks.clear();
@@ -177,6 +196,7 @@ void * BufferArray::appendBufferAlloc(size_t len)
 		mBlocks.reserve(mBlocks.size() + 5);
 	}
 	Block * block = Block::alloc((std::max)(BLOCK_ALLOC_SIZE, len));
+	memset(block->mData, 0, len);
 	block->mUsed = len;
 	mBlocks.push_back(block);
 	mLen += len;
@@ -184,6 +204,38 @@ void * BufferArray::appendBufferAlloc(size_t len)
 }
 
 
+bool BufferArray::reserve(size_t len)
+{
+	if (! mBlocks.empty())
+	{
+		const Block & last(*mBlocks.back());
+		if (last.mAlloced - last.mUsed >= len)
+		{
+			// Already room at the end
+			return true;
+		}
+	}
+
+	// Start a new, empty block big enough for all of it.  Any
+	// space left in the current last block goes unused as
+	// append() only ever fills the last block.
+	if (mBlocks.size() >= mBlocks.capacity())
+	{
+		mBlocks.reserve(mBlocks.size() + 5);
+	}
+	try
+	{
+		mBlocks.push_back(Block::alloc((std::max)(BLOCK_ALLOC_SIZE, len)));
+	}
+	catch (std::bad_alloc&)
+	{
+		LL_WARNS() << "Unable to reserve " << len << " bytes for BufferArray" << LL_ENDL;
+		return false;
+	}
+	return true;
+}
+
+
 size_t BufferArray::read(size_t pos, void * dst, size_t len)
 {
 	char * c_dst(static_cast<char *>(dst));
@@ -282,7 +334,42 @@ size_t BufferArray::write(size_t pos, const void * src, size_t len)
 }
 		
 
-int BufferArray::findBlock(size_t pos, size_t * ret_offset)
+const char * BufferArray::getContiguous(size_t pos, size_t len) const
+{
+	size_t offset(0);
+	const int block(findBlock(pos, &offset));
+	if (block < 0)
+	{
+		return NULL;
+	}
+
+	const Block & b(*mBlocks[block]);
+	if (b.mUsed - offset < len)
+	{
+		// Runs into the next block
+		return NULL;
+	}
+	return &b.mData[offset];
+}
+
+
+void BufferArray::getSegments(segment_list_t & segments) const
+{
+	segments.clear();
+	segments.reserve(mBlocks.size());
+	for (container_t::const_iterator it(mBlocks.begin());
+		 it != mBlocks.end();
+		 ++it)
+	{
+		if ((*it)->mUsed)
+		{
+			segments.push_back(segment_t(&(*it)->mData[0], (*it)->mUsed));
+		}
+	}
+}
+
+
+int BufferArray::findBlock(size_t pos, size_t * ret_offset) const
 {
 	*ret_offset = 0;
 	if (pos >= mLen)
@@ -326,9 +413,7 @@ bool BufferArray::getBlockStartEnd(int block, const char ** start, const char **
 BufferArray::Block::Block(size_t len)
 	: mUsed(0),
 	  mAlloced(len)
-{
-	memset(mData, 0, len);
-}
+{}
 			
 
 BufferArray::Block::~Block()
@@ -360,9 +445,49 @@ void BufferArray::Block::operator delete(void * mem, size_t)
 
 BufferArray::Block * BufferArray::Block::alloc(size_t len)
 {
+	if (BLOCK_ALLOC_SIZE == len)
+	{
+		Pool & pool(getPool());
+		LLCoreInt::HttpScopedLock lock(pool.mMutex);
+
+		if (! pool.mFree.empty())
+		{
+			Block * block(pool.mFree.back());
+			pool.mFree.pop_back();
+			block->mUsed = 0;
+			return block;
+		}
+	}
+	
 	Block * block = new (len) Block(len);
 	return block;
 }
+
+
+void BufferArray::Block::release(Block * block)
+{
+	if (block && BLOCK_ALLOC_SIZE == block->mAlloced)
+	{
+		Pool & pool(getPool());
+		LLCoreInt::HttpScopedLock lock(pool.mMutex);
+
+		if (pool.mFree.size() < BLOCK_POOL_MAX)
+		{
+			pool.mFree.push_back(block);
+			return;
+		}
+	}
+	delete block;
+}
+
+
+BufferArray::Block::Pool & BufferArray::Block::getPool()
+{
+	// Deliberately never destroyed, bodies may still be
+	// released during static destruction.
+	static Pool * pool(new Pool);
+	return *pool;
+}
 	
 
 }  // end namespace LLCore
@@ -59,7 +59,15 @@ class BufferArrayStreamBuf;
 /// write and append operations and beyond which the current position
 /// cannot be set.
 ///
-/// Threading:  not thread-safe
+/// Consumers that can work on the data in place needn't copy it out
+/// with read().  getContiguous() hands out a pointer when the wanted
+/// range lies in a single block, which reserve() arranges for when the
+/// size is known in advance, and getSegments() lists the blocks for
+/// anything that can take scattered input.
+///
+/// Threading:  not thread-safe.  Standard-size blocks are recycled
+/// through a pool shared by all instances which is safe to use from
+/// any thread.
 ///
 /// Allocation:  Refcounted, heap only.  Caller of the constructor
 /// is given a single refcount.
@@ -84,8 +92,13 @@ private:
 	void operator=(const BufferArray &);		// Not defined
 
 public:
-	// Internal magic number, may be used by unit tests.
+	// Internal magic numbers, may be used by unit tests.
 	static const size_t BLOCK_ALLOC_SIZE = 65540;
+	static const size_t BLOCK_POOL_MAX = 64;		// Free blocks kept for reuse
+
+	/// A piece of the data, start and length, as seen by getSegments().
+	typedef std::pair<const char *, size_t> segment_t;
+	typedef std::vector<segment_t> segment_list_t;
 	
 	/// Appends the indicated data to the BufferArray
 	/// modifying current position and total size.  New
@@ -104,6 +117,16 @@ public:
 	///					of BufferArray of 'len' size.
 	void * appendBufferAlloc(size_t len);
 
+	/// Guarantees that the next 'len' bytes appended, by any
+	/// combination of append() and write() at the end, land in
+	/// one contiguous block.  Meant for callers that know how
+	/// much data is coming, e.g. from a Content-Length header.
+	/// Doesn't change the size of the BufferArray.
+	///
+	/// @return			false if the memory couldn't be had,
+	///					the BufferArray is unchanged then.
+	bool reserve(size_t len);
+
 	/// Current count of bytes in BufferArray instance.
 	size_t size() const
 		{
@@ -120,9 +143,23 @@ public:
 	/// append data when current position is equal to the
 	/// size of the instance or do a mix of both.
 	size_t write(size_t pos, const void * src, size_t len);
+
+	/// Contiguous view of 'len' bytes from the given position.
+	/// Valid until the BufferArray is next modified or released.
+	///
+	/// @return			Pointer to the data or NULL if the range
+	///					isn't held in a single block or goes
+	///					beyond the data.  Caller falls back to
+	///					read() or getSegments() then.
+	const char * getContiguous(size_t pos, size_t len) const;
+
+	/// Scatter/gather view of all the data, replacing the
+	/// contents of 'segments' with one entry per non-empty
+	/// block in order.  Valid as for getContiguous().
+	void getSegments(segment_list_t & segments) const;
 	
 protected:
-	int findBlock(size_t pos, size_t * ret_offset);
+	int findBlock(size_t pos, size_t * ret_offset) const;
 
 	bool getBlockStartEnd(int block, const char ** start, const char ** end);
 	
@@ -233,6 +233,42 @@ public:
 		/// Global only
 		PO_SSL_VERIFY_CALLBACK,
 
+		/// If greater than 0, requests in the class ask for HTTP/2
+		/// (over TLS, plain http stays on HTTP/1.1) and libcurl
+		/// multiplexes up to this many concurrent streams on each
+		/// connection.  Requests wait for a stream on an existing
+		/// connection rather than opening a new one.  Connection
+		/// counts are still governed by PO_CONNECTION_LIMIT and
+		/// PO_PER_HOST_CONNECTION_LIMIT, the number of requests in
+		/// flight becomes the per-host limit times this value.
+		/// Takes precedence over PO_PIPELINING_DEPTH.  A value of
+		/// zero, the default, keeps the class on HTTP/1.1.
+		///
+		/// Per-class only
+		PO_HTTP2_STREAM_LIMIT,
+
+		/// Long value giving the estimated response bytes allowed
+		/// in flight across all classes taking part in scheduling
+		/// (@see PO_SCHEDULER_WEIGHT).  When non-zero, their ready
+		/// requests are released in weighted fair order between
+		/// the classes, highest priority first within each, for
+		/// as long as the total stays under this value.  A request
+		/// is estimated at its Range: length if it has one.  Zero,
+		/// the default, leaves every class to its own limits.
+		///
+		/// Global only
+		PO_SCHEDULER_BYTE_LIMIT,
+
+		/// Long value giving the class's share of the scheduler's
+		/// bytes relative to other classes, 1-100.  With weights of
+		/// 4 and 1, one class gets four bytes through for every one
+		/// of the other while both have requests waiting.  Zero,
+		/// the default, keeps the class out of scheduling and its
+		/// requests out of the byte count.
+		///
+		/// Per-class only
+		PO_SCHEDULER_WEIGHT,
+
 		PO_LAST  // Always at end
 	};
 
@@ -317,7 +353,9 @@ public:
 	/// @param	policy_id		Default or user-defined policy class under
 	///							which this request is to be serviced.
 	/// @param	priority		Standard priority scheme inherited from
-	///							Indra code base (U32-type scheme).
+	///							Indra code base (U32-type scheme).  Higher
+	///							values are served first within the policy
+	///							class, equal values in order of issue.
 	/// @param	url				URL with any encoded query parameters to
 	///							be accessed.
 	/// @param	options			Optional instance of an HttpOptions object
@@ -42,9 +42,14 @@ HTTPStats::~HTTPStats()
 void HTTPStats::resetStats()
 {
     mResutCodes.clear();
+    mQueueDelay.clear();
     mDataDown.reset();
     mDataUp.reset();
     mRequests = 0;
+    mNewConnections = 0;
+    mReusedConnections = 0;
+    mHttp2Streams = 0;
+    mHttp2ReusedStreams = 0;
 }
 
 
@@ -61,6 +66,32 @@ void HTTPStats::recordResultCode(S32 code)
 
 }
 
+void HTTPStats::recordConnectionUse(bool http2, bool new_connection)
+{
+    if (new_connection)
+        ++mNewConnections;
+    else
+        ++mReusedConnections;
+
+    if (http2)
+    {
+        ++mHttp2Streams;
+        if (!new_connection)
+            ++mHttp2ReusedStreams;
+    }
+}
+
+void HTTPStats::recordQueueDelay(S32 policy_class, U64 usecs)
+{
+    mQueueDelay[policy_class].push(F32(usecs) / 1000.f);
+}
+
+F32 HTTPStats::getMeanQueueDelay(S32 policy_class) const
+{
+    std::map<S32, StatsAccumulator>::const_iterator it(mQueueDelay.find(policy_class));
+    return (mQueueDelay.end() == it) ? 0.f : (*it).second.getMean();
+}
+
 namespace
 {
     std::string byte_count_converter(F32 bytes)
@@ -93,6 +124,8 @@ void HTTPStats::dumpStats()
     out << "Data Sent: " << byte_count_converter(mDataUp.getSum()) << "   (" << mDataUp.getSum() << ")" << std::endl;
     out << "Data Recv: " << byte_count_converter(mDataDown.getSum()) << "   (" << mDataDown.getSum() << ")" << std::endl;
     out << "Total requests: " << mRequests << "(request objects created)" << std::endl;
+    out << "Connections opened: " << mNewConnections << "   reused: " << mReusedConnections << std::endl;
+    out << "HTTP/2 streams: " << mHttp2Streams << "   on reused connections: " << mHttp2ReusedStreams << std::endl;
     out << std::endl;
     out << "Result Codes:" << std::endl << "--- -----" << std::endl;
 
@@ -101,6 +134,15 @@ void HTTPStats::dumpStats()
         out << (*it).first << " " << (*it).second << std::endl;
     }
 
+    out << std::endl;
+    out << "Queueing delay (ms):" << std::endl << "Class Requests Mean Max" << std::endl;
+
+    for (std::map<S32, StatsAccumulator>::iterator it = mQueueDelay.begin(); it != mQueueDelay.end(); ++it)
+    {
+        out << (*it).first << " " << (*it).second.getCount() << " " << (*it).second.getMean()
+            << " " << (*it).second.getMaxValue() << std::endl;
+    }
+
     LL_WARNS("HTTPCore") << out.str() << LL_ENDL;
 }
 
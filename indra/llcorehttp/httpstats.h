@@ -59,6 +59,23 @@ namespace LLCore
 
         void    recordResultCode(S32 code);
 
+        // A completed transfer: whether it ran as an HTTP/2 stream
+        // and whether it had to open a connection or reused one.
+        void    recordConnectionUse(bool http2, bool new_connection);
+
+        S32     getNewConnections() const { return mNewConnections; }
+        S32     getReusedConnections() const { return mReusedConnections; }
+        S32     getHttp2Streams() const { return mHttp2Streams; }
+        S32     getHttp2ReusedStreams() const { return mHttp2ReusedStreams; }
+
+        // Time a request spent on its class's ready queue before
+        // being started, in microseconds.
+        void    recordQueueDelay(S32 policy_class, U64 usecs);
+
+        // Mean of the above in milliseconds, 0 for a class that
+        // hasn't started anything.
+        F32     getMeanQueueDelay(S32 policy_class) const;
+
         void    dumpStats();
     private:
         StatsAccumulator mDataDown;
@@ -66,7 +83,13 @@ namespace LLCore
 
         S32              mRequests;
 
+        S32              mNewConnections;
+        S32              mReusedConnections;
+        S32              mHttp2Streams;
+        S32              mHttp2ReusedStreams;
+
         std::map<S32, S32> mResutCodes;
+        std::map<S32, StatsAccumulator> mQueueDelay;	// milliseconds, by policy class
     };
 
 
@@ -374,6 +374,84 @@ void BufferArrayTestObjectType::test<8>()
 	ba->release();
 }
 
+template <> template <>
+void BufferArrayTestObjectType::test<9>()
+{
+	set_test_name("BufferArray reserve and contiguous/segment views");
+
+	// create a new ref counted object with an implicit reference
+	BufferArray * ba = new BufferArray();
+
+	// a little data, then room for a body bigger than a block
+	char str1[] = "abcdefghij";
+	size_t str1_len(strlen(str1));
+	ba->append(str1, str1_len);
+	const size_t body_len(BufferArray::BLOCK_ALLOC_SIZE + 1000);
+	ensure("Reserve succeeds", ba->reserve(body_len));
+	ensure("Reserve doesn't change size", str1_len == ba->size());
+
+	// fill it in pieces as libcurl would
+	char piece[1000];
+	for (size_t i(0); i < body_len; i += sizeof(piece))
+	{
+		memset(piece, 'a' + (i / sizeof(piece)) % 26, sizeof(piece));
+		ba->append(piece, (std::min)(sizeof(piece), body_len - i));
+	}
+	ensure("Size correct", str1_len + body_len == ba->size());
+
+	// body is all in one place
+	const char * body(ba->getContiguous(str1_len, body_len));
+	ensure("Body is contiguous", NULL != body);
+	ensure("Body content correct.1", 'a' == body[0] && 'a' == body[999]);
+	ensure("Body content correct.2", 'b' == body[1000]);
+	ensure("Body content correct.3", 'a' + (body_len - 1) / 1000 % 26 == body[body_len - 1]);
+	ensure("Prefix is contiguous", 0 == strncmp(ba->getContiguous(0, str1_len), str1, str1_len));
+	ensure("Range spanning blocks isn't contiguous", NULL == ba->getContiguous(0, str1_len + 1));
+	ensure("Range beyond end isn't contiguous", NULL == ba->getContiguous(str1_len, body_len + 1));
+	ensure("Position beyond end isn't contiguous", NULL == ba->getContiguous(ba->size(), 0));
+
+	// scatter/gather view covers the same data
+	BufferArray::segment_list_t segments;
+	ba->getSegments(segments);
+	ensure_equals("Segment count", segments.size(), size_t(2));
+	ensure("Segment 1", segments[0].second == str1_len && 0 == strncmp(segments[0].first, str1, str1_len));
+	ensure("Segment 2", segments[1].second == body_len && segments[1].first == body);
+
+	// reserving what's already there is a no-op
+	ensure("Reserve with room succeeds", ba->reserve(0));
+	ba->getSegments(segments);
+	ensure_equals("Segment count unchanged", segments.size(), size_t(2));
+
+	// release the implicit reference, causing the object to be released
+	ba->release();
+}
+
+template <> template <>
+void BufferArrayTestObjectType::test<10>()
+{
+	set_test_name("BufferArray block pool reuse");
+
+	char str1[] = "abcdefghij";
+	size_t str1_len(strlen(str1));
+
+	BufferArray * ba = new BufferArray();
+	ba->append(str1, str1_len);
+	const char * first(ba->getContiguous(0, str1_len));
+	ba->release();
+
+	// next standard block comes back out of the pool
+	ba = new BufferArray();
+	ba->append(str1 + 5, 5);
+	ensure("Pooled block reused", first == ba->getContiguous(0, 5));
+	ensure("Pooled block holds new data only", 5 == ba->size() && 0 == strncmp(first, "fghij", 5));
+
+	// an oversized block isn't pooled but still works
+	char * big(static_cast<char *>(ba->appendBufferAlloc(BufferArray::BLOCK_ALLOC_SIZE * 2)));
+	ensure("Large allocation zeroed", 0 == big[0] && 0 == big[BufferArray::BLOCK_ALLOC_SIZE * 2 - 1]);
+	ensure("Large allocation contiguous", big == ba->getContiguous(5, BufferArray::BLOCK_ALLOC_SIZE * 2));
+	ba->release();
+}
+
 }  // end namespace tut
 
 
@@ -0,0 +1,124 @@
+/** 
+ * @file test_httpreadyqueue.hpp
+ * @brief unit tests for the LLCore::HttpReadyQueue class
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+#ifndef TEST_LLCORE_HTTP_READYQUEUE_H_
+#define TEST_LLCORE_HTTP_READYQUEUE_H_
+
+#include "_httpreadyqueue.h"
+
+#include <iostream>
+
+
+using namespace LLCore;
+
+
+
+namespace tut
+{
+
+struct HttpReadyqueueTestData
+{
+	// the test objects inherit from this so the member functions and variables
+	// can be referenced directly inside of the test functions.
+
+	// Queue up requests with the given priorities, tagging each
+	// with its position in mReqLength so order can be checked.
+	void fill(HttpReadyQueue & queue, const HttpRequest::priority_t * priorities, size_t count)
+		{
+			for (size_t i(0); i < count; ++i)
+			{
+				HttpOpRequest::ptr_t op(new HttpOpRequest());
+				op->mReqPriority = priorities[i];
+				op->mReqLength = i;
+				queue.push(op);
+			}
+		}
+};
+
+typedef test_group<HttpReadyqueueTestData> HttpReadyqueueTestGroupType;
+typedef HttpReadyqueueTestGroupType::object HttpReadyqueueTestObjectType;
+HttpReadyqueueTestGroupType HttpReadyqueueTestGroup("HttpReadyqueue Tests");
+
+template <> template <>
+void HttpReadyqueueTestObjectType::test<1>()
+{
+	set_test_name("HttpReadyQueue priority order");
+
+	HttpReadyQueue queue;
+	const HttpRequest::priority_t priorities[] = { 5, 1, 9, 5, 1, 9, 7 };
+	fill(queue, priorities, LL_ARRAY_SIZE(priorities));
+	ensure_equals("All queued", queue.size(), LL_ARRAY_SIZE(priorities));
+
+#if LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
+	const size_t expected[] = { 0, 1, 2, 3, 4, 5, 6 };
+#else
+	// Highest first, equals in the order they came
+	const size_t expected[] = { 2, 5, 6, 0, 3, 1, 4 };
+#endif
+	for (size_t i(0); i < LL_ARRAY_SIZE(expected); ++i)
+	{
+		ensure("Not empty", ! queue.empty());
+		ensure_equals("Service order", queue.top()->mReqLength, expected[i]);
+		queue.pop();
+	}
+	ensure("Empty at end", queue.empty());
+}
+
+template <> template <>
+void HttpReadyqueueTestObjectType::test<2>()
+{
+	set_test_name("HttpReadyQueue reprioritization");
+
+	HttpReadyQueue queue;
+	const HttpRequest::priority_t priorities[] = { 3, 3, 3, 3 };
+	fill(queue, priorities, LL_ARRAY_SIZE(priorities));
+
+	// Same steps as HttpPolicy::changePriority()
+	HttpReadyQueue::container_type & c(queue.get_container());
+	HttpOpRequest::ptr_t op(c[2]);
+	c.erase(c.begin() + 2);
+	op->mReqPriority = 4;
+	queue.push(op);
+
+#if ! LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
+	ensure_equals("Raised request goes first", queue.top()->mReqLength, size_t(2));
+	queue.pop();
+#endif
+	ensure_equals("Others keep their order.1", queue.top()->mReqLength, size_t(0));
+	queue.pop();
+	ensure_equals("Others keep their order.2", queue.top()->mReqLength, size_t(1));
+	queue.pop();
+	ensure_equals("Others keep their order.3", queue.top()->mReqLength, size_t(3));
+	queue.pop();
+#if LLCORE_HTTP_READY_QUEUE_IGNORES_PRIORITY
+	ensure_equals("Changed request goes last", queue.top()->mReqLength, size_t(2));
+	queue.pop();
+#endif
+	ensure("Empty at end", queue.empty());
+}
+
+}  // end namespace tut
+
+#endif  // TEST_LLCORE_HTTP_READYQUEUE_H_
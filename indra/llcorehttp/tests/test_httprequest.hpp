@@ -32,6 +32,11 @@
 #include "httpheaders.h"
 #include "httpresponse.h"
 #include "httpoptions.h"
+#include "httpstats.h"
+#include "_httpinternal.h"
+#include "_httplibcurl.h"
+#include "_httpoprequest.h"
+#include "_httppolicy.h"
 #include "_httpservice.h"
 #include "_httprequestqueue.h"
 
@@ -3056,6 +3061,349 @@ void HttpRequestTestObjectType::test<23>()
 }
 
 
+template <> template <>
+void HttpRequestTestObjectType::test<24>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest PO_HTTP2_STREAM_LIMIT set and get");
+
+	try
+	{
+		HttpRequest::createService();
+
+		HttpRequest::policy_t pclass(HttpRequest::createPolicyClass());
+		ensure("Policy class created", pclass > HttpRequest::DEFAULT_POLICY_ID);
+
+		long value(-1);
+		HttpStatus status(HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+															 pclass, 8, &value));
+		ensure("Stream limit set", bool(status));
+		ensure_equals("Stream limit read back", value, 8L);
+
+		// Out of range values are clamped, not rejected
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+													pclass, 100000, &value);
+		ensure("Large stream limit accepted", bool(status));
+		ensure_equals("Large stream limit clamped", value, HTTP_HTTP2_STREAMS_MAX);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+													pclass, -5, &value);
+		ensure("Negative stream limit accepted", bool(status));
+		ensure_equals("Negative stream limit clamped", value, 0L);
+
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+													HttpRequest::DEFAULT_POLICY_ID, 4, &value);
+		ensure("Default class stream limit set", bool(status));
+		ensure_equals("Default class stream limit read back", value, 4L);
+
+		// Per-class only, and only for classes that exist
+		value = -1;
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+													HttpRequest::GLOBAL_POLICY_ID, 8, &value);
+		ensure("Global stream limit rejected", ! status);
+		ensure("Global stream limit rejected status", status == HttpStatus(HttpStatus::LLCORE, HE_INVALID_ARG));
+		status = HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT,
+													pclass + 1, 8, &value);
+		ensure("Unknown class rejected", ! status);
+		ensure_equals("Rejected value not returned", value, -1L);
+
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+template <> template <>
+void HttpRequestTestObjectType::test<25>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest scheduler weighted share under a byte limit");
+
+	// This drives the policy and transport layers directly without
+	// the worker thread.  Requests are handed to libcurl but never
+	// performed so nothing goes out on the network.
+	std::string url_base(get_base_url());
+	const long request_bytes(100000L);
+	std::vector<HttpHandle> handles;
+
+	try
+	{
+		HttpRequest::createService();
+
+		HttpRequest::policy_t heavy(HttpRequest::createPolicyClass());
+		HttpRequest::policy_t light(HttpRequest::createPolicyClass());
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_SCHEDULER_BYTE_LIMIT,
+										   HttpRequest::GLOBAL_POLICY_ID, 8 * request_bytes, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_SCHEDULER_WEIGHT, heavy, 3, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_SCHEDULER_WEIGHT, light, 1, NULL);
+
+		HttpService * service(HttpService::instanceOf());
+		HttpPolicy & policy(service->getPolicy());
+		HttpLibcurl & transport(service->getTransport());
+		policy.start();
+		transport.start(light + 1);
+
+		// More than either class's connection limit can take
+		for (int i(0); i < 10; ++i)
+		{
+			for (HttpRequest::policy_t pclass(heavy); pclass <= light; ++pclass)
+			{
+				HttpOpRequest::ptr_t op(new HttpOpRequest());
+				ensure("GET set up", bool(op->setupGetByteRange(pclass, 0U, url_base,
+																0, request_bytes,
+																HttpOptions::ptr_t(),
+																HttpHeaders::ptr_t())));
+				handles.push_back(op->getHandle());
+				policy.addOp(op);
+			}
+		}
+
+		// Eight requests fit under the limit, split 3:1 by weight
+		policy.processReadyQueue();
+		ensure_equals("Heavy class share", transport.getActiveCountInClass(heavy), 6);
+		ensure_equals("Light class share", transport.getActiveCountInClass(light), 2);
+		ensure_equals("Active bytes at the limit", transport.getActiveBytes(), size_t(8 * request_bytes));
+
+		// Nothing more starts until bytes are released
+		policy.processReadyQueue();
+		ensure_equals("Still at the limit", transport.getActiveCount(), 8);
+
+		// Canceling hands back the bytes of active requests and
+		// drops the waiting ones
+		for (int i(0); i < handles.size(); ++i)
+		{
+			ensure("Request canceled", service->cancel(handles[i]));
+		}
+		ensure_equals("No active requests", transport.getActiveCount(), 0);
+		ensure_equals("Active bytes released on cancel", transport.getActiveBytes(), size_t(0));
+		ensure_equals("Heavy class ready queue empty", policy.getReadyCount(heavy), 0);
+		ensure_equals("Light class ready queue empty", policy.getReadyCount(light), 0);
+
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+
+template <> template <>
+void HttpRequestTestObjectType::test<26>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest scheduler bytes released after retries");
+
+	// Handler can be stack-allocated *if* there are no dangling
+	// references to it after completion of this method.
+	TestHandler2 handler(this, "handler");
+	LLCore::HttpHandler::ptr_t handlerp(&handler, NoOpDeletor);
+	std::string url_base(get_base_url() + "/503/6/");	// 503 with unusable Retry-After
+	mHandlerCalls = 0;
+
+	HttpRequest * req = NULL;
+	HttpOptions::ptr_t opts;
+
+	try
+	{
+		HttpRequest::createService();
+
+		HttpRequest::policy_t pclass(HttpRequest::createPolicyClass());
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_SCHEDULER_BYTE_LIMIT,
+										   HttpRequest::GLOBAL_POLICY_ID, 100000L, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_SCHEDULER_WEIGHT, pclass, 1, NULL);
+
+		HttpRequest::startThread();
+
+		req = new HttpRequest();
+
+		// Each request fails, waits in the retry queue and is
+		// charged again when it restarts
+		opts = HttpOptions::ptr_t(new HttpOptions());
+		opts->setRetries(2);
+		opts->setUseRetryAfter(false);
+		opts->setMinBackoff(HttpTime(100000));
+		opts->setMaxBackoff(HttpTime(200000));
+
+		mStatus = HttpStatus(503);
+		const int request_limit(4);
+		for (int i(0); i < request_limit; ++i)
+		{
+			HttpHandle handle = req->requestGetByteRange(pclass,
+														 0U,
+														 url_base,
+														 0,
+														 40000,
+														 opts,
+														 HttpHeaders::ptr_t(),
+														 handlerp);
+			ensure("Valid handle returned for 503 request", handle != LLCORE_HTTP_HANDLE_INVALID);
+		}
+
+		// Run the notification pump.
+		int count(0);
+		int limit(LOOP_COUNT_LONG);
+		while (count++ < limit && mHandlerCalls < request_limit)
+		{
+			req->update(0);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Requests executed in reasonable time", count < limit);
+		ensure("One handler invocation per request", mHandlerCalls == request_limit);
+
+		// Okay, request a shutdown of the servicing thread
+		mStatus = HttpStatus();
+		mHandlerCalls = 0;
+		HttpHandle handle = req->requestStopThread(handlerp);
+		ensure("Valid handle returned for stop request", handle != LLCORE_HTTP_HANDLE_INVALID);
+
+		count = 0;
+		limit = LOOP_COUNT_LONG;
+		while (count++ < limit && mHandlerCalls < 1)
+		{
+			req->update(1000000);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Stop request executed in reasonable time", count < limit);
+
+		count = 0;
+		limit = LOOP_COUNT_SHORT;
+		while (count++ < limit && ! HttpService::isStopped())
+		{
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Thread actually stopped running", HttpService::isStopped());
+
+		// Safe to look at the transport with the thread gone
+		ensure_equals("Active bytes released after retries",
+					  HttpService::instanceOf()->getTransport().getActiveBytes(), size_t(0));
+
+		opts.reset();
+		delete req;
+		req = NULL;
+
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		stop_thread(req);
+		opts.reset();
+		delete req;
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+
+template <> template <>
+void HttpRequestTestObjectType::test<27>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest connection counts with HTTP/2 streams enabled");
+
+	// The test server only speaks plain HTTP/1.x so this can't see
+	// requests multiplexed as streams.  It does check that a class
+	// set up for HTTP/2 (multiplexing, PIPEWAIT, a stream limit)
+	// still completes a burst over HTTP/1.x and that every transfer
+	// is counted as a connection opened or reused.
+	TestHandler2 handler(this, "handler");
+	LLCore::HttpHandler::ptr_t handlerp(&handler, NoOpDeletor);
+	std::string url_base(get_base_url());
+	mHandlerCalls = 0;
+
+	HttpRequest * req = NULL;
+
+	try
+	{
+		HttpRequest::createService();
+
+		HttpRequest::policy_t pclass(HttpRequest::createPolicyClass());
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAM_LIMIT, pclass, 8, NULL);
+		HTTPStats::instance().resetStats();
+
+		HttpRequest::startThread();
+
+		req = new HttpRequest();
+
+		// More at once than the class has connections
+		mStatus = HttpStatus(200);
+		const int request_limit(12);
+		for (int i(0); i < request_limit; ++i)
+		{
+			HttpHandle handle = req->requestGet(pclass,
+												0U,
+												url_base,
+												HttpOptions::ptr_t(),
+												HttpHeaders::ptr_t(),
+												handlerp);
+			ensure("Valid handle returned for GET request", handle != LLCORE_HTTP_HANDLE_INVALID);
+		}
+
+		// Run the notification pump.
+		int count(0);
+		int limit(LOOP_COUNT_LONG);
+		while (count++ < limit && mHandlerCalls < request_limit)
+		{
+			req->update(0);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Requests executed in reasonable time", count < limit);
+		ensure("One handler invocation per request", mHandlerCalls == request_limit);
+
+		// Okay, request a shutdown of the servicing thread
+		mStatus = HttpStatus();
+		mHandlerCalls = 0;
+		HttpHandle handle = req->requestStopThread(handlerp);
+		ensure("Valid handle returned for stop request", handle != LLCORE_HTTP_HANDLE_INVALID);
+
+		count = 0;
+		limit = LOOP_COUNT_LONG;
+		while (count++ < limit && mHandlerCalls < 1)
+		{
+			req->update(1000000);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Stop request executed in reasonable time", count < limit);
+
+		count = 0;
+		limit = LOOP_COUNT_SHORT;
+		while (count++ < limit && ! HttpService::isStopped())
+		{
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Thread actually stopped running", HttpService::isStopped());
+
+		// Safe to look at the counts with the thread gone
+		const HTTPStats & stats(HTTPStats::instance());
+		ensure_equals("Every transfer counted once",
+					  stats.getNewConnections() + stats.getReusedConnections(), request_limit);
+		ensure("At least one connection opened", stats.getNewConnections() > 0);
+		ensure_equals("No HTTP/2 streams over HTTP/1.x", stats.getHttp2Streams(), 0);
+		ensure_equals("No reused HTTP/2 streams over HTTP/1.x", stats.getHttp2ReusedStreams(), 0);
+
+		delete req;
+		req = NULL;
+
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		stop_thread(req);
+		delete req;
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+
 }  // end namespace tut
 
 namespace
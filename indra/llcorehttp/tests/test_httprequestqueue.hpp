@@ -32,6 +32,10 @@
 
 #include "_httpoperation.h"
 
+#if LL_LINUX
+#include <poll.h>
+#endif
+
 
 using namespace LLCoreInt;
 
@@ -151,6 +155,50 @@ void HttpRequestqueueTestObjectType::test<4>()
 	}
 }
 
+template <> template <>
+void HttpRequestqueueTestObjectType::test<5>()
+{
+	set_test_name("HttpRequestQueue wake descriptor");
+
+	HttpRequestQueue::init();
+
+	HttpRequestQueue * rq = HttpRequestQueue::instanceOf();
+	const int fd(rq->getWakeDescriptor());
+#if LL_LINUX
+	ensure("Wake descriptor available", fd >= 0);
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	ensure("Quiet when nothing queued", 0 == poll(&pfd, 1, 0));
+
+	HttpOperation::ptr_t op (new HttpOpNull());
+	rq->addOp(op);
+	ensure("Readable after first op queued", 1 == poll(&pfd, 1, 0));
+
+	rq->clearWake();
+	ensure("Quiet after clearing", 0 == poll(&pfd, 1, 0));
+
+	// Already non-empty, no need to wake again
+	op.reset(new HttpOpNull());
+	rq->addOp(op);
+	ensure("Quiet while ops waiting", 0 == poll(&pfd, 1, 0));
+
+	HttpRequestQueue::OpContainer ops;
+	rq->fetchAll(false, ops);
+	ensure("Two ops fetched", 2 == ops.size());
+	ops.clear();
+
+	rq->stopQueue();
+	ensure("Readable after stop", 1 == poll(&pfd, 1, 0));
+#else
+	ensure("No wake descriptor", fd < 0);
+#endif
+
+	HttpRequestQueue::term();
+}
+
 }  // end namespace tut
 
 
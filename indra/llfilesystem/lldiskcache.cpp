@@ -40,20 +40,141 @@
 
 #include "lldiskcache.h"
 
+namespace
+{
+    /**
+     * Names of the index snapshot and journal kept in the cache directory.
+     * They deliberately do not start with the cache filename prefix so they
+     * are never mistaken for cache files.
+     */
+    const std::string INDEX_SNAPSHOT_NAME("index.dat");
+    const std::string INDEX_JOURNAL_NAME("index.journal");
+
+    /**
+     * Both files start with this header. Bump the trailing digit if the
+     * record layout ever changes so that old indices get rebuilt.
+     */
+    const char INDEX_MAGIC[] = "LLDCIDX1";
+    const size_t INDEX_MAGIC_LEN = sizeof(INDEX_MAGIC) - 1;
+
+    const U8 INDEX_OP_UPDATE = 'U';
+    const U8 INDEX_OP_REMOVE = 'R';
+
+    /**
+     * Once the journal on disk is bigger than this, flushIndex() folds it
+     * into a new snapshot
+     */
+    const size_t INDEX_JOURNAL_COMPACT_BYTES = 4 * 1024 * 1024;
+
+    /**
+     * Threshold in time_t units that is used to decide if a change to the
+     * last access time of a file is written to the journal or only kept in
+     * memory. Originally added as a precaution for the concern outlined in
+     * SL-14582 about frequent writes on older SSDs reducing their lifespan.
+     * The in-memory LRU order is always updated.
+     *
+     * Let's start with 1 hour in time_t units and see how that unfolds
+     */
+    const std::time_t ACCESS_TIME_THRESHOLD = 1 * 60 * 60;
+
+    // Records are written in native byte order: the cache is never shared
+    // between machines.
+    void append_index_record(std::string& out, U8 op, const std::string& key, U64 size, S64 access_time)
+    {
+        U16 key_len = (U16)llmin(key.size(), (size_t)U16_MAX);
+        out.append((const char*)&op, sizeof(op));
+        out.append((const char*)&key_len, sizeof(key_len));
+        out.append(key, 0, key_len);
+        out.append((const char*)&size, sizeof(size));
+        out.append((const char*)&access_time, sizeof(access_time));
+    }
+
+    // Returns false at the end of the buffer or on a truncated record, which
+    // is what a crash in the middle of a journal append leaves behind.
+    bool read_index_record(const std::string& in, size_t& pos, U8& op, std::string& key, U64& size, S64& access_time)
+    {
+        U16 key_len = 0;
+        if (pos + sizeof(op) + sizeof(key_len) > in.size())
+        {
+            return false;
+        }
+        memcpy(&op, in.data() + pos, sizeof(op));
+        memcpy(&key_len, in.data() + pos + sizeof(op), sizeof(key_len));
+        size_t key_pos = pos + sizeof(op) + sizeof(key_len);
+        if (key_pos + key_len + sizeof(size) + sizeof(access_time) > in.size())
+        {
+            return false;
+        }
+        key.assign(in, key_pos, key_len);
+        memcpy(&size, in.data() + key_pos + key_len, sizeof(size));
+        memcpy(&access_time, in.data() + key_pos + key_len + sizeof(size), sizeof(access_time));
+        pos = key_pos + key_len + sizeof(size) + sizeof(access_time);
+        return true;
+    }
+
+    bool read_whole_file(const std::string& filename, std::string& out)
+    {
+        LLFILE* fp = LLFile::fopen(filename, "rb");
+        if (!fp)
+        {
+            return false;
+        }
+        fseek(fp, 0, SEEK_END);
+        long file_size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        bool success = false;
+        if (file_size >= 0)
+        {
+            out.resize(file_size);
+            success = (file_size == 0) || (fread(&out[0], 1, file_size, fp) == (size_t)file_size);
+        }
+        LLFile::close(fp);
+        return success;
+    }
+
+    bool write_whole_file(const std::string& filename, const char* mode, const std::string& data)
+    {
+        LLFILE* fp = LLFile::fopen(filename, mode);
+        if (!fp)
+        {
+            return false;
+        }
+        bool success = data.empty() || (fwrite(data.data(), 1, data.size(), fp) == data.size());
+        LLFile::close(fp);
+        return success;
+    }
+}
+
 LLDiskCache::LLDiskCache(const std::string cache_dir,
                          const uintmax_t max_size_bytes,
-                         const bool enable_cache_debug_info) :
+                         const bool enable_cache_debug_info,
+                         const bool enable_pack_store) :
     mCacheDir(cache_dir),
     mMaxSizeBytes(max_size_bytes),
-    mEnableCacheDebugInfo(enable_cache_debug_info)
+    mEnableCacheDebugInfo(enable_cache_debug_info),
+    mIndexTotalBytes(0),
+    mJournalFileBytes(0)
 {
     mCacheFilenamePrefix = "sl_cache";
 
     LLFile::mkdir(cache_dir);
+
+    if (enable_pack_store)
+    {
+        // before loading the index since rebuilding it needs the pack contents
+        mPackStore.reset(new LLDiskCachePack(cache_dir + gDirUtilp->getDirDelimiter() + "packs"));
+    }
+
+    loadIndex();
+}
+
+LLDiskCache::~LLDiskCache()
+{
+    flushIndex();
 }
 
 // WARNING: purge() is called by LLPurgeDiskCacheThread. As such it must
-// NOT touch any LLDiskCache data without introducing and locking a mutex!
+// NOT touch any LLDiskCache data without locking mIndexMutex!
 
 // Interaction through the filesystem itself should be safe. Let’s say thread
 // A is accessing the cache file for reading/writing and thread B is trimming
@@ -90,72 +211,60 @@ void LLDiskCache::purge()
     boost::system::error_code ec;
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    typedef std::pair<std::time_t, std::pair<uintmax_t, std::string>> file_info_t;
-    std::vector<file_info_t> file_info;
-
-#if LL_WINDOWS
-    std::wstring cache_path(utf8str_to_utf16str(mCacheDir));
-#else
-    std::string cache_path(mCacheDir);
-#endif
-    if (boost::filesystem::is_directory(cache_path, ec) && !ec.failed())
+    // Pick the victims from the cold end of the LRU list while holding the
+    // lock but delete the files after releasing it so readers and writers
+    // on other threads are not held up by the filesystem.
+    std::vector<IndexEntry> victims;
+    uintmax_t file_size_total = 0;
     {
-        for (auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(cache_path, ec), {}))
+        LLMutexLock lock(&mIndexMutex);
+        while (mIndexTotalBytes > mMaxSizeBytes && !mIndexLRU.empty())
         {
-            if (boost::filesystem::is_regular_file(entry, ec) && !ec.failed())
-            {
-                if (entry.path().string().find(mCacheFilenamePrefix) != std::string::npos)
-                {
-                    uintmax_t file_size = boost::filesystem::file_size(entry, ec);
-                    if (ec.failed())
-                    {
-                        continue;
-                    }
-                    const std::string file_path = entry.path().string();
-                    const std::time_t file_time = boost::filesystem::last_write_time(entry, ec);
-                    if (ec.failed())
-                    {
-                        continue;
-                    }
-
-                    file_info.push_back(file_info_t(file_time, { file_size, file_path }));
-                }
-            }
+            victims.push_back(mIndexLRU.back());
+            eraseEntry(mIndexLRU.back().mKey, true);
         }
+        file_size_total = mIndexTotalBytes;
     }
 
-    std::sort(file_info.begin(), file_info.end(), [](file_info_t& x, file_info_t& y)
-    {
-        return x.first > y.first;
-    });
-
     LL_INFOS() << "Purging cache to a maximum of " << mMaxSizeBytes << " bytes" << LL_ENDL;
 
-    std::vector<bool> file_removed;
-    if (mEnableCacheDebugInfo)
-    {
-        file_removed.reserve(file_info.size());
-    }
-    uintmax_t file_size_total = 0;
-    for (file_info_t& entry : file_info)
+    for (const IndexEntry& entry : victims)
     {
-        file_size_total += entry.second.first;
-
-        bool should_remove = file_size_total > mMaxSizeBytes;
-        if (mEnableCacheDebugInfo)
+        if (mPackStore && mPackStore->remove(entry.mKey))
         {
-            file_removed.push_back(should_remove);
+            continue;
         }
-        if (should_remove)
+
+        const std::string file_path = mCacheDir + gDirUtilp->getDirDelimiter() + entry.mKey;
+#if LL_WINDOWS
+        boost::filesystem::remove(utf8str_to_utf16str(file_path), ec);
+#else
+        boost::filesystem::remove(file_path, ec);
+#endif
+        if (ec.failed())
         {
-            boost::filesystem::remove(entry.second.second, ec);
-            if (ec.failed())
+            LL_WARNS() << "Failed to delete cache file " << file_path << ": " << ec.message() << LL_ENDL;
+
+            // Most likely in use - put it back as the oldest entry so the
+            // next purge tries again rather than losing track of it
+            LLMutexLock lock(&mIndexMutex);
+            if (mIndexMap.find(entry.mKey) == mIndexMap.end())
             {
-                LL_WARNS() << "Failed to delete cache file " << entry.second.second << ": " << ec.message() << LL_ENDL;
+                mIndexLRU.push_back(entry);
+                mIndexMap[entry.mKey] = std::prev(mIndexLRU.end());
+                mIndexTotalBytes += entry.mSize;
+                append_index_record(mJournalPending, INDEX_OP_UPDATE, entry.mKey, entry.mSize, entry.mLastAccess);
             }
         }
     }
 
+    flushIndex();
+
+    if (mPackStore)
+    {
+        mPackStore->compact();
+    }
+
     if (mEnableCacheDebugInfo)
     {
         auto end_time = std::chrono::high_resolution_clock::now();
@@ -163,25 +272,21 @@ void LLDiskCache::purge()
 
         // Log afterward so it doesn't affect the time measurement
         // Logging thousands of file results can take hundreds of milliseconds
-        for (size_t i = 0; i < file_info.size(); ++i)
+        for (const IndexEntry& entry : victims)
         {
-            const file_info_t& entry = file_info[i];
-            const bool removed = file_removed[i];
-            const std::string action = removed ? "DELETE:" : "KEEP:";
-
             // have to do this because of LL_INFO/LL_END weirdness
             std::ostringstream line;
 
-            line << action << "  ";
-            line << entry.first << "  ";
-            line << entry.second.first << "  ";
-            line << entry.second.second;
+            line << "DELETE:  ";
+            line << entry.mLastAccess << "  ";
+            line << entry.mSize << "  ";
+            line << entry.mKey;
             line << " (" << file_size_total << "/" << mMaxSizeBytes << ")";
             LL_INFOS() << line.str() << LL_ENDL;
         }
 
         LL_INFOS() << "Total dir size after purge is " << dirFileSize(mCacheDir) << LL_ENDL;
-        LL_INFOS() << "Cache purge took " << execute_time << " ms to execute for " << file_info.size() << " files" << LL_ENDL;
+        LL_INFOS() << "Cache purge took " << execute_time << " ms to execute for " << victims.size() << " files" << LL_ENDL;
     }
 }
 
@@ -258,62 +363,327 @@ const std::string LLDiskCache::metaDataToFilepath(const std::string id,
 
 void LLDiskCache::updateFileAccessTime(const std::string file_path)
 {
-    /**
-     * Threshold in time_t units that is used to decide if the last access time
-     * time of the file is updated or not. Added as a precaution for the concern
-     * outlined in SL-14582  about frequent writes on older SSDs reducing their
-     * lifespan. I think this is the right place for the threshold value - rather
-     * than it being a pref - do comment on that Jira if you disagree...
-     *
-     * Let's start with 1 hour in time_t units and see how that unfolds
-     */
-    const std::time_t time_threshold = 1 * 60 * 60;
+    const std::string key = filepathToIndexKey(file_path);
 
     // current time
     const std::time_t cur_time = std::time(nullptr);
 
+    {
+        LLMutexLock lock(&mIndexMutex);
+        index_map_t::iterator iter = mIndexMap.find(key);
+        if (iter != mIndexMap.end())
+        {
+            // we only journal the new value if the time in ACCESS_TIME_THRESHOLD
+            // has elapsed since the last one
+            const IndexEntry& entry = *iter->second;
+            touchEntry(key, entry.mSize, cur_time, cur_time - entry.mLastAccess > ACCESS_TIME_THRESHOLD);
+            return;
+        }
+    }
+
+    // Not in the index - most likely written by another viewer instance
+    // sharing this cache. Adopt it if it really exists.
     boost::system::error_code ec;
 #if LL_WINDOWS
-    // file last write time
-    const std::time_t last_write_time = boost::filesystem::last_write_time(utf8str_to_utf16str(file_path), ec);
-    if (ec.failed())
+    const uintmax_t file_size = boost::filesystem::file_size(utf8str_to_utf16str(file_path), ec);
+#else
+    const uintmax_t file_size = boost::filesystem::file_size(file_path, ec);
+#endif
+    if (!ec.failed())
+    {
+        LLMutexLock lock(&mIndexMutex);
+        touchEntry(key, file_size, cur_time, true);
+    }
+}
+
+void LLDiskCache::updateFileSize(const std::string file_path, const uintmax_t file_size)
+{
+    const std::string key = filepathToIndexKey(file_path);
+
+    LLMutexLock lock(&mIndexMutex);
+    touchEntry(key, file_size, std::time(nullptr), true);
+}
+
+void LLDiskCache::removeFileEntry(const std::string file_path)
+{
+    const std::string key = filepathToIndexKey(file_path);
+
+    LLMutexLock lock(&mIndexMutex);
+    eraseEntry(key, true);
+}
+
+bool LLDiskCache::hasFileEntry(const std::string& file_path)
+{
+    const std::string key = filepathToIndexKey(file_path);
+
+    LLMutexLock lock(&mIndexMutex);
+    return mIndexMap.find(key) != mIndexMap.end();
+}
+
+void LLDiskCache::renameFileEntry(const std::string old_file_path, const std::string new_file_path)
+{
+    const std::string old_key = filepathToIndexKey(old_file_path);
+    const std::string new_key = filepathToIndexKey(new_file_path);
+
+    LLMutexLock lock(&mIndexMutex);
+    index_map_t::iterator iter = mIndexMap.find(old_key);
+    if (iter != mIndexMap.end())
+    {
+        const uintmax_t file_size = iter->second->mSize;
+        eraseEntry(old_key, true);
+        touchEntry(new_key, file_size, std::time(nullptr), true);
+    }
+}
+
+const std::string LLDiskCache::filepathToIndexKey(const std::string& file_path)
+{
+    return gDirUtilp->getBaseFileName(file_path);
+}
+
+void LLDiskCache::touchEntry(const std::string& key, const uintmax_t file_size, const std::time_t access_time, bool journal)
+{
+    index_map_t::iterator iter = mIndexMap.find(key);
+    if (iter == mIndexMap.end())
+    {
+        mIndexLRU.push_front({ key, 0, access_time });
+        iter = mIndexMap.emplace(key, mIndexLRU.begin()).first;
+    }
+    else
+    {
+        mIndexLRU.splice(mIndexLRU.begin(), mIndexLRU, iter->second);
+    }
+
+    IndexEntry& entry = *iter->second;
+    mIndexTotalBytes -= entry.mSize;
+    mIndexTotalBytes += file_size;
+    entry.mSize = file_size;
+    entry.mLastAccess = access_time;
+
+    if (journal)
+    {
+        append_index_record(mJournalPending, INDEX_OP_UPDATE, key, file_size, access_time);
+    }
+}
+
+void LLDiskCache::eraseEntry(const std::string& key, bool journal)
+{
+    index_map_t::iterator iter = mIndexMap.find(key);
+    if (iter == mIndexMap.end())
     {
-        LL_WARNS() << "Failed to read last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
         return;
     }
 
-    // delta between cur time and last time the file was written
-    const std::time_t delta_time = cur_time - last_write_time;
+    mIndexTotalBytes -= iter->second->mSize;
+    mIndexLRU.erase(iter->second);
+    mIndexMap.erase(iter);
 
-    // we only write the new value if the time in time_threshold has elapsed
-    // before the last one
-    if (delta_time > time_threshold)
+    if (journal)
     {
-        boost::filesystem::last_write_time(utf8str_to_utf16str(file_path), cur_time, ec);
+        append_index_record(mJournalPending, INDEX_OP_REMOVE, key, 0, 0);
     }
-#else
-    // file last write time
-    const std::time_t last_write_time = boost::filesystem::last_write_time(file_path, ec);
-    if (ec.failed())
+}
+
+void LLDiskCache::loadIndex()
+{
+    const std::string snapshot_path = mCacheDir + gDirUtilp->getDirDelimiter() + INDEX_SNAPSHOT_NAME;
+    const std::string journal_path = mCacheDir + gDirUtilp->getDirDelimiter() + INDEX_JOURNAL_NAME;
+
+    std::string snapshot;
+    if (!read_whole_file(snapshot_path, snapshot) ||
+        snapshot.compare(0, INDEX_MAGIC_LEN, INDEX_MAGIC) != 0)
     {
-        LL_WARNS() << "Failed to read last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
+        LL_INFOS() << "Disk cache index missing or invalid, rebuilding it" << LL_ENDL;
+        rebuildIndex();
         return;
     }
 
-    // delta between cur time and last time the file was written
-    const std::time_t delta_time = cur_time - last_write_time;
+    LLMutexLock lock(&mIndexMutex);
+
+    auto replay = [this](const std::string& data)
+    {
+        size_t pos = INDEX_MAGIC_LEN;
+        U8 op;
+        std::string key;
+        U64 size;
+        S64 access_time;
+        while (read_index_record(data, pos, op, key, size, access_time))
+        {
+            if (op == INDEX_OP_UPDATE)
+            {
+                touchEntry(key, size, (std::time_t)access_time, false);
+            }
+            else if (op == INDEX_OP_REMOVE)
+            {
+                eraseEntry(key, false);
+            }
+        }
+        return pos;
+    };
+
+    replay(snapshot);
 
-    // we only write the new value if the time in time_threshold has elapsed
-    // before the last one
-    if (delta_time > time_threshold)
+    std::string journal;
+    if (read_whole_file(journal_path, journal))
     {
-        boost::filesystem::last_write_time(file_path, cur_time, ec);
+        if (journal.compare(0, INDEX_MAGIC_LEN, INDEX_MAGIC) == 0)
+        {
+            // A short count means a torn record at the end - anything after
+            // it is unusable, so force a compaction on the next flush
+            size_t used = replay(journal);
+            mJournalFileBytes = (used == journal.size()) ? journal.size() : INDEX_JOURNAL_COMPACT_BYTES;
+        }
+        else
+        {
+            mJournalFileBytes = INDEX_JOURNAL_COMPACT_BYTES;
+        }
     }
+
+    // Records are not in access order on disk so restore the LRU order once
+    mIndexLRU.sort([](const IndexEntry& a, const IndexEntry& b)
+    {
+        return a.mLastAccess > b.mLastAccess;
+    });
+
+    LL_INFOS() << "Loaded disk cache index with " << mIndexMap.size() << " entries totalling "
+               << mIndexTotalBytes << " bytes" << LL_ENDL;
+}
+
+void LLDiskCache::rebuildIndex()
+{
+    typedef std::pair<std::time_t, std::pair<uintmax_t, std::string>> file_info_t;
+    std::vector<file_info_t> file_info;
+
+    boost::system::error_code ec;
+#if LL_WINDOWS
+    std::wstring cache_path(utf8str_to_utf16str(mCacheDir));
+#else
+    std::string cache_path(mCacheDir);
 #endif
+    if (boost::filesystem::is_directory(cache_path, ec) && !ec.failed())
+    {
+        for (auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(cache_path, ec), {}))
+        {
+            if (boost::filesystem::is_regular_file(entry, ec) && !ec.failed())
+            {
+                const std::string file_name = entry.path().filename().string();
+                if (file_name.find(mCacheFilenamePrefix) == 0)
+                {
+                    uintmax_t file_size = boost::filesystem::file_size(entry, ec);
+                    if (ec.failed())
+                    {
+                        continue;
+                    }
+                    const std::time_t file_time = boost::filesystem::last_write_time(entry, ec);
+                    if (ec.failed())
+                    {
+                        continue;
+                    }
+
+                    file_info.push_back(file_info_t(file_time, { file_size, file_name }));
+                }
+            }
+        }
+    }
 
-    if (ec.failed())
+    // packed assets have no timestamp of their own so treat them as new
+    if (mPackStore)
     {
-        LL_WARNS() << "Failed to update last write time for cache file " << file_path << ": " << ec.message() << LL_ENDL;
+        const std::time_t cur_time = std::time(nullptr);
+        std::vector<std::pair<std::string, U32> > packed;
+        mPackStore->getEntries(packed);
+        for (const std::pair<std::string, U32>& entry : packed)
+        {
+            file_info.push_back(file_info_t(cur_time, { entry.second, entry.first }));
+        }
+    }
+
+    // oldest first so that the newest ends up at the front of the LRU list
+    std::sort(file_info.begin(), file_info.end(), [](file_info_t& x, file_info_t& y)
+    {
+        return x.first < y.first;
+    });
+
+    {
+        LLMutexLock file_lock(&mIndexFileMutex);
+        LLMutexLock lock(&mIndexMutex);
+        mIndexLRU.clear();
+        mIndexMap.clear();
+        mIndexTotalBytes = 0;
+        mJournalPending.clear();
+        for (const file_info_t& entry : file_info)
+        {
+            touchEntry(entry.second.second, entry.second.first, entry.first, false);
+        }
+
+        // nothing on disk matches what we have now so write a full snapshot
+        mJournalFileBytes = INDEX_JOURNAL_COMPACT_BYTES;
+    }
+
+    flushIndex();
+
+    LL_INFOS() << "Rebuilt disk cache index with " << file_info.size() << " entries" << LL_ENDL;
+}
+
+void LLDiskCache::flushIndex()
+{
+    LLMutexLock file_lock(&mIndexFileMutex);
+
+    const std::string snapshot_path = mCacheDir + gDirUtilp->getDirDelimiter() + INDEX_SNAPSHOT_NAME;
+    const std::string journal_path = mCacheDir + gDirUtilp->getDirDelimiter() + INDEX_JOURNAL_NAME;
+
+    std::string pending;
+    std::string snapshot;
+    {
+        LLMutexLock lock(&mIndexMutex);
+        if (mJournalFileBytes + mJournalPending.size() < INDEX_JOURNAL_COMPACT_BYTES)
+        {
+            pending.swap(mJournalPending);
+        }
+        else
+        {
+            // Serialize oldest first so a replay rebuilds the same LRU order
+            // without needing the sort in loadIndex()
+            snapshot.reserve(INDEX_MAGIC_LEN + mIndexMap.size() * 64);
+            snapshot.append(INDEX_MAGIC, INDEX_MAGIC_LEN);
+            for (index_lru_t::reverse_iterator iter = mIndexLRU.rbegin(); iter != mIndexLRU.rend(); ++iter)
+            {
+                append_index_record(snapshot, INDEX_OP_UPDATE, iter->mKey, iter->mSize, iter->mLastAccess);
+            }
+            mJournalPending.clear();
+        }
+    }
+
+    if (!snapshot.empty())
+    {
+        // Write the new snapshot to the side first so a crash part way
+        // through leaves the previous snapshot and journal intact
+        const std::string temp_path = snapshot_path + ".tmp";
+        if (write_whole_file(temp_path, "wb", snapshot))
+        {
+            LLFile::remove(snapshot_path, ENOENT);
+            LLFile::rename(temp_path, snapshot_path);
+            write_whole_file(journal_path, "wb", std::string(INDEX_MAGIC, INDEX_MAGIC_LEN));
+            mJournalFileBytes = INDEX_MAGIC_LEN;
+        }
+        else
+        {
+            LL_WARNS() << "Failed to write disk cache index " << temp_path << LL_ENDL;
+        }
+    }
+    else if (!pending.empty())
+    {
+        if (mJournalFileBytes == 0)
+        {
+            pending.insert(0, INDEX_MAGIC, INDEX_MAGIC_LEN);
+        }
+        if (write_whole_file(journal_path, "ab", pending))
+        {
+            mJournalFileBytes += pending.size();
+        }
+        else
+        {
+            LL_WARNS() << "Failed to append to disk cache journal " << journal_path << LL_ENDL;
+        }
     }
 }
 
@@ -321,8 +691,14 @@ const std::string LLDiskCache::getCacheInfo()
 {
     std::ostringstream cache_info;
 
+    uintmax_t total_bytes = 0;
+    {
+        LLMutexLock lock(&mIndexMutex);
+        total_bytes = mIndexTotalBytes;
+    }
+
     F32 max_in_mb = (F32)mMaxSizeBytes / (1024.0 * 1024.0);
-    F32 percent_used = ((F32)dirFileSize(mCacheDir) / (F32)mMaxSizeBytes) * 100.0;
+    F32 percent_used = ((F32)total_bytes / (F32)mMaxSizeBytes) * 100.0;
 
     cache_info << std::fixed;
     cache_info << std::setprecision(1);
@@ -363,6 +739,14 @@ void LLDiskCache::clearCache()
             }
         }
     }
+
+    if (mPackStore)
+    {
+        mPackStore->clear();
+    }
+
+    // Start again from what is actually left behind
+    rebuildIndex();
 }
 
 void LLDiskCache::removeOldVFSFiles()
@@ -22,15 +22,22 @@
                     that identifies the type of asset being stored.
         .asset      A file extension of .asset is used to help
                     identify this as a Viewer asset file
- * 2/ The time of last access for a file can be updated instantly
- *    for file reads and automatically as part of the file writes.
- * 3/ The purge algorithm collects a list of all files in the
- *    directory, sorts them by date of last access (write) and then
- *    deletes any files based on age until the total size of all
- *    the files is less than the maximum size specified.
- * 4/ An LLSingleton idiom is used since there will only ever be
+ * 2/ The size and time of last access of every file is kept in an
+ *    index held in memory and persisted alongside the cache files as
+ *    a snapshot plus an append-only journal of changes. Reads update
+ *    the index only and never touch the metadata of the file itself.
+ * 3/ The index keeps its entries in least recently used order along
+ *    with a running total of their sizes, so the purge algorithm just
+ *    evicts entries from the cold end until the total size of all
+ *    the files is less than the maximum size specified. A full scan
+ *    of the directory is only needed to rebuild a missing or damaged
+ *    index.
+ * 4/ Optionally, small assets are appended to a few large segment files
+ *    instead of getting a file each - see lldiskcachepack.h. They use
+ *    the same index keys so they are purged the same way.
+ * 5/ An LLSingleton idiom is used since there will only ever be
  *    a single cache and we want to access it from numerous places.
- * 5/ Performance on my modest system seems very acceptable. For
+ * 6/ Performance on my modest system seems very acceptable. For
  *    example, in testing, I was able to purge a directory of
  *    10,000 files, deleting about half of them in ~ 1700ms. For
  *    the same sized directory of files, writing the last updated
@@ -63,6 +70,11 @@
 #define _LLDISKCACHE
 
 #include "llsingleton.h"
+#include "llmutex.h"
+#include "lldiskcachepack.h"
+
+#include <list>
+#include <unordered_map>
 
 class LLDiskCache :
     public LLParamSingleton<LLDiskCache>
@@ -92,9 +104,15 @@ class LLDiskCache :
                      * if there are bugs, we can ask uses to enable this
                      * setting and send us their logs
                      */
-                    const bool enable_cache_debug_info);
+                    const bool enable_cache_debug_info,
+                    /**
+                     * Store small assets packed into segment files rather
+                     * than one file each. Defined by the setting at
+                     * 'DiskCachePackSmallAssets'
+                     */
+                    const bool enable_pack_store);
 
-        virtual ~LLDiskCache() = default;
+        virtual ~LLDiskCache();
 
     public:
         /**
@@ -116,18 +134,46 @@ class LLDiskCache :
         void updateFileAccessTime(const std::string file_path);
 
         /**
-         * Purge the oldest items in the cache so that the combined size of all files
-         * is no bigger than mMaxSizeBytes.
+         * Record the new size of a file in the cache after it was written and
+         * mark it as the most recently used entry. Must be called after every
+         * successful write so that the index keeps an accurate total size.
+         */
+        void updateFileSize(const std::string file_path, const uintmax_t file_size);
+
+        /**
+         * Drop the index entry for a file that was removed from the cache
+         */
+        void removeFileEntry(const std::string file_path);
+
+        /**
+         * True if the index has an entry for the file, packed or loose
+         */
+        bool hasFileEntry(const std::string& file_path);
+
+        /**
+         * Move the index entry for a file that was renamed within the cache
+         */
+        void renameFileEntry(const std::string old_file_path, const std::string new_file_path);
+
+        /**
+         * Purge the least recently used items in the cache so that the combined
+         * size of all files is no bigger than mMaxSizeBytes.
          *
          * WARNING: purge() is called by LLPurgeDiskCacheThread. As such it must
-         * NOT touch any LLDiskCache data without introducing and locking a mutex!
+         * NOT touch any LLDiskCache data without locking mIndexMutex!
          *
-         * Purging the disk cache involves nontrivial work on the viewer's
-         * filesystem. If called on the main thread, this causes a noticeable
-         * freeze.
+         * Since the index tracks the total size, this only does work in
+         * proportion to the number of files it actually deletes.
          */
         void purge();
 
+        /**
+         * Write any pending index changes to the journal on disk, folding the
+         * journal into a fresh snapshot once it has grown large enough.
+         * Called from purge() and on shutdown.
+         */
+        void flushIndex();
+
         /**
          * Clear the cache by removing all the files in the specified cache
          * directory individually. Only the files that contain a prefix defined
@@ -142,6 +188,19 @@ class LLDiskCache :
 
         void removeOldVFSFiles();
 
+        /**
+         * The packed store for small assets, or nullptr if LLFileSystem
+         * should only use loose files
+         */
+        LLDiskCachePack* getPackStore() { return mPackStore.get(); }
+
+        /**
+         * Key used for a file in the index and the pack store - the filename
+         * without the cache directory so the index survives the cache being
+         * moved
+         */
+        const std::string filepathToIndexKey(const std::string& file_path);
+
     private:
         /**
          * Utility function to gather the total size the files in a given
@@ -156,7 +215,72 @@ class LLDiskCache :
          */
         const std::string assetTypeToString(LLAssetType::EType at);
 
+        /**
+         * Load the index snapshot and replay the journal on top of it. If
+         * either is missing or damaged, falls back to rebuildIndex()
+         */
+        void loadIndex();
+
+        /**
+         * Rebuild the index from a full scan of the cache directory using
+         * the last write time of each file as its last access time. This is
+         * the only place that walks the directory in normal operation.
+         */
+        void rebuildIndex();
+
+        /**
+         * Set the size and access time of an entry and move it to the front
+         * of the LRU list, creating it if needed. mIndexMutex must be held.
+         */
+        void touchEntry(const std::string& key, const uintmax_t file_size, const std::time_t access_time, bool journal);
+
+        /**
+         * Remove an entry from the index. mIndexMutex must be held.
+         */
+        void eraseEntry(const std::string& key, bool journal);
+
     private:
+        /**
+         * An entry in the index. The list is kept in order of last access
+         * with the most recently used file at the front.
+         */
+        struct IndexEntry
+        {
+            std::string mKey;
+            uintmax_t   mSize;
+            std::time_t mLastAccess;
+        };
+        typedef std::list<IndexEntry> index_lru_t;
+        typedef std::unordered_map<std::string, index_lru_t::iterator> index_map_t;
+
+        index_lru_t mIndexLRU;
+        index_map_t mIndexMap;
+
+        /**
+         * Running total of the sizes of all the files in the index
+         */
+        uintmax_t mIndexTotalBytes;
+
+        /**
+         * Journal records that have not been written to disk yet and the
+         * size of the journal file on disk
+         */
+        std::string mJournalPending;
+        size_t mJournalFileBytes;
+
+        /**
+         * Guards the index since it is updated by any thread that reads or
+         * writes cache files and purged by LLPurgeDiskCacheThread
+         */
+        LLMutex mIndexMutex;
+
+        /**
+         * Serializes flushIndex() so the journal and snapshot files are only
+         * ever rewritten by one thread at a time. Always taken before
+         * mIndexMutex, never while holding it.
+         */
+        LLMutex mIndexFileMutex;
+
         /**
          * The maximum size of the cache in bytes. After purge is called, the
          * total size of the cache files in the cache directory will be
@@ -187,6 +311,11 @@ class LLDiskCache :
          * various parts of the code
          */
         bool mEnableCacheDebugInfo;
+
+        /**
+         * Segment file storage for small assets, see lldiskcachepack.h
+         */
+        std::unique_ptr<LLDiskCachePack> mPackStore;
 };
 
 class LLPurgeDiskCacheThread : public LLThread
@@ -0,0 +1,528 @@
+/**
+ * @file lldiskcachepack.cpp
+ * @brief Packed storage of small disk cache assets in segment files.
+ *
+ * See the notes in the header for how this is supposed to work.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lldir.h"
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include "lldiskcachepack.h"
+
+const S32 LLDiskCachePack::MAX_PACKED_ASSET_BYTES = 64 * 1024;
+const U32 LLDiskCachePack::MAX_SEGMENT_BYTES = 64 * 1024 * 1024;
+
+namespace
+{
+    const char SEGMENT_MAGIC[] = "LLDCPAK1";
+    const U32 SEGMENT_MAGIC_LEN = sizeof(SEGMENT_MAGIC) - 1;
+    const char SEGMENT_PREFIX[] = "segment_";
+    const char SEGMENT_EXTENSION[] = ".pack";
+
+    const U32 RECORD_MAGIC = 0x4b50434c; // "LCPK"
+    const U8 RECORD_FLAG_TOMBSTONE = 0x01;
+
+    // Written in native byte order: the cache is never shared between machines
+    struct RecordHeader
+    {
+        U32 mMagic;
+        U16 mKeyLength;
+        U8  mFlags;
+        U8  mPad;
+        U32 mDataLength;
+    };
+
+#if LL_WINDOWS
+    boost::filesystem::path native_path(const std::string& path)
+    {
+        return boost::filesystem::path(utf8str_to_utf16str(path));
+    }
+#else
+    boost::filesystem::path native_path(const std::string& path)
+    {
+        return boost::filesystem::path(path);
+    }
+#endif
+}
+
+LLDiskCachePack::LLDiskCachePack(const std::string& pack_dir, U32 segment_bytes) :
+    mPackDir(pack_dir),
+    mSegmentBytes(segment_bytes),
+    mActiveSegment(0)
+{
+    LLFile::mkdir(mPackDir);
+
+    loadSegments();
+}
+
+LLDiskCachePack::~LLDiskCachePack()
+{
+    closeSegments();
+}
+
+std::string LLDiskCachePack::getSegmentPath(U32 segment) const
+{
+    return llformat("%s%s%s%08u%s", mPackDir.c_str(), gDirUtilp->getDirDelimiter().c_str(),
+                    SEGMENT_PREFIX, segment, SEGMENT_EXTENSION);
+}
+
+void LLDiskCachePack::loadSegments()
+{
+    LLMutexLock lock(&mMutex);
+
+    boost::system::error_code ec;
+    boost::filesystem::path pack_path(native_path(mPackDir));
+    if (boost::filesystem::is_directory(pack_path, ec) && !ec.failed())
+    {
+        for (auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(pack_path, ec), {}))
+        {
+            const std::string file_name = entry.path().filename().string();
+            U32 segment = 0;
+            if (file_name.find(SEGMENT_PREFIX) == 0 &&
+                sscanf(file_name.c_str() + strlen(SEGMENT_PREFIX), "%u", &segment) == 1 &&
+                segment > 0)
+            {
+                mSegments[segment] = { nullptr, 0, 0 };
+            }
+        }
+    }
+
+    // Oldest first so that newer records replace older ones in the index
+    for (segment_map_t::iterator iter = mSegments.begin(); iter != mSegments.end(); )
+    {
+        scanSegment(iter->first, iter->second);
+        if (!iter->second.mFile)
+        {
+            iter = mSegments.erase(iter);
+        }
+        else
+        {
+            mActiveSegment = iter->first;
+            ++iter;
+        }
+    }
+
+    LL_INFOS() << "Loaded " << mLocations.size() << " packed assets from "
+               << mSegments.size() << " segments in " << mPackDir << LL_ENDL;
+}
+
+void LLDiskCachePack::scanSegment(U32 segment, Segment& seg)
+{
+    const std::string path = getSegmentPath(segment);
+    seg.mFile = LLFile::fopen(path, "r+b");
+    if (!seg.mFile)
+    {
+        LL_WARNS() << "Unable to open cache pack segment " << path << LL_ENDL;
+        return;
+    }
+
+    fseek(seg.mFile, 0, SEEK_END);
+    const long file_size = ftell(seg.mFile);
+    fseek(seg.mFile, 0, SEEK_SET);
+
+    char magic[SEGMENT_MAGIC_LEN];
+    if (file_size < (long)SEGMENT_MAGIC_LEN ||
+        fread(magic, 1, SEGMENT_MAGIC_LEN, seg.mFile) != SEGMENT_MAGIC_LEN ||
+        memcmp(magic, SEGMENT_MAGIC, SEGMENT_MAGIC_LEN) != 0)
+    {
+        LL_WARNS() << "Discarding invalid cache pack segment " << path << LL_ENDL;
+        LLFile::close(seg.mFile);
+        seg.mFile = nullptr;
+        LLFile::remove(path);
+        return;
+    }
+
+    U32 offset = SEGMENT_MAGIC_LEN;
+    std::string key;
+    RecordHeader header;
+    while (fread(&header, sizeof(header), 1, seg.mFile) == 1)
+    {
+        const U32 record_bytes = sizeof(header) + header.mKeyLength + header.mDataLength;
+        if (header.mMagic != RECORD_MAGIC ||
+            header.mDataLength > (U32)MAX_PACKED_ASSET_BYTES ||
+            (long)offset + (long)record_bytes > file_size)
+        {
+            break;
+        }
+
+        key.resize(header.mKeyLength);
+        if (header.mKeyLength && fread(&key[0], 1, header.mKeyLength, seg.mFile) != header.mKeyLength)
+        {
+            break;
+        }
+        fseek(seg.mFile, header.mDataLength, SEEK_CUR);
+
+        location_map_t::iterator iter = mLocations.find(key);
+        if (iter != mLocations.end())
+        {
+            dropLocation(iter);
+        }
+        if (!(header.mFlags & RECORD_FLAG_TOMBSTONE))
+        {
+            mLocations[key] = { segment, (U32)(offset + sizeof(header) + header.mKeyLength), header.mDataLength, record_bytes };
+            seg.mLiveBytes += record_bytes;
+        }
+        offset += record_bytes;
+    }
+
+    seg.mTotalBytes = offset;
+
+    if ((long)offset < file_size)
+    {
+        // Torn write at the end from a crash - anything past it is lost
+        LL_WARNS() << "Truncating cache pack segment " << path << " from " << file_size
+                   << " to " << offset << " bytes" << LL_ENDL;
+        LLFile::close(seg.mFile);
+        boost::system::error_code ec;
+        boost::filesystem::resize_file(native_path(path), offset, ec);
+        seg.mFile = LLFile::fopen(path, "r+b");
+    }
+}
+
+bool LLDiskCachePack::openActiveSegment()
+{
+    segment_map_t::iterator iter = mSegments.find(mActiveSegment);
+    if (iter != mSegments.end() && iter->second.mFile && iter->second.mTotalBytes < mSegmentBytes)
+    {
+        return true;
+    }
+
+    const U32 segment = mActiveSegment + 1;
+    const std::string path = getSegmentPath(segment);
+    LLFILE* fp = LLFile::fopen(path, "w+b");
+    if (!fp)
+    {
+        LL_WARNS() << "Unable to create cache pack segment " << path << LL_ENDL;
+        return false;
+    }
+    if (fwrite(SEGMENT_MAGIC, 1, SEGMENT_MAGIC_LEN, fp) != SEGMENT_MAGIC_LEN)
+    {
+        LLFile::close(fp);
+        LLFile::remove(path);
+        return false;
+    }
+    fflush(fp);
+
+    mSegments[segment] = { fp, SEGMENT_MAGIC_LEN, 0 };
+    mActiveSegment = segment;
+    return true;
+}
+
+bool LLDiskCachePack::appendRecord(const std::string& key, const U8* data, U32 size, bool tombstone, Location& location)
+{
+    if (!openActiveSegment())
+    {
+        return false;
+    }
+
+    Segment& seg = mSegments[mActiveSegment];
+
+    RecordHeader header;
+    header.mMagic = RECORD_MAGIC;
+    header.mKeyLength = (U16)key.size();
+    header.mFlags = tombstone ? RECORD_FLAG_TOMBSTONE : 0;
+    header.mPad = 0;
+    header.mDataLength = tombstone ? 0 : size;
+
+    const U32 record_bytes = sizeof(header) + header.mKeyLength + header.mDataLength;
+
+    fseek(seg.mFile, seg.mTotalBytes, SEEK_SET);
+    bool success = fwrite(&header, sizeof(header), 1, seg.mFile) == 1 &&
+                   fwrite(key.data(), 1, key.size(), seg.mFile) == key.size() &&
+                   (header.mDataLength == 0 || fwrite(data, 1, header.mDataLength, seg.mFile) == header.mDataLength);
+    fflush(seg.mFile);
+
+    if (!success)
+    {
+        // Leave mTotalBytes alone so the partial record is overwritten by
+        // the next one, or truncated by the scan at the next startup
+        LL_WARNS() << "Failed to write to cache pack segment " << getSegmentPath(mActiveSegment) << LL_ENDL;
+        return false;
+    }
+
+    location = { mActiveSegment, (U32)(seg.mTotalBytes + sizeof(header) + header.mKeyLength), header.mDataLength, record_bytes };
+    seg.mTotalBytes += record_bytes;
+    return true;
+}
+
+bool LLDiskCachePack::readRecord(const Location& location, U32 offset, U8* buffer, U32 bytes)
+{
+    segment_map_t::iterator iter = mSegments.find(location.mSegment);
+    if (iter == mSegments.end() || !iter->second.mFile)
+    {
+        return false;
+    }
+
+    fseek(iter->second.mFile, location.mOffset + offset, SEEK_SET);
+    return fread(buffer, 1, bytes, iter->second.mFile) == bytes;
+}
+
+void LLDiskCachePack::dropLocation(location_map_t::iterator iter)
+{
+    segment_map_t::iterator seg = mSegments.find(iter->second.mSegment);
+    if (seg != mSegments.end())
+    {
+        seg->second.mLiveBytes -= llmin(seg->second.mLiveBytes, iter->second.mRecordBytes);
+    }
+    mLocations.erase(iter);
+}
+
+S32 LLDiskCachePack::getSize(const std::string& key)
+{
+    LLMutexLock lock(&mMutex);
+
+    location_map_t::const_iterator iter = mLocations.find(key);
+    return (iter != mLocations.end()) ? (S32)iter->second.mSize : -1;
+}
+
+S32 LLDiskCachePack::read(const std::string& key, S32 offset, U8* buffer, S32 bytes)
+{
+    LLMutexLock lock(&mMutex);
+
+    location_map_t::const_iterator iter = mLocations.find(key);
+    if (iter == mLocations.end())
+    {
+        return -1;
+    }
+
+    const S32 size = (S32)iter->second.mSize;
+    if (offset < 0 || offset >= size || bytes <= 0)
+    {
+        return 0;
+    }
+
+    const S32 to_read = llmin(bytes, size - offset);
+    return readRecord(iter->second, offset, buffer, to_read) ? to_read : 0;
+}
+
+bool LLDiskCachePack::readAll(const std::string& key, std::vector<U8>& data)
+{
+    LLMutexLock lock(&mMutex);
+
+    location_map_t::const_iterator iter = mLocations.find(key);
+    if (iter == mLocations.end())
+    {
+        return false;
+    }
+
+    data.resize(iter->second.mSize);
+    return data.empty() || readRecord(iter->second, 0, &data[0], iter->second.mSize);
+}
+
+bool LLDiskCachePack::write(const std::string& key, const U8* data, S32 size)
+{
+    if (size < 0 || !isPackable(size))
+    {
+        return false;
+    }
+
+    LLMutexLock lock(&mMutex);
+
+    Location location;
+    if (!appendRecord(key, data, size, false, location))
+    {
+        return false;
+    }
+
+    location_map_t::iterator iter = mLocations.find(key);
+    if (iter != mLocations.end())
+    {
+        dropLocation(iter);
+    }
+    mLocations[key] = location;
+    mSegments[location.mSegment].mLiveBytes += location.mRecordBytes;
+    return true;
+}
+
+bool LLDiskCachePack::remove(const std::string& key)
+{
+    LLMutexLock lock(&mMutex);
+
+    location_map_t::iterator iter = mLocations.find(key);
+    if (iter == mLocations.end())
+    {
+        return false;
+    }
+
+    Location tombstone;
+    appendRecord(key, nullptr, 0, true, tombstone);
+    dropLocation(iter);
+    return true;
+}
+
+bool LLDiskCachePack::rename(const std::string& old_key, const std::string& new_key)
+{
+    LLMutexLock lock(&mMutex);
+
+    location_map_t::iterator iter = mLocations.find(old_key);
+    if (iter == mLocations.end())
+    {
+        return false;
+    }
+    if (old_key == new_key)
+    {
+        // Nothing to move, and the tombstone below would drop the asset
+        return true;
+    }
+
+    std::vector<U8> data(iter->second.mSize);
+    Location location;
+    if ((!data.empty() && !readRecord(iter->second, 0, &data[0], iter->second.mSize)) ||
+        !appendRecord(new_key, data.empty() ? nullptr : &data[0], data.size(), false, location))
+    {
+        return false;
+    }
+
+    location_map_t::iterator existing = mLocations.find(new_key);
+    if (existing != mLocations.end())
+    {
+        dropLocation(existing);
+    }
+    mLocations[new_key] = location;
+    mSegments[location.mSegment].mLiveBytes += location.mRecordBytes;
+
+    Location tombstone;
+    appendRecord(old_key, nullptr, 0, true, tombstone);
+    dropLocation(mLocations.find(old_key));
+    return true;
+}
+
+void LLDiskCachePack::compact()
+{
+    U32 segment = 0;
+    std::vector<std::string> keys;
+    {
+        LLMutexLock lock(&mMutex);
+
+        U64 total_bytes = 0;
+        U64 live_bytes = 0;
+        for (const segment_map_t::value_type& seg : mSegments)
+        {
+            if (seg.first != mActiveSegment)
+            {
+                total_bytes += seg.second.mTotalBytes;
+                live_bytes += seg.second.mLiveBytes;
+            }
+        }
+
+        // Only the oldest segment is ever compacted: see the header
+        if (total_bytes == 0 || live_bytes * 2 > total_bytes)
+        {
+            return;
+        }
+        segment = mSegments.begin()->first;
+
+        for (const location_map_t::value_type& entry : mLocations)
+        {
+            if (entry.second.mSegment == segment)
+            {
+                keys.push_back(entry.first);
+            }
+        }
+    }
+
+    // Move one record at a time so readers and writers on other threads
+    // only ever wait for a single small copy
+    std::vector<U8> data;
+    for (const std::string& key : keys)
+    {
+        LLMutexLock lock(&mMutex);
+
+        location_map_t::iterator iter = mLocations.find(key);
+        if (iter == mLocations.end() || iter->second.mSegment != segment)
+        {
+            continue;
+        }
+
+        data.resize(iter->second.mSize);
+        Location location;
+        if ((!data.empty() && !readRecord(iter->second, 0, &data[0], iter->second.mSize)) ||
+            !appendRecord(key, data.empty() ? nullptr : &data[0], data.size(), false, location))
+        {
+            // Try again next time rather than risk losing the asset
+            return;
+        }
+        dropLocation(iter);
+        mLocations[key] = location;
+        mSegments[location.mSegment].mLiveBytes += location.mRecordBytes;
+    }
+
+    LLMutexLock lock(&mMutex);
+    segment_map_t::iterator iter = mSegments.find(segment);
+    if (iter != mSegments.end() && iter->second.mLiveBytes == 0)
+    {
+        LL_DEBUGS() << "Compacted cache pack segment " << segment << LL_ENDL;
+        if (iter->second.mFile)
+        {
+            LLFile::close(iter->second.mFile);
+        }
+        LLFile::remove(getSegmentPath(segment));
+        mSegments.erase(iter);
+    }
+}
+
+void LLDiskCachePack::clear()
+{
+    LLMutexLock lock(&mMutex);
+
+    for (const segment_map_t::value_type& seg : mSegments)
+    {
+        if (seg.second.mFile)
+        {
+            LLFile::close(seg.second.mFile);
+        }
+        LLFile::remove(getSegmentPath(seg.first));
+    }
+    mSegments.clear();
+    mLocations.clear();
+    mActiveSegment = 0;
+}
+
+void LLDiskCachePack::getEntries(std::vector<std::pair<std::string, U32> >& entries)
+{
+    LLMutexLock lock(&mMutex);
+
+    entries.reserve(entries.size() + mLocations.size());
+    for (const location_map_t::value_type& entry : mLocations)
+    {
+        entries.push_back(std::make_pair(entry.first, entry.second.mSize));
+    }
+}
+
+void LLDiskCachePack::closeSegments()
+{
+    LLMutexLock lock(&mMutex);
+
+    for (segment_map_t::value_type& seg : mSegments)
+    {
+        if (seg.second.mFile)
+        {
+            LLFile::close(seg.second.mFile);
+            seg.second.mFile = nullptr;
+        }
+    }
+}
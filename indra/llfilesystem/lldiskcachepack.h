@@ -0,0 +1,168 @@
+/**
+ * @file lldiskcachepack.h
+ * @brief Packed storage of small disk cache assets in segment files.
+ *
+ * @Description:
+ * Caches full of tiny assets (sounds, gestures, notecards, mesh headers)
+ * end up as huge numbers of small files, each costing an inode, the block
+ * slack at the end of it and an open/read/close every time it is used.
+ * This stores those assets as records appended to a small number of large
+ * segment files instead:
+ * 1/ Every record is self describing - a header with the key and size of
+ *    the asset followed by its data. Removing an asset appends a tombstone
+ *    record. The newest record for a key always wins, so the in-memory
+ *    index of where each asset lives can be rebuilt at startup by reading
+ *    just the record headers of each segment in order.
+ * 2/ Records are never updated in place. Writing an asset again appends a
+ *    new copy and leaves the old one as garbage in its segment.
+ * 3/ Once garbage makes up more than half of the closed segments, the
+ *    oldest segment has its live records copied forward into the active
+ *    segment and is then deleted. Compacting oldest first means dropping
+ *    its tombstones can never bring an older copy of an asset back.
+ *
+ * Keys are the same leaf filenames LLDiskCache uses for loose files so
+ * that packed assets take part in the cache LRU index and purge.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLDISKCACHEPACK_H
+#define LL_LLDISKCACHEPACK_H
+
+#include "llmutex.h"
+#include "llfile.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class LLDiskCachePack
+{
+    public:
+        /**
+         * Assets larger than this are always stored as loose files
+         */
+        static const S32 MAX_PACKED_ASSET_BYTES;
+
+        /**
+         * A new segment is started once the active one grows past this
+         */
+        static const U32 MAX_SEGMENT_BYTES;
+
+        /**
+         * Opens (creating if needed) the pack directory and rebuilds the
+         * index from the segment files in it. segment_bytes overrides
+         * MAX_SEGMENT_BYTES, mostly so tests can roll segments quickly.
+         */
+        LLDiskCachePack(const std::string& pack_dir, U32 segment_bytes = MAX_SEGMENT_BYTES);
+        ~LLDiskCachePack();
+
+        /**
+         * True if an asset of this size should be stored packed
+         */
+        static bool isPackable(S64 size) { return size <= MAX_PACKED_ASSET_BYTES; }
+
+        /**
+         * Size of the packed asset, or -1 if the asset is not packed
+         */
+        S32 getSize(const std::string& key);
+
+        /**
+         * Read up to bytes of the packed asset starting at offset. Returns
+         * the number of bytes read or -1 if the asset is not packed.
+         */
+        S32 read(const std::string& key, S32 offset, U8* buffer, S32 bytes);
+
+        /**
+         * Read the whole packed asset. Returns false if it is not packed.
+         */
+        bool readAll(const std::string& key, std::vector<U8>& data);
+
+        /**
+         * Replace the whole contents of an asset
+         */
+        bool write(const std::string& key, const U8* data, S32 size);
+
+        /**
+         * Returns false if the asset was not packed
+         */
+        bool remove(const std::string& key);
+        bool rename(const std::string& old_key, const std::string& new_key);
+
+        /**
+         * Reclaim space taken by overwritten and removed records. Safe to
+         * call from any thread - does nothing if there is too little to gain.
+         */
+        void compact();
+
+        /**
+         * Remove every packed asset and segment file
+         */
+        void clear();
+
+        /**
+         * Key and size of every packed asset, used to rebuild the cache index
+         */
+        void getEntries(std::vector<std::pair<std::string, U32> >& entries);
+
+    private:
+        struct Location
+        {
+            U32 mSegment;
+            U32 mOffset;        // of the asset data in the segment
+            U32 mSize;          // of the asset data
+            U32 mRecordBytes;   // header, key and data
+        };
+        typedef std::unordered_map<std::string, Location> location_map_t;
+
+        struct Segment
+        {
+            LLFILE* mFile;
+            U32     mTotalBytes;
+            U32     mLiveBytes;
+        };
+        typedef std::map<U32, Segment> segment_map_t;
+
+        std::string getSegmentPath(U32 segment) const;
+        void loadSegments();
+        void scanSegment(U32 segment, Segment& seg);
+        bool openActiveSegment();
+        bool appendRecord(const std::string& key, const U8* data, U32 size, bool tombstone, Location& location);
+        bool readRecord(const Location& location, U32 offset, U8* buffer, U32 bytes);
+        void dropLocation(location_map_t::iterator iter);
+        void closeSegments();
+
+    private:
+        std::string     mPackDir;
+        U32             mSegmentBytes;
+        location_map_t  mLocations;
+        segment_map_t   mSegments;
+        U32             mActiveSegment;
+
+        /**
+         * Guards everything above. Reads seek the shared segment handles
+         * so they take it too.
+         */
+        LLMutex         mMutex;
+};
+
+#endif // LL_LLDISKCACHEPACK_H
@@ -34,6 +34,15 @@
 #include "llfasttimer.h"
 #include "lldiskcache.h"
 
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 const S32 LLFileSystem::READ        = 0x00000001;
 const S32 LLFileSystem::WRITE       = 0x00000002;
 const S32 LLFileSystem::READ_WRITE  = 0x00000003;  // LLFileSystem::READ & LLFileSystem::WRITE
@@ -41,6 +50,85 @@ const S32 LLFileSystem::APPEND      = 0x00000006;  // 0x00000004 & LLFileSystem:
 
 static LLTrace::BlockTimerStatHandle FTM_VFILE_WAIT("VFile Wait");
 
+// Below this, reading into a buffer is cheaper than setting up a mapping
+static const S32 MIN_MAPPED_VIEW_BYTES = 64 * 1024;
+
+LLFileSystemView::LLFileSystemView() :
+    mData(nullptr),
+    mSize(0),
+    mMapBase(nullptr),
+    mMapLength(0)
+{
+}
+
+LLFileSystemView::~LLFileSystemView()
+{
+    if (mMapBase)
+    {
+#if LL_WINDOWS
+        UnmapViewOfFile(mMapBase);
+#else
+        munmap(mMapBase, mMapLength);
+#endif
+    }
+}
+
+bool LLFileSystemView::mapFile(const std::string& filename, S32 size)
+{
+#if LL_WINDOWS
+    HANDLE file = CreateFileW(utf8str_to_utf16str(filename).c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    // The view keeps the mapping alive so both handles can go straight away
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    if (!base)
+    {
+        return false;
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // The file may have shrunk since the size was looked up and touching
+    // pages past the end of a mapping raises SIGBUS
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+#endif
+
+    mMapBase = base;
+    mMapLength = size;
+    mData = (const U8*)base;
+    mSize = size;
+    return true;
+}
+
 LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_type, S32 mode)
 {
     mFileType = file_type;
@@ -63,12 +151,10 @@ LLFileSystem::LLFileSystem(const LLUUID& file_id, const LLAssetType::EType file_
         // update the last access time for the file if it exists - this is required
         // even though we are reading and not writing because this is the
         // way the cache works - it relies on a valid "last accessed time" for
-        // each file so it knows how to remove the oldest, unused files
-        bool exists = gDirUtilp->fileExists(filename);
-        if (exists)
-        {
-            LLDiskCache::getInstance()->updateFileAccessTime(filename);
-        }
+        // each file so it knows how to remove the oldest, unused files. The
+        // cache index knows whether the file exists so there is no need to
+        // check here.
+        LLDiskCache::getInstance()->updateFileAccessTime(filename);
     }
 }
 
@@ -84,6 +170,16 @@ bool LLFileSystem::getExists(const LLUUID& file_id, const LLAssetType::EType fil
     const std::string extra_info = "";
     const std::string filename = LLDiskCache::getInstance()->metaDataToFilepath(id_str, file_type, extra_info);
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack)
+    {
+        S32 packed_size = pack->getSize(LLDiskCache::getInstance()->filepathToIndexKey(filename));
+        if (packed_size >= 0)
+        {
+            return packed_size > 0;
+        }
+    }
+
     llifstream file(filename, std::ios::binary);
     if (file.is_open())
     {
@@ -101,7 +197,12 @@ bool LLFileSystem::removeFile(const LLUUID& file_id, const LLAssetType::EType fi
     const std::string extra_info = "";
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id_str, file_type, extra_info);
 
-    LLFile::remove(filename.c_str(), suppress_error);
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (!pack || !pack->remove(LLDiskCache::getInstance()->filepathToIndexKey(filename)))
+    {
+        LLFile::remove(filename.c_str(), suppress_error);
+    }
+    LLDiskCache::getInstance()->removeFileEntry(filename);
 
     return true;
 }
@@ -122,6 +223,15 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
     // Rename needs the new file to not exist.
     LLFileSystem::removeFile(new_file_id, new_file_type, ENOENT);
 
+    // Packed assets are renamed without touching any files
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack && pack->rename(LLDiskCache::getInstance()->filepathToIndexKey(old_filename),
+                             LLDiskCache::getInstance()->filepathToIndexKey(new_filename)))
+    {
+        LLDiskCache::getInstance()->renameFileEntry(old_filename, new_filename);
+        return TRUE;
+    }
+
     if (LLFile::rename(old_filename, new_filename) != 0)
     {
         // We would like to return FALSE here indicating the operation
@@ -130,6 +240,10 @@ bool LLFileSystem::renameFile(const LLUUID& old_file_id, const LLAssetType::ETyp
         //return FALSE;
         LL_WARNS() << "Failed to rename " << old_file_id << " to " << new_id_str << " reason: "  << strerror(errno) << LL_ENDL;
     }
+    else
+    {
+        LLDiskCache::getInstance()->renameFileEntry(old_filename, new_filename);
+    }
 
     return TRUE;
 }
@@ -142,6 +256,16 @@ S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType fi
     const std::string extra_info = "";
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id_str, file_type, extra_info);
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack)
+    {
+        S32 packed_size = pack->getSize(LLDiskCache::getInstance()->filepathToIndexKey(filename));
+        if (packed_size >= 0)
+        {
+            return packed_size;
+        }
+    }
+
     S32 file_size = 0;
     llifstream file(filename, std::ios::binary);
     if (file.is_open())
@@ -153,6 +277,46 @@ S32 LLFileSystem::getFileSize(const LLUUID& file_id, const LLAssetType::EType fi
     return file_size;
 }
 
+LLFileSystemView::ptr_t LLFileSystem::mapView()
+{
+    std::string id;
+    mFileID.toString(id);
+    const std::string extra_info = "";
+    const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id, mFileType, extra_info);
+
+    LLFileSystemView::ptr_t view = new LLFileSystemView();
+
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack && pack->readAll(LLDiskCache::getInstance()->filepathToIndexKey(filename), view->mBuffer))
+    {
+        view->mData = view->mBuffer.empty() ? nullptr : &view->mBuffer[0];
+        view->mSize = (S32)view->mBuffer.size();
+        return view;
+    }
+
+    S32 size = getSize();
+    if (size <= 0)
+    {
+        return LLFileSystemView::ptr_t();
+    }
+
+    if (size >= MIN_MAPPED_VIEW_BYTES && view->mapFile(filename, size))
+    {
+        return view;
+    }
+
+    llifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        return LLFileSystemView::ptr_t();
+    }
+    view->mBuffer.resize(size);
+    file.read((char*)&view->mBuffer[0], size);
+    view->mData = &view->mBuffer[0];
+    view->mSize = (S32)file.gcount();
+    return view;
+}
+
 BOOL LLFileSystem::read(U8* buffer, S32 bytes)
 {
     BOOL success = FALSE;
@@ -162,6 +326,18 @@ BOOL LLFileSystem::read(U8* buffer, S32 bytes)
     const std::string extra_info = "";
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id, mFileType, extra_info);
 
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack)
+    {
+        S32 bytes_read = pack->read(LLDiskCache::getInstance()->filepathToIndexKey(filename), mPosition, buffer, bytes);
+        if (bytes_read >= 0)
+        {
+            mBytesRead = bytes_read;
+            mPosition += mBytesRead;
+            return mBytesRead ? TRUE : FALSE;
+        }
+    }
+
     llifstream file(filename, std::ios::binary);
     if (file.is_open())
     {
@@ -208,6 +384,13 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
     const std::string filename =  LLDiskCache::getInstance()->metaDataToFilepath(id_str, mFileType, extra_info);
 
     BOOL success = FALSE;
+    S64 file_size = 0;
+
+    LLDiskCachePack* pack = LLDiskCache::getInstance()->getPackStore();
+    if (pack && writePacked(pack, filename, buffer, bytes, success))
+    {
+        return success;
+    }
 
     if (mMode == APPEND)
     {
@@ -217,6 +400,7 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
             ofs.write((const char*)buffer, bytes);
 
             mPosition = ofs.tellp(); // <FS:Ansariel> Fix asset caching
+            file_size = mPosition;
 
             success = TRUE;
         }
@@ -232,6 +416,10 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
             ofs.write((const char*)buffer, bytes);
             mPosition += bytes;
             success = TRUE;
+
+            // may have written into the middle of the file
+            ofs.seekp(0, std::ios::end);
+            file_size = ofs.tellp();
         }
         else
         {
@@ -242,6 +430,7 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
                 ofs.write((const char*)buffer, bytes);
                 mPosition += bytes;
                 success = TRUE;
+                file_size = mPosition;
             }
         }
     }
@@ -254,14 +443,92 @@ BOOL LLFileSystem::write(const U8* buffer, S32 bytes)
             ofs.write((const char*)buffer, bytes);
 
             mPosition += bytes;
+            file_size = mPosition;
 
             success = TRUE;
         }
     }
 
+    if (success)
+    {
+        // keep the cache index in step so purging never needs to scan
+        LLDiskCache::getInstance()->updateFileSize(filename, file_size);
+    }
+
     return success;
 }
 
+bool LLFileSystem::writePacked(LLDiskCachePack* pack, const std::string& filename, const U8* buffer, S32 bytes, BOOL& success)
+{
+    // Records in the pack are immutable so every write rewrites the whole
+    // asset. That is fine as long as assets stay small - once one outgrows
+    // the pack it is moved to a loose file and stays there.
+    const std::string key = LLDiskCache::getInstance()->filepathToIndexKey(filename);
+
+    std::vector<U8> data;
+    S32 position = mPosition;
+    if (mMode == WRITE)
+    {
+        if (!LLDiskCachePack::isPackable(bytes))
+        {
+            pack->remove(key);
+            return false;
+        }
+        position = 0;
+    }
+    else if (!pack->readAll(key, data))
+    {
+        // Existing loose files are left where they are
+        if (!LLDiskCachePack::isPackable((S64)mPosition + bytes) || gDirUtilp->fileExists(filename))
+        {
+            return false;
+        }
+    }
+
+    if (mMode == APPEND)
+    {
+        position = (S32)data.size();
+    }
+    data.resize(llmax((S32)data.size(), position + bytes));
+    if (bytes > 0)
+    {
+        memcpy(&data[position], buffer, bytes);
+    }
+
+    if (LLDiskCachePack::isPackable(data.size()))
+    {
+        // An asset is either packed or loose, so an indexed asset that is
+        // not packed yet must be an older loose copy that has to go
+        const bool replaces_loose = mMode == WRITE && pack->getSize(key) < 0 &&
+                                    LLDiskCache::getInstance()->hasFileEntry(filename);
+        success = pack->write(key, data.empty() ? nullptr : &data[0], (S32)data.size()) ? TRUE : FALSE;
+        if (success && replaces_loose)
+        {
+            LLFile::remove(filename, ENOENT);
+        }
+    }
+    else
+    {
+        llofstream ofs(filename, std::ios::binary);
+        if (ofs)
+        {
+            ofs.write((const char*)&data[0], data.size());
+            success = ofs ? TRUE : FALSE;
+        }
+        if (success)
+        {
+            pack->remove(key);
+        }
+    }
+
+    if (success)
+    {
+        mPosition = position + bytes;
+        LLDiskCache::getInstance()->updateFileSize(filename, data.size());
+    }
+    return true;
+}
+
 BOOL LLFileSystem::seek(S32 offset, S32 origin)
 {
     if (-1 == origin)
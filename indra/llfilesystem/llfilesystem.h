@@ -33,6 +33,43 @@
 #include "lluuid.h"
 #include "llassettype.h"
 #include "lldiskcache.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+
+/**
+ * A read-only view of the whole contents of a cached asset, as handed out
+ * by LLFileSystem::mapView(). Large loose files are memory mapped so that
+ * consumers parse straight out of the OS page cache with no intermediate
+ * allocation or copy. Small and packed assets are simply read into a
+ * buffer owned by the view since mapping them costs more than it saves.
+ *
+ * Views should be short lived: a mapping does not stop another thread
+ * from rewriting the file underneath it.
+ */
+class LLFileSystemView : public LLThreadSafeRefCount
+{
+    public:
+        typedef LLPointer<LLFileSystemView> ptr_t;
+
+        const U8* getData() const { return mData; }
+        S32 getSize() const { return mSize; }
+        bool isMapped() const { return mMapBase != nullptr; }
+
+    protected:
+        friend class LLFileSystem;
+
+        LLFileSystemView();
+        ~LLFileSystemView();
+
+        bool mapFile(const std::string& filename, S32 size);
+
+    private:
+        const U8*       mData;
+        S32             mSize;
+        std::vector<U8> mBuffer;
+        void*           mMapBase;
+        size_t          mMapLength;
+};
 
 class LLFileSystem
 {
@@ -59,6 +96,12 @@ class LLFileSystem
                                const LLUUID& new_file_id, const LLAssetType::EType new_file_type);
         static S32 getFileSize(const LLUUID& file_id, const LLAssetType::EType file_type);
 
+        /**
+         * Returns a view of the whole asset, or a null pointer if it does
+         * not exist. Does not move the read position.
+         */
+        LLFileSystemView::ptr_t mapView();
+
     public:
         static const S32 READ;
         static const S32 WRITE;
@@ -66,6 +109,13 @@ class LLFileSystem
         static const S32 APPEND;
 
     protected:
+        /**
+         * Write through the pack store for small assets. Returns false if
+         * the asset should be written as a loose file instead, otherwise
+         * sets success to the result of the write.
+         */
+        bool writePacked(LLDiskCachePack* pack, const std::string& filename, const U8* buffer, S32 bytes, BOOL& success);
+
         LLAssetType::EType mFileType;
         LLUUID  mFileID;
         S32     mPosition;
@@ -0,0 +1,217 @@
+/**
+ * @file lldiskcachepack_test.cpp
+ * @brief LLDiskCachePack test cases.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lltut.h"
+#include "lluuid.h"
+#include "stringize.h"
+#include "../lldir.h"
+#include "../lldiskcachepack.h"
+
+namespace tut
+{
+    struct LLDiskCachePackFixture
+    {
+        std::string mPackDir;
+
+        LLDiskCachePackFixture()
+        {
+            LLUUID random;
+            random.generate();
+            mPackDir = STRINGIZE(LLFile::tmpdir() << "lldiskcachepack-test-" << random);
+        }
+
+        ~LLDiskCachePackFixture()
+        {
+            LLDiskCachePack(mPackDir).clear();
+            LLFile::rmdir(mPackDir);
+        }
+
+        std::string segmentPath(U32 segment)
+        {
+            return mPackDir + gDirUtilp->getDirDelimiter() + llformat("segment_%08u.pack", segment);
+        }
+
+        static std::vector<U8> makeData(S32 size, U8 seed)
+        {
+            std::vector<U8> data(size);
+            for (S32 i = 0; i < size; ++i)
+            {
+                data[i] = (U8)(seed + i);
+            }
+            return data;
+        }
+
+        void ensureData(const std::string& msg, LLDiskCachePack& pack, const std::string& key, const std::vector<U8>& expected)
+        {
+            std::vector<U8> data;
+            ensure(msg + " is packed", pack.readAll(key, data));
+            ensure_equals(msg + " size", pack.getSize(key), (S32)expected.size());
+            ensure(msg + " contents", data == expected);
+        }
+    };
+    typedef test_group<LLDiskCachePackFixture> LLDiskCachePackTest_factory;
+    typedef LLDiskCachePackTest_factory::object LLDiskCachePackTest_t;
+    LLDiskCachePackTest_factory tf("LLDiskCachePack");
+
+    template<> template<>
+    void LLDiskCachePackTest_t::test<1>()
+    {
+        set_test_name("write and read");
+
+        LLDiskCachePack pack(mPackDir);
+        const std::vector<U8> a = makeData(1000, 1);
+        const std::vector<U8> empty;
+
+        ensure_equals("missing asset size", pack.getSize("a"), -1);
+        ensure("write a", pack.write("a", &a[0], (S32)a.size()));
+        ensure("write empty", pack.write("empty", nullptr, 0));
+        ensureData("a", pack, "a", a);
+        ensureData("empty", pack, "empty", empty);
+
+        U8 buffer[16];
+        ensure_equals("partial read", pack.read("a", 990, buffer, sizeof(buffer)), 10);
+        ensure("partial read contents", memcmp(buffer, &a[990], 10) == 0);
+        ensure_equals("read past the end", pack.read("a", 1000, buffer, sizeof(buffer)), 0);
+        ensure_equals("read missing asset", pack.read("b", 0, buffer, sizeof(buffer)), -1);
+
+        const std::vector<U8> big = makeData(LLDiskCachePack::MAX_PACKED_ASSET_BYTES + 1, 2);
+        ensure("oversized asset rejected", !pack.write("big", &big[0], (S32)big.size()));
+        ensure_equals("oversized asset not packed", pack.getSize("big"), -1);
+    }
+
+    template<> template<>
+    void LLDiskCachePackTest_t::test<2>()
+    {
+        set_test_name("overwrite, remove and rename");
+
+        LLDiskCachePack pack(mPackDir);
+        const std::vector<U8> a1 = makeData(500, 1);
+        const std::vector<U8> a2 = makeData(200, 7);
+
+        ensure("write a", pack.write("a", &a1[0], (S32)a1.size()));
+        ensure("overwrite a", pack.write("a", &a2[0], (S32)a2.size()));
+        ensureData("overwritten a", pack, "a", a2);
+
+        ensure("rename a", pack.rename("a", "b"));
+        ensure_equals("renamed from", pack.getSize("a"), -1);
+        ensureData("renamed to", pack, "b", a2);
+        ensure("rename missing asset", !pack.rename("a", "c"));
+        ensure("rename to itself", pack.rename("b", "b"));
+        ensureData("renamed to itself", pack, "b", a2);
+
+        ensure("remove b", pack.remove("b"));
+        ensure_equals("removed", pack.getSize("b"), -1);
+        ensure("remove missing asset", !pack.remove("b"));
+
+        std::vector<std::pair<std::string, U32> > entries;
+        pack.getEntries(entries);
+        ensure("no entries left", entries.empty());
+    }
+
+    template<> template<>
+    void LLDiskCachePackTest_t::test<3>()
+    {
+        set_test_name("reopen rescans segments");
+
+        const std::vector<U8> a = makeData(300, 1);
+        const std::vector<U8> b1 = makeData(400, 2);
+        const std::vector<U8> b2 = makeData(100, 3);
+        const std::vector<U8> c = makeData(50, 4);
+        {
+            LLDiskCachePack pack(mPackDir);
+            pack.write("a", &a[0], (S32)a.size());
+            pack.write("b", &b1[0], (S32)b1.size());
+            pack.write("b", &b2[0], (S32)b2.size());
+            pack.write("c", &c[0], (S32)c.size());
+            pack.rename("c", "d");
+            pack.rename("d", "d");
+            pack.write("gone", &a[0], (S32)a.size());
+            pack.remove("gone");
+        }
+
+        // A torn record at the end is dropped without losing the others
+        LLFILE* fp = LLFile::fopen(segmentPath(1), "ab");
+        ensure("open segment", fp != nullptr);
+        const U8 torn[] = { 0x4c, 0x43, 0x50, 0x4b, 0x01 };
+        fwrite(torn, 1, sizeof(torn), fp);
+        LLFile::close(fp);
+
+        LLDiskCachePack pack(mPackDir);
+        ensureData("a", pack, "a", a);
+        ensureData("b", pack, "b", b2);
+        ensureData("d", pack, "d", c);
+        ensure_equals("renamed from", pack.getSize("c"), -1);
+        ensure_equals("removed", pack.getSize("gone"), -1);
+
+        std::vector<std::pair<std::string, U32> > entries;
+        pack.getEntries(entries);
+        ensure_equals("entries", entries.size(), (size_t)3);
+
+        ensure("write after truncation", pack.write("e", &c[0], (S32)c.size()));
+        ensureData("e", pack, "e", c);
+    }
+
+    template<> template<>
+    void LLDiskCachePackTest_t::test<4>()
+    {
+        set_test_name("compact relocates live records");
+
+        // Small enough that each segment only takes a few records
+        const U32 segment_bytes = 256;
+        const std::vector<U8> a1 = makeData(100, 1);
+        const std::vector<U8> b1 = makeData(100, 2);
+        const std::vector<U8> c = makeData(100, 3);
+        const std::vector<U8> a2 = makeData(100, 4);
+        const std::vector<U8> b2 = makeData(100, 5);
+        {
+            LLDiskCachePack pack(mPackDir, segment_bytes);
+            pack.write("a", &a1[0], (S32)a1.size());
+            pack.write("b", &b1[0], (S32)b1.size());
+            pack.write("c", &c[0], (S32)c.size());
+
+            // Nothing to gain while the only segment is still active
+            pack.compact();
+            ensure("segment 1 kept while active", LLFile::isfile(segmentPath(1)));
+
+            // These go to segment 2, leaving only c live in segment 1
+            pack.write("a", &a2[0], (S32)a2.size());
+            pack.write("b", &b2[0], (S32)b2.size());
+            ensure("segment 2 created", LLFile::isfile(segmentPath(2)));
+
+            pack.compact();
+            ensure("segment 1 removed", !LLFile::isfile(segmentPath(1)));
+            ensureData("a after compact", pack, "a", a2);
+            ensureData("b after compact", pack, "b", b2);
+            ensureData("c after compact", pack, "c", c);
+        }
+
+        LLDiskCachePack pack(mPackDir, segment_bytes);
+        ensureData("a after reopen", pack, "a", a2);
+        ensureData("b after reopen", pack, "b", b2);
+        ensureData("c after reopen", pack, "c", c);
+    }
+}
@@ -42,6 +42,18 @@
 
 #include <boost/preprocessor.hpp>
 
+// AVX2 is only used where the CPU reports it
+#if LL_IMAGE_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#define LL_TARGET_AVX2
+#else
+#define LL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 //..................................................................................
 //..................................................................................
 // Helper macrose's for generate cycle unwrap templates
@@ -556,6 +568,232 @@ inline void bilinear_scale(
 	} //else
 }
 
+#if LL_IMAGE_SSE2
+//..................................................................................
+// SSE2 versions of the pixel kernels. Each one mirrors its scalar version
+// operation for operation so the results are identical.
+//..................................................................................
+
+// The 4 channels of an RGBA pixel as S32 lanes
+inline __m128i load_pixel4_epi32(const U8* pix)
+{
+	S32 packed;
+	memcpy(&packed, pix, 4);
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+}
+
+// pix[c] * val. The pixel lanes have zero high halves, so a multiply-add
+// of 16 bit halves is exact for the weights used here (0 to 1<<14)
+inline __m128i mul_pixel4(const U8* pix, S32 val)
+{
+	return _mm_madd_epi16(load_pixel4_epi32(pix), _mm_set1_epi32(val));
+}
+
+// Low 32 bits of a 32x32 bit multiply, as the scalar S32 arithmetic does
+inline __m128i mullo_epi32_sse2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+							  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// *dptr++ = comp[c] & 0xff for the 4 channels
+inline void store_pixel4(U8*& dptr, __m128i comp)
+{
+	comp = _mm_and_si128(comp, _mm_set1_epi32(0xff));
+	comp = _mm_packs_epi32(comp, comp);
+	S32 packed = _mm_cvtsi128_si32(_mm_packus_epi16(comp, comp));
+	memcpy(dptr, &packed, 4);
+	dptr += 4;
+}
+
+// Weighted sum of a run of pixels spaced step bytes apart, as used by the
+// down scaling paths of bilinear_scale()
+inline __m128i sum_pixel4_run(const U8* pix, S32 step, S32 ap, S32 C)
+{
+	__m128i sum = mul_pixel4(pix, ap);
+	pix += step;
+	S32 i;
+	for (i = (1 << 14) - ap; i > C; i -= C)
+	{
+		sum = _mm_add_epi32(sum, mul_pixel4(pix, C));
+		pix += step;
+	}
+	if (i > 0)
+	{
+		sum = _mm_add_epi32(sum, mul_pixel4(pix, i));
+	}
+	return sum;
+}
+
+// bilinear_scale<4>() with the 4 channels of a pixel held in one register
+static void bilinear_scale_sse2_4(
+	const U8 *src, U32 srcW, U32 srcH, U32 srcStride
+	, U8 *dst, U32 dstW, U32 dstH, U32 dstStride
+	)
+{
+	scale_info<4> info(src, srcW, srcH, dstW, dstH, srcStride);
+
+	const U8 *sptr;
+	U8 *dptr;
+	const U8 *pix;
+	__m128i comp, cx;
+
+	if(3 == info.xup_yup)
+	{ //scale x/y - up
+		for(U32 y = 0; y < dstH; ++y)
+		{
+			dptr = dst + (y * dstStride);
+			sptr = info.ystrides[y];
+			const S32 yap = info.yapoints[y];
+
+			if(0 < yap)
+			{
+				const __m128i ya = _mm_set1_epi32(yap);
+				const __m128i inv_ya = _mm_set1_epi32(256 - yap);
+				for(U32 x = 0; x < dstW; ++x)
+				{
+					const S32 xap = info.xapoints[x];
+					pix = sptr + info.xpoints[x] * 4;
+					if(0 < xap)
+					{
+						comp = _mm_add_epi32(mul_pixel4(pix, 256 - xap), mul_pixel4(pix + 4, xap));
+						pix += srcStride;
+						cx = _mm_add_epi32(mul_pixel4(pix + 4, xap), mul_pixel4(pix, 256 - xap));
+						comp = _mm_srai_epi32(_mm_add_epi32(mullo_epi32_sse2(cx, ya), mullo_epi32_sse2(comp, inv_ya)), 16);
+					}
+					else
+					{
+						comp = mul_pixel4(pix, 256 - yap);
+						comp = _mm_srai_epi32(_mm_add_epi32(comp, mul_pixel4(pix + srcStride, yap)), 8);
+					}
+					store_pixel4(dptr, comp);
+				}
+			}
+			else
+			{
+				for(U32 x = 0; x < dstW; ++x)
+				{
+					const S32 xap = info.xapoints[x];
+					pix = sptr + info.xpoints[x] * 4;
+					if(0 < xap)
+					{
+						// same pixel twice, as the scalar version does
+						comp = _mm_add_epi32(mul_pixel4(pix, 256 - xap), mul_pixel4(pix, xap));
+						store_pixel4(dptr, _mm_srai_epi32(comp, 8));
+					}
+					else
+					{
+						memcpy(dptr, pix, 4);
+						dptr += 4;
+					}
+				}
+			}
+		}
+	}
+	else if(info.xup_yup == 1)
+	{ //scaling down vertically
+		for(U32 y = 0; y < dstH; y++)
+		{
+			const S32 Cy = info.yapoints[y] >> 16;
+			const S32 yap = info.yapoints[y] & 0xffff;
+
+			dptr = dst + (y * dstStride);
+
+			for(U32 x = 0; x < dstW; x++)
+			{
+				const S32 xap = info.xapoints[x];
+				pix = info.ystrides[y] + info.xpoints[x] * 4;
+				comp = sum_pixel4_run(pix, srcStride, yap, Cy);
+
+				if(xap > 0)
+				{
+					cx = sum_pixel4_run(pix + 4, srcStride, yap, Cy);
+					comp = _mm_add_epi32(mullo_epi32_sse2(comp, _mm_set1_epi32(256 - xap)),
+										 mullo_epi32_sse2(cx, _mm_set1_epi32(xap)));
+					comp = _mm_srai_epi32(comp, 12);
+				}
+				else
+				{
+					comp = _mm_srai_epi32(comp, 4);
+				}
+
+				store_pixel4(dptr, _mm_srai_epi32(comp, 10));
+			}
+		}
+	}
+	else if(info.xup_yup == 2)
+	{ // scaling down horizontally
+		for(U32 y = 0; y < dstH; y++)
+		{
+			const S32 yap = info.yapoints[y];
+			dptr = dst + (y * dstStride);
+
+			for(U32 x = 0; x < dstW; x++)
+			{
+				const S32 Cx = info.xapoints[x] >> 16;
+				const S32 xap = info.xapoints[x] & 0xffff;
+
+				pix = info.ystrides[y] + info.xpoints[x] * 4;
+				comp = sum_pixel4_run(pix, 4, xap, Cx);
+
+				if(yap > 0)
+				{
+					cx = sum_pixel4_run(pix + srcStride, 4, xap, Cx);
+					comp = _mm_add_epi32(mullo_epi32_sse2(comp, _mm_set1_epi32(256 - yap)),
+										 mullo_epi32_sse2(cx, _mm_set1_epi32(yap)));
+					comp = _mm_srai_epi32(comp, 12);
+				}
+				else
+				{
+					comp = _mm_srai_epi32(comp, 4);
+				}
+
+				store_pixel4(dptr, _mm_srai_epi32(comp, 10));
+			}
+		}
+	}
+	else
+	{ //scale x/y - down
+		for(U32 y = 0; y < dstH; y++)
+		{
+			const S32 Cy = info.yapoints[y] >> 16;
+			const S32 yap = info.yapoints[y] & 0xffff;
+
+			dptr = dst + (y * dstStride);
+			for(U32 x = 0; x < dstW; x++)
+			{
+				const S32 Cx = info.xapoints[x] >> 16;
+				const S32 xap = info.xapoints[x] & 0xffff;
+
+				sptr = info.ystrides[y] + info.xpoints[x] * 4;
+				cx = sum_pixel4_run(sptr, 4, xap, Cx);
+				sptr += srcStride;
+				comp = mullo_epi32_sse2(_mm_srai_epi32(cx, 5), _mm_set1_epi32(yap));
+
+				S32 j;
+				for(j = (1 << 14) - yap; j > Cy; j -= Cy)
+				{
+					cx = sum_pixel4_run(sptr, 4, xap, Cx);
+					sptr += srcStride;
+					comp = _mm_add_epi32(comp, mullo_epi32_sse2(_mm_srai_epi32(cx, 5), _mm_set1_epi32(Cy)));
+				}
+
+				if(j > 0)
+				{
+					cx = sum_pixel4_run(sptr, 4, xap, Cx);
+					comp = _mm_add_epi32(comp, mullo_epi32_sse2(_mm_srai_epi32(cx, 5), _mm_set1_epi32(j)));
+				}
+
+				store_pixel4(dptr, _mm_srai_epi32(comp, 23));
+			}
+		}
+	}
+}
+#endif // LL_IMAGE_SSE2
+
 //wrapper
 static void bilinear_scale(const U8 *src, U32 srcW, U32 srcH, U32 srcCh, U32 srcStride, U8 *dst, U32 dstW, U32 dstH, U32 dstCh, U32 dstStride)
 {
@@ -570,6 +808,13 @@ static void bilinear_scale(const U8 *src, U32 srcW, U32 srcH, U32 srcCh, U32 src
 		bilinear_scale<3>(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride);
 		break;
 	case 4:
+#if LL_IMAGE_SSE2
+		if (LLImage::getSIMDLevel() >= LLImage::SIMD_SSE2)
+		{
+			bilinear_scale_sse2_4(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride);
+			break;
+		}
+#endif
 		bilinear_scale<4>(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride);
 		break;
 	default:
@@ -589,21 +834,80 @@ LLMutex* LLImage::sMutex = NULL;
 bool LLImage::sUseNewByteRange = false;
 S32  LLImage::sMinimalReverseByteRangePercent = 75;
 
+LLImage::ESIMDLevel LLImage::sSIMDLevel = LLImage::getMaxSIMDLevel();
+
 //static
 void LLImage::initClass(bool use_new_byte_range, S32 minimal_reverse_byte_range_percent)
 {
 	sUseNewByteRange = use_new_byte_range;
     sMinimalReverseByteRangePercent = minimal_reverse_byte_range_percent;
 	sMutex = new LLMutex();
+	LL_INFOS("Image") << "Using " << getSIMDLevelName(sSIMDLevel) << " image kernels" << LL_ENDL;
 }
 
 //static
 void LLImage::cleanupClass()
 {
+	LLImageRaw::purgeBufferPool();
 	delete sMutex;
 	sMutex = NULL;
 }
 
+static LLImage::ESIMDLevel detect_simd_level()
+{
+#if !LL_IMAGE_SSE2
+	return LLImage::SIMD_SCALAR;
+#elif LL_WINDOWS
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		// AVX2 also needs the OS to save the upper halves of the registers
+		__cpuid(info, 1);
+		const bool osxsave_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+		if (osxsave_avx && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+			{
+				return LLImage::SIMD_AVX2;
+			}
+		}
+	}
+	return LLImage::SIMD_SSE2;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? LLImage::SIMD_AVX2 : LLImage::SIMD_SSE2;
+#endif
+}
+
+//static
+LLImage::ESIMDLevel LLImage::getMaxSIMDLevel()
+{
+	static const ESIMDLevel max_level = detect_simd_level();
+	return max_level;
+}
+
+//static
+void LLImage::setSIMDLevel(ESIMDLevel level)
+{
+	sSIMDLevel = llmin(level, getMaxSIMDLevel());
+}
+
+//static
+const char* LLImage::getSIMDLevelName(ESIMDLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE2:
+		return "SSE2";
+	case SIMD_AVX2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
 //static
 const std::string& LLImage::getLastError()
 {
@@ -671,11 +975,26 @@ void LLImageBase::sanityCheck()
 // virtual
 void LLImageBase::deleteData()
 {
-	ll_aligned_free_16(mData);
+	if (mData)
+	{
+		freeBuffer(mData, mDataSize); // virtual
+	}
 	mDataSize = 0;
 	mData = NULL;
 }
 
+// virtual
+U8* LLImageBase::allocateBuffer(S32 size)
+{
+	return (U8*)ll_aligned_malloc_16(size);
+}
+
+// virtual
+void LLImageBase::freeBuffer(U8* data, S32 size)
+{
+	ll_aligned_free_16(data);
+}
+
 // virtual
 U8* LLImageBase::allocateData(S32 size)
 {
@@ -710,7 +1029,7 @@ U8* LLImageBase::allocateData(S32 size)
 	if (!mBadBufferAllocation && (!mData || size != mDataSize))
 	{
 		deleteData(); // virtual
-		mData = (U8*)ll_aligned_malloc_16(size);
+		mData = allocateBuffer(size); // virtual
 		if (!mData)
 		{
 			LL_WARNS() << "Failed to allocate image data size [" << size << "]" << LL_ENDL;
@@ -794,6 +1113,94 @@ U8* LLImageBase::allocateDataSize(S32 width, S32 height, S32 ncomponents, S32 si
 	return allocateData(size); // virtual
 }
 
+//---------------------------------------------------------------------------
+// LLImageRawBufferPool
+//---------------------------------------------------------------------------
+
+// Free lists of raw image buffers bucketed by exact size. Texture sizes are
+// powers of two times 1, 3 or 4 components, so each distinct size is in
+// effect its own size class and a freed buffer is almost always asked for
+// again shortly by the decoder.
+class LLImageRawBufferPool
+{
+public:
+	// Smaller buffers are cheap enough to get from the allocator
+	static const S32 MIN_POOLED_SIZE = 64 * 64 * 4;
+	static const S32 MAX_POOLED_SIZE = 2048 * 2048 * 4;
+	static const S64 MAX_POOL_BYTES = 64 * 1024 * 1024;
+	static const size_t MAX_BUFFERS_PER_SIZE = 16;
+
+	static LLImageRawBufferPool& instance()
+	{
+		// never deleted, images may outlive static destruction
+		static LLImageRawBufferPool* sInstance = new LLImageRawBufferPool();
+		return *sInstance;
+	}
+
+	static bool isPoolable(S32 size)
+	{
+		return size >= MIN_POOLED_SIZE && size <= MAX_POOLED_SIZE;
+	}
+
+	U8* allocate(S32 size)
+	{
+		if (isPoolable(size))
+		{
+			LLMutexLock lock(&mMutex);
+			buffer_map_t::iterator iter = mBuffers.find(size);
+			if (iter != mBuffers.end() && !iter->second.empty())
+			{
+				U8* data = iter->second.back();
+				iter->second.pop_back();
+				mPooledBytes -= size;
+				return data;
+			}
+		}
+		return (U8*)ll_aligned_malloc_16(size);
+	}
+
+	void release(U8* data, S32 size)
+	{
+		if (isPoolable(size))
+		{
+			LLMutexLock lock(&mMutex);
+			if (mPooledBytes + size <= MAX_POOL_BYTES)
+			{
+				std::vector<U8*>& buffers = mBuffers[size];
+				if (buffers.size() < MAX_BUFFERS_PER_SIZE)
+				{
+					buffers.push_back(data);
+					mPooledBytes += size;
+					return;
+				}
+			}
+		}
+		ll_aligned_free_16(data);
+	}
+
+	void purge()
+	{
+		LLMutexLock lock(&mMutex);
+		for (buffer_map_t::value_type& entry : mBuffers)
+		{
+			for (U8* data : entry.second)
+			{
+				ll_aligned_free_16(data);
+			}
+		}
+		mBuffers.clear();
+		mPooledBytes = 0;
+	}
+
+private:
+	LLImageRawBufferPool() : mPooledBytes(0) {}
+
+	typedef std::map<S32, std::vector<U8*> > buffer_map_t;
+	buffer_map_t mBuffers;
+	S64 mPooledBytes;
+	LLMutex mMutex;
+};
+
 //---------------------------------------------------------------------------
 // LLImageRaw
 //---------------------------------------------------------------------------
@@ -873,6 +1280,24 @@ void LLImageRaw::deleteData()
 	LLImageBase::deleteData();
 }
 
+// virtual
+U8* LLImageRaw::allocateBuffer(S32 size)
+{
+	return LLImageRawBufferPool::instance().allocate(size);
+}
+
+// virtual
+void LLImageRaw::freeBuffer(U8* data, S32 size)
+{
+	LLImageRawBufferPool::instance().release(data, size);
+}
+
+//static
+void LLImageRaw::purgeBufferPool()
+{
+	LLImageRawBufferPool::instance().purge();
+}
+
 void LLImageRaw::setDataAndSize(U8 *data, S32 width, S32 height, S8 components) 
 { 
 	if(data == getData())
@@ -1547,6 +1972,42 @@ LLPointer<LLImageRaw> LLImageRaw::scaled(S32 new_width, S32 new_height)
     return result;
 }
 
+#if LL_IMAGE_SSE2
+// The 3 or 4 channels of a pixel as float lanes, never reading past the pixel
+inline __m128 load_pixel_ps(const U8* pix, S32 components)
+{
+	S32 packed = pix[0] | (pix[1] << 8) | (pix[2] << 16) | (components == 4 ? pix[3] << 24 : 0);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+// Box filtered average of the input pixels from index0 to index1. Each lane
+// sees the same float operations, in the same order, as the scalar loops in
+// copyLineScaled() and compositeRowScaled4onto3() so the results match.
+inline void average_span_sse2(const U8* in, S32 components, S32 stride, S32 index0, S32 index1,
+							  F32 fract0, F32 fract1, bool right_straddle, F32 norm_factor, U8* dst)
+{
+	__m128 sum = _mm_mul_ps(load_pixel_ps(in + index0 * stride, components), _mm_set1_ps(fract0));
+	for (S32 u = index0 + 1; u < index1; u++)
+	{
+		sum = _mm_add_ps(sum, load_pixel_ps(in + u * stride, components));
+	}
+	if (right_straddle)
+	{
+		sum = _mm_add_ps(sum, _mm_mul_ps(load_pixel_ps(in + index1 * stride, components), _mm_set1_ps(fract1)));
+	}
+	sum = _mm_mul_ps(sum, _mm_set1_ps(norm_factor));
+
+	// U8(ll_round(x)), the sums are never negative so truncation is floor
+	__m128i rounded = _mm_cvttps_epi32(_mm_add_ps(sum, _mm_set1_ps(0.5f)));
+	rounded = _mm_and_si128(rounded, _mm_set1_epi32(0xff));
+	rounded = _mm_packs_epi32(rounded, rounded);
+	S32 packed = _mm_cvtsi128_si32(_mm_packus_epi16(rounded, rounded));
+	memcpy(dst, &packed, components);
+}
+#endif // LL_IMAGE_SSE2
+
 void LLImageRaw::copyLineScaled( U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len, S32 in_pixel_step, S32 out_pixel_step )
 {
 	const S32 components = getComponents();
@@ -1554,6 +2015,9 @@ void LLImageRaw::copyLineScaled( U8* in, U8* out, S32 in_pixel_len, S32 out_pixe
 
 	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
 	const F32 norm_factor = 1.f / ratio;
+#if LL_IMAGE_SSE2
+	const bool use_sse2 = components >= 3 && LLImage::getSIMDLevel() >= LLImage::SIMD_SSE2;
+#endif
 
 	S32 goff = components >= 2 ? 1 : 0;
 	S32 boff = components >= 3 ? 2 : 0;
@@ -1582,6 +2046,14 @@ void LLImageRaw::copyLineScaled( U8* in, U8* out, S32 in_pixel_len, S32 out_pixe
 				++inp;
 			}
 		}
+#if LL_IMAGE_SSE2
+		else if (use_sse2)
+		{
+			average_span_sse2(in, components, in_pixel_step * components, index0, index1,
+							  fract0, fract1, fract1 && index1 < in_pixel_len, norm_factor,
+							  out + x * out_pixel_step * components);
+		}
+#endif
 		else
 		{
 			// Left straddle
@@ -1671,6 +2143,9 @@ void LLImageRaw::compositeRowScaled4onto3( U8* in, U8* out, S32 in_pixel_len, S3
 
 	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
 	const F32 norm_factor = 1.f / ratio;
+#if LL_IMAGE_SSE2
+	const bool use_sse2 = LLImage::getSIMDLevel() >= LLImage::SIMD_SSE2;
+#endif
 
 	for( S32 x = 0; x < out_pixel_len; x++ )
 	{
@@ -1697,6 +2172,18 @@ void LLImageRaw::compositeRowScaled4onto3( U8* in, U8* out, S32 in_pixel_len, S3
 			in_scaled_b = in[t1 + 0];
 			in_scaled_a = in[t1 + 0];
 		}
+#if LL_IMAGE_SSE2
+		else if (use_sse2)
+		{
+			U8 scaled[IN_COMPONENTS];
+			average_span_sse2(in, IN_COMPONENTS, IN_COMPONENTS, index0, index1,
+							  fract0, fract1, fract1 && index1 < in_pixel_len, norm_factor, scaled);
+			in_scaled_r = scaled[0];
+			in_scaled_g = scaled[1];
+			in_scaled_b = scaled[2];
+			in_scaled_a = scaled[3];
+		}
+#endif
 		else
 		{
 			// Left straddle
@@ -2256,37 +2743,188 @@ void LLImageBase::setDataAndSize(U8 *data, S32 size)
 	mDataSize = size; 
 }	
 
+// Averages each 2x2 block of the rows, from output pixel w to the end
+static void generate_mip_row(const U8* row0, const U8* row1, U8* out, S32 w, S32 width, S32 nchannels)
+{
+	const U8* indata = row0 + w*nchannels*2;
+	const U8* indata1 = row1 + w*nchannels*2;
+	U8* data = out + w*nchannels;
+	for (; w<width; w++)
+	{
+		switch(nchannels)
+		{
+		  case 4:
+			avg4_colors4(indata, indata+4, indata1, indata1+4, data);
+			break;
+		  case 3:
+			avg4_colors3(indata, indata+3, indata1, indata1+3, data);
+			break;
+		  case 2:
+			avg4_colors2(indata, indata+2, indata1, indata1+2, data);
+			break;
+		  case 1:
+			*(U8*)data = (U8)(((U32)(indata[0]) + indata[1] + indata1[0] + indata1[1])>>2);
+			break;
+		  default:
+			LL_ERRS() << "generateMmip called with bad num channels" << LL_ENDL;
+		}
+		indata += nchannels*2;
+		indata1 += nchannels*2;
+		data += nchannels;
+	}
+}
+
+#if LL_IMAGE_SSE2
+// SSE2 version of generate_mip_row() for 1, 2 and 4 channels. Returns the
+// output pixel it stopped at, the caller finishes the row.
+static S32 generate_mip_row_sse2(const U8* row0, const U8* row1, U8* out, S32 w, S32 width, S32 nchannels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	switch (nchannels)
+	{
+	case 4:
+		for (; w + 4 <= width; w += 4)
+		{
+			const __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + w*8)));
+			const __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + w*8 + 16)));
+			const __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + w*8)));
+			const __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + w*8 + 16)));
+			// split into the left and right pixel of each block
+			const __m128i ae = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128i ao = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+			const __m128i be = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128i bo = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+			__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(ae, zero), _mm_unpacklo_epi8(ao, zero)),
+									   _mm_add_epi16(_mm_unpacklo_epi8(be, zero), _mm_unpacklo_epi8(bo, zero)));
+			__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(ae, zero), _mm_unpackhi_epi8(ao, zero)),
+									   _mm_add_epi16(_mm_unpackhi_epi8(be, zero), _mm_unpackhi_epi8(bo, zero)));
+			lo = _mm_srli_epi16(lo, 2);
+			hi = _mm_srli_epi16(hi, 2);
+			_mm_storeu_si128((__m128i*)(out + w*4), _mm_packus_epi16(lo, hi));
+		}
+		break;
+	case 2:
+		for (; w + 4 <= width; w += 4)
+		{
+			// even pixels to the low half, odd pixels to the high half
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w*4));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + w*4));
+			a = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+			b = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero)),
+										_mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)));
+			sum = _mm_srli_epi16(sum, 2);
+			_mm_storel_epi64((__m128i*)(out + w*2), _mm_packus_epi16(sum, sum));
+		}
+		break;
+	case 1:
+		{
+			const __m128i mask = _mm_set1_epi16(0x00ff);
+			for (; w + 16 <= width; w += 16)
+			{
+				const __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + w*2));
+				const __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + w*2 + 16));
+				const __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + w*2));
+				const __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + w*2 + 16));
+				__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8)),
+										   _mm_add_epi16(_mm_and_si128(b0, mask), _mm_srli_epi16(b0, 8)));
+				__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8)),
+										   _mm_add_epi16(_mm_and_si128(b1, mask), _mm_srli_epi16(b1, 8)));
+				lo = _mm_srli_epi16(lo, 2);
+				hi = _mm_srli_epi16(hi, 2);
+				_mm_storeu_si128((__m128i*)(out + w), _mm_packus_epi16(lo, hi));
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return w;
+}
+
+// AVX2 version of generate_mip_row() for 1 and 4 channels. The 256 bit
+// shuffles and packs work on each 128 bit half, so the result is put back
+// in order with a final cross lane permute.
+LL_TARGET_AVX2
+static S32 generate_mip_row_avx2(const U8* row0, const U8* row1, U8* out, S32 width, S32 nchannels)
+{
+	S32 w = 0;
+	const __m256i zero = _mm256_setzero_si256();
+	switch (nchannels)
+	{
+	case 4:
+		for (; w + 8 <= width; w += 8)
+		{
+			const __m256 a0 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(row0 + w*8)));
+			const __m256 a1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(row0 + w*8 + 32)));
+			const __m256 b0 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(row1 + w*8)));
+			const __m256 b1 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)(row1 + w*8 + 32)));
+			const __m256i ae = _mm256_castps_si256(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m256i ao = _mm256_castps_si256(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+			const __m256i be = _mm256_castps_si256(_mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m256i bo = _mm256_castps_si256(_mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+			__m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(ae, zero), _mm256_unpacklo_epi8(ao, zero)),
+										  _mm256_add_epi16(_mm256_unpacklo_epi8(be, zero), _mm256_unpacklo_epi8(bo, zero)));
+			__m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(ae, zero), _mm256_unpackhi_epi8(ao, zero)),
+										  _mm256_add_epi16(_mm256_unpackhi_epi8(be, zero), _mm256_unpackhi_epi8(bo, zero)));
+			lo = _mm256_srli_epi16(lo, 2);
+			hi = _mm256_srli_epi16(hi, 2);
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)(out + w*4), packed);
+		}
+		break;
+	case 1:
+		{
+			const __m256i mask = _mm256_set1_epi16(0x00ff);
+			for (; w + 32 <= width; w += 32)
+			{
+				const __m256i a0 = _mm256_loadu_si256((const __m256i*)(row0 + w*2));
+				const __m256i a1 = _mm256_loadu_si256((const __m256i*)(row0 + w*2 + 32));
+				const __m256i b0 = _mm256_loadu_si256((const __m256i*)(row1 + w*2));
+				const __m256i b1 = _mm256_loadu_si256((const __m256i*)(row1 + w*2 + 32));
+				__m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a0, mask), _mm256_srli_epi16(a0, 8)),
+											  _mm256_add_epi16(_mm256_and_si256(b0, mask), _mm256_srli_epi16(b0, 8)));
+				__m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a1, mask), _mm256_srli_epi16(a1, 8)),
+											  _mm256_add_epi16(_mm256_and_si256(b1, mask), _mm256_srli_epi16(b1, 8)));
+				lo = _mm256_srli_epi16(lo, 2);
+				hi = _mm256_srli_epi16(hi, 2);
+				const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256((__m256i*)(out + w), packed);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return w;
+}
+#endif // LL_IMAGE_SSE2
+
 //static
 void LLImageBase::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
 {
 	llassert(width > 0 && height > 0);
-	U8* data = mipdata;
-	S32 in_width = width*2;
+#if LL_IMAGE_SSE2
+	const LLImage::ESIMDLevel level = LLImage::getSIMDLevel();
+#endif
+	const S32 in_stride = width*2*nchannels;
 	for (S32 h=0; h<height; h++)
 	{
-		for (S32 w=0; w<width; w++)
+		const U8* row0 = indata + h*2*in_stride;
+		const U8* row1 = row0 + in_stride; // odd lines are only read here
+		U8* out = mipdata + h*width*nchannels;
+		S32 w = 0;
+#if LL_IMAGE_SSE2
+		if (level >= LLImage::SIMD_AVX2)
 		{
-			switch(nchannels)
-			{
-			  case 4:
-				avg4_colors4(indata, indata+4, indata+4*in_width, indata+4*in_width+4, data);
-				break;
-			  case 3:
-				avg4_colors3(indata, indata+3, indata+3*in_width, indata+3*in_width+3, data);
-				break;
-			  case 2:
-				avg4_colors2(indata, indata+2, indata+2*in_width, indata+2*in_width+2, data);
-				break;
-			  case 1:
-				*(U8*)data = (U8)(((U32)(indata[0]) + indata[1] + indata[in_width] + indata[in_width+1])>>2);
-				break;
-			  default:
-				LL_ERRS() << "generateMmip called with bad num channels" << LL_ENDL;
-			}
-			indata += nchannels*2;
-			data += nchannels;
+			w = generate_mip_row_avx2(row0, row1, out, width, nchannels);
+		}
+		if (level >= LLImage::SIMD_SSE2)
+		{
+			w = generate_mip_row_sse2(row0, row1, out, w, width, nchannels);
 		}
-		indata += nchannels*in_width; // skip odd lines
+#endif
+		generate_mip_row(row0, row1, out, w, width, nchannels);
 	}
 }
 
@@ -32,6 +32,14 @@
 #include "llpointer.h"
 #include "lltrace.h"
 
+// SSE2 versions of the pixel kernels are built in. The x86 builds require
+// SSE2 so this is only off for other architectures.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LL_IMAGE_SSE2 1
+#else
+#define LL_IMAGE_SSE2 0
+#endif
+
 const S32 MIN_IMAGE_MIP =  2; // 4x4, only used for expand/contract power of 2
 const S32 MAX_IMAGE_MIP = 11; // 2048x2048
 
@@ -100,12 +108,28 @@ public:
 	
 	static bool useNewByteRange() { return sUseNewByteRange; }
 	static S32  getReverseByteRangePercent() { return sMinimalReverseByteRangePercent; }
+
+	// Instruction sets the pixel kernels (scaling, compositing, mip
+	// generation and filters) can use. The best one the CPU supports is used by
+	// default. Every level gives bit for bit the same results, forcing a
+	// lower one is only useful for testing and benchmarking.
+	enum ESIMDLevel
+	{
+		SIMD_SCALAR = 0,
+		SIMD_SSE2,
+		SIMD_AVX2
+	};
+	static ESIMDLevel getSIMDLevel() { return sSIMDLevel; }
+	static ESIMDLevel getMaxSIMDLevel();
+	static void setSIMDLevel(ESIMDLevel level); // clamped to getMaxSIMDLevel()
+	static const char* getSIMDLevelName(ESIMDLevel level);
 	
 protected:
 	static LLMutex* sMutex;
 	static std::string sLastErrorMessage;
 	static bool sUseNewByteRange;
     static S32  sMinimalReverseByteRangePercent;
+	static ESIMDLevel sSIMDLevel;
 };
 
 //============================================================================
@@ -150,6 +174,12 @@ public:
 protected:
 	// special accessor to allow direct setting of mData and mDataSize by LLImageFormatted
 	void setDataAndSize(U8 *data, S32 size);
+
+	// Where allocateData() and deleteData() get and return their buffers.
+	// Buffers must come from ll_aligned_malloc_16() so they can be
+	// handed between images.
+	virtual U8* allocateBuffer(S32 size);
+	virtual void freeBuffer(U8* data, S32 size);
 	
 public:
 	static void generateMip(const U8 *indata, U8* mipdata, int width, int height, S32 nchannels);
@@ -274,7 +304,15 @@ protected:
 
 	void setDataAndSize(U8 *data, S32 width, S32 height, S8 components) ;
 
+	// Reuse buffers from the raw buffer pool, decoded images come in a
+	// handful of sizes and churn constantly
+	/*virtual*/ U8* allocateBuffer(S32 size);
+	/*virtual*/ void freeBuffer(U8* data, S32 size);
+
 public:
+	// Free every buffer held by the raw buffer pool
+	static void purgeBufferPool();
+
 	static S32 sGlobalRawMemory;
 	static S32 sRawImageCount;
 
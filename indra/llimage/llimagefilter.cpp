@@ -36,6 +36,64 @@
 #include "llsdserialize.h"
 #include "llstring.h"
 
+#if LL_IMAGE_SSE2
+#include <emmintrin.h>
+
+// Red, green and blue of a pixel as float lanes, the last lane is 0
+inline __m128 load_rgb_ps(const U8* pixel)
+{
+    S32 packed = pixel[VRED] | (pixel[VGREEN] << 8) | (pixel[VBLUE] << 16);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+inline __m128 clamp_255_ps(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.f));
+}
+
+// LLVector3::clamp(0,255) followed by the conversion to the U8 arguments of blendStencil()
+inline __m128 clamp_truncate_ps(__m128 v)
+{
+    return _mm_cvtepi32_ps(_mm_cvttps_epi32(clamp_255_ps(v)));
+}
+
+// blendStencil() on the 3 lanes at once. Each lane goes through the same float operations
+// as the scalar code so the pixels come out identical.
+inline void blend_stencil_sse2(EStencilBlendMode mode, F32 alpha, U8* pixel, __m128 value)
+{
+    const F32 inv_alpha = 1.0 - alpha;
+    const __m128 a = _mm_set1_ps(alpha);
+    const __m128 inv_a = _mm_set1_ps(inv_alpha);
+    const __m128 background = load_rgb_ps(pixel);
+    __m128 result;
+    switch (mode)
+    {
+        case STENCIL_BLEND_MODE_BLEND:
+            result = _mm_add_ps(_mm_mul_ps(inv_a, background), _mm_mul_ps(a, value));
+            break;
+        case STENCIL_BLEND_MODE_ADD:
+            result = clamp_255_ps(_mm_add_ps(background, _mm_mul_ps(a, value)));
+            break;
+        case STENCIL_BLEND_MODE_ABACK:
+            result = clamp_255_ps(_mm_add_ps(_mm_mul_ps(inv_a, background), value));
+            break;
+        case STENCIL_BLEND_MODE_FADE:
+            result = _mm_mul_ps(a, value);
+            break;
+        default:
+            return;
+    }
+    __m128i bytes = _mm_and_si128(_mm_cvttps_epi32(result), _mm_set1_epi32(0xff));
+    bytes = _mm_packs_epi32(bytes, bytes);
+    S32 packed = _mm_cvtsi128_si32(_mm_packus_epi16(bytes, bytes));
+    pixel[VRED]   = (U8)(packed);
+    pixel[VGREEN] = (U8)(packed >> 8);
+    pixel[VBLUE]  = (U8)(packed >> 16);
+}
+#endif // LL_IMAGE_SSE2
+
 //---------------------------------------------------------------------------
 // LLImageFilter
 //---------------------------------------------------------------------------
@@ -76,7 +134,6 @@ LLImageFilter::~LLImageFilter()
 /*
  *TODO 
  * Rename stencil to mask
- * Improve perf: use LUT for alpha blending in uniform case
  * Add gradient coloring as a filter
  */
 
@@ -269,6 +326,9 @@ void LLImageFilter::executeFilter(LLPointer<LLImageRaw> raw_image)
             LL_WARNS() << "Filter unknown, cannot execute filter command : " << filter_name << LL_ENDL;
         }
     }
+
+    // Run whatever point operations are still queued
+    flushPointOps();
 }
 
 //============================================================================
@@ -309,44 +369,130 @@ void LLImageFilter::blendStencil(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue
 
 void LLImageFilter::colorCorrect(const U8* lut_red, const U8* lut_green, const U8* lut_blue)
 {
-	const S32 components = mImage->getComponents();
-	llassert( components >= 1 && components <= 4 );
-    
-	S32 width  = mImage->getWidth();
-    S32 height = mImage->getHeight();
-    
-	U8* dst_data = mImage->getData();
-	for (S32 j = 0; j < height; j++)
-	{
-        for (S32 i = 0; i < width; i++)
+    mPointOps.push_back(PointOp());
+    PointOp& op = mPointOps.back();
+    op.mIsLUT = true;
+    op.mBlended = false;
+    memcpy(op.mLUT[VRED], lut_red, 256);	/* Flawfinder: ignore */
+    memcpy(op.mLUT[VGREEN], lut_green, 256);	/* Flawfinder: ignore */
+    memcpy(op.mLUT[VBLUE], lut_blue, 256);	/* Flawfinder: ignore */
+}
+
+void LLImageFilter::colorTransform(const LLMatrix3 &transform)
+{
+    mPointOps.push_back(PointOp());
+    PointOp& op = mPointOps.back();
+    op.mIsLUT = false;
+    op.mBlended = false;
+    op.mTransform = transform;
+    for (S32 k = 0; k < 3; k++)
+    {
+        for (S32 c = 0; c < 3; c++)
         {
-            // Blend LUT value
-            blendStencil(getStencilAlpha(i,j), dst_data, lut_red[dst_data[VRED]], lut_green[dst_data[VGREEN]], lut_blue[dst_data[VBLUE]]);
-            dst_data += components;
+            op.mRows[k][c] = transform.mMatrix[k][c];
         }
-	}
+        op.mRows[k][3] = 0.f;
+    }
 }
 
-void LLImageFilter::colorTransform(const LLMatrix3 &transform)
+void LLImageFilter::flushPointOps()
 {
+    if (mPointOps.empty())
+    {
+        return;
+    }
+
+    // Compile the queue. Under a uniform stencil the blend is the same for every pixel, so
+    // it is folded into the lookup tables and consecutive tables are composed into one.
+    const bool uniform = (mStencilShape == STENCIL_SHAPE_UNIFORM);
+    const F32 uniform_alpha = getStencilAlpha(0,0);
+    std::vector<PointOp> ops;
+    ops.reserve(mPointOps.size());
+    for (size_t k = 0; k < mPointOps.size(); k++)
+    {
+        PointOp& op = mPointOps[k];
+        if (op.mIsLUT && uniform)
+        {
+            for (S32 v = 0; v < 256; v++)
+            {
+                U8 pixel[3] = { (U8)(v), (U8)(v), (U8)(v) };
+                blendStencil(uniform_alpha, pixel, op.mLUT[VRED][v], op.mLUT[VGREEN][v], op.mLUT[VBLUE][v]);
+                op.mLUT[VRED][v]   = pixel[VRED];
+                op.mLUT[VGREEN][v] = pixel[VGREEN];
+                op.mLUT[VBLUE][v]  = pixel[VBLUE];
+            }
+            op.mBlended = true;
+            if (!ops.empty() && ops.back().mBlended)
+            {
+                PointOp& prev = ops.back();
+                for (S32 c = 0; c < 3; c++)
+                {
+                    for (S32 v = 0; v < 256; v++)
+                    {
+                        prev.mLUT[c][v] = op.mLUT[c][prev.mLUT[c][v]];
+                    }
+                }
+                continue;
+            }
+        }
+        ops.push_back(op);
+    }
+    mPointOps.clear();
+
+    // Run all of them on each pixel in turn
 	const S32 components = mImage->getComponents();
-	llassert( components >= 1 && components <= 4 );
+	llassert( components >= 3 && components <= 4 );
     
 	S32 width  = mImage->getWidth();
     S32 height = mImage->getHeight();
+    const size_t nb_ops = ops.size();
+#if LL_IMAGE_SSE2
+    const bool use_sse2 = (LLImage::getSIMDLevel() >= LLImage::SIMD_SSE2);
+#endif
     
 	U8* dst_data = mImage->getData();
 	for (S32 j = 0; j < height; j++)
 	{
         for (S32 i = 0; i < width; i++)
         {
-            // Compute transform
-            LLVector3 src((F32)(dst_data[VRED]),(F32)(dst_data[VGREEN]),(F32)(dst_data[VBLUE]));
-            LLVector3 dst = src * transform;
-            dst.clamp(0.0f,255.0f);
-            
-            // Blend result
-            blendStencil(getStencilAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
+            // The stencil doesn't change within the queue
+            F32 alpha = (uniform ? uniform_alpha : getStencilAlpha(i,j));
+            for (size_t k = 0; k < nb_ops; k++)
+            {
+                const PointOp& op = ops[k];
+                if (op.mBlended)
+                {
+                    dst_data[VRED]   = op.mLUT[VRED][dst_data[VRED]];
+                    dst_data[VGREEN] = op.mLUT[VGREEN][dst_data[VGREEN]];
+                    dst_data[VBLUE]  = op.mLUT[VBLUE][dst_data[VBLUE]];
+                }
+                else if (op.mIsLUT)
+                {
+                    // Blend LUT value
+                    blendStencil(alpha, dst_data, op.mLUT[VRED][dst_data[VRED]], op.mLUT[VGREEN][dst_data[VGREEN]], op.mLUT[VBLUE][dst_data[VBLUE]]);
+                }
+#if LL_IMAGE_SSE2
+                else if (use_sse2)
+                {
+                    // Same operation order as LLVector3 * LLMatrix3
+                    const __m128 src = load_rgb_ps(dst_data);
+                    __m128 dst = _mm_mul_ps(_mm_shuffle_ps(src, src, _MM_SHUFFLE(0,0,0,0)), _mm_loadu_ps(op.mRows[VX]));
+                    dst = _mm_add_ps(dst, _mm_mul_ps(_mm_shuffle_ps(src, src, _MM_SHUFFLE(1,1,1,1)), _mm_loadu_ps(op.mRows[VY])));
+                    dst = _mm_add_ps(dst, _mm_mul_ps(_mm_shuffle_ps(src, src, _MM_SHUFFLE(2,2,2,2)), _mm_loadu_ps(op.mRows[VZ])));
+                    blend_stencil_sse2(mStencilBlendMode, alpha, dst_data, clamp_truncate_ps(dst));
+                }
+#endif
+                else
+                {
+                    // Compute transform
+                    LLVector3 src((F32)(dst_data[VRED]),(F32)(dst_data[VGREEN]),(F32)(dst_data[VBLUE]));
+                    LLVector3 dst = src * op.mTransform;
+                    dst.clamp(0.0f,255.0f);
+                    
+                    // Blend result
+                    blendStencil(alpha, dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
+                }
+            }
             dst_data += components;
         }
 	}
@@ -354,6 +500,9 @@ void LLImageFilter::colorTransform(const LLMatrix3 &transform)
 
 void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_value)
 {
+    // Neighbouring pixels must have all the previous operations applied
+    flushPointOps();
+
 	const S32 components = mImage->getComponents();
 	llassert( components >= 1 && components <= 4 );
     
@@ -378,6 +527,20 @@ void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_v
         kernel_min = 0.0;
     }
     F32 kernel_range = kernel_max - kernel_min;
+#if LL_IMAGE_SSE2
+    const bool use_sse2 = (LLImage::getSIMDLevel() >= LLImage::SIMD_SSE2);
+    __m128 kernel_ps[NUM_VALUES_IN_MAT3][NUM_VALUES_IN_MAT3];
+    for (S32 i = 0; i < NUM_VALUES_IN_MAT3; i++)
+    {
+        for (S32 j = 0; j < NUM_VALUES_IN_MAT3; j++)
+        {
+            kernel_ps[i][j] = _mm_set1_ps(kernel.mMatrix[i][j]);
+        }
+    }
+    const __m128 kernel_min_ps = _mm_set1_ps(kernel_min);
+    const __m128 kernel_range_ps = _mm_set1_ps(kernel_range);
+    const __m128 sign_mask = _mm_set1_ps(-0.f);
+#endif
     
     // Allocate temporary buffers and initialize algorithm's data
 	S32 width  = mImage->getWidth();
@@ -435,33 +598,60 @@ void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_v
         // All other pixels
         for (S32 i = 1; i < (width-1); i++)
         {
-            // Compute convolution
-            LLVector3 dst;
-            dst.mV[VRED] = (kernel.mMatrix[0][0]*NW[VRED] + kernel.mMatrix[0][1]*N[VRED] + kernel.mMatrix[0][2]*NE[VRED] +
-                            kernel.mMatrix[1][0]*W[VRED]  + kernel.mMatrix[1][1]*C[VRED] + kernel.mMatrix[1][2]*E[VRED] +
-                            kernel.mMatrix[2][0]*SW[VRED] + kernel.mMatrix[2][1]*S[VRED] + kernel.mMatrix[2][2]*SE[VRED]);
-            dst.mV[VGREEN] = (kernel.mMatrix[0][0]*NW[VGREEN] + kernel.mMatrix[0][1]*N[VGREEN] + kernel.mMatrix[0][2]*NE[VGREEN] +
-                              kernel.mMatrix[1][0]*W[VGREEN]  + kernel.mMatrix[1][1]*C[VGREEN] + kernel.mMatrix[1][2]*E[VGREEN] +
-                              kernel.mMatrix[2][0]*SW[VGREEN] + kernel.mMatrix[2][1]*S[VGREEN] + kernel.mMatrix[2][2]*SE[VGREEN]);
-            dst.mV[VBLUE] = (kernel.mMatrix[0][0]*NW[VBLUE] + kernel.mMatrix[0][1]*N[VBLUE] + kernel.mMatrix[0][2]*NE[VBLUE] +
-                             kernel.mMatrix[1][0]*W[VBLUE]  + kernel.mMatrix[1][1]*C[VBLUE] + kernel.mMatrix[1][2]*E[VBLUE] +
-                             kernel.mMatrix[2][0]*SW[VBLUE] + kernel.mMatrix[2][1]*S[VBLUE] + kernel.mMatrix[2][2]*SE[VBLUE]);
-            if (abs_value)
+#if LL_IMAGE_SSE2
+            if (use_sse2)
             {
-                dst.mV[VRED]   = llabs(dst.mV[VRED]);
-                dst.mV[VGREEN] = llabs(dst.mV[VGREEN]);
-                dst.mV[VBLUE]  = llabs(dst.mV[VBLUE]);
+                // The 3 channels at once, summed in the same order as below
+                __m128 sum = _mm_mul_ps(kernel_ps[0][0], load_rgb_ps(NW));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[0][1], load_rgb_ps(N)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[0][2], load_rgb_ps(NE)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[1][0], load_rgb_ps(W)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[1][1], load_rgb_ps(C)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[1][2], load_rgb_ps(E)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[2][0], load_rgb_ps(SW)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[2][1], load_rgb_ps(S)));
+                sum = _mm_add_ps(sum, _mm_mul_ps(kernel_ps[2][2], load_rgb_ps(SE)));
+                if (abs_value)
+                {
+                    sum = _mm_andnot_ps(sign_mask, sum);
+                }
+                if (normalize)
+                {
+                    sum = _mm_div_ps(_mm_sub_ps(sum, kernel_min_ps), kernel_range_ps);
+                }
+                blend_stencil_sse2(mStencilBlendMode, getStencilAlpha(i,j), dst_data, clamp_truncate_ps(sum));
             }
-            if (normalize)
+            else
+#endif
             {
-                dst.mV[VRED]   = (dst.mV[VRED] - kernel_min)/kernel_range;
-                dst.mV[VGREEN] = (dst.mV[VGREEN] - kernel_min)/kernel_range;
-                dst.mV[VBLUE]  = (dst.mV[VBLUE] - kernel_min)/kernel_range;
+                // Compute convolution
+                LLVector3 dst;
+                dst.mV[VRED] = (kernel.mMatrix[0][0]*NW[VRED] + kernel.mMatrix[0][1]*N[VRED] + kernel.mMatrix[0][2]*NE[VRED] +
+                                kernel.mMatrix[1][0]*W[VRED]  + kernel.mMatrix[1][1]*C[VRED] + kernel.mMatrix[1][2]*E[VRED] +
+                                kernel.mMatrix[2][0]*SW[VRED] + kernel.mMatrix[2][1]*S[VRED] + kernel.mMatrix[2][2]*SE[VRED]);
+                dst.mV[VGREEN] = (kernel.mMatrix[0][0]*NW[VGREEN] + kernel.mMatrix[0][1]*N[VGREEN] + kernel.mMatrix[0][2]*NE[VGREEN] +
+                                  kernel.mMatrix[1][0]*W[VGREEN]  + kernel.mMatrix[1][1]*C[VGREEN] + kernel.mMatrix[1][2]*E[VGREEN] +
+                                  kernel.mMatrix[2][0]*SW[VGREEN] + kernel.mMatrix[2][1]*S[VGREEN] + kernel.mMatrix[2][2]*SE[VGREEN]);
+                dst.mV[VBLUE] = (kernel.mMatrix[0][0]*NW[VBLUE] + kernel.mMatrix[0][1]*N[VBLUE] + kernel.mMatrix[0][2]*NE[VBLUE] +
+                                 kernel.mMatrix[1][0]*W[VBLUE]  + kernel.mMatrix[1][1]*C[VBLUE] + kernel.mMatrix[1][2]*E[VBLUE] +
+                                 kernel.mMatrix[2][0]*SW[VBLUE] + kernel.mMatrix[2][1]*S[VBLUE] + kernel.mMatrix[2][2]*SE[VBLUE]);
+                if (abs_value)
+                {
+                    dst.mV[VRED]   = llabs(dst.mV[VRED]);
+                    dst.mV[VGREEN] = llabs(dst.mV[VGREEN]);
+                    dst.mV[VBLUE]  = llabs(dst.mV[VBLUE]);
+                }
+                if (normalize)
+                {
+                    dst.mV[VRED]   = (dst.mV[VRED] - kernel_min)/kernel_range;
+                    dst.mV[VGREEN] = (dst.mV[VGREEN] - kernel_min)/kernel_range;
+                    dst.mV[VBLUE]  = (dst.mV[VBLUE] - kernel_min)/kernel_range;
+                }
+                dst.clamp(0.0f,255.0f);
+                
+                // Blend result
+                blendStencil(getStencilAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
             }
-            dst.clamp(0.0f,255.0f);
-            
-            // Blend result
-            blendStencil(getStencilAlpha(i,j), dst_data, dst.mV[VRED], dst.mV[VGREEN], dst.mV[VBLUE]);
             
             // Next pixel
             dst_data += components;
@@ -491,6 +681,8 @@ void LLImageFilter::convolve(const LLMatrix3 &kernel, bool normalize, bool abs_v
 
 void LLImageFilter::filterScreen(EScreenMode mode, const F32 wave_length, const F32 angle)
 {
+    flushPointOps();
+
 	const S32 components = mImage->getComponents();
 	llassert( components >= 1 && components <= 4 );
     
@@ -544,6 +736,9 @@ void LLImageFilter::filterScreen(EScreenMode mode, const F32 wave_length, const
 //============================================================================
 void LLImageFilter::setStencil(EStencilShape shape, EStencilBlendMode mode, F32 min, F32 max, F32* params)
 {
+    // Queued operations use the stencil they were queued under
+    flushPointOps();
+
     mStencilShape = shape;
     mStencilBlendMode = mode;
     mStencilMin = llmin(llmax(min, -1.0f), 1.0f);
@@ -610,6 +805,8 @@ U32* LLImageFilter::getBrightnessHistogram()
 
 void LLImageFilter::computeHistograms()
 {
+    flushPointOps();
+
  	const S32 components = mImage->getComponents();
 	llassert( components >= 1 && components <= 4 );
     
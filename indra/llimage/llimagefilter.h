@@ -30,10 +30,13 @@
 #include "llsd.h"
 #include "llimage.h"
 
+#include <vector>
+
+#include "m3math.h"
+
 class LLImageRaw;
 class LLColor4U;
 class LLColor3;
-class LLMatrix3;
 
 typedef enum e_stencil_blend_mode
 {
@@ -88,8 +91,11 @@ private:
     void filterBrightness(F32 add, const LLColor3& alpha);      // Change brightness according to add: > 0 brighter, < 0 darker
     
     // Filter Primitives
+    // colorTransform() and colorCorrect() only queue their point operation. Queued operations
+    // are run together, in a single pass over the image, by flushPointOps().
     void colorTransform(const LLMatrix3 &transform);
     void colorCorrect(const U8* lut_red, const U8* lut_green, const U8* lut_blue);
+    void flushPointOps();
     void filterScreen(EScreenMode mode, const F32 wave_length, const F32 angle);
     void blendStencil(F32 alpha, U8* pixel, U8 red, U8 green, U8 blue);
     void convolve(const LLMatrix3 &kernel, bool normalize, bool abs_value);
@@ -105,6 +111,17 @@ private:
     LLSD mFilterData;
     LLPointer<LLImageRaw> mImage;
 
+    // Queued point operation : a per channel lookup table or a color matrix
+    struct PointOp
+    {
+        bool      mIsLUT;
+        bool      mBlended;     // Stencil blend already folded into the LUT
+        U8        mLUT[3][256];
+        LLMatrix3 mTransform;
+        F32       mRows[3][4];  // mTransform rows padded for SIMD
+    };
+    std::vector<PointOp> mPointOps;
+
     // Histograms (if we ever happen to need them)
     U32 *mHistoRed;
     U32 *mHistoGreen;
@@ -32,20 +32,65 @@
 
 //----------------------------------------------------------------------------
 
+// Requests with the same discard level are handed to a worker together so
+// it decodes them back to back instead of going back to the queue for each
+constexpr size_t DECODE_BATCH_SIZE = 4;
+
+// Keep enough requests in flight that workers never wait on the main thread
+constexpr S32 REQUESTS_IN_FLIGHT_PER_WORKER = 2;
+
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
-	: LLQueuedThread("imagedecode", threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, U32 pool_size)
+	: LLQueuedThread("imagedecode", threaded),
+	  mRequestsInFlight(0),
+	  mMaxRequestsInFlight(0)
 {
 	mCreationMutex = new LLMutex();
+
+	if (threaded)
+	{
+		if (pool_size == 0)
+		{
+			// leave some headroom for the main thread and the other workers
+			U32 num_cpus = gSysCPU.getNumCPUs();
+			pool_size = llmax(1U, num_cpus * 3 / 4);
+		}
+		LL_INFOS() << "Starting image decode pool with " << pool_size << " workers" << LL_ENDL;
+		// Decodes are short and posted in bursts, so let the workers keep
+		// their own deques rather than all waiting on one queue
+		mThreadPool.reset(new LL::ThreadPool("ImageDecode", pool_size, 1024 * 1024, true));
+		mThreadPool->start();
+		mMaxRequestsInFlight = pool_size * REQUESTS_IN_FLIGHT_PER_WORKER;
+	}
 }
 
 //virtual 
 LLImageDecodeThread::~LLImageDecodeThread()
 {
+	if (mThreadPool)
+	{
+		// joins the workers, so nothing touches mCompletedList after this
+		mThreadPool->close();
+	}
+	for (auto& completed : mCompletedList)
+	{
+		completed.first->deleteRequest();
+	}
+	mCompletedList.clear();
 	delete mCreationMutex ;
 }
 
-constexpr uint8_t MAX_THREADS_FALLBACK = 4;
+// ANY THREAD
+void LLImageDecodeThread::processBatch(const request_batch_t& batch)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
+	for (ImageRequest* req : batch)
+	{
+		bool result = req->processRequest();
+		LLMutexLock lock(&mCompletedMutex);
+		mCompletedList.push_back(std::make_pair(req, result));
+	}
+}
 
 // MAIN THREAD
 // virtual
@@ -53,74 +98,78 @@ S32 LLImageDecodeThread::update(F32 max_time_ms)
 {
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
 
-    std::vector< std::shared_future<FutureResult> > vctNew;
-
-    LLMutexLock lock(mCreationMutex);
-    vctNew.reserve(mRequests.size() / 3);
+    // Responders expect to be called on the main thread, so finished
+    // requests wait here until the next update
+    completed_list_t completed;
+    {
+        LLMutexLock lock(&mCompletedMutex);
+        completed.swap(mCompletedList);
+    }
+    for (auto& entry : completed)
+    {
+        entry.first->finishRequest(entry.second);
+        entry.first->deleteRequest();
+    }
+    mRequestsInFlight -= completed.size();
 
-    for( auto &f : mRequests )
+    // Pull the best candidates off the queue, grouping runs that share a
+    // discard level into batches
+    std::vector<request_batch_t> batches;
     {
-        auto ready = f.wait_for(std::chrono::microseconds(5));
-        if (ready == std::future_status::ready)
+        LLMutexLock lock(mCreationMutex);
+
+        S32 slots = mThreadPool ? mMaxRequestsInFlight - mRequestsInFlight : (S32)mCreationList.size();
+        S32 current_discard = 0;
+        while (slots > 0 && !mCreationList.empty())
         {
-            FutureResult res = f.get();
-            res.mRequest->finishRequest(res.mRequestResult);
+            const creation_info& info = *mCreationList.begin();
+            if (batches.empty() || batches.back().size() >= DECODE_BATCH_SIZE || info.discard != current_discard)
+            {
+                batches.push_back(request_batch_t());
+                current_discard = info.discard;
+            }
+            batches.back().push_back(new ImageRequest(info.handle, info.image, info.priority, info.discard,
+                                                      info.needs_aux, info.responder));
+            mCreationList.erase(mCreationList.begin());
+            --slots;
         }
-        else
-            vctNew.push_back(f);
     }
 
-    std::swap(vctNew, mRequests);
-
-    uint32_t numCPUS = gSysCPU.getNumCPUs();
-    uint32_t threadsToCreate = MAX_THREADS_FALLBACK;
-
-    if( numCPUS > 0 )
+    if (mThreadPool && !batches.empty())
     {
-        float fLoadAvg = gSysCPU.getLoadAvg();
-        float fTarget = 0.8; // 80% load
-        float fDiff = fTarget - fLoadAvg;
-        if(fDiff <= 0 )
-            threadsToCreate = 0;
-        else
+        // Hand the pool the whole update in one go: it deals the batches
+        // out across its workers' deques and idle workers steal the rest
+        std::vector<LL::ThreadPool::Work> work;
+        work.reserve(batches.size());
+        for (const request_batch_t& batch : batches)
+        {
+            mRequestsInFlight += batch.size();
+            work.emplace_back([this, batch]() { processBatch(batch); });
+        }
+        if (!mThreadPool->postBatch(std::move(work)))
         {
-            fDiff *= numCPUS;
-            threadsToCreate = static_cast< uint32_t  >( fDiff );
+            // pool closed because the app is shutting down, nothing was queued
+            for (const request_batch_t& batch : batches)
+            {
+                for (ImageRequest* req : batch)
+                {
+                    req->finishRequest(false);
+                    req->deleteRequest();
+                }
+                mRequestsInFlight -= batch.size();
+            }
         }
     }
-
-    // Create at least 1
-    if( mRequests.empty() && threadsToCreate == 0 )
-        threadsToCreate = 1;
-
-    if( mRequests.size() < threadsToCreate )
+    else
     {
-        auto newCreationList = mCreationList;
-        mCreationList.clear();
-
-        for(auto info: newCreationList)
+        // Not threaded: decode and finish right here
+        for (const request_batch_t& batch : batches)
         {
-            if(mRequests.size() < threadsToCreate)
+            for (ImageRequest* req : batch)
             {
-                ImageRequest *req = new ImageRequest(info.handle, info.image, info.priority, info.discard,
-                                                     info.needs_aux, info.responder);
-
-                std::shared_future<FutureResult> f = std::async(std::launch::async,
-                    [](ImageRequest *aReq) -> FutureResult {
-                        FutureResult res;
-                        res.mRequest = aReq;
-                        res.mRequestResult = aReq->processRequest();
-                        return res;
-                    }, req);
-
-                mRequests.emplace_back(f);
-            } else
-                mCreationList.emplace_back(info);
-            //bool res = addRequest(req);
-            //if (!res)
-            //{
-            //	LL_ERRS() << "request added after LLLFSThread::cleanupClass()" << LL_ENDL;
-            //}
+                req->finishRequest(req->processRequest());
+                req->deleteRequest();
+            }
         }
     }
 
@@ -134,7 +183,7 @@ LLImageDecodeThread::handle_t LLImageDecodeThread::decodeImage(LLImageFormatted*
     LL_PROFILE_ZONE_SCOPED_CATEGORY_TEXTURE;
 	LLMutexLock lock(mCreationMutex);
 	handle_t handle = generateHandle();
-	mCreationList.push_back(creation_info(handle, image, priority, discard, needs_aux, responder));
+	mCreationList.insert(creation_info(handle, image, priority, discard, needs_aux, responder));
 	return handle;
 }
 
@@ -30,7 +30,9 @@
 #include "llimage.h"
 #include "llpointer.h"
 #include "llworkerthread.h"
-#include <future>
+#include "threadpool.h"
+#include <memory>
+#include <set>
 
 
 class LLImageDecodeThread : public LLQueuedThread
@@ -46,6 +48,7 @@ public:
 
 	class ImageRequest : public LLQueuedThread::QueuedRequest
 	{
+		friend class LLImageDecodeThread; // for deleteRequest()
 	protected:
 		virtual ~ImageRequest(); // use deleteRequest()
 		
@@ -74,7 +77,9 @@ public:
 	};
 	
 public:
-	LLImageDecodeThread(bool threaded = true);
+	// pool_size is the number of decode workers, 0 picks one based on the
+	// number of cores. Ignored when not threaded.
+	LLImageDecodeThread(bool threaded = true, U32 pool_size = 0);
 	virtual ~LLImageDecodeThread();
 
 	handle_t decodeImage(LLImageFormatted* image,
@@ -98,17 +103,41 @@ private:
 			: handle(h), image(i), priority(p), discard(d), needs_aux(aux), responder(r)
 		{}
 	};
-	typedef std::list<creation_info> creation_list_t;
+	// Pending requests are decoded highest priority first. Within a
+	// priority, coarser discard levels (smaller, cheaper decodes) go
+	// first, which also lines up requests that can share a batch.
+	struct creation_less
+	{
+		bool operator()(const creation_info& lhs, const creation_info& rhs) const
+		{
+			if (lhs.priority != rhs.priority)
+			{
+				return lhs.priority > rhs.priority;
+			}
+			if (lhs.discard != rhs.discard)
+			{
+				return lhs.discard > rhs.discard;
+			}
+			return lhs.handle < rhs.handle;
+		}
+	};
+	typedef std::set<creation_info, creation_less> creation_list_t;
 	creation_list_t mCreationList;
 	LLMutex* mCreationMutex;
 
-    struct FutureResult
-    {
-        ImageRequest  *mRequest = nullptr;
-        bool mRequestResult = false;
-    };
+	typedef std::vector<ImageRequest*> request_batch_t;
+	void processBatch(const request_batch_t& batch);
+
+	// Decode workers, null when not threaded
+	std::unique_ptr<LL::ThreadPool> mThreadPool;
+	// Requests handed to the pool and not yet finished (main thread only)
+	S32 mRequestsInFlight;
+	S32 mMaxRequestsInFlight;
 
-    std::vector< std::shared_future< FutureResult > > mRequests;
+	// Decoded on a worker, waiting for update() to finish them on the main thread
+	typedef std::vector<std::pair<ImageRequest*, bool> > completed_list_t;
+	completed_list_t mCompletedList;
+	LLMutex mCompletedMutex;
 };
 
 #endif
@@ -60,12 +60,16 @@ void LLImageBase::sanityCheck() { }
 void LLImageBase::deleteData() { }
 U8* LLImageBase::allocateData(S32 size) { return NULL; }
 U8* LLImageBase::reallocateData(S32 size) { return NULL; }
+U8* LLImageBase::allocateBuffer(S32 size) { return NULL; }
+void LLImageBase::freeBuffer(U8* data, S32 size) { }
 
 LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components) { }
 LLImageRaw::~LLImageRaw() { }
 void LLImageRaw::deleteData() { }
 U8* LLImageRaw::allocateData(S32 size) { return NULL; }
 U8* LLImageRaw::reallocateData(S32 size) { return NULL; }
+U8* LLImageRaw::allocateBuffer(S32 size) { return NULL; }
+void LLImageRaw::freeBuffer(U8* data, S32 size) { }
 const U8* LLImageBase::getData() const { return NULL; }
 U8* LLImageBase::getData() { return NULL; }
 
@@ -289,6 +289,65 @@ S32 LLCamera::AABBInFrustumNoFarClip(const LLVector4a& center, const LLVector4a&
 	return result?1:2;
 }
 
+// Structure of arrays version of the above, each lane does the same
+// arithmetic in the same order as the scalar test so results match exactly
+void LLCamera::AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results, bool no_far_clip, const LLPlane* planes)
+{
+	if(!planes)
+	{
+		//use agent space
+		planes = mAgentPlanes;
+	}
+
+	U32 outside = 0;
+	U32 crossing = 0;
+	LLVector4a rscale, px, py, pz, d, dot, term;
+	LLVector4a minp[3];
+	LLVector4a maxp[3];
+	U32 max_planes = llmin(mPlaneCount, (U32) AGENT_PLANE_USER_CLIP_NUM);		// mAgentPlanes[] size is 7
+	for (U32 i = 0; i < max_planes; i++)
+	{
+		U8 mask = mPlaneMask[i];
+		if ((!no_far_clip || i != 5) && (mask < PLANE_MASK_NUM))
+		{
+			const LLPlane& p(planes[i]);
+			const LLVector4a& scaler = sFrustumScaler[mask];
+			for (U32 axis = 0; axis < 3; axis++)
+			{
+				LLVector4a s;
+				s.splat(scaler[axis]);
+				rscale.setMul(radius[axis], s);
+				minp[axis].setSub(center[axis], rscale);
+				maxp[axis].setAdd(center[axis], rscale);
+			}
+			px.splat(p[0]);
+			py.splat(p[1]);
+			pz.splat(p[2]);
+			d.splat(-p[3]);
+
+			dot.setMul(px, minp[0]);
+			term.setMul(py, minp[1]);
+			dot.add(term);
+			term.setMul(pz, minp[2]);
+			dot.add(term);
+			outside |= dot.greaterThan(d).getGatheredBits();
+
+			dot.setMul(px, maxp[0]);
+			term.setMul(py, maxp[1]);
+			dot.add(term);
+			term.setMul(pz, maxp[2]);
+			dot.add(term);
+			crossing |= dot.greaterThan(d).getGatheredBits();
+		}
+	}
+
+	for (U32 lane = 0; lane < 4; lane++)
+	{
+		U32 bit = 1 << lane;
+		results[lane] = (outside & bit) ? 0 : ((crossing & bit) ? 1 : 2);
+	}
+}
+
 //exactly same as the function AABBInFrustumNoFarClip(...)
 //except uses mRegionPlanes instead of mAgentPlanes.
 S32 LLCamera::AABBInRegionFrustumNoFarClip(const LLVector4a& center, const LLVector4a& radius) 
@@ -208,6 +208,10 @@ public:
 	S32 AABBInRegionFrustum(const LLVector4a& center, const LLVector4a& radius);
 	S32 AABBInFrustumNoFarClip(const LLVector4a& center, const LLVector4a& radius, const LLPlane* planes = NULL);
 	S32 AABBInRegionFrustumNoFarClip(const LLVector4a& center, const LLVector4a& radius);
+	// Same as AABBInFrustum() or AABBInFrustumNoFarClip() for four boxes at
+	// once. center and radius each point to three vectors holding the x, y
+	// and z of the four boxes, results gets one return value per box.
+	void AABBInFrustum4(const LLVector4a* center, const LLVector4a* radius, S32* results, bool no_far_clip = false, const LLPlane* planes = NULL);
 
 	//does a quick 'n dirty sphere-sphere check
 	S32 sphereInFrustumQuick(const LLVector3 &sphere_center, const F32 radius); 
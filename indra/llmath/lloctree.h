@@ -30,6 +30,7 @@
 #include "lltreenode.h"
 #include "v3math.h"
 #include "llvector4a.h"
+#include "llalignedarray.h"
 #include <vector>
 
 #define OCT_ERRS LL_WARNS("OctreeErrors")
@@ -107,12 +108,19 @@ public:
         NO_CHILD_NODES = 255 // Note: This is an U8 to match the max value in mChildMap[]
     };
 
+	enum
+	{
+		SHAPE_CHILDREN = 1,
+		SHAPE_DESCENDANTS = 2
+	};
+
 	LLOctreeNode(	const LLVector4a& center, 
 					const LLVector4a& size, 
 					BaseType* parent, 
 					U8 octant = NO_CHILD_NODES)
 	:	mParent((oct_node*)parent), 
-		mOctant(octant) 
+		mOctant(octant),
+		mShapeDirty(0)
 	{ 
 		llassert(size[0] >= gOctreeMinSize*0.5f);
 
@@ -157,6 +165,11 @@ public:
 	inline U8 getOctant() const							{ return mOctant; }
 	inline const oct_node*	getOctParent() const		{ return (const oct_node*) getParent(); }
 	inline oct_node* getOctParent() 					{ return (oct_node*) getParent(); }
+	// Whether the node's own child list (SHAPE_CHILDREN) or one further down
+	// (SHAPE_DESCENDANTS) changed since the flat copy last looked
+	inline bool isShapeDirty(U8 flags = SHAPE_CHILDREN | SHAPE_DESCENDANTS) const	{ return (mShapeDirty & flags) != 0; }
+	// Only for LLOctreeFlat, of which there is at most one per tree
+	inline void clearShapeDirty() const					{ mShapeDirty = 0; }
 	
 	U8 getOctant(const LLVector4a& pos) const			//get the octant pos is in
 	{
@@ -518,6 +531,7 @@ public:
 	{
 		mChildCount = 0;
 		memset(mChildMap, NO_CHILD_NODES, sizeof(mChildMap));
+		dirtyShape();
 	}
 
 	void validate()
@@ -580,6 +594,7 @@ public:
 		mChild[mChildCount] = child;
 		++mChildCount;
 		child->setParent(this);
+		dirtyShape();
 
 		if (!silent)
 		{
@@ -593,6 +608,8 @@ public:
 
 	void removeChild(S32 index, BOOL destroy = FALSE)
 	{
+		dirtyShape();
+
 		for (U32 i = 0; i < this->getListenerCount(); i++)
 		{
 			oct_listener* listener = getOctListener(i);
@@ -647,6 +664,18 @@ public:
 	}
 
 protected:
+	// Flag this node's child list as changed and its ancestors as having a
+	// change below them. Stops at the first ancestor already flagged, those
+	// above it are too until the flat copy clears them on its way down.
+	void dirtyShape()
+	{
+		mShapeDirty |= SHAPE_CHILDREN;
+		for (oct_node* node = mParent; node && !(node->mShapeDirty & SHAPE_DESCENDANTS); node = node->mParent)
+		{
+			node->mShapeDirty |= SHAPE_DESCENDANTS;
+		}
+	}
+
 	typedef enum
 	{
 		CENTER = 0,
@@ -666,6 +695,7 @@ protected:
     oct_node* mChild[8];
 	U8 mChildMap[8];
 	U32 mChildCount;
+	mutable U8 mShapeDirty;
 
 	element_list mData;
 }; 
@@ -832,6 +862,258 @@ public:
     }
 };
 
+// A contiguous copy of the shape of an octree for traversals that read it
+// every frame, like culling. The children of a node sit together in a block
+// of LANES or 2 * LANES entries, and the bounds of the nodes are kept as
+// structure of arrays, LANES nodes per group of LLVector4a, so all the
+// children of a node can be tested against a set of planes a few at a time
+// instead of one pointer chase at a time.
+//
+// The pointer tree stays the owner of the elements and the listeners. The
+// copy follows the nodes' shape flags to the child lists that changed and
+// only lays those out again, and its bounds are whatever the caller last
+// set, typically from the node's listener.
+template <class T, typename T_PTR>
+class LLOctreeFlat
+{
+public:
+	typedef LLOctreeNode<T, T_PTR> oct_node;
+
+	enum
+	{
+		LANES = 4,
+		// LLVector4a per group of LANES nodes: center x, y, z then size x, y, z
+		GROUP_STRIDE = 6
+	};
+
+	struct Node
+	{
+		const oct_node* mNode;	// NULL for padding
+		U32 mFirstChild;
+		U32 mChildCount;
+	};
+
+	LLOctreeFlat()
+	:	mRoot(NULL)
+	{
+	}
+
+	// Bring the copy up to date with the tree. on_node(node, index) is
+	// called for every node placed or moved so the caller can remember
+	// where it went and set its bounds.
+	template <typename ON_NODE>
+	void update(const oct_node* root, ON_NODE on_node)
+	{
+		if (root != mRoot || mNodes.empty())
+		{
+			mRoot = root;
+			mNodes.clear();
+			mBounds.resize(0);
+			mFreeBlocks[0].clear();
+			mFreeBlocks[1].clear();
+
+			const U32 index = allocBlock(1);
+			mNodes[index].mNode = root;
+			layout(index, on_node);
+		}
+		else if (root->isShapeDirty())
+		{
+			refresh(0, on_node);
+		}
+	}
+
+	// Ignored unless node is still at index, so a node that was dropped
+	// from the tree cannot clobber whatever took its place
+	void setBounds(U32 index, const oct_node* node, const LLVector4a& center, const LLVector4a& size)
+	{
+		if (index >= mNodes.size() || mNodes[index].mNode != node)
+		{
+			return;
+		}
+		LLVector4a* group = &mBounds[(index / LANES) * GROUP_STRIDE];
+		const U32 lane = index % LANES;
+		for (U32 axis = 0; axis < 3; ++axis)
+		{
+			group[axis].getF32ptr()[lane] = center[axis];
+			group[3 + axis].getF32ptr()[lane] = size[axis];
+		}
+	}
+
+	U32 getNodeCount() const					{ return (U32)mNodes.size(); }
+	const Node& getNode(U32 index) const		{ return mNodes[index]; }
+
+	// Centers then sizes, three LLVector4a each, of the group of LANES nodes
+	// starting at first, which must be a multiple of LANES
+	const LLVector4a* getGroupBounds(U32 first) const { return &mBounds[(first / LANES) * GROUP_STRIDE]; }
+
+private:
+	// Lay out the whole subtree of the node at index
+	template <typename ON_NODE>
+	void layout(U32 index, ON_NODE& on_node)
+	{
+		const oct_node* node = mNodes[index].mNode;
+		node->clearShapeDirty();
+		on_node(node, index);
+
+		const U32 count = node->getChildCount();
+		const U32 first = count ? allocBlock(count) : 0;
+		mNodes[index].mFirstChild = first;
+		mNodes[index].mChildCount = count;
+		for (U32 i = 0; i < count; ++i)
+		{
+			mNodes[first + i].mNode = node->getChild(i);
+			layout(first + i, on_node);
+		}
+	}
+
+	// Catch up with the changes flagged under the node at index
+	template <typename ON_NODE>
+	void refresh(U32 index, ON_NODE& on_node)
+	{
+		const oct_node* node = mNodes[index].mNode;
+		if (node->isShapeDirty(oct_node::SHAPE_CHILDREN))
+		{
+			relayoutChildren(index, on_node);
+		}
+		else
+		{
+			// Same children as last time, so they are all still alive
+			const Node entry = mNodes[index];
+			for (U32 i = 0; i < entry.mChildCount; ++i)
+			{
+				if (mNodes[entry.mFirstChild + i].mNode->isShapeDirty())
+				{
+					refresh(entry.mFirstChild + i, on_node);
+				}
+			}
+		}
+		node->clearShapeDirty();
+	}
+
+	// The node's child list changed. Children it had before keep their
+	// subtrees, new ones get laid out and the subtrees of the ones that
+	// left are freed. The old entries may point at deleted nodes, they are
+	// only compared, never followed. A new node reusing a deleted one's
+	// address is harmless since new nodes start out flagged.
+	template <typename ON_NODE>
+	void relayoutChildren(U32 index, ON_NODE& on_node)
+	{
+		const oct_node* node = mNodes[index].mNode;
+		const Node entry = mNodes[index];
+		Node old[2 * LANES];
+		for (U32 i = 0; i < entry.mChildCount; ++i)
+		{
+			old[i] = mNodes[entry.mFirstChild + i];
+		}
+
+		const U32 count = node->getChildCount();
+		U32 first = entry.mFirstChild;
+		if (entry.mChildCount)
+		{
+			freeBlock(entry.mFirstChild, entry.mChildCount);
+		}
+		if (count)
+		{
+			// Comes back out of the free list if the size class still fits
+			first = allocBlock(count);
+		}
+		mNodes[index].mFirstChild = count ? first : 0;
+		mNodes[index].mChildCount = count;
+
+		for (U32 i = 0; i < count; ++i)
+		{
+			const oct_node* child = node->getChild(i);
+			U32 j = 0;
+			while (j < entry.mChildCount && old[j].mNode != child)
+			{
+				++j;
+			}
+
+			if (j < entry.mChildCount)
+			{
+				mNodes[first + i] = old[j];
+				old[j].mNode = NULL;
+				on_node(child, first + i);
+				if (child->isShapeDirty())
+				{
+					refresh(first + i, on_node);
+				}
+			}
+			else
+			{
+				mNodes[first + i].mNode = child;
+				layout(first + i, on_node);
+			}
+		}
+
+		for (U32 j = 0; j < entry.mChildCount; ++j)
+		{
+			if (old[j].mNode)
+			{
+				freeSubtree(old[j]);
+			}
+		}
+	}
+
+	void freeSubtree(const Node& entry)
+	{
+		if (entry.mChildCount)
+		{
+			for (U32 i = 0; i < entry.mChildCount; ++i)
+			{
+				const Node child = mNodes[entry.mFirstChild + i];
+				freeSubtree(child);
+			}
+			freeBlock(entry.mFirstChild, entry.mChildCount);
+		}
+	}
+
+	static U32 sizeClass(U32 count)				{ return count > LANES ? 1 : 0; }
+
+	// A cleared block big enough for count children, starting on a LANES
+	// boundary
+	U32 allocBlock(U32 count)
+	{
+		const U32 size_class = sizeClass(count);
+		const U32 block_size = LANES << size_class;
+		U32 first;
+		if (!mFreeBlocks[size_class].empty())
+		{
+			first = mFreeBlocks[size_class].back();
+			mFreeBlocks[size_class].pop_back();
+		}
+		else
+		{
+			first = (U32)mNodes.size();
+			mNodes.resize(first + block_size);
+			mBounds.resize((U32)(mNodes.size() / LANES) * GROUP_STRIDE);
+		}
+
+		Node pad = { NULL, 0, 0 };
+		for (U32 i = 0; i < block_size; ++i)
+		{
+			mNodes[first + i] = pad;
+		}
+		return first;
+	}
+
+	void freeBlock(U32 first, U32 count)
+	{
+		const U32 size_class = sizeClass(count);
+		Node pad = { NULL, 0, 0 };
+		for (U32 i = 0; i < (U32)(LANES << size_class); ++i)
+		{
+			mNodes[first + i] = pad;
+		}
+		mFreeBlocks[size_class].push_back(first);
+	}
+
+	const oct_node* mRoot;
+	std::vector<Node> mNodes;
+	LLAlignedArray<LLVector4a, 64> mBounds;
+	std::vector<U32> mFreeBlocks[2];	// of LANES and 2 * LANES entries
+};
+
 //========================
 //		LLOctreeTraveler
 //========================
@@ -45,12 +45,17 @@
 #include "lloctree.h"
 #include "llvolume.h"
 #include "llvolumeoctree.h"
+#include "llvolumefacecache.h"
 #include "llstl.h"
 #include "llsdserialize.h"
 #include "llvector4a.h"
 #include "llmatrix4a.h"
 #include "llmeshoptimizer.h"
 #include "lltimer.h"
+#include "workqueue.h"
+
+#include <condition_variable>
+#include <mutex>
 
 #define DEBUG_SILHOUETTE_BINORMALS 0
 #define DEBUG_SILHOUETTE_NORMALS 0 // TomY: Use this to display normals using the silhouette
@@ -2040,7 +2045,72 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+std::atomic<S32> LLVolume::sNumMeshPoints(0);
+std::weak_ptr<LL::WorkQueue> LLVolume::sGenerationQueue;
+S32 LLVolume::sGenerationThreads = 0;
+LLVolumeFaceCache* LLVolume::sFaceCache = NULL;
+
+// Volumes with fewer mesh points than this build their faces serially, the
+// faces are too cheap to be worth handing to another thread
+const S32 MIN_PARALLEL_MESH_POINTS = 1024;
+
+namespace
+{
+	// Shared by the threads building the faces of one volume. Faces are
+	// claimed one at a time, so the thread that asked for the volume keeps
+	// building even if no worker picks the job up, and a worker that starts
+	// late finds nothing left to claim and never touches the volume.
+	class LLVolumeFaceJob
+	{
+	public:
+		LLVolumeFaceJob(LLVolume* volume, BOOL partial_build)
+		:	mVolume(volume),
+			mPartialBuild(partial_build),
+			mNumFaces((S32)volume->getVolumeFaces().size()),
+			mNextFace(0),
+			mFacesDone(0)
+		{
+		}
+
+		void build()
+		{
+			S32 built = 0;
+			for (S32 i = mNextFace++; i < mNumFaces; i = mNextFace++)
+			{
+				mVolume->getVolumeFaces()[i].create(mVolume, mPartialBuild);
+				++built;
+			}
+
+			if (built > 0 && (mFacesDone += built) == mNumFaces)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mCond.notify_all();
+			}
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCond.wait(lock, [this]() { return mFacesDone == mNumFaces; });
+		}
+
+	private:
+		LLVolume* mVolume;
+		const BOOL mPartialBuild;
+		const S32 mNumFaces;
+		std::atomic<S32> mNextFace;
+		std::atomic<S32> mFacesDone;
+		std::mutex mMutex;
+		std::condition_variable mCond;
+	};
+}
+
+//static
+void LLVolume::setGenerationQueue(const std::weak_ptr<LL::WorkQueue>& queue, S32 num_threads)
+{
+	sGenerationQueue = queue;
+	sGenerationThreads = num_threads;
+}
 
 LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
 	: mParams(params)
@@ -2386,7 +2456,29 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD with code " << uzip_result << " , will probably fetch from sim again." << LL_ENDL;
 		return false;
 	}
-	
+
+	return unpackVolumeFacesInternal(mdl);
+}
+
+bool LLVolume::unpackVolumeFaces(const U8* in, S32 size)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
+
+	//in is pointing at a zlib compressed block of LLSD
+	//decompress block
+	LLSD mdl;
+	U32 uzip_result = LLUZipHelper::unzip_llsd(mdl, in, size);
+	if (uzip_result != LLUZipHelper::ZR_OK)
+	{
+		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD with code " << uzip_result << " , will probably fetch from sim again." << LL_ENDL;
+		return false;
+	}
+
+	return unpackVolumeFacesInternal(mdl);
+}
+
+bool LLVolume::unpackVolumeFacesInternal(const LLSD& mdl)
+{
 	{
 		U32 face_count = mdl.size();
 
@@ -2804,6 +2896,22 @@ void LLVolume::createVolumeFaces()
 			partial_build = FALSE;
 			mVolumeFaces.resize(num_faces);
 		}
+
+		// Unique volumes are regenerated in place (flexis), sculpts and
+		// meshes get their faces from their assets
+		LLUUID cache_key;
+		const bool use_cache = sFaceCache && !partial_build && !mUnique
+			&& mParams.getSculptType() == LL_SCULPT_TYPE_NONE
+			&& mMesh.size() >= LLVolumeFaceCache::MIN_CACHED_MESH_POINTS;
+		if (use_cache)
+		{
+			cache_key = LLVolumeFaceCache::getKey(mParams, mDetail);
+			if (sFaceCache->fetch(cache_key, num_faces, mVolumeFaces))
+			{
+				return;
+			}
+		}
+
 		// Initialize volume faces with parameter data
 		for (S32 i = 0; i < (S32)mVolumeFaces.size(); i++)
 		{
@@ -2872,14 +2980,48 @@ void LLVolume::createVolumeFaces()
 			}
 		}
 
-		for (face_list_t::iterator iter = mVolumeFaces.begin();
-			 iter != mVolumeFaces.end(); ++iter)
+		if (sGenerationThreads > 0 && mVolumeFaces.size() > 1 && mMesh.size() >= MIN_PARALLEL_MESH_POINTS)
+		{
+			createVolumeFacesParallel(partial_build);
+		}
+		else
+		{
+			for (face_list_t::iterator iter = mVolumeFaces.begin();
+				 iter != mVolumeFaces.end(); ++iter)
+			{
+				(*iter).create(this, partial_build);
+			}
+		}
+
+		if (use_cache)
 		{
-			(*iter).create(this, partial_build);
+			sFaceCache->store(cache_key, mVolumeFaces);
 		}
 	}
 }
 
+void LLVolume::createVolumeFacesParallel(BOOL partial_build)
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_VOLUME
+
+	// Faces only read the shared mesh, profile and path and write
+	// themselves, and the scratch arrays used while building one are
+	// thread_local, so each face can go to a different thread.
+	std::shared_ptr<LLVolumeFaceJob> job = std::make_shared<LLVolumeFaceJob>(this, partial_build);
+
+	S32 helpers = llmin((S32)mVolumeFaces.size() - 1, sGenerationThreads);
+	for (S32 i = 0; i < helpers; ++i)
+	{
+		if (!LL::WorkQueue::postMaybe(sGenerationQueue, [job]() { job->build(); }))
+		{
+			break;
+		}
+	}
+
+	job->build();
+	job->wait();
+}
+
 
 inline LLVector4a sculpt_rgb_to_vector(U8 r, U8 g, U8 b)
 {
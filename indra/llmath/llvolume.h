@@ -27,7 +27,9 @@
 #ifndef LL_LLVOLUME_H
 #define LL_LLVOLUME_H
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 
 class LLProfileParams;
 class LLPathParams;
@@ -41,6 +43,12 @@ template <class T, typename T_PTR> class LLOctreeNode;
 class LLVolumeFace;
 class LLVolume;
 class LLVolumeTriangle;
+class LLVolumeFaceCache;
+
+namespace LL
+{
+	class WorkQueue;
+}
 
 #include "lluuid.h"
 #include "v4color.h"
@@ -1069,7 +1077,15 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static std::atomic<S32> sNumMeshPoints;
+
+	// When set, the faces of large volumes are built in parallel by the
+	// threads servicing this queue, see LLVolumeMgr::startGenerationThreads()
+	static void setGenerationQueue(const std::weak_ptr<LL::WorkQueue>& queue, S32 num_threads);
+
+	// When set, the faces of plain prims are looked up in and added to
+	// this cache instead of always being generated
+	static void setFaceCache(LLVolumeFaceCache* cache)		{ sFaceCache = cache; }
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -1100,12 +1116,18 @@ private:
 protected:
 	BOOL generate();
 	void createVolumeFaces();
+	void createVolumeFacesParallel(BOOL partial_build);
 public:
 	virtual bool unpackVolumeFaces(std::istream& is, S32 size);
+	// same as above but decompresses straight out of the caller's buffer
+	bool unpackVolumeFaces(const U8* in, S32 size);
 
 	virtual void setMeshAssetLoaded(BOOL loaded);
 	virtual BOOL isMeshAssetLoaded();
 
+ private:
+	bool unpackVolumeFacesInternal(const LLSD& mdl);
+
  protected:
 	BOOL mUnique;
 	F32 mDetail;
@@ -1122,6 +1144,10 @@ public:
 	BOOL mGenerateSingleFace;
 	face_list_t mVolumeFaces;
 
+	static std::weak_ptr<LL::WorkQueue> sGenerationQueue;
+	static S32 sGenerationThreads;
+	static LLVolumeFaceCache* sFaceCache;
+
 public:
 	LLVector4a* mHullPoints;
 	U16* mHullIndices;
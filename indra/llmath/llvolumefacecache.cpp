@@ -0,0 +1,311 @@
+/**
+ * @file llvolumefacecache.cpp
+ * @brief Cache of generated prim volume faces keyed by volume parameters
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumefacecache.h"
+#include "llvolume.h"
+
+// Bump whenever the packed layout or the face generation code changes, old
+// entries then simply stop matching any key
+const U32 VOLUME_FACE_CACHE_VERSION = 1;
+const U32 VOLUME_FACE_CACHE_MAGIC = 0x4656544c; // "LTVF"
+
+//static
+const S32 LLVolumeFaceCache::MIN_CACHED_MESH_POINTS = 512;
+
+namespace
+{
+	struct FaceHeader
+	{
+		S32 mID;
+		U32 mTypeMask;
+		S32 mBeginS;
+		S32 mBeginT;
+		S32 mNumS;
+		S32 mNumT;
+		S32 mNumVertices;
+		S32 mNumIndices;
+		S32 mNumEdges;
+	};
+
+	template <typename T>
+	void append(std::vector<U8>& data, const T* values, size_t count)
+	{
+		const U8* bytes = (const U8*)values;
+		data.insert(data.end(), bytes, bytes + sizeof(T) * count);
+	}
+
+	class Reader
+	{
+	public:
+		Reader(const U8* data, S32 size) : mData(data), mLeft(size) {}
+
+		template <typename T>
+		bool read(T* values, size_t count)
+		{
+			size_t bytes = sizeof(T) * count;
+			if (bytes > (size_t)mLeft)
+			{
+				return false;
+			}
+			// Through void* since T may be a non-trivial type like LLVector4a
+			memcpy((void*)values, mData, bytes);
+			mData += bytes;
+			mLeft -= (S32)bytes;
+			return true;
+		}
+
+		bool atEnd() const { return mLeft == 0; }
+
+	private:
+		const U8* mData;
+		S32 mLeft;
+	};
+}
+
+LLVolumeFaceCache::LLVolumeFaceCache(U32 max_memory_bytes, Store* store)
+:	mMemoryBytes(0),
+	mMaxMemoryBytes(max_memory_bytes),
+	mStore(store)
+{
+}
+
+LLVolumeFaceCache::~LLVolumeFaceCache()
+{
+	delete mStore;
+	mStore = NULL;
+}
+
+//static
+LLUUID LLVolumeFaceCache::getKey(const LLVolumeParams& params, F32 detail)
+{
+	const LLProfileParams& profile = params.getProfileParams();
+	const LLPathParams& path = params.getPathParams();
+
+	F32 values[] = {
+		profile.getBegin(), profile.getEnd(), profile.getHollow(),
+		path.getBegin(), path.getEnd(),
+		path.getScaleX(), path.getScaleY(),
+		path.getShearX(), path.getShearY(),
+		path.getTwistBegin(), path.getTwistEnd(),
+		path.getRadiusOffset(),
+		path.getTaperX(), path.getTaperY(),
+		path.getRevolutions(), path.getSkew(),
+		detail };
+	U8 types[] = { profile.getCurveType(), path.getCurveType(), params.getSculptType() };
+
+	std::string stream;
+	stream.append((const char*)&VOLUME_FACE_CACHE_VERSION, sizeof(VOLUME_FACE_CACHE_VERSION));
+	stream.append((const char*)values, sizeof(values));
+	stream.append((const char*)types, sizeof(types));
+	stream.append((const char*)params.getSculptID().mData, UUID_BYTES);
+
+	LLUUID key;
+	key.generate(stream);
+	return key;
+}
+
+bool LLVolumeFaceCache::fetch(const LLUUID& key, S32 num_faces, std::vector<LLVolumeFace>& faces)
+{
+	{
+		LLMutexLock lock(&mMutex);
+		entry_map_t::iterator iter = mEntries.find(key);
+		if (iter != mEntries.end())
+		{
+			mLRU.splice(mLRU.begin(), mLRU, iter->second.mLRU);
+			const std::vector<U8>& data = iter->second.mData;
+			return unpack(data.data(), (S32)data.size(), num_faces, faces);
+		}
+	}
+
+	if (!mStore)
+	{
+		return false;
+	}
+
+	std::vector<U8> data;
+	bool hit = mStore->read(key, [&](const U8* stored, S32 size)
+		{
+			if (!unpack(stored, size, num_faces, faces))
+			{
+				return false;
+			}
+			data.assign(stored, stored + size);
+			return true;
+		});
+
+	if (hit)
+	{
+		LLMutexLock lock(&mMutex);
+		insert(key, data);
+	}
+	return hit;
+}
+
+void LLVolumeFaceCache::store(const LLUUID& key, const std::vector<LLVolumeFace>& faces)
+{
+	std::vector<U8> data;
+	pack(faces, data);
+
+	if (mStore)
+	{
+		mStore->write(key, data);
+	}
+
+	LLMutexLock lock(&mMutex);
+	insert(key, data);
+}
+
+// Needs mMutex
+void LLVolumeFaceCache::insert(const LLUUID& key, std::vector<U8>& data)
+{
+	if (data.size() > mMaxMemoryBytes / 4)
+	{
+		// Would push out too much else
+		return;
+	}
+
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter != mEntries.end())
+	{
+		// Another thread generated the same volume
+		mLRU.splice(mLRU.begin(), mLRU, iter->second.mLRU);
+		return;
+	}
+
+	mLRU.push_front(key);
+	Entry& entry = mEntries[key];
+	entry.mData.swap(data);
+	entry.mLRU = mLRU.begin();
+	mMemoryBytes += (U32)entry.mData.size();
+
+	while (mMemoryBytes > mMaxMemoryBytes && !mLRU.empty())
+	{
+		entry_map_t::iterator oldest = mEntries.find(mLRU.back());
+		mMemoryBytes -= (U32)oldest->second.mData.size();
+		mEntries.erase(oldest);
+		mLRU.pop_back();
+	}
+}
+
+//static
+void LLVolumeFaceCache::pack(const std::vector<LLVolumeFace>& faces, std::vector<U8>& data)
+{
+	U32 header[] = { VOLUME_FACE_CACHE_MAGIC, VOLUME_FACE_CACHE_VERSION, (U32)faces.size() };
+	append(data, header, 3);
+
+	for (const LLVolumeFace& face : faces)
+	{
+		FaceHeader fh;
+		fh.mID = face.mID;
+		fh.mTypeMask = face.mTypeMask;
+		fh.mBeginS = face.mBeginS;
+		fh.mBeginT = face.mBeginT;
+		fh.mNumS = face.mNumS;
+		fh.mNumT = face.mNumT;
+		fh.mNumVertices = face.mNumVertices;
+		fh.mNumIndices = face.mNumIndices;
+		fh.mNumEdges = (S32)face.mEdge.size();
+		append(data, &fh, 1);
+
+		// extents and center
+		append(data, face.mExtents, 3);
+		append(data, face.mTexCoordExtents, 2);
+
+		append(data, face.mPositions, face.mNumVertices);
+		append(data, face.mNormals, face.mNumVertices);
+		append(data, face.mTexCoords, face.mNumVertices);
+		append(data, face.mIndices, face.mNumIndices);
+		append(data, face.mEdge.data(), face.mEdge.size());
+	}
+}
+
+//static
+bool LLVolumeFaceCache::unpack(const U8* data, S32 size, S32 num_faces, std::vector<LLVolumeFace>& faces)
+{
+	Reader reader(data, size);
+
+	U32 header[3];
+	if (!reader.read(header, 3)
+		|| header[0] != VOLUME_FACE_CACHE_MAGIC
+		|| header[1] != VOLUME_FACE_CACHE_VERSION
+		|| header[2] != (U32)num_faces)
+	{
+		return false;
+	}
+
+	std::vector<LLVolumeFace> unpacked(num_faces);
+	for (LLVolumeFace& face : unpacked)
+	{
+		FaceHeader fh;
+		if (!reader.read(&fh, 1)
+			|| fh.mNumVertices < 0 || fh.mNumVertices > 65536
+			|| fh.mNumIndices < 0 || fh.mNumIndices % 3 != 0
+			|| fh.mNumEdges < 0)
+		{
+			return false;
+		}
+
+		face.mID = fh.mID;
+		face.mTypeMask = fh.mTypeMask;
+		face.mBeginS = fh.mBeginS;
+		face.mBeginT = fh.mBeginT;
+		face.mNumS = fh.mNumS;
+		face.mNumT = fh.mNumT;
+
+		if (!reader.read(face.mExtents, 3) || !reader.read(face.mTexCoordExtents, 2))
+		{
+			return false;
+		}
+
+		face.resizeVertices(fh.mNumVertices);
+		face.resizeIndices(fh.mNumIndices);
+		if (face.mNumVertices != fh.mNumVertices || face.mNumIndices != fh.mNumIndices)
+		{
+			// Out of memory
+			return false;
+		}
+		face.mEdge.resize(fh.mNumEdges);
+
+		if (!reader.read(face.mPositions, fh.mNumVertices)
+			|| !reader.read(face.mNormals, fh.mNumVertices)
+			|| !reader.read(face.mTexCoords, fh.mNumVertices)
+			|| !reader.read(face.mIndices, fh.mNumIndices)
+			|| !reader.read(face.mEdge.data(), fh.mNumEdges))
+		{
+			return false;
+		}
+	}
+
+	if (!reader.atEnd())
+	{
+		return false;
+	}
+
+	faces.swap(unpacked);
+	return true;
+}
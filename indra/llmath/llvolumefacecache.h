@@ -0,0 +1,102 @@
+/**
+ * @file llvolumefacecache.h
+ * @brief Cache of generated prim volume faces keyed by volume parameters
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMEFACECACHE_H
+#define LL_LLVOLUMEFACECACHE_H
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "llmutex.h"
+#include "lluuid.h"
+
+class LLVolumeFace;
+class LLVolumeParams;
+
+// The geometry of a prim depends only on its volume parameters and level
+// of detail, so the faces LLVolume generates can be kept and reused under
+// a key derived from those. Entries are packed into a flat blob that is
+// kept in a bounded in-memory LRU and, when a Store is given, written to
+// it so that they survive the session.
+//
+// Safe to use from any thread.
+class LLVolumeFaceCache
+{
+	LOG_CLASS(LLVolumeFaceCache);
+
+public:
+	// Persistent backing for the cache
+	class Store
+	{
+	public:
+		virtual ~Store() {}
+
+		// Pass the stored entry to unpack. Returns false if there is no
+		// entry or unpack rejected it.
+		virtual bool read(const LLUUID& key, const std::function<bool(const U8* data, S32 size)>& unpack) = 0;
+		virtual void write(const LLUUID& key, const std::vector<U8>& data) = 0;
+	};
+
+	// Takes ownership of store
+	LLVolumeFaceCache(U32 max_memory_bytes, Store* store = NULL);
+	~LLVolumeFaceCache();
+
+	// Only volumes with at least this many mesh points are cached, smaller
+	// ones regenerate faster than an entry can be looked up
+	static const S32 MIN_CACHED_MESH_POINTS;
+
+	static LLUUID getKey(const LLVolumeParams& params, F32 detail);
+
+	// Replaces faces and returns true on a hit
+	bool fetch(const LLUUID& key, S32 num_faces, std::vector<LLVolumeFace>& faces);
+	void store(const LLUUID& key, const std::vector<LLVolumeFace>& faces);
+
+	U32 getMemoryBytes() const { return mMemoryBytes; }
+
+private:
+	static void pack(const std::vector<LLVolumeFace>& faces, std::vector<U8>& data);
+	static bool unpack(const U8* data, S32 size, S32 num_faces, std::vector<LLVolumeFace>& faces);
+
+	void insert(const LLUUID& key, std::vector<U8>& data);
+
+	struct Entry
+	{
+		std::vector<U8> mData;
+		std::list<LLUUID>::iterator mLRU;
+	};
+	typedef std::unordered_map<LLUUID, Entry> entry_map_t;
+
+	entry_map_t mEntries;
+	std::list<LLUUID> mLRU;		// most recently used first
+	U32 mMemoryBytes;
+	const U32 mMaxMemoryBytes;
+	Store* mStore;
+	LLMutex mMutex;
+};
+
+#endif // LL_LLVOLUMEFACECACHE_H
@@ -27,7 +27,10 @@
 
 #include "llvolumemgr.h"
 #include "llvolume.h"
+#include "threadpool.h"
 
+#include <condition_variable>
+#include <mutex>
 
 const F32 BASE_THRESHOLD = 0.03f;
 
@@ -53,8 +56,12 @@ LLVolumeMgr::LLVolumeMgr()
 
 LLVolumeMgr::~LLVolumeMgr()
 {
+	stopGenerationThreads();
 	cleanup();
 
+	LLVolume::setFaceCache(NULL);
+	mFaceCache.reset();
+
 	delete mDataMutex;
 	mDataMutex = NULL;
 }
@@ -112,6 +119,29 @@ LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32
 	return volgroupp->refLOD(detail);
 }
 
+void LLVolumeMgr::prefetchVolume(const LLVolumeParams &volume_params, const S32 detail)
+{
+	if (!mGenerationPool)
+	{
+		return;
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	// Only groups that already exist, a group nobody references would
+	// never be cleaned up
+	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
+	if (iter != mVolumeLODGroups.end())
+	{
+		iter->second->prefetchLOD(detail, mGenerationPool->getQueue());
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+}
+
 // virtual
 LLVolumeLODGroup* LLVolumeMgr::getGroup( const LLVolumeParams& volume_params ) const
 {
@@ -218,6 +248,46 @@ void LLVolumeMgr::useMutex()
 	}
 }
 
+void LLVolumeMgr::startGenerationThreads(S32 num_threads)
+{
+	if (mGenerationPool || num_threads <= 0)
+	{
+		return;
+	}
+	if (!mDataMutex)
+	{
+		LL_WARNS() << "Volume generation threads need useMutex()" << LL_ENDL;
+		return;
+	}
+
+	LL_INFOS() << "Generating volumes on " << num_threads << " threads" << LL_ENDL;
+	mGenerationPool.reset(new LL::ThreadPool("VolumeGen", num_threads, 1024 * 1024));
+	mGenerationPool->start();
+	LLVolume::setGenerationQueue(mGenerationPool->getQueue().getWeak(), num_threads);
+}
+
+void LLVolumeMgr::stopGenerationThreads()
+{
+	if (mGenerationPool)
+	{
+		LLVolume::setGenerationQueue(std::weak_ptr<LL::WorkQueue>(), 0);
+		mGenerationPool->close();
+		mGenerationPool.reset();
+	}
+}
+
+void LLVolumeMgr::useFaceCache(U32 max_memory_bytes, LLVolumeFaceCache::Store* store)
+{
+	if (mFaceCache || max_memory_bytes == 0)
+	{
+		delete store;
+		return;
+	}
+
+	mFaceCache.reset(new LLVolumeFaceCache(max_memory_bytes, store));
+	LLVolume::setFaceCache(mFaceCache.get());
+}
+
 std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 {
 	s << "{ numLODgroups=" << volume_mgr.mVolumeLODGroups.size() << ", ";
@@ -245,6 +315,62 @@ std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 	return s;
 }
 
+// A LOD being built by the generation threads. Whichever of the worker and
+// refLOD() claims it first builds the volume, so refLOD() only ever waits
+// for a build that is already running.
+class LLVolumeLODGroup::PendingLOD
+{
+public:
+	PendingLOD(const LLVolumeParams& params, F32 detail)
+	:	mParams(params),
+		mDetail(detail),
+		mClaimed(false),
+		mDone(false)
+	{
+	}
+
+	// On a generation thread
+	void build()
+	{
+		if (mClaimed.exchange(true))
+		{
+			return;
+		}
+		// Nothing else can see the volume until mDone is set
+		mVolume = new LLVolume(mParams, mDetail);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mDone = true;
+		mCond.notify_all();
+	}
+
+	// On the thread calling refLOD()
+	LLPointer<LLVolume> take()
+	{
+		if (!mClaimed.exchange(true))
+		{
+			return new LLVolume(mParams, mDetail);
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCond.wait(lock, [this]() { return mDone; });
+		// Drop our reference here so that the worker releasing its copy of
+		// this object never touches the volume's ref count
+		LLPointer<LLVolume> volume = mVolume;
+		mVolume = NULL;
+		return volume;
+	}
+
+private:
+	const LLVolumeParams mParams;
+	const F32 mDetail;
+	std::atomic<bool> mClaimed;
+	bool mDone;
+	LLPointer<LLVolume> mVolume;
+	std::mutex mMutex;
+	std::condition_variable mCond;
+};
+
 LLVolumeLODGroup::LLVolumeLODGroup(const LLVolumeParams &params)
 	: mVolumeParams(params),
 	  mRefs(0)
@@ -295,12 +421,37 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
 	mRefs++;
 	if (mVolumeLODs[detail].isNull())
 	{
-		mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail]);
+		if (mPendingLODs[detail])
+		{
+			mVolumeLODs[detail] = mPendingLODs[detail]->take();
+			mPendingLODs[detail].reset();
+		}
+		else
+		{
+			mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail]);
+		}
 	}
 	mLODRefs[detail]++;
 	return mVolumeLODs[detail];
 }
 
+bool LLVolumeLODGroup::prefetchLOD(const S32 detail, LL::WorkQueue& queue)
+{
+	llassert(detail >=0 && detail < NUM_LODS);
+	if (mVolumeLODs[detail].notNull() || mPendingLODs[detail])
+	{
+		return false;
+	}
+
+	std::shared_ptr<PendingLOD> pending = std::make_shared<PendingLOD>(mVolumeParams, mDetailScales[detail]);
+	if (!queue.postIfOpen([pending]() { pending->build(); }))
+	{
+		return false;
+	}
+	mPendingLODs[detail] = pending;
+	return true;
+}
+
 BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 {
 	llassert_always(mRefs > 0);
@@ -28,14 +28,22 @@
 #define LL_LLVOLUMEMGR_H
 
 #include <map>
+#include <memory>
 
 #include "llvolume.h"
+#include "llvolumefacecache.h"
 #include "llpointer.h"
 #include "llthread.h"
 
 class LLVolumeParams;
 class LLVolumeLODGroup;
 
+namespace LL
+{
+	class ThreadPool;
+	class WorkQueue;
+}
+
 class LLVolumeLODGroup
 {
 	LOG_CLASS(LLVolumeLODGroup);
@@ -57,6 +65,10 @@ public:
 
 	LLVolume* refLOD(const S32 detail);
 	BOOL derefLOD(LLVolume *volumep);
+	// Start building a LOD that is not loaded yet on the queue's threads,
+	// so that a later refLOD() finds it ready. Returns false if the LOD is
+	// already loaded or being built.
+	bool prefetchLOD(const S32 detail, LL::WorkQueue& queue);
 	S32 getNumRefs() const { return mRefs; }
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
@@ -70,6 +82,9 @@ protected:
 	S32 mRefs;
 	S32 mLODRefs[NUM_LODS];
 	LLPointer<LLVolume> mVolumeLODs[NUM_LODS];
+	// LODs handed to the generation threads and not yet collected by refLOD()
+	class PendingLOD;
+	std::shared_ptr<PendingLOD> mPendingLODs[NUM_LODS];
 	static F32 mDetailThresholds[NUM_LODS];
 	static F32 mDetailScales[NUM_LODS];
 	S32		mAccessCount[NUM_LODS];
@@ -90,8 +105,21 @@ public:
 	virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail);
 	virtual void unrefVolume(LLVolume *volumep);
 
+	// Queue generation of a LOD of an already referenced volume on the
+	// generation threads. Does nothing if they were not started.
+	void prefetchVolume(const LLVolumeParams &volume_params, const S32 detail);
+
 	void dump();
 
+	// Build volumes, and the faces of large volumes, on a pool of threads.
+	// Like useMutex() this must be called manually and needs the mutex.
+	void startGenerationThreads(S32 num_threads);
+	void stopGenerationThreads();
+
+	// Reuse generated prim faces through a cache of up to max_memory_bytes,
+	// backed by store if not NULL. Takes ownership of store.
+	void useFaceCache(U32 max_memory_bytes, LLVolumeFaceCache::Store* store);
+
 	// manually call this for mutex magic
 	void useMutex();
 
@@ -107,6 +135,8 @@ protected:
 	volume_lod_group_map_t mVolumeLODGroups;
 
 	LLMutex* mDataMutex;
+	std::unique_ptr<LL::ThreadPool> mGenerationPool;
+	std::unique_ptr<LLVolumeFaceCache> mFaceCache;
 };
 
 #endif // LL_LLVOLUMEMGR_H
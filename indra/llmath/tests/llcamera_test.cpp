@@ -0,0 +1,169 @@
+/**
+ * @file llcamera_test.cpp
+ * @brief Test cases for LLCamera frustum checks.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../test/lltut.h"
+
+#include "../llcamera.h"
+
+#include <random>
+
+#include "stringize.h"
+
+namespace tut
+{
+	struct LLCameraData
+	{
+		std::mt19937 mRandom;
+
+		LLCameraData()
+		:	mRandom(1234)
+		{
+		}
+
+		F32 random(F32 lo, F32 hi)
+		{
+			return std::uniform_real_distribution<F32>(lo, hi)(mRandom);
+		}
+
+		// Set up the agent planes the way LLViewerCamera does, from the
+		// corners of the near and far clip rectangles
+		void lookAt(LLCamera& camera, const LLVector3& origin, const LLVector3& target)
+		{
+			camera.lookAt(origin, target);
+
+			const F32 half_height = tanf(camera.getView() * 0.5f);
+			const F32 half_width = half_height * camera.getAspect();
+			const LLVector3 at = camera.getAtAxis();
+			const LLVector3 left = camera.getLeftAxis() * half_width;
+			const LLVector3 up = camera.getUpAxis() * half_height;
+
+			LLVector3 frust[LLCamera::AGENT_FRUSTRUM_NUM];
+			frust[0] = at + left - up;
+			frust[1] = at - left - up;
+			frust[2] = at - left + up;
+			frust[3] = at + left + up;
+			for (U32 i = 0; i < 4; ++i)
+			{
+				frust[i + 4] = origin + frust[i] * camera.getFar();
+				frust[i] = origin + frust[i] * camera.getNear();
+			}
+			camera.calcAgentFrustumPlanes(frust);
+		}
+
+		// Checks AABBInFrustum4() against the scalar tests for random boxes
+		// around and about the frustum
+		void ensureMatchesScalar(const std::string& msg, LLCamera& camera)
+		{
+			const F32 extent = camera.getFar() * 1.2f;
+			for (U32 group = 0; group < 500; ++group)
+			{
+				LLVector4a centers[3];
+				LLVector4a radii[3];
+				LLVector4a center[4];
+				LLVector4a radius[4];
+				for (U32 lane = 0; lane < 4; ++lane)
+				{
+					const F32 size = random(0.f, 1.f) < 0.2f ? random(10.f, extent) : random(0.1f, 10.f);
+					const LLVector3 offset(random(-extent, extent), random(-extent, extent), random(-extent, extent));
+					center[lane].load3((camera.getOrigin() + offset).mV);
+					radius[lane].set(random(0.1f, size), random(0.1f, size), random(0.1f, size));
+					for (U32 axis = 0; axis < 3; ++axis)
+					{
+						centers[axis].getF32ptr()[lane] = center[lane][axis];
+						radii[axis].getF32ptr()[lane] = radius[lane][axis];
+					}
+				}
+
+				S32 results[4];
+				S32 results_no_far[4];
+				camera.AABBInFrustum4(centers, radii, results);
+				camera.AABBInFrustum4(centers, radii, results_no_far, true);
+				for (U32 lane = 0; lane < 4; ++lane)
+				{
+					ensure_equals(STRINGIZE(msg << " group " << group << " lane " << lane),
+								  results[lane], camera.AABBInFrustum(center[lane], radius[lane]));
+					ensure_equals(STRINGIZE(msg << " no far clip group " << group << " lane " << lane),
+								  results_no_far[lane], camera.AABBInFrustumNoFarClip(center[lane], radius[lane]));
+				}
+			}
+		}
+	};
+
+	typedef test_group<LLCameraData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory llcamera_test_factory("LLCamera");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		set_test_name("AABBInFrustum");
+
+		LLCamera camera;
+		camera.setFar(64.f);
+		lookAt(camera, LLVector3(128.f, 128.f, 20.f), LLVector3(200.f, 128.f, 20.f));
+
+		LLVector4a radius(1.f, 1.f, 1.f);
+		LLVector4a center(160.f, 128.f, 20.f);
+		ensure_equals("inside", camera.AABBInFrustum(center, radius), 2);
+		center.set(128.f + 64.f, 128.f, 20.f);
+		ensure_equals("crossing the far plane", camera.AABBInFrustum(center, radius), 1);
+		ensure_equals("far plane ignored", camera.AABBInFrustumNoFarClip(center, radius), 2);
+		center.set(100.f, 128.f, 20.f);
+		ensure_equals("behind", camera.AABBInFrustum(center, radius), 0);
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		set_test_name("AABBInFrustum4 matches AABBInFrustum");
+
+		LLCamera camera;
+		camera.setFar(128.f);
+		for (U32 i = 0; i < 20; ++i)
+		{
+			camera.setView(random(0.3f, 2.f));
+			camera.setAspect(random(0.5f, 2.5f));
+			const LLVector3 origin(random(0.f, 256.f), random(0.f, 256.f), random(0.f, 100.f));
+			const LLVector3 target(origin + LLVector3(random(-1.f, 1.f), random(-1.f, 1.f), random(-0.5f, 0.5f)));
+			lookAt(camera, origin, target);
+			ensureMatchesScalar(STRINGIZE("camera " << i), camera);
+		}
+
+		// Planes masked off are skipped by both
+		camera.ignoreAgentFrustumPlane(LLCamera::AGENT_PLANE_LEFT);
+		camera.ignoreAgentFrustumPlane(LLCamera::AGENT_PLANE_TOP);
+		ensureMatchesScalar("ignored planes", camera);
+	}
+}
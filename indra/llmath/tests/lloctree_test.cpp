@@ -0,0 +1,351 @@
+/**
+ * @file lloctree_test.cpp
+ * @brief Test cases for LLOctreeFlat.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../test/lltut.h"
+
+#include "../lloctree.h"
+
+#include <map>
+#include <random>
+
+#include "stringize.h"
+
+namespace
+{
+	// Nothing is ever inserted, the tree's shape is built by hand
+	class TestElement
+	{
+	public:
+		TestElement()
+		:	mBinIndex(-1)
+		{
+		}
+
+		const LLVector4a& getPositionGroup() const	{ return mPosition; }
+		F32 getBinRadius() const					{ return 0.f; }
+		S32 getBinIndex() const						{ return mBinIndex; }
+		void setBinIndex(S32 index) const			{ mBinIndex = index; }
+
+	private:
+		LLVector4a mPosition;
+		mutable S32 mBinIndex;
+	};
+
+	typedef LLOctreeNode<TestElement, TestElement*> TestNode;
+	typedef LLOctreeFlat<TestElement, TestElement*> TestFlat;
+}
+
+namespace tut
+{
+	struct LLOctreeFlatData
+	{
+		TestNode* mRoot;
+		TestFlat mFlat;
+		// Where on_node last put each node
+		std::map<const TestNode*, U32> mIndex;
+		U32 mVisits;
+		std::mt19937 mRandom;
+
+		LLOctreeFlatData()
+		:	mVisits(0),
+			mRandom(1234)
+		{
+			LLVector4a center(128.f, 128.f, 128.f);
+			LLVector4a size(128.f, 128.f, 128.f);
+			mRoot = new TestNode(center, size, NULL);
+		}
+
+		~LLOctreeFlatData()
+		{
+			delete mRoot;
+		}
+
+		TestNode* addChild(TestNode* parent, U8 octant)
+		{
+			LLVector4a size;
+			size.setMul(parent->getSize(), 0.5f);
+			LLVector4a center(parent->getCenter());
+			for (U32 axis = 0; axis < 3; ++axis)
+			{
+				center.getF32ptr()[axis] += (octant & (1 << axis)) ? size[axis] : -size[axis];
+			}
+			TestNode* child = new TestNode(center, size, parent, octant);
+			parent->addChild(child);
+			return child;
+		}
+
+		static bool hasOctant(const TestNode* parent, U8 octant)
+		{
+			for (U32 i = 0; i < parent->getChildCount(); ++i)
+			{
+				if (parent->getChild(i)->getOctant() == octant)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Some octant the parent has no child in yet
+		U8 freeOctant(const TestNode* parent)
+		{
+			U8 octant;
+			do
+			{
+				octant = mRandom() % 8;
+			}
+			while (hasOctant(parent, octant));
+			return octant;
+		}
+
+		// Every child in a random subset of the octants, to the given depth
+		void grow(TestNode* node, U32 depth)
+		{
+			if (depth == 0)
+			{
+				return;
+			}
+			for (U8 octant = 0; octant < 8; ++octant)
+			{
+				if (mRandom() % 3)
+				{
+					grow(addChild(node, octant), depth - 1);
+				}
+			}
+		}
+
+		void collect(TestNode* node, std::vector<TestNode*>& nodes)
+		{
+			nodes.push_back(node);
+			for (U32 i = 0; i < node->getChildCount(); ++i)
+			{
+				collect(node->getChild(i), nodes);
+			}
+		}
+
+		void update()
+		{
+			mVisits = 0;
+			mFlat.update(mRoot, [this](const TestNode* node, U32 index)
+				{
+					++mVisits;
+					mIndex[node] = index;
+					mFlat.setBounds(index, node, node->getCenter(), node->getSize());
+				});
+		}
+
+		// The copy has the tree's shape, the bounds of every node and each
+		// node where on_node last said it was
+		U32 ensureMatches(const std::string& msg, const TestNode* node, U32 index)
+		{
+			const TestFlat::Node& entry = mFlat.getNode(index);
+			ensure(STRINGIZE(msg << " node at " << index), entry.mNode == node);
+			ensure_equals(STRINGIZE(msg << " reported index"), mIndex[node], index);
+			ensure_equals(STRINGIZE(msg << " child count at " << index), entry.mChildCount, node->getChildCount());
+
+			const LLVector4a* bounds = mFlat.getGroupBounds(index - index % TestFlat::LANES);
+			const U32 lane = index % TestFlat::LANES;
+			for (U32 axis = 0; axis < 3; ++axis)
+			{
+				ensure_equals(STRINGIZE(msg << " center at " << index), bounds[axis][lane], node->getCenter()[axis]);
+				ensure_equals(STRINGIZE(msg << " size at " << index), bounds[3 + axis][lane], node->getSize()[axis]);
+			}
+
+			U32 count = 1;
+			if (entry.mChildCount)
+			{
+				ensure_equals(STRINGIZE(msg << " children aligned at " << index), entry.mFirstChild % TestFlat::LANES, 0U);
+				const U32 block = entry.mChildCount > TestFlat::LANES ? 2 * TestFlat::LANES : TestFlat::LANES;
+				ensure(STRINGIZE(msg << " block in range at " << index), entry.mFirstChild + block <= mFlat.getNodeCount());
+				for (U32 i = 0; i < node->getChildCount(); ++i)
+				{
+					count += ensureMatches(msg, node->getChild(i), entry.mFirstChild + i);
+				}
+				for (U32 i = entry.mChildCount; i < block; ++i)
+				{
+					ensure(STRINGIZE(msg << " padding at " << entry.mFirstChild + i), mFlat.getNode(entry.mFirstChild + i).mNode == NULL);
+				}
+			}
+			return count;
+		}
+	};
+
+	typedef test_group<LLOctreeFlatData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory lloctreeflat_test_factory("LLOctreeFlat");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		set_test_name("layout");
+
+		grow(mRoot, 3);
+		update();
+		std::vector<TestNode*> nodes;
+		collect(mRoot, nodes);
+		ensure_equals("every node placed", mVisits, (U32)nodes.size());
+		ensure_equals("every node reached", ensureMatches("layout", mRoot, 0), (U32)nodes.size());
+
+		update();
+		ensure_equals("nothing to do when unchanged", mVisits, 0U);
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		set_test_name("only changed child lists are laid out again");
+
+		TestNode* a = addChild(mRoot, 0);
+		TestNode* b = addChild(mRoot, 1);
+		TestNode* a1 = addChild(a, 0);
+		TestNode* a2 = addChild(a, 1);
+		TestNode* b1 = addChild(b, 0);
+		addChild(b1, 0);
+		update();
+		ensureMatches("initial", mRoot, 0);
+
+		// a's children go through on_node again, b's subtree isn't touched
+		TestNode* a3 = addChild(a, 2);
+		update();
+		ensure_equals("add visits", mVisits, 3U);
+		ensure_equals("siblings keep their place", mIndex[a1], mFlat.getNode(mIndex[a]).mFirstChild);
+		ensureMatches("after add", mRoot, 0);
+
+		// Growing past LANES children moves them to a bigger block
+		addChild(a, 3);
+		addChild(a, 4);
+		update();
+		ensure_equals("grow visits", mVisits, 5U);
+		ensureMatches("after grow", mRoot, 0);
+
+		// Deep change, the path to it is only walked
+		addChild(a2, 5);
+		update();
+		ensure_equals("deep add visits", mVisits, 1U);
+		ensureMatches("after deep add", mRoot, 0);
+
+		// Moving a subtree lays it out again under its new parent
+		a->removeChild(0);
+		a3->addChild(a1);
+		update();
+		ensureMatches("after move", mRoot, 0);
+
+		// Removing b drops its subtree from the copy, and its blocks are
+		// reused instead of growing the copy
+		const U32 node_count = mFlat.getNodeCount();
+		mRoot->removeChild(1);
+		delete b;
+		update();
+		ensureMatches("after remove", mRoot, 0);
+		b = addChild(mRoot, 1);
+		addChild(addChild(b, 0), 0);
+		update();
+		ensureMatches("after re-add", mRoot, 0);
+		ensure_equals("blocks reused", mFlat.getNodeCount(), node_count);
+
+		// A different root starts over
+		TestNode* root = mRoot;
+		mRoot = a;
+		update();
+		ensureMatches("new root", mRoot, 0);
+		mRoot = root;
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		set_test_name("random changes");
+
+		grow(mRoot, 3);
+		update();
+		for (U32 step = 0; step < 300; ++step)
+		{
+			// A few changes per update
+			for (U32 change = mRandom() % 4; change > 0; --change)
+			{
+				std::vector<TestNode*> nodes;
+				collect(mRoot, nodes);
+				TestNode* node = nodes[mRandom() % nodes.size()];
+				const U32 op = mRandom() % 3;
+				if (op == 0 && node->getChildCount() < 8)
+				{
+					grow(addChild(node, freeOctant(node)), mRandom() % 3);
+				}
+				else if (op == 1 && node != mRoot)
+				{
+					// May take empty ancestors with it
+					TestNode* parent = node->getOctParent();
+					for (U32 i = 0; i < parent->getChildCount(); ++i)
+					{
+						if (parent->getChild(i) == node)
+						{
+							parent->removeChild(i);
+							break;
+						}
+					}
+					delete node;
+				}
+				else if (op == 2 && node != mRoot && node->getOctParent() != mRoot)
+				{
+					// To a child of the root that isn't under the node
+					TestNode* target = mRoot->getChild(mRandom() % mRoot->getChildCount());
+					TestNode* ancestor = node;
+					while (ancestor->getOctParent() != mRoot)
+					{
+						ancestor = ancestor->getOctParent();
+					}
+					if (target != ancestor && !hasOctant(target, node->getOctant()))
+					{
+						TestNode* parent = node->getOctParent();
+						for (U32 i = 0; i < parent->getChildCount(); ++i)
+						{
+							if (parent->getChild(i) == node)
+							{
+								parent->removeChild(i);
+								break;
+							}
+						}
+						target->addChild(node);
+					}
+				}
+			}
+
+			update();
+			std::vector<TestNode*> nodes;
+			collect(mRoot, nodes);
+			ensure_equals(STRINGIZE("nodes reached at step " << step), ensureMatches(STRINGIZE("step " << step), mRoot, 0), (U32)nodes.size());
+		}
+	}
+}
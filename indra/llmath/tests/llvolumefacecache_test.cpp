@@ -0,0 +1,233 @@
+/**
+ * @file   llvolumefacecache_test.cpp
+ * @brief  Test for llvolumefacecache.cpp.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "../test/lltut.h"
+#include "../llvolume.h"
+#include "../llvolumefacecache.h"
+
+#include <map>
+
+namespace
+{
+	typedef std::map<LLUUID, std::vector<U8> > stored_map_t;
+
+	// Keeps entries in a map owned by the test, since the cache deletes
+	// its store
+	class TestStore : public LLVolumeFaceCache::Store
+	{
+	public:
+		TestStore(stored_map_t& stored) : mStored(stored) {}
+
+		bool read(const LLUUID& key, const std::function<bool(const U8* data, S32 size)>& unpack) override
+		{
+			stored_map_t::const_iterator iter = mStored.find(key);
+			return iter != mStored.end() && unpack(iter->second.data(), (S32)iter->second.size());
+		}
+
+		void write(const LLUUID& key, const std::vector<U8>& data) override
+		{
+			mStored[key] = data;
+		}
+
+	private:
+		stored_map_t& mStored;
+	};
+
+	void makeFace(LLVolumeFace& face, S32 id, F32 offset)
+	{
+		face.mID = id;
+		face.mTypeMask = LLVolumeFace::TOP_MASK;
+		face.mNumS = 2;
+		face.mNumT = 2;
+		face.resizeVertices(4);
+		face.resizeIndices(6);
+		for (S32 i = 0; i < 4; ++i)
+		{
+			face.mPositions[i].set(offset + i, (F32)(i & 1), (F32)(i >> 1));
+			face.mNormals[i].set(0.f, 0.f, 1.f);
+			face.mTexCoords[i].set((F32)(i & 1), (F32)(i >> 1));
+		}
+		const U16 indices[] = { 0, 1, 2, 2, 1, 3 };
+		memcpy(face.mIndices, indices, sizeof(indices));
+		face.mExtents[0].set(offset, 0.f, 0.f);
+		face.mExtents[1].set(offset + 3.f, 1.f, 1.f);
+		face.mEdge.assign(6, -1);
+	}
+
+	LLUUID makeKey(U32 n)
+	{
+		LLUUID key;
+		key.mData[0] = (U8)n;
+		key.mData[1] = 1;
+		return key;
+	}
+}
+
+namespace tut
+{
+	struct LLVolumeFaceCacheData
+	{
+		std::vector<LLVolumeFace> mFaces;
+
+		LLVolumeFaceCacheData()
+		:	mFaces(2)
+		{
+			makeFace(mFaces[0], 0, 0.f);
+			makeFace(mFaces[1], 1, 10.f);
+		}
+
+		void ensureFaces(const std::string& msg, const std::vector<LLVolumeFace>& faces)
+		{
+			ensure_equals(msg + " face count", faces.size(), mFaces.size());
+			for (size_t f = 0; f < faces.size(); ++f)
+			{
+				const LLVolumeFace& a = faces[f];
+				const LLVolumeFace& b = mFaces[f];
+				ensure_equals(msg + " id", a.mID, b.mID);
+				ensure_equals(msg + " type mask", a.mTypeMask, b.mTypeMask);
+				ensure_equals(msg + " vertices", a.mNumVertices, b.mNumVertices);
+				ensure_equals(msg + " indices", a.mNumIndices, b.mNumIndices);
+				ensure(msg + " edges", a.mEdge == b.mEdge);
+				ensure(msg + " extents", a.mExtents[0].equals3(b.mExtents[0]) && a.mExtents[1].equals3(b.mExtents[1]));
+				for (S32 i = 0; i < a.mNumVertices; ++i)
+				{
+					ensure(msg + " position", a.mPositions[i].equals3(b.mPositions[i]));
+					ensure(msg + " normal", a.mNormals[i].equals3(b.mNormals[i]));
+					ensure(msg + " tex coord", a.mTexCoords[i] == b.mTexCoords[i]);
+				}
+				ensure(msg + " index data", memcmp(a.mIndices, b.mIndices, sizeof(U16) * a.mNumIndices) == 0);
+			}
+		}
+	};
+
+	typedef test_group<LLVolumeFaceCacheData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory llvolumefacecache_test_factory("LLVolumeFaceCache");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		set_test_name("pack and unpack round trip");
+
+		stored_map_t stored;
+		const LLUUID key = makeKey(1);
+		{
+			LLVolumeFaceCache cache(1024 * 1024, new TestStore(stored));
+			cache.store(key, mFaces);
+			ensure("written to the store", stored.count(key) == 1);
+			ensure_equals("memory use", cache.getMemoryBytes(), (U32)stored[key].size());
+
+			std::vector<LLVolumeFace> faces;
+			ensure("memory hit", cache.fetch(key, 2, faces));
+			ensureFaces("memory hit", faces);
+
+			std::vector<LLVolumeFace> wrong;
+			ensure("face count mismatch rejected", !cache.fetch(key, 3, wrong));
+			ensure("missing key", !cache.fetch(makeKey(2), 2, wrong));
+		}
+
+		// A new session only has the store
+		LLVolumeFaceCache cache(1024 * 1024, new TestStore(stored));
+		ensure_equals("starts empty", cache.getMemoryBytes(), 0U);
+		std::vector<LLVolumeFace> faces;
+		ensure("store hit", cache.fetch(key, 2, faces));
+		ensureFaces("store hit", faces);
+		ensure_equals("store hit kept in memory", cache.getMemoryBytes(), (U32)stored[key].size());
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		set_test_name("truncated entries are rejected");
+
+		stored_map_t stored;
+		const LLUUID key = makeKey(1);
+		LLVolumeFaceCache(1024 * 1024, new TestStore(stored)).store(key, mFaces);
+		const std::vector<U8> full = stored[key];
+
+		// Cut at a few points: the header, a face header and the index data
+		const size_t cuts[] = { 0, 8, 20, full.size() / 2, full.size() - 1 };
+		for (size_t cut : cuts)
+		{
+			stored[key].assign(full.begin(), full.begin() + cut);
+			LLVolumeFaceCache cache(1024 * 1024, new TestStore(stored));
+			std::vector<LLVolumeFace> faces;
+			ensure("truncated entry rejected", !cache.fetch(key, 2, faces));
+			ensure("truncated entry leaves faces alone", faces.empty());
+			ensure_equals("truncated entry not kept", cache.getMemoryBytes(), 0U);
+		}
+
+		// Trailing bytes are just as suspect
+		stored[key] = full;
+		stored[key].push_back(0);
+		LLVolumeFaceCache cache(1024 * 1024, new TestStore(stored));
+		std::vector<LLVolumeFace> faces;
+		ensure("padded entry rejected", !cache.fetch(key, 2, faces));
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		set_test_name("least recently used entries are evicted");
+
+		stored_map_t stored;
+		LLVolumeFaceCache(1024 * 1024, new TestStore(stored)).store(makeKey(0), mFaces);
+		const U32 entry_bytes = (U32)stored.begin()->second.size();
+
+		// Room for four entries, each well under a quarter of the limit
+		LLVolumeFaceCache cache(entry_bytes * 4 + entry_bytes / 2);
+		for (U32 n = 1; n <= 4; ++n)
+		{
+			cache.store(makeKey(n), mFaces);
+		}
+		ensure_equals("four entries", cache.getMemoryBytes(), entry_bytes * 4);
+
+		// Touch the oldest so the second becomes the eviction candidate
+		std::vector<LLVolumeFace> faces;
+		ensure("first entry", cache.fetch(makeKey(1), 2, faces));
+
+		cache.store(makeKey(5), mFaces);
+		ensure_equals("still four entries", cache.getMemoryBytes(), entry_bytes * 4);
+		ensure("second entry evicted", !cache.fetch(makeKey(2), 2, faces));
+		ensure("first entry kept", cache.fetch(makeKey(1), 2, faces));
+		ensure("third entry kept", cache.fetch(makeKey(3), 2, faces));
+		ensure("newest entry kept", cache.fetch(makeKey(5), 2, faces));
+
+		// Entries over a quarter of the limit are not kept at all
+		LLVolumeFaceCache small(entry_bytes * 2);
+		small.store(makeKey(1), mFaces);
+		ensure_equals("oversized entry skipped", small.getMemoryBytes(), 0U);
+		ensure("oversized entry missing", !small.fetch(makeKey(1), 2, faces));
+	}
+}
@@ -118,9 +118,12 @@ bool responseToLLSD(HttpResponse * response, bool log, LLSD & out_llsd)
         return false;
     }
 
-    LLCore::BufferArrayStream bas(body);
+    // One copy into contiguous memory lets the parser scan the text in
+    // place rather than stream it through expat a character at a time
+    std::string text(body->size(), '\0');
+    body->read(0, &text[0], text.size());
     LLSD body_llsd;
-    S32 parse_status(LLSDSerialize::fromXML(body_llsd, bas, log));
+    S32 parse_status(LLSDSerialize::fromXML(body_llsd, text.data(), text.size(), log));
     if (LLSDParser::PARSE_FAILURE == parse_status){
         return false;
     }
@@ -128,6 +131,25 @@ bool responseToLLSD(HttpResponse * response, bool log, LLSD & out_llsd)
     return true;
 }
 
+bool responseToLLSD(HttpResponse * response, bool log, LLPointer<LLSDArena> & out_doc)
+{
+    BufferArray * body(response->getBody());
+    if (!body || !body->size())
+    {
+        return false;
+    }
+
+    LLCore::BufferArrayStream bas(body);
+    LLPointer<LLSDArena> doc;
+    S32 parse_status(LLSDSerialize::fromXML(doc, bas, log));
+    if (LLSDParser::PARSE_FAILURE == parse_status || doc.isNull())
+    {
+        return false;
+    }
+    out_doc = doc;
+    return true;
+}
+
 
 HttpHandle requestPostWithLLSD(HttpRequest * request,
     HttpRequest::policy_t policy_id,
@@ -40,6 +40,7 @@
 #include "bufferarray.h"
 #include "bufferstream.h"
 #include "llsd.h"
+#include "llsdarena.h"
 #include "llevents.h"
 #include "llcoros.h"
 #include "lleventcoro.h"
@@ -90,6 +91,21 @@ bool responseToLLSD(LLCore::HttpResponse * response,
 					bool log,
 					LLSD & out_llsd);
 
+/// As above but parses the body into an immutable arena document
+/// instead of an LLSD tree.  Preferred for large responses that are
+/// only read, such as inventory fetches, as the whole document is a
+/// single allocation.
+///
+/// @arg	out_doc		Output document written only upon
+///						successful parse of the response object.
+///
+/// @return				Returns true (and writes to out_doc) if
+///						parse was successful.  False otherwise.
+///
+bool responseToLLSD(LLCore::HttpResponse * response,
+					bool log,
+					LLPointer<LLSDArena> & out_doc);
+
 /// Create a std::string representation of a response object
 /// suitable for logging.  Mainly intended for logging of
 /// failures and debug information.  This won't be fast,
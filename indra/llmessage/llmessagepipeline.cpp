@@ -0,0 +1,292 @@
+/**
+ * @file llmessagepipeline.cpp
+ * @brief Inbound UDP packets and the thread that receives and decodes them
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmessagepipeline.h"
+
+#if LL_WINDOWS
+	#include <winsock2.h>
+#else
+	#include <netinet/in.h>
+#endif
+
+#include "llpacketring.h"
+#include "lltimer.h"
+#include "message.h"
+
+// How long the network thread waits on an idle socket before checking
+// whether it should quit
+const S32 PIPELINE_WAIT_MS = 10;
+
+LLInboundPacket::LLInboundPacket() :
+	mTrueSize(0),
+	mStatus(PACKET_OK),
+	mAcks(0),
+	mData(mTrueBuffer),
+	mSize(0),
+	mCompressedSize(0),
+	mExpandOverflow(false),
+	mPacketID(0)
+{
+}
+
+void LLInboundPacket::prepare(LLTemplateMessageReader& decoder)
+{
+	mStatus = PACKET_OK;
+	mAcks = 0;
+	mData = mTrueBuffer;
+	mSize = mTrueSize;
+	mCompressedSize = 0;
+	mExpandOverflow = false;
+	mPacketID = 0;
+
+	if (mTrueSize < LL_MINIMUM_VALID_PACKET_SIZE)
+	{
+		mStatus = PACKET_TOO_SHORT;
+		return;
+	}
+
+	// note if packet acks are appended.
+	if (mTrueBuffer[0] & LL_ACK_FLAG)
+	{
+		mAcks = mTrueBuffer[--mSize];
+		if (mSize >= (S32)(mAcks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+		{
+			mSize -= mAcks * sizeof(TPACKETID);
+		}
+		else
+		{
+			mStatus = PACKET_BAD_ACKS;
+			return;
+		}
+	}
+
+	if (mTrueBuffer[0] & LL_ZERO_CODE_FLAG)
+	{
+		expandZeroCode();
+	}
+	mPacketID = ntohl(*((U32*)(&mData[1])));
+
+	decoder.decodeMessage(mData, mSize, mSender);
+	decoder.swapDecoded(mDecoded);
+}
+
+void LLInboundPacket::expandZeroCode()
+{
+	mCompressedSize = mSize;
+	mTrueBuffer[0] &= (~LL_ZERO_CODE_FLAG);
+
+	S32 count = mSize;
+	U8 *inptr = mTrueBuffer;
+	U8 *outptr = mExpandedBuffer;
+
+// skip the packet id field
+
+	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	{
+		count--;
+		*outptr++ = *inptr++;
+	}
+
+// reconstruct encoded packet, keeping track of net size gain
+
+// sequential zero bytes are encoded as 0 [U8 count]
+// with 0 0 [count] representing wrap (>256 zeroes)
+
+	while (count--)
+	{
+		if (outptr > (&mExpandedBuffer[NET_BUFFER_SIZE-1]))
+		{
+			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
+			mExpandOverflow = true;
+			outptr = mExpandedBuffer;
+			break;
+		}
+		if (!((*outptr++ = *inptr++)))
+		{
+			while (((count--)) && (!(*inptr)))
+			{
+				*outptr++ = *inptr++;
+				if (outptr > (&mExpandedBuffer[NET_BUFFER_SIZE-256]))
+				{
+					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
+					mExpandOverflow = true;
+					outptr = mExpandedBuffer;
+					count = -1;
+					break;
+				}
+				memset(outptr,0,255);
+				outptr += 255;
+			}
+
+			if (count < 0)
+			{
+				break;
+			}
+			else
+			{
+				if (outptr > (&mExpandedBuffer[NET_BUFFER_SIZE-(*inptr)]))
+				{
+					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
+					mExpandOverflow = true;
+					outptr = mExpandedBuffer;
+				}
+				memset(outptr,0,(*inptr) - 1);
+				outptr += ((*inptr) - 1);
+				inptr++;
+			}
+		}
+	}
+
+	mData = mExpandedBuffer;
+	mSize = (S32)(outptr - mExpandedBuffer);
+}
+
+LLMessagePipeline::LLMessagePipeline(S32 socket, LLPacketRing& packet_ring,
+									 LLTemplateMessageReader::message_template_number_map_t& templates) :
+	LLThread("Message pipeline"),
+	mSocket(socket),
+	mPacketRing(packet_ring),
+	mDecoder(templates),
+	mAllocated(0),
+	mBatchNext(0),
+	mBatchFrame(0)
+{
+}
+
+LLMessagePipeline::~LLMessagePipeline()
+{
+	shutdown();
+	for (LLInboundPacket* packet : mReady)
+	{
+		delete packet;
+	}
+	for (LLInboundPacket* packet : mFree)
+	{
+		delete packet;
+	}
+	for (LLInboundPacket* packet : mBatch)
+	{
+		delete packet;
+	}
+}
+
+LLInboundPacket* LLMessagePipeline::next(S64 frame_count)
+{
+	if (mBatchNext < mBatch.size())
+	{
+		return mBatch[mBatchNext++];
+	}
+	if (frame_count && frame_count == mBatchFrame)
+	{
+		// this frame's batch is done, the rest waits for the next one
+		return NULL;
+	}
+	mBatchFrame = frame_count;
+
+	{
+		LLMutexLock lock(&mQueueMutex);
+		mFree.insert(mFree.end(), mBatch.begin(), mBatch.end());
+		mBatch.clear();
+		mBatch.swap(mReady);
+	}
+	mBatchNext = 0;
+	return mBatch.empty() ? NULL : mBatch[mBatchNext++];
+}
+
+LLInboundPacket* LLMessagePipeline::allocate()
+{
+	{
+		LLMutexLock lock(&mQueueMutex);
+		if (!mFree.empty())
+		{
+			LLInboundPacket* packet = mFree.back();
+			mFree.pop_back();
+			return packet;
+		}
+		if (mAllocated >= MAX_PACKETS)
+		{
+			return NULL;
+		}
+		++mAllocated;
+	}
+	return new LLInboundPacket;
+}
+
+void LLMessagePipeline::run()
+{
+	std::vector<LLInboundPacket*> prepared;
+	while (!isQuitting())
+	{
+		if (!wait_for_packet(mSocket, PIPELINE_WAIT_MS))
+		{
+			continue;
+		}
+
+		bool full = false;
+		while (!isQuitting())
+		{
+			LLInboundPacket* packet = allocate();
+			if (!packet)
+			{
+				// The main thread is behind, leave the rest in the socket
+				full = true;
+				break;
+			}
+
+			packet->mTrueSize = mPacketRing.receivePacket(mSocket, (char *)packet->mTrueBuffer);
+			if (!packet->mTrueSize)
+			{
+				LLMutexLock lock(&mQueueMutex);
+				mFree.push_back(packet);
+				break;
+			}
+			packet->mSender = mPacketRing.getLastSender();
+			packet->mReceivingIF = mPacketRing.getLastReceivingInterface();
+			packet->prepare(mDecoder);
+			prepared.push_back(packet);
+
+			if (prepared.size() >= (size_t)NET_MAX_BATCH)
+			{
+				LLMutexLock lock(&mQueueMutex);
+				mReady.insert(mReady.end(), prepared.begin(), prepared.end());
+				prepared.clear();
+			}
+		}
+
+		if (!prepared.empty())
+		{
+			LLMutexLock lock(&mQueueMutex);
+			mReady.insert(mReady.end(), prepared.begin(), prepared.end());
+			prepared.clear();
+		}
+		if (full)
+		{
+			ms_sleep(1);
+		}
+	}
+}
@@ -0,0 +1,121 @@
+/**
+ * @file llmessagepipeline.h
+ * @brief Inbound UDP packets and the thread that receives and decodes them
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESSAGEPIPELINE_H
+#define LL_LLMESSAGEPIPELINE_H
+
+#include <vector>
+
+#include "llhost.h"
+#include "llmutex.h"
+#include "llthread.h"
+#include "lltemplatemessagereader.h"
+#include "net.h"
+
+class LLPacketRing;
+
+// A UDP packet with the work done that doesn't need the circuits: the
+// appended acks found, the zero coding expanded and the message decoded.
+// Everything else, and anything that calls back into the viewer, is left
+// to LLMessageSystem::processInboundPacket() on the main thread.
+struct LLInboundPacket
+{
+	enum EStatus
+	{
+		PACKET_OK,
+		PACKET_TOO_SHORT,
+		PACKET_BAD_ACKS			// more appended acks than the packet holds
+	};
+
+	LLInboundPacket();
+
+	// Fills in everything below from the first mTrueSize bytes of
+	// mTrueBuffer, decoding with decoder. Safe off the main thread as long
+	// as nothing else uses decoder.
+	void prepare(LLTemplateMessageReader& decoder);
+
+	U8			mTrueBuffer[NET_BUFFER_SIZE];	// as received
+	S32			mTrueSize;
+	LLHost		mSender;
+	LLHost		mReceivingIF;
+
+	EStatus		mStatus;
+	S32			mAcks;				// packet ids at the end of mTrueBuffer
+	U8*			mData;				// mTrueBuffer or mExpandedBuffer
+	S32			mSize;				// of mData, without the acks
+	S32			mCompressedSize;	// size before zero expansion, 0 if not zero coded
+	bool		mExpandOverflow;	// zero coding would have overrun mExpandedBuffer
+	TPACKETID	mPacketID;
+	LLTemplateMessageReader::DecodedMessage mDecoded;
+
+private:
+	void expandZeroCode();
+
+	U8			mExpandedBuffer[NET_BUFFER_SIZE];
+};
+
+// Receives and prepares packets on its own thread. The main thread takes
+// them a frame's worth at a time, so the message handlers still run where
+// they always have.
+class LLMessagePipeline : public LLThread
+{
+public:
+	// Most packets waiting for the main thread before the network thread
+	// stops reading the socket and lets the OS buffer them
+	static const size_t MAX_PACKETS = 512;
+
+	LLMessagePipeline(S32 socket, LLPacketRing& packet_ring,
+					  LLTemplateMessageReader::message_template_number_map_t& templates);
+	virtual ~LLMessagePipeline();
+
+	// Main thread: the next packet of the current batch, or NULL once it
+	// is used up. A new batch is picked up at most once per frame_count,
+	// or every time for a frame_count of 0. The packet stays valid until
+	// the next call.
+	LLInboundPacket* next(S64 frame_count);
+
+protected:
+	virtual void run();
+
+private:
+	LLInboundPacket* allocate();
+
+	S32 mSocket;
+	LLPacketRing& mPacketRing;
+	LLTemplateMessageReader mDecoder;
+
+	LLMutex mQueueMutex;
+	std::vector<LLInboundPacket*> mReady;		// prepared, waiting for the main thread
+	std::vector<LLInboundPacket*> mFree;
+	size_t mAllocated;
+
+	// main thread only
+	std::vector<LLInboundPacket*> mBatch;
+	size_t mBatchNext;
+	S64 mBatchFrame;
+};
+
+#endif // LL_LLMESSAGEPIPELINE_H
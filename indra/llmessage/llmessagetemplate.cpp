@@ -67,6 +67,42 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+void LLMessageTemplate::buildDecodeLayout()
+{
+	mDecodeBlocks.clear();
+	mDecodeVariables.clear();
+	for (message_block_map_t::const_iterator iter = mMemberBlocks.begin();
+		 iter != mMemberBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* blockp = *iter;
+		DecodeBlock block;
+		block.mName = blockp->mName;
+		block.mType = blockp->mType;
+		block.mNumber = blockp->mNumber;
+		block.mTotalSize = blockp->mTotalSize;
+		block.mFirstVariable = (S32)mDecodeVariables.size();
+		block.mVariableCount = (S32)blockp->mMemberVariables.size();
+
+		S32 offset = 0;
+		for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = blockp->mMemberVariables.begin();
+			 var_iter != blockp->mMemberVariables.end(); ++var_iter)
+		{
+			const LLMessageVariable* varp = *var_iter;
+			DecodeVariable var;
+			var.mName = varp->getName();
+			var.mType = varp->getType();
+			var.mSize = varp->getSize();
+			var.mOffset = offset;
+			if (offset >= 0)
+			{
+				offset = (var.mType == MVT_VARIABLE) ? -1 : offset + var.mSize;
+			}
+			mDecodeVariables.push_back(var);
+		}
+		mDecodeBlocks.push_back(block);
+	}
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
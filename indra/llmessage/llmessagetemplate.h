@@ -391,6 +391,41 @@ public:
 		return iter != mMemberBlocks.end()? *iter : NULL;
 	}
 
+	// The blocks and variables flattened into arrays in packet order, for
+	// LLTemplateMessageReader to decode with. Built on first use by the
+	// thread reading messages, the template must be complete by then.
+	struct DecodeVariable
+	{
+		char*				mName;
+		EMsgVariableType	mType;
+		S32					mSize;		// for MVT_VARIABLE, the size of the length
+		S32					mOffset;	// from the block start, -1 after a MVT_VARIABLE
+	};
+
+	struct DecodeBlock
+	{
+		char*				mName;
+		EMsgBlockType		mType;
+		S32					mNumber;
+		S32					mTotalSize;	// -1 if any variable is MVT_VARIABLE
+		S32					mFirstVariable;
+		S32					mVariableCount;
+	};
+
+	const std::vector<DecodeBlock>& getDecodeBlocks()
+	{
+		if (mDecodeBlocks.size() != mMemberBlocks.size())
+		{
+			buildDecodeLayout();
+		}
+		return mDecodeBlocks;
+	}
+
+	const std::vector<DecodeVariable>& getDecodeVariables() const
+	{
+		return mDecodeVariables;
+	}
+
 public:
 	typedef LLIndexedVector<LLMessageBlock*, char*, 8> message_block_map_t;
 	message_block_map_t						mMemberBlocks;
@@ -413,6 +448,11 @@ public:
 	bool									mBanFromUntrusted;
 
 private:
+	void buildDecodeLayout();
+
+	std::vector<DecodeBlock>				mDecodeBlocks;
+	std::vector<DecodeVariable>				mDecodeVariables;
+
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
 	void									**mUserData;
@@ -55,7 +55,11 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mUseBatchedIO(FALSE),
+	mReceiveBatchCount(0),
+	mReceiveBatchNext(0),
+	mSendBatchCount(0)
 {
 }
 
@@ -83,6 +87,10 @@ void LLPacketRing::cleanup ()
 		delete packetp;
 		mSendQueue.pop();
 	}
+
+	mReceiveBatchCount = 0;
+	mReceiveBatchNext = 0;
+	mSendBatchCount = 0;
 }
 
 ///////////////////////////////////////////////////////////
@@ -116,6 +124,37 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 {
 	mOutThrottle.setRate(bps);
 }
+
+void LLPacketRing::setUseBatchedIO(const BOOL use_batched_io)
+{
+	// Turning it off leaves the pool alone: anything already received is
+	// still handed out by receivePacket() and queued sends by flushSends().
+	if (use_batched_io && mBatchBuffers.empty())
+	{
+		mBatchBuffers.resize(2 * NET_MAX_BATCH * NET_BUFFER_SIZE);
+		for (S32 i = 0; i < NET_MAX_BATCH; ++i)
+		{
+			mReceiveBatch[i].mData = &mBatchBuffers[i * NET_BUFFER_SIZE];
+			mSendBatch[i].mData = &mBatchBuffers[(NET_MAX_BATCH + i) * NET_BUFFER_SIZE];
+		}
+	}
+	mUseBatchedIO = use_batched_io;
+}
+
+BOOL LLPacketRing::flushSends(int h_socket)
+{
+	if (!mSendBatchCount)
+	{
+		return TRUE;
+	}
+
+	S32 count = mSendBatchCount;
+	mSendBatchCount = 0;
+	S32 sent = send_packets(h_socket, mSendBatch, count);
+	mIOStats.mSendCalls++;
+	mIOStats.mSendFailures += count - sent;
+	return sent == count;
+}
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 {
@@ -228,6 +267,7 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		{
 			U8 buffer[NET_BUFFER_SIZE + SOCKS_HEADER_SIZE];
 			packet_size = receive_packet(socket, static_cast<char*>(static_cast<void*>(buffer)));
+			mIOStats.mReceiveCalls++;
 			
 			if (packet_size > SOCKS_HEADER_SIZE)
 			{
@@ -243,17 +283,25 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 			{
 				packet_size = 0;
 			}
+			mLastReceivingIF = ::get_receiving_interface();
+		}
+		else if (mUseBatchedIO || mReceiveBatchNext < mReceiveBatchCount)
+		{
+			packet_size = receiveFromBatch(socket, datap);
 		}
 		else
 		{
 			packet_size = receive_packet(socket, datap);
+			mIOStats.mReceiveCalls++;
 			mLastSender = ::get_sender();
+			mLastReceivingIF = ::get_receiving_interface();
 		}
 
-		mLastReceivingIF = ::get_receiving_interface();
-
 		if (packet_size)  // did we actually get a packet?
 		{
+			mIOStats.mPacketsIn++;
+			mIOStats.mBytesIn += packet_size;
+
 			if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
 			{
 				mPacketsToDrop++;
@@ -270,6 +318,31 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	return packet_size;
 }
 
+S32 LLPacketRing::receiveFromBatch(S32 socket, char *datap)
+{
+	if (mReceiveBatchNext == mReceiveBatchCount)
+	{
+		mReceiveBatchNext = 0;
+		mReceiveBatchCount = 0;
+		if (!mUseBatchedIO)
+		{
+			return 0;
+		}
+		mReceiveBatchCount = receive_packets(socket, mReceiveBatch, NET_MAX_BATCH);
+		mIOStats.mReceiveCalls++;
+		if (!mReceiveBatchCount)
+		{
+			return 0;
+		}
+	}
+
+	const LLNetDatagram& packet = mReceiveBatch[mReceiveBatchNext++];
+	memcpy(datap, packet.mData, packet.mSize);	/*Flawfinder: ignore*/
+	mLastSender = LLHost(packet.mHostIP, packet.mHostPort);
+	mLastReceivingIF = LLHost(packet.mReceivingIF, INVALID_PORT);
+	return packet.mSize;
+}
+
 BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host)
 {
 	BOOL status = TRUE;
@@ -346,10 +419,30 @@ BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LL
 
 BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host)
 {
-	
+	mIOStats.mPacketsOut++;
+	mIOStats.mBytesOut += buf_size;
+
 	if (!LLProxy::isSOCKSProxyEnabled())
 	{
-		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
+		if (mUseBatchedIO)
+		{
+			LLNetDatagram& packet = mSendBatch[mSendBatchCount++];
+			memcpy(packet.mData, send_buffer, buf_size);	/*Flawfinder: ignore*/
+			packet.mSize = buf_size;
+			packet.mHostIP = host.getAddress();
+			packet.mHostPort = host.getPort();
+			// A failure in a full batch is reported against this packet,
+			// otherwise it only shows up in the stats
+			return mSendBatchCount < NET_MAX_BATCH || flushSends(h_socket);
+		}
+
+		mIOStats.mSendCalls++;
+		BOOL status = send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
+		if (!status)
+		{
+			mIOStats.mSendFailures++;
+		}
+		return status;
 	}
 
 	char headered_send_buffer[NET_BUFFER_SIZE + SOCKS_HEADER_SIZE];
@@ -363,6 +456,7 @@ BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 bu
 
 	memcpy(headered_send_buffer + SOCKS_HEADER_SIZE, send_buffer, buf_size);
 
+	mIOStats.mSendCalls++;
 	return send_packet(	h_socket,
 						headered_send_buffer,
 						buf_size + SOCKS_HEADER_SIZE,
@@ -28,7 +28,9 @@
 #ifndef LL_LLPACKETRING_H
 #define LL_LLPACKETRING_H
 
+#include <atomic>
 #include <queue>
+#include <vector>
 
 #include "llhost.h"
 #include "llpacketbuffer.h"
@@ -55,10 +57,35 @@ public:
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
+	// Batched I/O moves up to NET_MAX_BATCH datagrams per system call through
+	// a buffer pool allocated when it is first turned on. Received datagrams
+	// are handed out one at a time by receivePacket(); sent ones are held
+	// until the batch is full or flushSends() is called. Not used while the
+	// SOCKS proxy is on or for the simulated input throttle.
+	void setUseBatchedIO(const BOOL use_batched_io);
+	BOOL getUseBatchedIO() const				{ return mUseBatchedIO; }
+	// Returns FALSE if any queued datagram failed to send
+	BOOL flushSends(int h_socket);
+
+	// Running totals for both the batched and the one-at-a-time paths.
+	// Atomic since the network thread receives while the main thread sends
+	// and reports them.
+	struct IOStats
+	{
+		std::atomic<U64> mPacketsIn{ 0 };
+		std::atomic<U64> mBytesIn{ 0 };
+		std::atomic<U64> mReceiveCalls{ 0 };	// receive_packet() or receive_packets() calls
+		std::atomic<U64> mPacketsOut{ 0 };
+		std::atomic<U64> mBytesOut{ 0 };
+		std::atomic<U64> mSendCalls{ 0 };		// send_packet() or send_packets() calls
+		std::atomic<U64> mSendFailures{ 0 };
+	};
+	const IOStats& getIOStats() const			{ return mIOStats; }
+
 	inline LLHost getLastSender();
 	inline LLHost getLastReceivingInterface();
 
-	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
+	S32 getAndResetActualInBits()				{ return mActualBitsIn.exchange(0); }
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
 protected:
 	BOOL mUseInThrottle;
@@ -68,14 +95,14 @@ protected:
 	LLThrottle mInThrottle;
 	LLThrottle mOutThrottle;
 
-	S32 mActualBitsIn;
+	std::atomic<S32> mActualBitsIn;		// added to by the receiving thread
 	S32 mActualBitsOut;
 	S32 mMaxBufferLength;			// How much data can we queue up before dropping data.
 	S32 mInBufferLength;			// Current incoming buffer length
 	S32 mOutBufferLength;			// Current outgoing buffer length
 
 	F32 mDropPercentage;			// % of packets to drop
-	U32 mPacketsToDrop;				// drop next n packets
+	std::atomic<U32> mPacketsToDrop;	// drop next n packets, set from the main thread
 
 	std::queue<LLPacketBuffer *> mReceiveQueue;
 	std::queue<LLPacketBuffer *> mSendQueue;
@@ -83,8 +110,19 @@ protected:
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
+	BOOL mUseBatchedIO;
+	std::vector<char> mBatchBuffers;		// 2 * NET_MAX_BATCH buffers of NET_BUFFER_SIZE
+	LLNetDatagram mReceiveBatch[NET_MAX_BATCH];
+	S32 mReceiveBatchCount;
+	S32 mReceiveBatchNext;
+	LLNetDatagram mSendBatch[NET_MAX_BATCH];
+	S32 mSendBatchCount;
+
+	IOStats mIOStats;
+
 private:
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host);
+	S32  receiveFromBatch(S32 socket, char *datap);
 };
 
 
@@ -38,20 +38,31 @@
 #include "v3math.h"
 #include "v4math.h"
 
+LLTemplateMessageReader::DecodedMessage::DecodedMessage() :
+	mReceiveSize(-1),
+	mTemplate(NULL),
+	mReceiveBuffer(NULL),
+	mDecoded(false),
+	mRanOffEnd(false)
+{
+}
+
 LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mDecoded(false),
+	mRanOffEnd(false),
+	mMessageNumbers(number_template_map),
+	mReceiveBuffer(NULL),
+	mLastBlock(0),
+	mLastVariable(0)
 {
 }
 
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
@@ -59,8 +70,71 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mDecoded = false;
+	mRanOffEnd = false;
+	mReceiveBuffer = NULL;
+	mInstances.clear();
+	mFields.clear();
+}
+
+S32 LLTemplateMessageReader::findBlock(const char* blockname)
+{
+	const std::vector<LLMessageTemplate::DecodeBlock>& blocks = mCurrentRMessageTemplate->getDecodeBlocks();
+	const S32 count = (S32)blocks.size();
+	// names are canonical string table pointers, compare those
+	for (S32 i = 0, block = mLastBlock; i < count; ++i, ++block)
+	{
+		if (block >= count)
+		{
+			block = 0;
+		}
+		if (blocks[block].mName == blockname)
+		{
+			mLastBlock = block;
+			return block;
+		}
+	}
+	return -1;
+}
+
+S32 LLTemplateMessageReader::findVariable(S32 block, const char* varname)
+{
+	const LLMessageTemplate::DecodeBlock& decode_block = mCurrentRMessageTemplate->getDecodeBlocks()[block];
+	const std::vector<LLMessageTemplate::DecodeVariable>& variables = mCurrentRMessageTemplate->getDecodeVariables();
+	const S32 first = decode_block.mFirstVariable;
+	const S32 count = decode_block.mVariableCount;
+	// try the variable after the last one first
+	S32 start = mLastVariable + 1 - first;
+	if (start < 0 || start >= count)
+	{
+		start = 0;
+	}
+	for (S32 i = 0, var = start; i < count; ++i, ++var)
+	{
+		if (var >= count)
+		{
+			var = 0;
+		}
+		if (variables[first + var].mName == varname)
+		{
+			mLastVariable = first + var;
+			return first + var;
+		}
+	}
+	return -1;
+}
+
+LLTemplateMessageReader::Field LLTemplateMessageReader::getField(S32 block, S32 blocknum, S32 variable) const
+{
+	const BlockInstance& instance = mInstances[mBlockSpans[block].mFirstInstance + blocknum];
+	if (instance.mFirstField < 0)
+	{
+		const LLMessageTemplate::DecodeVariable& var = mCurrentRMessageTemplate->getDecodeVariables()[variable];
+		Field field = { instance.mStart + var.mOffset, var.mSize };
+		return field;
+	}
+	const LLMessageTemplate::DecodeBlock& decode_block = mCurrentRMessageTemplate->getDecodeBlocks()[block];
+	return mFields[instance.mFirstField + variable - decode_block.mFirstVariable];
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -72,79 +146,68 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mReceiveBuffer)
 	{
 		LL_ERRS() << "Invalid mCurrentMessageData in getData!" << LL_ENDL;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = findBlock(blockname);
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockSpans[block].mCount)
 	{
 		LL_ERRS() << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << LL_ENDL;
+			<< " not in message " << mCurrentRMessageTemplate->mName << LL_ENDL;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgBlkData::msg_var_data_map_t &var_data_map = msg_block_data->mMemberVarData;
-
-	if (var_data_map.find(vnamep) == var_data_map.end())
+	S32 variable = findVariable(block, varname);
+	if (variable < 0)
 	{
-		LL_ERRS() << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << LL_ENDL;
+		LL_ERRS() << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName<< " block " << blockname << LL_ENDL;
 		return;
 	}
 
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+	const Field field = getField(block, blocknum, variable);
 
-	if (size && size != vardata.getSize())
+	if (size && size != field.mSize)
 	{
-		LL_ERRS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_ERRS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << field.mSize
 			<< " but copying into buffer of size " << size
 			<< LL_ENDL;
 		return;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
-	if( max_size >= vardata_size )
-	{   
-		switch( vardata_size )
-		{ 
-		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
-			break;
-		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
-			break;
-		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
-			break;
-		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
-			break;
-		default:
-			memcpy(datap, vardata.getData(), vardata_size);
-			break;
+	const U8* src = (field.mOffset >= 0) ? mReceiveBuffer + field.mOffset : NULL;
+	if( max_size >= field.mSize )
+	{
+		if (!src)
+		{
+			memset(datap, 0, field.mSize);
+		}
+		else if (field.mSize)
+		{
+			htolememcpy(datap, src, mCurrentRMessageTemplate->getDecodeVariables()[variable].mType, field.mSize);
 		}
 	}
 	else
 	{
-		LL_WARNS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_WARNS() << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << field.mSize
 			<< " but truncated to max size of " << max_size
 			<< LL_ENDL;
 
-		memcpy(datap, vardata.getData(), max_size);
+		if (src)
+		{
+			memcpy(datap, src, max_size);
+		}
+		else
+		{
+			memset(datap, 0, max_size);
+		}
 	}
 }
 
@@ -157,22 +220,19 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mReceiveBuffer)
 	{
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = findBlock(blockname);
+	if (block < 0)
 	{
 		return 0;
 	}
 
-	return (iter->second)->mBlockNumber;
+	return mBlockSpans[block].mCount;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -184,43 +244,36 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mReceiveBuffer)
 	{	// This is a serious error - crash
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = findBlock(blockname);
+	if (block < 0 || mBlockSpans[block].mCount == 0)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " not in message "
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	S32 variable = findVariable(block, varname);
+	if (variable < 0)
 	{	// don't crash
 		LL_INFOS() << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	if (mCurrentRMessageTemplate->getDecodeBlocks()[block].mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		LL_ERRS() << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return getField(block, 0, variable).mSize;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -232,35 +285,29 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mReceiveBuffer)
 	{	// This is a serious error - crash
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block = findBlock(blockname);
+	if (block < 0 || blocknum < 0 || blocknum >= mBlockSpans[block].mCount)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< mCurrentRMessageTemplate->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	S32 variable = findVariable(block, varname);
+	if (variable < 0)
 	{	// don't crash
-		LL_INFOS() << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+		LL_INFOS() << "Variable " << varname << " not in message "
+			<<  mCurrentRMessageTemplate->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return getField(block, blocknum, variable).mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -525,52 +572,55 @@ void LLTemplateMessageReader::logRanOffEndOfPacket( const LLHost& host, const S3
 //				<< mCurrentRecvPacketID << " "
 				<< getMessageName() << LL_ENDL;
 	}
-	gMessageSystem->callExceptionFunc(MX_RAN_OFF_END_OF_PACKET);
+	// The exception callback is made by dispatchMessage() on the main thread
+	mRanOffEnd = true;
 }
 
-static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
-
 // decode a given message
 BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender )
 {
-    LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
-
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
-	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
+	// Nothing is copied: record where each block, and where need be each
+	// variable, starts in the packet.
+	mReceiveBuffer = buffer;
+	mDecoded = false;
+	mRanOffEnd = false;
+	mInstances.clear();
+	mFields.clear();
+	mLastBlock = 0;
+	mLastVariable = 0;
+
+	const std::vector<LLMessageTemplate::DecodeBlock>& blocks = mCurrentRMessageTemplate->getDecodeBlocks();
+	const std::vector<LLMessageTemplate::DecodeVariable>& variables = mCurrentRMessageTemplate->getDecodeVariables();
+	mBlockSpans.resize(blocks.size());
+
+	// loop through the template recording the layout as we go
+	for (size_t block = 0; block < blocks.size(); ++block)
 	{
-		LLMessageBlock* mbci = *iter;
+		const LLMessageTemplate::DecodeBlock& mbci = blocks[block];
 		U8	repeat_number;
 		S32	i;
 
 		// how many of this block?
 
-		if (mbci->mType == MBT_SINGLE)
+		if (mbci.mType == MBT_SINGLE)
 		{
 			// just one
 			repeat_number = 1;
 		}
-		else if (mbci->mType == MBT_MULTIPLE)
+		else if (mbci.mType == MBT_MULTIPLE)
 		{
 			// a known number
-			repeat_number = mbci->mNumber;
+			repeat_number = mbci.mNumber;
 		}
-		else if (mbci->mType == MBT_VARIABLE)
+		else if (mbci.mType == MBT_VARIABLE)
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
@@ -595,42 +645,38 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		mBlockSpans[block].mFirstInstance = (S32)mInstances.size();
+		mBlockSpans[block].mCount = repeat_number;
 
 		// now loop through the block
 		for (i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
+			BlockInstance instance;
+			instance.mStart = decode_pos;
+
+			if (mbci.mTotalSize >= 0 && decode_pos + mbci.mTotalSize <= mReceiveSize)
 			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
+				// fixed size and all there, the template knows the offsets
+				instance.mFirstField = -1;
+				mInstances.push_back(instance);
+				decode_pos += mbci.mTotalSize;
+				continue;
 			}
 
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
+			instance.mFirstField = (S32)mFields.size();
+			mInstances.push_back(instance);
 
 			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
+			for (S32 var = mbci.mFirstVariable; var < mbci.mFirstVariable + mbci.mVariableCount; ++var)
 			{
-				const LLMessageVariable& mvci = **iter;
-
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				const LLMessageTemplate::DecodeVariable& mvci = variables[var];
+				Field field;
 
 				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
+				if (mvci.mType == MVT_VARIABLE)
 				{
 					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
+					S32 data_size = mvci.mSize;
 					U8 tsizeb = 0;
 					U16 tsizeh = 0;
 					U32 tsize = 0;
@@ -664,43 +710,62 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					field.mOffset = decode_pos;
+					field.mSize = tsize;
+					if ((decode_pos + (S32)tsize) > mReceiveSize)
+					{
+						// the length claims more than the packet holds,
+						// read zeros rather than whatever follows it
+						logRanOffEndOfPacket(sender, decode_pos, tsize);
+						field.mOffset = -1;
+					}
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					field.mOffset = decode_pos;
+					field.mSize = mvci.mSize;
+					if ((decode_pos + mvci.mSize) > mReceiveSize)
 					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+						logRanOffEndOfPacket(sender, decode_pos, mvci.mSize);
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						field.mOffset = -1;
 					}
-					else
-					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
-					}
-					decode_pos += mvci.getSize();
+					decode_pos += mvci.mSize;
 				}
+				mFields.push_back(field);
 			}
 		}
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (mInstances.empty() && !blocks.empty())
 	{
 		LL_DEBUGS() << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << LL_ENDL;
 		return FALSE;
 	}
 
+	mDecoded = true;
+	return TRUE;
+}
+
+static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
+
+// call the handler for a decoded message
+BOOL LLTemplateMessageReader::dispatchMessage(const LLHost& sender)
+{
+	LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
+
+	if (mRanOffEnd)
+	{
+		gMessageSystem->callExceptionFunc(MX_RAN_OFF_END_OF_PACKET);
+	}
+	if (!mDecoded)
+	{
+		return FALSE;
+	}
+
 	{
 		static LLTimer decode_timer;
 
@@ -757,6 +822,12 @@ BOOL LLTemplateMessageReader::validateMessage(const U8* buffer,
 {
 	mReceiveSize = buffer_size;
 	BOOL valid = decodeTemplate(buffer, buffer_size, &mCurrentRMessageTemplate );
+	return valid && validateDecoded(sender, trusted);
+}
+
+BOOL LLTemplateMessageReader::validateDecoded(const LLHost& sender, bool trusted)
+{
+	BOOL valid = (mCurrentRMessageTemplate != NULL);
 	if(valid)
 	{
 		mCurrentRMessageTemplate->mReceiveCount++;
@@ -789,9 +860,36 @@ BOOL LLTemplateMessageReader::validateMessage(const U8* buffer,
 BOOL LLTemplateMessageReader::readMessage(const U8* buffer, 
 										  const LLHost& sender)
 {
+	decodeData(buffer, sender);
+	return dispatchMessage(sender);
+}
+
+BOOL LLTemplateMessageReader::decodeMessage(const U8* buffer, S32 buffer_size,
+											const LLHost& sender)
+{
+	clearMessage();
+	mReceiveSize = buffer_size;
+	if (!decodeTemplate(buffer, buffer_size, &mCurrentRMessageTemplate))
+	{
+		return FALSE;
+	}
 	return decodeData(buffer, sender);
 }
 
+void LLTemplateMessageReader::swapDecoded(DecodedMessage& decoded)
+{
+	std::swap(mReceiveSize, decoded.mReceiveSize);
+	std::swap(mCurrentRMessageTemplate, decoded.mTemplate);
+	std::swap(mReceiveBuffer, decoded.mReceiveBuffer);
+	mBlockSpans.swap(decoded.mBlockSpans);
+	mInstances.swap(decoded.mInstances);
+	mFields.swap(decoded.mFields);
+	std::swap(mDecoded, decoded.mDecoded);
+	std::swap(mRanOffEnd, decoded.mRanOffEnd);
+	mLastBlock = 0;
+	mLastVariable = 0;
+}
+
 //virtual 
 const char* LLTemplateMessageReader::getMessageName() const
 {
@@ -826,5 +924,43 @@ void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+
+	// The builder wants the old copying representation, only forwarded
+	// messages pay for it.
+	LLMsgData message(mCurrentRMessageTemplate->mName);
+	const std::vector<LLMessageTemplate::DecodeBlock>& blocks = mCurrentRMessageTemplate->getDecodeBlocks();
+	const std::vector<LLMessageTemplate::DecodeVariable>& variables = mCurrentRMessageTemplate->getDecodeVariables();
+	for (size_t block = 0; block < mBlockSpans.size(); ++block)
+	{
+		const LLMessageTemplate::DecodeBlock& mbci = blocks[block];
+		const S32 repeat_number = mBlockSpans[block].mCount;
+		for (S32 i = 0; i < repeat_number; ++i)
+		{
+			LLMsgBlkData* cur_data_block = new LLMsgBlkData(mbci.mName, repeat_number);
+			// build new name to prevent collisions
+			cur_data_block->mName = mbci.mName + i;
+			message.addBlock(cur_data_block);
+
+			for (S32 var = mbci.mFirstVariable; var < mbci.mFirstVariable + mbci.mVariableCount; ++var)
+			{
+				const LLMessageTemplate::DecodeVariable& mvci = variables[var];
+				cur_data_block->addVariable(mvci.mName, mvci.mType);
+				const Field field = getField((S32)block, i, var);
+				if (field.mOffset >= 0)
+				{
+					cur_data_block->addData(mvci.mName, mReceiveBuffer + field.mOffset, field.mSize, mvci.mType);
+				}
+				else if (mvci.mType == MVT_VARIABLE)
+				{
+					cur_data_block->addData(mvci.mName, NULL, 0, mvci.mType);
+				}
+				else
+				{
+					std::vector<U8> data(field.mSize, 0);
+					cur_data_block->addData(mvci.mName, &(data[0]), field.mSize, mvci.mType);
+				}
+			}
+		}
+	}
+	builder.copyFromMessageData(message);
 }
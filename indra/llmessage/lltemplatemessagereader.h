@@ -30,16 +30,63 @@
 #include "llmessagereader.h"
 
 #include <map>
+#include <vector>
 
 class LLMessageTemplate;
-class LLMsgData;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
+private:
+
+	// Where one decoded variable sits in the packet. mOffset is -1 when
+	// the packet ended first, the variable then reads as mSize zeros.
+	struct Field
+	{
+		S32 mOffset;
+		S32 mSize;
+	};
+
+	// One decoded copy of a block. Blocks whose size is fixed by the
+	// template and that fit in the packet have no Fields: each variable is
+	// at mStart plus its template offset.
+	struct BlockInstance
+	{
+		S32 mStart;
+		S32 mFirstField;	// into mFields, or -1
+	};
+
+	// The copies of one template block in the message
+	struct BlockSpan
+	{
+		S32 mFirstInstance;	// into mInstances
+		S32 mCount;
+	};
+
 public:
 
 	typedef std::map<U32, LLMessageTemplate*> message_template_number_map_t;
 
+	// A decoded message that can be moved from the reader that decoded it
+	// to the one that dispatches it with swapDecoded(). Reusing one keeps
+	// its vectors' capacity. The packet buffer must outlive dispatch.
+	class DecodedMessage
+	{
+	public:
+		DecodedMessage();
+
+	private:
+		friend class LLTemplateMessageReader;
+
+		S32 mReceiveSize;
+		LLMessageTemplate* mTemplate;
+		const U8* mReceiveBuffer;
+		std::vector<BlockSpan> mBlockSpans;
+		std::vector<BlockInstance> mInstances;
+		std::vector<Field> mFields;
+		bool mDecoded;
+		bool mRanOffEnd;
+	};
+
 	LLTemplateMessageReader(message_template_number_map_t&);
 	virtual ~LLTemplateMessageReader();
 
@@ -102,6 +149,16 @@ public:
 						 const LLHost& sender, bool trusted = false);
 	BOOL readMessage(const U8* buffer, const LLHost& sender);
 
+	// The same work split so that decoding can run on another thread:
+	// decodeMessage() finds the template and the layout without updating
+	// any template or message system state, provided the templates' decode
+	// layouts were built beforehand. The message is then swapDecoded() into
+	// the main thread's reader for validateDecoded() and dispatchMessage().
+	BOOL decodeMessage(const U8* buffer, S32 buffer_size, const LLHost& sender);
+	void swapDecoded(DecodedMessage& decoded);
+	BOOL validateDecoded(const LLHost& sender, bool trusted);
+	BOOL dispatchMessage(const LLHost& sender);
+
 	bool isTrusted() const;
 	bool isBanned(bool trusted_source) const;
 	bool isUdpBanned() const;
@@ -111,6 +168,12 @@ private:
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
+	// Index into the template's decode blocks, or -1
+	S32 findBlock(const char* blockname);
+	// Index into the template's decode variables, or -1
+	S32 findVariable(S32 block, const char* varname);
+	Field getField(S32 block, S32 blocknum, S32 variable) const;
+
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template ); // outputs
 
@@ -120,8 +183,22 @@ private:
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
+	bool mDecoded;			// decodeData() succeeded
+	bool mRanOffEnd;		// and found the packet shorter than the template
 	message_template_number_map_t& mMessageNumbers;
+
+	// The decoded message: views into mReceiveBuffer rather than copies,
+	// in vectors that keep their capacity from one message to the next
+	// so decoding doesn't allocate.
+	const U8* mReceiveBuffer;
+	std::vector<BlockSpan> mBlockSpans;
+	std::vector<BlockInstance> mInstances;
+	std::vector<Field> mFields;
+
+	// Handlers mostly read blocks and variables in template order, so
+	// lookups start where the last one left off.
+	S32 mLastBlock;
+	S32 mLastVariable;
 };
 
 #endif // LL_LLTEMPLATEMESSAGEREADER_H
@@ -55,6 +55,7 @@
 #include "llmd5.h"
 #include "llmessagebuilder.h"
 #include "llmessageconfig.h"
+#include "llmessagepipeline.h"
 #include "lltemplatemessagedispatcher.h"
 #include "llpumpio.h"
 #include "lltemplatemessagebuilder.h"
@@ -231,6 +232,8 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 
 	mTemplateMessageReader = new LLTemplateMessageReader(mMessageNumbers);
 	mLLSDMessageReader = new LLSDMessageReader();
+	mInboundPacket = new LLInboundPacket;
+	mPipeline = NULL;
 
 	// initialize various bits of net info
 	mSocket = 0;
@@ -275,6 +278,7 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 	mMaxMessageCounts = 200; // >= 0 means dump warnings
 	mMaxMessageTime   = F32Seconds(1.f);
 
+	mTrueReceiveBuffer = NULL;
 	mTrueReceiveSize = 0;
 
 	mReceiveTime = F32Seconds(0.f);
@@ -322,8 +326,13 @@ LLMessageSystem::~LLMessageSystem()
 	for_each(mMessageNumbers.begin(), mMessageNumbers.end(), DeletePairedPointer());
 	mMessageNumbers.clear();
 	
+	stopNetworkThread();
+	delete mInboundPacket;
+	mInboundPacket = NULL;
+
 	if (!mbError)
 	{
+		mPacketRing.flushSends(mSocket);
 		end_net(mSocket);
 	}
 	mSocket = 0;
@@ -498,243 +507,288 @@ BOOL LLMessageSystem::checkMessages(LockMessageChecker&, S64 frame_count )
 
 	// loop until either no packets or a valid packet
 	// i.e., burn through packets from unregistered circuits
-	S32 receive_size = 0;
 	do
 	{
 		clearReceiveState();
-		
-		BOOL recv_reliable = FALSE;
-		BOOL recv_resent = FALSE;
-		S32 acks = 0;
-		S32 true_rcv_size = 0;
 
-		U8* buffer = mTrueReceiveBuffer;
-		
-		mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
-		// If you want to dump all received packets into SecondLife.log, uncomment this
-		//dumpPacketToLog();
-		
-		receive_size = mTrueReceiveSize;
-		mLastSender = mPacketRing.getLastSender();
-		mLastReceivingIF = mPacketRing.getLastReceivingInterface();
-		
-		if (receive_size < (S32) LL_MINIMUM_VALID_PACKET_SIZE)
+		LLInboundPacket* packet = nextInboundPacket(frame_count);
+		if (!packet)
 		{
-			// A receive size of zero is OK, that means that there are no more packets available.
-			// Ones that are non-zero but below the minimum packet size are worrisome.
-			if (receive_size > 0)
-			{
-				LL_WARNS("Messaging") << "Invalid (too short) packet discarded " << receive_size << LL_ENDL;
-				callExceptionFunc(MX_PACKET_TOO_SHORT);
-			}
 			// no data in packet receive buffer
 			valid_packet = FALSE;
+			break;
 		}
-		else
-		{
-			LLHost host;
-			LLCircuitData* cdp;
-			
-			// note if packet acks are appended.
-			if(buffer[0] & LL_ACK_FLAG)
-			{
-				acks += buffer[--receive_size];
-				true_rcv_size = receive_size;
-				if(receive_size >= ((S32)(acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE)))
-				{
-					receive_size -= acks * sizeof(TPACKETID);
-				}
-				else
-				{
-					// mal-formed packet. ignore it and continue with
-					// the next one
-					LL_WARNS("Messaging") << "Malformed packet received. Packet size "
-						<< receive_size << " with invalid no. of acks " << acks
-						<< LL_ENDL;
-					valid_packet = FALSE;
-					continue;
-				}
-			}
+		valid_packet = processInboundPacket(*packet);
+	} while (!valid_packet);
 
-			// process the message as normal
-			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
-			mCurrentRecvPacketID = ntohl(*((U32*)(&buffer[1])));
-			host = getSender();
+	F64Seconds mt_sec = getMessageTimeSeconds();
+	// Check to see if we need to print debug info
+	if ((mt_sec - mCircuitPrintTime) > mCircuitPrintFreq)
+	{
+		dumpCircuitInfo();
+		mCircuitPrintTime = mt_sec;
+	}
 
-			const bool resetPacketId = true;
-			cdp = findCircuit(host, resetPacketId);
+	if( !valid_packet )
+	{
+		clearReceiveState();
+	}
 
-			// At this point, cdp is now a pointer to the circuit that
-			// this message came in on if it's valid, and NULL if the
-			// circuit was bogus.
+	return valid_packet;
+}
 
-			if(cdp && (acks > 0) && ((S32)(acks * sizeof(TPACKETID)) < (true_rcv_size)))
-			{
-				TPACKETID packet_id;
-				U32 mem_id=0;
-				for(S32 i = 0; i < acks; ++i)
-				{
-					true_rcv_size -= sizeof(TPACKETID);
-					memcpy(&mem_id, &mTrueReceiveBuffer[true_rcv_size], /* Flawfinder: ignore*/
-					     sizeof(TPACKETID));
-					packet_id = ntohl(mem_id);
-					//LL_INFOS("Messaging") << "got ack: " << packet_id << LL_ENDL;
-					cdp->ackReliablePacket(packet_id);
-				}
-				if (!cdp->getUnackedPacketCount())
-				{
-					// Remove this circuit from the list of circuits with unacked packets
-					mCircuitInfo.mUnackedCircuitMap.erase(cdp->mHost);
-				}
-			}
+LLInboundPacket* LLMessageSystem::nextInboundPacket(S64 frame_count)
+{
+	if (mPipeline)
+	{
+		return mPipeline->next(frame_count);
+	}
 
-			if (buffer[0] & LL_RELIABLE_FLAG)
-			{
-				recv_reliable = TRUE;
-			}
-			if (buffer[0] & LL_RESENT_FLAG)
-			{
-				recv_resent = TRUE;
-				if (cdp && cdp->isDuplicateResend(mCurrentRecvPacketID))
-				{
-					// We need to ACK here to suppress
-					// further resends of packets we've
-					// already seen.
-					if (recv_reliable)
-					{
-						//mAckList.addData(new LLPacketAck(host, mCurrentRecvPacketID));
-						// ***************************************
-						// TESTING CODE
-						//if(mCircuitInfo.mCurrentCircuit->mHost != host)
-						//{
-						//	LL_WARNS("Messaging") << "DISCARDED PACKET HOST MISMATCH! HOST: "
-						//			<< host << " CIRCUIT: "
-						//			<< mCircuitInfo.mCurrentCircuit->mHost
-						//			<< LL_ENDL;
-						//}
-						// ***************************************
-						//mCircuitInfo.mCurrentCircuit->mAcks.put(mCurrentRecvPacketID);
-						cdp->collectRAck(mCurrentRecvPacketID);
-					}
-								 
-					LL_DEBUGS("Messaging") << "Discarding duplicate resend from " << host << LL_ENDL;
-					if(mVerboseLog)
-					{
-						std::ostringstream str;
-						str << "MSG: <- " << host;
-						std::string tbuf;
-						tbuf = llformat( "\t%6d\t%6d\t%6d ", receive_size, (mIncomingCompressedSize ? mIncomingCompressedSize : receive_size), mCurrentRecvPacketID);
-						str << tbuf << "(unknown)"
-							<< (recv_reliable ? " reliable" : "")
-							<< " resent "
-							<< ((acks > 0) ? "acks" : "")
-							<< " DISCARD DUPLICATE";
-						LL_INFOS("Messaging") << str.str() << LL_ENDL;
-					}
-					mPacketsIn++;
-					valid_packet = FALSE;
-					continue;
-				}
-			}
+	LLInboundPacket* packet = mInboundPacket;
+	packet->mTrueSize = mPacketRing.receivePacket(mSocket, (char *)packet->mTrueBuffer);
+	if (!packet->mTrueSize)
+	{
+		// A receive size of zero is OK, that means that there are no more packets available.
+		return NULL;
+	}
+	packet->mSender = mPacketRing.getLastSender();
+	packet->mReceivingIF = mPacketRing.getLastReceivingInterface();
+	packet->prepare(*mTemplateMessageReader);
+	return packet;
+}
 
-			// UseCircuitCode can be a valid, off-circuit packet.
-			// But we don't want to acknowledge UseCircuitCode until the circuit is
-			// available, which is why the acknowledgement test is done above.  JC
-			bool trusted = cdp && cdp->getTrusted();
-			valid_packet = mTemplateMessageReader->validateMessage(
-				buffer,
-				receive_size,
-				host,
-				trusted);
-			if (!valid_packet)
-			{
-				clearReceiveState();
-			}
+// Everything checkMessages() does with a packet once it has been prepared:
+// circuit and ack bookkeeping, validation and calling the handler.
+// Returns TRUE if the packet held a valid message.
+BOOL LLMessageSystem::processInboundPacket(LLInboundPacket& packet)
+{
+	BOOL valid_packet = FALSE;
+	BOOL recv_reliable = FALSE;
+	BOOL recv_resent = FALSE;
+	S32 acks = packet.mAcks;
+	S32 receive_size = packet.mSize;
+	U8* buffer = packet.mData;
 
-			// UseCircuitCode is allowed in even from an invalid circuit, so that
-			// we can toss circuits around.
-			if(
-				valid_packet &&
-				!cdp && 
-				(mTemplateMessageReader->getMessageName() !=
-				 _PREHASH_UseCircuitCode))
-			{
-				logMsgFromInvalidCircuit( host, recv_reliable );
-				clearReceiveState();
-				valid_packet = FALSE;
-			}
+	mTrueReceiveBuffer = packet.mTrueBuffer;
+	mTrueReceiveSize = packet.mTrueSize;
+	mLastSender = packet.mSender;
+	mLastReceivingIF = packet.mReceivingIF;
+	// If you want to dump all received packets into SecondLife.log, uncomment this
+	//dumpPacketToLog();
 
-			if(
-				valid_packet &&
-				cdp &&
-				!cdp->getTrusted() && 
-				mTemplateMessageReader->isTrusted())
-			{
-				logTrustedMsgFromUntrustedCircuit( host );
-				clearReceiveState();
+	if (packet.mStatus == LLInboundPacket::PACKET_TOO_SHORT)
+	{
+		// Ones that are non-zero but below the minimum packet size are worrisome.
+		LL_WARNS("Messaging") << "Invalid (too short) packet discarded " << mTrueReceiveSize << LL_ENDL;
+		callExceptionFunc(MX_PACKET_TOO_SHORT);
+		return FALSE;
+	}
+	if (packet.mStatus == LLInboundPacket::PACKET_BAD_ACKS)
+	{
+		// mal-formed packet. ignore it and continue with
+		// the next one
+		LL_WARNS("Messaging") << "Malformed packet received. Packet size "
+			<< receive_size << " with invalid no. of acks " << acks
+			<< LL_ENDL;
+		return FALSE;
+	}
 
-				sendDenyTrustedCircuit(host);
-				valid_packet = FALSE;
-			}
+	// process the message as normal
+	if (packet.mCompressedSize)
+	{
+		mTotalBytesIn += packet.mCompressedSize;
+		mCompressedPacketsIn++;
+		mCompressedBytesIn += packet.mCompressedSize;
+		mUncompressedBytesIn += receive_size;
+	}
+	else
+	{
+		mTotalBytesIn += receive_size;
+	}
+	if (packet.mExpandOverflow)
+	{
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+	}
+	mIncomingCompressedSize = packet.mCompressedSize;
+	mCurrentRecvPacketID = packet.mPacketID;
+	LLHost host = getSender();
 
-			if( valid_packet )
-			{
-				logValidMsg(cdp, host, recv_reliable, recv_resent, (BOOL)(acks>0) );
-				valid_packet = mTemplateMessageReader->readMessage(buffer, host);
-			}
+	const bool resetPacketId = true;
+	LLCircuitData* cdp = findCircuit(host, resetPacketId);
 
-			// It's possible that the circuit went away, because ANY message can disable the circuit
-			// (for example, UseCircuit, CloseCircuit, DisableSimulator).  Find it again.
-			cdp = mCircuitInfo.findCircuit(host);
+	// At this point, cdp is now a pointer to the circuit that
+	// this message came in on if it's valid, and NULL if the
+	// circuit was bogus.
 
-			if (valid_packet)
-			{
-				mPacketsIn++;
-				mBytesIn += mTrueReceiveSize;
-				
-				// ACK here for	valid packets that we've seen
-				// for the first time.
-				if (cdp && recv_reliable)
-				{
-					// Add to the recently received list for duplicate suppression
-					cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
+	// the acks sit between the message and the ack count byte
+	S32 true_rcv_size = mTrueReceiveSize - 1;
+	if(cdp && (acks > 0) && ((S32)(acks * sizeof(TPACKETID)) < (true_rcv_size)))
+	{
+		TPACKETID packet_id;
+		U32 mem_id=0;
+		for(S32 i = 0; i < acks; ++i)
+		{
+			true_rcv_size -= sizeof(TPACKETID);
+			memcpy(&mem_id, &mTrueReceiveBuffer[true_rcv_size], /* Flawfinder: ignore*/
+			     sizeof(TPACKETID));
+			packet_id = ntohl(mem_id);
+			//LL_INFOS("Messaging") << "got ack: " << packet_id << LL_ENDL;
+			cdp->ackReliablePacket(packet_id);
+		}
+		if (!cdp->getUnackedPacketCount())
+		{
+			// Remove this circuit from the list of circuits with unacked packets
+			mCircuitInfo.mUnackedCircuitMap.erase(cdp->mHost);
+		}
+	}
 
-					// Put it onto the list of packets to be acked
-					cdp->collectRAck(mCurrentRecvPacketID);
-					mReliablePacketsIn++;
-				}
+	if (buffer[0] & LL_RELIABLE_FLAG)
+	{
+		recv_reliable = TRUE;
+	}
+	if (buffer[0] & LL_RESENT_FLAG)
+	{
+		recv_resent = TRUE;
+		if (cdp && cdp->isDuplicateResend(mCurrentRecvPacketID))
+		{
+			// We need to ACK here to suppress
+			// further resends of packets we've
+			// already seen.
+			if (recv_reliable)
+			{
+				cdp->collectRAck(mCurrentRecvPacketID);
 			}
-			else
+						 
+			LL_DEBUGS("Messaging") << "Discarding duplicate resend from " << host << LL_ENDL;
+			if(mVerboseLog)
 			{
-				if (mbProtected  && (!cdp))
-				{
-					LL_WARNS("Messaging") << "Invalid Packet from invalid circuit " << host << LL_ENDL;
-					mOffCircuitPackets++;
-				}
-				else
-				{
-					mInvalidOnCircuitPackets++;
-				}
+				std::ostringstream str;
+				str << "MSG: <- " << host;
+				std::string tbuf;
+				tbuf = llformat( "\t%6d\t%6d\t%6d ", receive_size, (mIncomingCompressedSize ? mIncomingCompressedSize : receive_size), mCurrentRecvPacketID);
+				str << tbuf << "(unknown)"
+					<< (recv_reliable ? " reliable" : "")
+					<< " resent "
+					<< ((acks > 0) ? "acks" : "")
+					<< " DISCARD DUPLICATE";
+				LL_INFOS("Messaging") << str.str() << LL_ENDL;
 			}
+			mPacketsIn++;
+			return FALSE;
 		}
-	} while (!valid_packet && receive_size > 0);
+	}
 
-	F64Seconds mt_sec = getMessageTimeSeconds();
-	// Check to see if we need to print debug info
-	if ((mt_sec - mCircuitPrintTime) > mCircuitPrintFreq)
+	// The message was decoded along with the rest of the packet, bring
+	// it into the reader the handlers use.
+	mTemplateMessageReader->swapDecoded(packet.mDecoded);
+
+	// UseCircuitCode can be a valid, off-circuit packet.
+	// But we don't want to acknowledge UseCircuitCode until the circuit is
+	// available, which is why the acknowledgement test is done above.  JC
+	bool trusted = cdp && cdp->getTrusted();
+	valid_packet = mTemplateMessageReader->validateDecoded(host, trusted);
+	if (!valid_packet)
 	{
-		dumpCircuitInfo();
-		mCircuitPrintTime = mt_sec;
+		clearReceiveState();
 	}
 
-	if( !valid_packet )
+	// UseCircuitCode is allowed in even from an invalid circuit, so that
+	// we can toss circuits around.
+	if(
+		valid_packet &&
+		!cdp && 
+		(mTemplateMessageReader->getMessageName() !=
+		 _PREHASH_UseCircuitCode))
 	{
+		logMsgFromInvalidCircuit( host, recv_reliable );
 		clearReceiveState();
+		valid_packet = FALSE;
 	}
 
+	if(
+		valid_packet &&
+		cdp &&
+		!cdp->getTrusted() && 
+		mTemplateMessageReader->isTrusted())
+	{
+		logTrustedMsgFromUntrustedCircuit( host );
+		clearReceiveState();
+
+		sendDenyTrustedCircuit(host);
+		valid_packet = FALSE;
+	}
+
+	if( valid_packet )
+	{
+		logValidMsg(cdp, host, recv_reliable, recv_resent, (BOOL)(acks>0) );
+		valid_packet = mTemplateMessageReader->dispatchMessage(host);
+	}
+
+	// It's possible that the circuit went away, because ANY message can disable the circuit
+	// (for example, UseCircuit, CloseCircuit, DisableSimulator).  Find it again.
+	cdp = mCircuitInfo.findCircuit(host);
+
+	if (valid_packet)
+	{
+		mPacketsIn++;
+		mBytesIn += mTrueReceiveSize;
+		
+		// ACK here for	valid packets that we've seen
+		// for the first time.
+		if (cdp && recv_reliable)
+		{
+			// Add to the recently received list for duplicate suppression
+			cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
+
+			// Put it onto the list of packets to be acked
+			cdp->collectRAck(mCurrentRecvPacketID);
+			mReliablePacketsIn++;
+		}
+	}
+	else
+	{
+		if (mbProtected  && (!cdp))
+		{
+			LL_WARNS("Messaging") << "Invalid Packet from invalid circuit " << host << LL_ENDL;
+			mOffCircuitPackets++;
+		}
+		else
+		{
+			mInvalidOnCircuitPackets++;
+		}
+	}
 	return valid_packet;
 }
 
+void LLMessageSystem::startNetworkThread()
+{
+	if (mPipeline || mbError)
+	{
+		return;
+	}
+
+	// Build every decode layout now, the network thread only reads them
+	for (message_template_name_map_t::iterator iter = mMessageTemplates.begin();
+		 iter != mMessageTemplates.end(); ++iter)
+	{
+		iter->second->getDecodeBlocks();
+	}
+
+	LL_INFOS("Messaging") << "Starting message network thread" << LL_ENDL;
+	mPipeline = new LLMessagePipeline(mSocket, mPacketRing, mMessageNumbers);
+	mPipeline->start();
+}
+
+void LLMessageSystem::stopNetworkThread()
+{
+	if (mPipeline)
+	{
+		// Packets it had ready are dropped, like any other lost packet
+		delete mPipeline;
+		mPipeline = NULL;
+	}
+}
+
 S32	LLMessageSystem::getReceiveBytes() const
 {
 	if (getReceiveCompressedSize())
@@ -816,6 +870,12 @@ void LLMessageSystem::processAcks(LockMessageChecker&, F32 collect_time)
 		mResendDumpTime = mt_sec;
 		mCircuitInfo.dumpResends();
 	}
+
+	// With batched I/O, anything sent this frame goes out now
+	if (!mPacketRing.flushSends(mSocket))
+	{
+		mSendPacketFailureCount++;
+	}
 }
 
 void LLMessageSystem::copyMessageReceivedToSend()
@@ -2611,6 +2671,18 @@ void LLMessageSystem::summarizeLogs(std::ostream& str)
 	buffer = llformat( "On-circuit invalid packets:   %17d", mInvalidOnCircuitPackets);
 	str << buffer << std::endl << std::endl;
 
+	const LLPacketRing::IOStats& io_stats = mPacketRing.getIOStats();
+	str << "Socket I/O" << (mPacketRing.getUseBatchedIO() ? " (batched):" : ":") << std::endl;
+	tmp_str = U64_to_str(io_stats.mReceiveCalls);
+	buffer = llformat( "Receive calls:             %20s (%5.2f packets per call)", tmp_str.c_str(), (F32)io_stats.mPacketsIn / (F32)llmax(io_stats.mReceiveCalls.load(), (U64)1));
+	str << buffer << std::endl;
+	tmp_str = U64_to_str(io_stats.mSendCalls);
+	buffer = llformat( "Send calls:                %20s (%5.2f packets per call)", tmp_str.c_str(), (F32)io_stats.mPacketsOut / (F32)llmax(io_stats.mSendCalls.load(), (U64)1));
+	str << buffer << std::endl;
+	tmp_str = U64_to_str(io_stats.mSendFailures);
+	buffer = llformat( "Socket send failures:      %20s", tmp_str.c_str());
+	str << buffer << std::endl << std::endl;
+
 	str << "Decoding: " << std::endl;
 	buffer = llformat( "%35s%10s%10s%10s%10s", "Message", "Count", "Time", "Max", "Avg");
 	str << buffer << std:: endl;	
@@ -2816,100 +2888,6 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 
 
 
-S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
-{
-	if ((*data_size ) < LL_MINIMUM_VALID_PACKET_SIZE)
-	{
-		LL_WARNS("Messaging") << "zeroCodeExpand() called with data_size of " << *data_size
-			<< LL_ENDL;
-	}
-
-	mTotalBytesIn += *data_size;
-
-	// if we're not zero-coded, simply return.
-	if (!(*data[0] & LL_ZERO_CODE_FLAG))
-	{
-		return 0;
-	}
-
-	S32 in_size = *data_size;
-	mCompressedPacketsIn++;
-	mCompressedBytesIn += *data_size;
-	
-	*data[0] &= (~LL_ZERO_CODE_FLAG);
-
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
-	{
-		count--;
-		*outptr++ = *inptr++;
-	}
-
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
-	}
-	
-	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
-	mUncompressedBytesIn += *data_size;
-
-	return(in_size);
-}
-
-
 void LLMessageSystem::addTemplate(LLMessageTemplate *templatep)
 {
 	if (mMessageTemplates.count(templatep->mName) > 0)
@@ -3326,7 +3304,11 @@ void LLMessageSystem::establishBidirectionalTrust(const LLHost &host, S64 frame_
 
 void LLMessageSystem::dumpPacketToLog()
 {
-	LL_WARNS("Messaging") << "Packet Dump from:" << mPacketRing.getLastSender() << LL_ENDL;
+	if (!mTrueReceiveBuffer)
+	{
+		return;
+	}
+	LL_WARNS("Messaging") << "Packet Dump from:" << getSender() << LL_ENDL;
 	LL_WARNS("Messaging") << "Packet Size:" << mTrueReceiveSize << LL_ENDL;
 	char line_buffer[256];		/* Flawfinder: ignore */
 	S32 i;
@@ -185,6 +185,8 @@ class LLSDMessageBuilder;
 class LLMessageReader;
 class LLTemplateMessageReader;
 class LLSDMessageReader;
+class LLMessagePipeline;
+struct LLInboundPacket;
 
 
 
@@ -417,6 +419,14 @@ public:
 	BOOL	checkMessages(LockMessageChecker&, S64 frame_count = 0 );
 	void	processAcks(LockMessageChecker&, F32 collect_time = 0.f);
 
+	// Moves receiving, zero expansion and template decoding of UDP packets
+	// to a network thread. checkMessages() then handles the packets that
+	// thread has ready, taking a new batch at most once per frame_count.
+	// Call once the message templates are loaded.
+	void	startNetworkThread();
+	void	stopNetworkThread();
+	bool	isNetworkThreadRunning() const	{ return mPipeline != NULL; }
+
 	BOOL	isMessageFast(const char *msg);
 	BOOL	isMessage(const char *msg)
 	{
@@ -536,7 +546,6 @@ public:
 	//void	buildMessage();
 
 	S32     zeroCode(U8 **data, S32 *data_size);
-	S32		zeroCodeExpand(U8 **data, S32 *data_size);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
 	// Uses ping-based retry
@@ -856,9 +865,15 @@ private:
 
 	LLMessagePollInfo						*mPollInfop;
 
-	U8	mEncodedRecvBuffer[MAX_BUFFER_SIZE];
-	U8	mTrueReceiveBuffer[MAX_BUFFER_SIZE];
+	// The packet being handled, and the one checkMessages() reads into
+	// when there is no network thread
+	const U8* mTrueReceiveBuffer;
 	S32	mTrueReceiveSize;
+	LLInboundPacket* mInboundPacket;
+	LLMessagePipeline* mPipeline;
+
+	LLInboundPacket* nextInboundPacket(S64 frame_count);
+	BOOL processInboundPacket(LLInboundPacket& packet);
 
 	// Must be valid during decode
 	
@@ -35,6 +35,7 @@
 #include "llwin32headerslean.h"
 #else
 	#include <sys/types.h>
+	#include <sys/select.h>
 	#include <sys/socket.h>
 	#include <netinet/in.h>
 	#include <arpa/inet.h>
@@ -112,6 +113,17 @@ U32 get_receiving_interface_ip(void)
 	return gsnReceivingIFAddr;
 }
 
+BOOL wait_for_packet(int hSocket, S32 timeout_ms)
+{
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(hSocket, &readable);
+	struct timeval timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;
+	return select(hSocket + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
 const char* u32_to_ip_string(U32 ip)
 {
 	static char buffer[MAXADDRSTR];	 /* Flawfinder: ignore */ 
@@ -660,4 +672,144 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 
 #endif
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Batched receive and send
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#if LL_LINUX
+
+S32 receive_packets(int hSocket, LLNetDatagram* packets, S32 count)
+{
+	struct mmsghdr msgs[NET_MAX_BATCH];
+	struct iovec iov[NET_MAX_BATCH];
+	struct sockaddr_in from[NET_MAX_BATCH];
+	char cmsg[NET_MAX_BATCH][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+	count = llmin(count, NET_MAX_BATCH);
+	memset(msgs, 0, count * sizeof(msgs[0]));
+	for (S32 i = 0; i < count; ++i)
+	{
+		iov[i].iov_base = packets[i].mData;
+		iov[i].iov_len = NET_BUFFER_SIZE;
+		msgs[i].msg_hdr.msg_name = &from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = cmsg[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(cmsg[i]);
+	}
+
+	int received = recvmmsg(hSocket, msgs, count, MSG_DONTWAIT, NULL);
+	if (received <= 0)
+	{
+		// Nothing waiting, or an error: same as receive_packet() returning 0
+		return 0;
+	}
+
+	for (S32 i = 0; i < received; ++i)
+	{
+		LLNetDatagram& packet = packets[i];
+		packet.mSize = msgs[i].msg_len;
+		packet.mHostIP = from[i].sin_addr.s_addr;
+		packet.mHostPort = ntohs(from[i].sin_port);
+		packet.mReceivingIF = INVALID_HOST_IP_ADDRESS;
+		for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+			 cmsgptr != NULL;
+			 cmsgptr = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsgptr))
+		{
+			if (cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO)
+			{
+				// see recvfrom_destip()
+				in_pktinfo* pktinfo = (in_pktinfo*)CMSG_DATA(cmsgptr);
+				packet.mReceivingIF = pktinfo->ipi_spec_dst.s_addr;
+			}
+		}
+	}
+	return received;
+}
+
+S32 send_packets(int hSocket, const LLNetDatagram* packets, S32 count)
+{
+	struct mmsghdr msgs[NET_MAX_BATCH];
+	struct iovec iov[NET_MAX_BATCH];
+	struct sockaddr_in to[NET_MAX_BATCH];
+
+	count = llmin(count, NET_MAX_BATCH);
+	memset(msgs, 0, count * sizeof(msgs[0]));
+	memset(to, 0, count * sizeof(to[0]));
+	for (S32 i = 0; i < count; ++i)
+	{
+		to[i].sin_family = AF_INET;
+		to[i].sin_addr.s_addr = packets[i].mHostIP;
+		to[i].sin_port = htons(packets[i].mHostPort);
+		iov[i].iov_base = packets[i].mData;
+		iov[i].iov_len = packets[i].mSize;
+		msgs[i].msg_hdr.msg_name = &to[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(to[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	S32 done = 0;
+	S32 sent = 0;
+	while (done < count)
+	{
+		int ret = sendmmsg(hSocket, msgs + done, count - done, 0);
+		if (ret > 0)
+		{
+			done += ret;
+			sent += ret;
+		}
+		else
+		{
+			// sendmmsg() stops at the first datagram that fails. Hand that
+			// one to send_packet(), which knows which errors to retry and
+			// logs the rest, then carry on with the remainder.
+			const LLNetDatagram& packet = packets[done];
+			if (send_packet(hSocket, packet.mData, packet.mSize, packet.mHostIP, packet.mHostPort))
+			{
+				++sent;
+			}
+			++done;
+		}
+	}
+	return sent;
+}
+
+#else
+
+S32 receive_packets(int hSocket, LLNetDatagram* packets, S32 count)
+{
+	S32 received = 0;
+	while (received < count)
+	{
+		LLNetDatagram& packet = packets[received];
+		packet.mSize = receive_packet(hSocket, packet.mData);
+		if (packet.mSize <= 0)
+		{
+			break;
+		}
+		packet.mHostIP = get_sender_ip();
+		packet.mHostPort = get_sender_port();
+		packet.mReceivingIF = get_receiving_interface_ip();
+		++received;
+	}
+	return received;
+}
+
+S32 send_packets(int hSocket, const LLNetDatagram* packets, S32 count)
+{
+	S32 sent = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		if (send_packet(hSocket, packets[i].mData, packets[i].mSize, packets[i].mHostIP, packets[i].mHostPort))
+		{
+			++sent;
+		}
+	}
+	return sent;
+}
+
+#endif
+
 //EOF
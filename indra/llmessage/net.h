@@ -45,6 +45,31 @@ S32		receive_packet(int hSocket, char * receiveBuffer);
 
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// Blocks for up to timeout_ms until a datagram can be read from hSocket,
+// returns TRUE if one can.
+BOOL	wait_for_packet(int hSocket, S32 timeout_ms);
+
+// Most datagrams moved by one receive_packets() or send_packets() call
+const S32 NET_MAX_BATCH = 32;
+
+// One datagram for the batched calls. The host is the sender when
+// receiving and the recipient when sending; ports are in host order.
+struct LLNetDatagram
+{
+	char*	mData;			// NET_BUFFER_SIZE bytes when receiving
+	S32		mSize;
+	U32		mHostIP;
+	U32		mHostPort;
+	U32		mReceivingIF;	// only set when receiving
+};
+
+// Batched receive and send, one recvmmsg()/sendmmsg() system call per batch
+// on Linux and a loop over receive_packet()/send_packet() elsewhere.
+// receive_packets() returns how many datagrams it filled in (0 when none are
+// waiting), send_packets() how many were sent successfully.
+S32		receive_packets(int hSocket, LLNetDatagram* packets, S32 count);
+S32		send_packets(int hSocket, const LLNetDatagram* packets, S32 count);
+
 //void	get_sender(char * tmp);
 LLHost	get_sender();
 U32		get_sender_port();
@@ -0,0 +1,243 @@
+/**
+ * @file llmessagepipeline_test.cpp
+ * @date 2022-04
+ * @brief LLInboundPacket preparation and LLMessagePipeline hand off tests.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmessagepipeline.h"
+
+#if LL_WINDOWS
+	#include <winsock2.h>
+#else
+	#include <netinet/in.h>
+#endif
+
+#include "llpacketring.h"
+#include "lltimer.h"
+#include "message.h"
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct messagepipeline_data
+	{
+		// No templates: every message fails to decode, which is fine since
+		// these tests only look at what prepare() does around the decoder
+		LLTemplateMessageReader::message_template_number_map_t mTemplates;
+		LLTemplateMessageReader mDecoder;
+
+		messagepipeline_data() :
+			mDecoder(mTemplates)
+		{
+		}
+
+		// Writes the packet header for packet_id, returns its size
+		static S32 writeHeader(U8* buffer, U8 flags, U32 packet_id)
+		{
+			buffer[0] = flags;
+			U32 id = htonl(packet_id);
+			memcpy(&buffer[1], &id, sizeof(id));
+			buffer[5] = 0;		// no extra header
+			return LL_PACKET_ID_SIZE;
+		}
+
+		void prepare(LLInboundPacket& packet, const std::vector<U8>& data)
+		{
+			memcpy(packet.mTrueBuffer, data.data(), data.size());
+			packet.mTrueSize = (S32)data.size();
+			packet.prepare(mDecoder);
+		}
+
+		static std::vector<U8> makePacket(U8 flags, U32 packet_id, const std::vector<U8>& body)
+		{
+			std::vector<U8> data(LL_PACKET_ID_SIZE);
+			writeHeader(data.data(), flags, packet_id);
+			data.insert(data.end(), body.begin(), body.end());
+			return data;
+		}
+
+		static void appendAcks(std::vector<U8>& data, U8 count)
+		{
+			for (U8 i = 0; i < count; ++i)
+			{
+				TPACKETID ack = htonl(100 + i);
+				const U8* bytes = (const U8*)&ack;
+				data.insert(data.end(), bytes, bytes + sizeof(ack));
+			}
+			data.push_back(count);
+		}
+	};
+	typedef test_group<messagepipeline_data> messagepipeline_test;
+	typedef messagepipeline_test::object messagepipeline_object;
+	tut::messagepipeline_test messagepipeline_testcase("LLMessagePipeline");
+
+	template<> template<>
+	void messagepipeline_object::test<1>()
+	{
+		set_test_name("plain and short packets");
+		LLInboundPacket packet;
+
+		const std::vector<U8> body = { 0xff, 0xff, 0x00, 0x01, 0x42 };
+		prepare(packet, makePacket(0, 0x01020304, body));
+		ensure_equals("status", packet.mStatus, LLInboundPacket::PACKET_OK);
+		ensure_equals("packet id", packet.mPacketID, (TPACKETID)0x01020304);
+		ensure_equals("acks", packet.mAcks, 0);
+		ensure_equals("size", packet.mSize, (S32)(LL_PACKET_ID_SIZE + body.size()));
+		ensure("data is the received buffer", packet.mData == packet.mTrueBuffer);
+		ensure_equals("not zero coded", packet.mCompressedSize, 0);
+
+		prepare(packet, std::vector<U8>(LL_MINIMUM_VALID_PACKET_SIZE - 1, 0));
+		ensure_equals("too short", packet.mStatus, LLInboundPacket::PACKET_TOO_SHORT);
+	}
+
+	template<> template<>
+	void messagepipeline_object::test<2>()
+	{
+		set_test_name("appended acks");
+		LLInboundPacket packet;
+
+		const std::vector<U8> body = { 0xff, 0xff, 0x00, 0x01, 0x42 };
+		std::vector<U8> data = makePacket(LL_ACK_FLAG, 7, body);
+		appendAcks(data, 3);
+		prepare(packet, data);
+		ensure_equals("status", packet.mStatus, LLInboundPacket::PACKET_OK);
+		ensure_equals("acks", packet.mAcks, 3);
+		ensure_equals("size without acks", packet.mSize, (S32)(LL_PACKET_ID_SIZE + body.size()));
+		TPACKETID last_ack;
+		memcpy(&last_ack, &packet.mTrueBuffer[packet.mSize + 2 * sizeof(TPACKETID)], sizeof(last_ack));
+		ensure_equals("acks left in place", ntohl(last_ack), (TPACKETID)102);
+		ensure_equals("packet id", packet.mPacketID, (TPACKETID)7);
+
+		// More acks than the packet has room for
+		data = makePacket(LL_ACK_FLAG, 8, body);
+		appendAcks(data, 1);
+		data.back() = 200;
+		prepare(packet, data);
+		ensure_equals("bad ack count", packet.mStatus, LLInboundPacket::PACKET_BAD_ACKS);
+
+		// Reusing the packet starts over
+		prepare(packet, makePacket(0, 9, body));
+		ensure_equals("reused status", packet.mStatus, LLInboundPacket::PACKET_OK);
+		ensure_equals("reused acks", packet.mAcks, 0);
+	}
+
+	template<> template<>
+	void messagepipeline_object::test<3>()
+	{
+		set_test_name("zero coded packets");
+		LLInboundPacket packet;
+
+		// 0x00 n encodes n zeros
+		const std::vector<U8> body = { 0xff, 0x00, 0x03, 0x07, 0x00, 0x01, 0x08 };
+		const std::vector<U8> expanded = { 0xff, 0x00, 0x00, 0x00, 0x07, 0x00, 0x08 };
+		std::vector<U8> data = makePacket(LL_ZERO_CODE_FLAG | LL_ACK_FLAG, 11, body);
+		appendAcks(data, 2);
+		prepare(packet, data);
+		ensure_equals("status", packet.mStatus, LLInboundPacket::PACKET_OK);
+		ensure_equals("acks", packet.mAcks, 2);
+		ensure_equals("compressed size", packet.mCompressedSize, (S32)(LL_PACKET_ID_SIZE + body.size()));
+		ensure_equals("expanded size", packet.mSize, (S32)(LL_PACKET_ID_SIZE + expanded.size()));
+		ensure("data is the expanded buffer", packet.mData != packet.mTrueBuffer);
+		ensure("no overflow", !packet.mExpandOverflow);
+		ensure("zero code flag cleared", !(packet.mTrueBuffer[0] & LL_ZERO_CODE_FLAG));
+		ensure("header copied", memcmp(packet.mData, packet.mTrueBuffer, LL_PACKET_ID_SIZE) == 0);
+		ensure("body expanded", memcmp(packet.mData + LL_PACKET_ID_SIZE, expanded.data(), expanded.size()) == 0);
+		ensure_equals("packet id", packet.mPacketID, (TPACKETID)11);
+
+		// A run of 0x00 0x00 pairs asks for 256 zeros each, far more than
+		// the expansion buffer holds
+		data = makePacket(LL_ZERO_CODE_FLAG, 12, std::vector<U8>(64, 0));
+		prepare(packet, data);
+		ensure("overflow", packet.mExpandOverflow);
+		ensure("overflow size bounded", packet.mSize >= 0 && packet.mSize <= NET_BUFFER_SIZE);
+	}
+
+	template<> template<>
+	void messagepipeline_object::test<4>()
+	{
+		set_test_name("batches handed to the main thread");
+
+		S32 send_socket = -1;
+		S32 receive_socket = -1;
+		int send_port = NET_USE_OS_ASSIGNED_PORT;
+		int receive_port = NET_USE_OS_ASSIGNED_PORT;
+		start_net(send_socket, send_port);
+		start_net(receive_socket, receive_port);
+		ensure("sockets", send_socket >= 0 && receive_socket >= 0);
+
+		LLPacketRing sender;
+		LLPacketRing receiver;
+		LLHost dest(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), receive_port);
+		const std::vector<U8> body = { 0xff, 0xff, 0x00, 0x01, 0x42 };
+		auto send = [&](U32 first, U32 count)
+		{
+			for (U32 id = first; id < first + count; ++id)
+			{
+				std::vector<U8> data = makePacket(0, id, body);
+				sender.sendPacket(send_socket, (char*)data.data(), (S32)data.size(), dest);
+			}
+			sender.flushSends(send_socket);
+		};
+
+		{
+			LLMessagePipeline pipeline(receive_socket, receiver, mTemplates);
+			pipeline.start();
+
+			// Picks up whatever the thread has ready, once per frame
+			S64 frame = 0;
+			U32 next_id = 1;
+			auto receive = [&](U32 count)
+			{
+				LLTimer timeout;
+				while (next_id <= count && timeout.getElapsedTimeF32() < 5.f)
+				{
+					++frame;
+					while (LLInboundPacket* packet = pipeline.next(frame))
+					{
+						ensure_equals("packet order", packet->mPacketID, next_id);
+						ensure_equals("packet status", packet->mStatus, LLInboundPacket::PACKET_OK);
+						ensure_equals("sender port", packet->mSender.getPort(), (U32)send_port);
+						++next_id;
+					}
+					ms_sleep(1);
+				}
+				ensure_equals("received", next_id - 1, count);
+			};
+
+			send(1, 100);
+			receive(100);
+
+			// This frame's batch is used up, more waits for the next frame
+			send(101, 20);
+			ms_sleep(100);
+			ensure("one batch per frame", pipeline.next(frame) == NULL);
+			receive(120);
+		}
+
+		end_net(send_socket);
+		end_net(receive_socket);
+	}
+}
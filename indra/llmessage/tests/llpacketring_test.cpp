@@ -0,0 +1,165 @@
+/**
+ * @file llpacketring_test.cpp
+ * @date 2022-04
+ * @brief LLPacketRing batched I/O tests and loopback benchmark.
+ *
+ * $LicenseInfo:firstyear=2022&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2022, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketring.h"
+
+#include <iostream>
+
+#include "llstring.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct packetring_data
+	{
+		S32 mSendSocket;
+		S32 mReceiveSocket;
+		int mReceivePort;
+
+		packetring_data() :
+			mSendSocket(-1),
+			mReceiveSocket(-1),
+			mReceivePort(NET_USE_OS_ASSIGNED_PORT)
+		{
+			int send_port = NET_USE_OS_ASSIGNED_PORT;
+			start_net(mSendSocket, send_port);
+			start_net(mReceiveSocket, mReceivePort);
+		}
+
+		~packetring_data()
+		{
+			end_net(mSendSocket);
+			end_net(mReceiveSocket);
+		}
+
+		// Sends count packets of size bytes in rounds small enough for the
+		// socket buffer, reading each round back and checking its contents.
+		// Returns the number received.
+		S32 roundTrip(LLPacketRing& sender, LLPacketRing& receiver, S32 count, S32 size)
+		{
+			const S32 ROUND = 64;
+			LLHost dest(ip_string_to_u32(LOOPBACK_ADDRESS_STRING), mReceivePort);
+			char send_buffer[NET_BUFFER_SIZE];
+			char receive_buffer[NET_BUFFER_SIZE];
+			S32 received = 0;
+			for (S32 first = 0; first < count; first += ROUND)
+			{
+				S32 last = llmin(first + ROUND, count);
+				for (S32 i = first; i < last; ++i)
+				{
+					memset(send_buffer, (U8)i, size);
+					memcpy(send_buffer, &i, sizeof(i));
+					sender.sendPacket(mSendSocket, send_buffer, size, dest);
+				}
+				sender.flushSends(mSendSocket);
+
+				// Loopback delivery is immediate but give it a moment anyway
+				LLTimer timeout;
+				while (received < last && timeout.getElapsedTimeF32() < 2.f)
+				{
+					S32 got = receiver.receivePacket(mReceiveSocket, receive_buffer);
+					if (!got)
+					{
+						continue;
+					}
+					S32 index;
+					memcpy(&index, receive_buffer, sizeof(index));
+					ensure_equals("packet order", index, received);
+					ensure_equals("packet size", got, size);
+					ensure_equals("packet contents", (U8)receive_buffer[size - 1], (U8)index);
+					ensure_equals("sender address", receiver.getLastSender().getAddress(), dest.getAddress());
+					++received;
+				}
+			}
+			return received;
+		}
+	};
+	typedef test_group<packetring_data> packetring_test;
+	typedef packetring_test::object packetring_object;
+	tut::packetring_test packetring_testcase("LLPacketRing");
+
+	template<> template<>
+	void packetring_object::test<1>()
+	{
+		set_test_name("batched round trip");
+		ensure("sockets", mSendSocket >= 0 && mReceiveSocket >= 0);
+		LLPacketRing sender;
+		LLPacketRing receiver;
+		sender.setUseBatchedIO(TRUE);
+		receiver.setUseBatchedIO(TRUE);
+
+		const S32 COUNT = 500;
+		ensure_equals("received", roundTrip(sender, receiver, COUNT, 200), COUNT);
+		const LLPacketRing::IOStats& out = sender.getIOStats();
+		ensure_equals("packets out", out.mPacketsOut, (U64)COUNT);
+		ensure_equals("bytes out", out.mBytesOut, (U64)COUNT * 200);
+		ensure_equals("send failures", out.mSendFailures, (U64)0);
+		const LLPacketRing::IOStats& in = receiver.getIOStats();
+		ensure_equals("packets in", in.mPacketsIn, (U64)COUNT);
+		ensure_equals("bytes in", in.mBytesIn, (U64)COUNT * 200);
+#if LL_LINUX
+		ensure("sends not batched", out.mSendCalls * 4 < COUNT);
+		ensure("receives not batched", in.mReceiveCalls < COUNT);
+#endif
+
+		// Switching back drains what was already pulled off the socket
+		receiver.setUseBatchedIO(FALSE);
+		ensure_equals("received unbatched", roundTrip(sender, receiver, 10, 50), 10);
+	}
+
+	template<> template<>
+	void packetring_object::test<2>()
+	{
+		set_test_name("loopback benchmark");
+		ensure("sockets", mSendSocket >= 0 && mReceiveSocket >= 0);
+		const S32 COUNT = 20000;
+		const S32 SIZE = 1000;
+		for (int batched = 0; batched < 2; ++batched)
+		{
+			LLPacketRing sender;
+			LLPacketRing receiver;
+			sender.setUseBatchedIO(batched);
+			receiver.setUseBatchedIO(batched);
+			LLTimer timer;
+			S32 received = roundTrip(sender, receiver, COUNT, SIZE);
+			F32 seconds = timer.getElapsedTimeF32();
+			ensure_equals("received", received, COUNT);
+			if (LLStringUtil::getenv("LL_TEST_BENCHMARKS").empty())
+			{
+				continue;
+			}
+			std::cout << (batched ? "batched:   " : "unbatched: ")
+					  << COUNT / llmax(seconds, 0.001f) << " packets/s, "
+					  << sender.getIOStats().mSendCalls << " send calls, "
+					  << receiver.getIOStats().mReceiveCalls << " receive calls"
+					  << std::endl;
+		}
+	}
+}
@@ -58,58 +58,59 @@ static const struct
 	U32							mMin;
 	U32							mMax;
 	U32							mRate;
+	U32							mWeight;			// Scheduler weight, 0 for none
 	bool						mPipelined;
 	std::string					mKey;
 	const char *				mUsage;
 } init_data[LLAppCoreHttp::AP_COUNT] =
 {
 	{ // AP_DEFAULT
-		8,		8,		8,		0,		false,
+		8,		8,		8,		0,		0,		false,
 		"",
 		"other"
 	},
 	{ // AP_TEXTURE
-		8,		1,		12,		0,		true,
+		8,		1,		12,		0,		2,		true,
 		"TextureFetchConcurrency",
 		"texture fetch"
 	},
 	{ // AP_MESH1
-		32,		1,		128,	0,		false,
+		32,		1,		128,	0,		4,		false,
 		"MeshMaxConcurrentRequests",
 		"mesh fetch"
 	},
 	{ // AP_MESH2
-		8,		1,		32,		0,		true,	
+		8,		1,		32,		0,		4,		true,	
 		"Mesh2MaxConcurrentRequests",
 		"mesh2 fetch"
 	},
 	{ // AP_LARGE_MESH
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		2,		false,
 		"",
 		"large mesh fetch"
 	},
 	{ // AP_UPLOADS 
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		0,		false,
 		"",
 		"asset upload"
 	},
 	{ // AP_LONG_POLL
-		32,		32,		32,		0,		false,
+		32,		32,		32,		0,		0,		false,
 		"",
 		"long poll"
 	},
 	{ // AP_INVENTORY
-		4,		1,		4,		0,		false,
+		4,		1,		4,		0,		0,		false,
 		"",
 		"inventory"
 	},
 	{ // AP_MATERIALS
-		2,		1,		8,		0,		false,
+		2,		1,		8,		0,		0,		false,
 		"RenderMaterials",
 		"material manager requests"
 	},
 	{ // AP_AGENT
-		2,		1,		32,		0,		false,
+		2,		1,		32,		0,		0,		false,
 		"Agent",
 		"Agent requests"
 	}
@@ -131,7 +132,8 @@ LLAppCoreHttp::LLAppCoreHttp()
 	  mStopHandle(LLCORE_HTTP_HANDLE_INVALID),
 	  mStopRequested(0.0),
 	  mStopped(false),
-	  mPipelined(true)
+	  mPipelined(true),
+	  mHttp2Streams(0U)
 {}
 
 
@@ -228,6 +230,22 @@ void LLAppCoreHttp::init()
 															trace_level, NULL);
 	}
 	
+	// Cross-class scheduler, off unless given a byte limit.  Classes
+	// take part according to their weight in the table above.
+	static const std::string http_scheduler_bytes("HttpSchedulerByteLimit");
+	if (gSavedSettings.controlExists(http_scheduler_bytes))
+	{
+		const long byte_limit(long(gSavedSettings.getU32(http_scheduler_bytes)));
+		status = LLCore::HttpRequest::setStaticPolicyOption(LLCore::HttpRequest::PO_SCHEDULER_BYTE_LIMIT,
+															LLCore::HttpRequest::GLOBAL_POLICY_ID,
+															byte_limit, NULL);
+		if (! status)
+		{
+			LL_WARNS("Init") << "Unable to set scheduler byte limit.  Reason:  " << status.toString()
+							 << LL_ENDL;
+		}
+	}
+
 	// Setup default policy and constrain if directed to
 	mHttpClasses[AP_DEFAULT].mPolicy = LLCore::HttpRequest::DEFAULT_POLICY_ID;
 
@@ -257,6 +275,15 @@ void LLAppCoreHttp::init()
 		}
 	}
 
+	// Global HTTP/2 setting, applies to the classes that would pipeline.
+	// Read before the initial settings are applied.
+	static const std::string http_http2_streams("HttpHTTP2Streams");
+	if (gSavedSettings.controlExists(http_http2_streams))
+	{
+		mHttp2Streams = gSavedSettings.getU32(http_http2_streams);
+		LL_INFOS("Init") << "HTTP/2 streams per connection:  " << mHttp2Streams << LL_ENDL;
+	}
+
 	// Need a request object to handle dynamic options before setting them
 	mRequest = new LLCore::HttpRequest;
 
@@ -414,6 +441,21 @@ void LLAppCoreHttp::refreshSettings(bool initial)
 				}
 			}
 
+			if (init_data[i].mWeight)
+			{
+				// Share of the scheduler's bytes
+				status = LLCore::HttpRequest::setStaticPolicyOption(LLCore::HttpRequest::PO_SCHEDULER_WEIGHT,
+																	mHttpClasses[app_policy].mPolicy,
+																	init_data[i].mWeight,
+																	NULL);
+				if (! status)
+				{
+					LL_WARNS("Init") << "Unable to set " << init_data[i].mUsage
+									 << " scheduler weight.  Reason:  " << status.toString()
+									 << LL_ENDL;
+				}
+			}
+
 		}
 
 		// Init- or run-time settings.  Must use the queued request API.
@@ -448,6 +490,24 @@ void LLAppCoreHttp::refreshSettings(bool initial)
 					mHttpClasses[app_policy].mPipelined = to_pipeline;
 				}
 			}
+
+			if (to_pipeline && mHttp2Streams)
+			{
+				// Same classes may multiplex over HTTP/2 where the server
+				// offers it.  Takes precedence over pipelining there.
+				LLCore::HttpHandle handle;
+				handle = mRequest->setPolicyOption(LLCore::HttpRequest::PO_HTTP2_STREAM_LIMIT,
+												   mHttpClasses[app_policy].mPolicy,
+												   long(mHttp2Streams),
+                                                   LLCore::HttpHandler::ptr_t());
+				if (LLCORE_HTTP_HANDLE_INVALID == handle)
+				{
+					status = mRequest->getStatus();
+					LL_WARNS("Init") << "Unable to set " << init_data[i].mUsage
+									 << " HTTP/2 streams.  Reason:  " << status.toString()
+									 << LL_ENDL;
+				}
+			}
 		}
 		
 		// Get target connection concurrency value
@@ -255,6 +255,7 @@ private:
 	bool						mStopped;
 	HttpClass					mHttpClasses[AP_COUNT];
 	bool						mPipelined;				// Global setting
+	U32							mHttp2Streams;			// Global 'HttpHTTP2Streams' setting, 0 for HTTP/1.1
 	boost::signals2::connection	mPipelinedSignal;		// Signal for 'HttpPipelining' setting
 	boost::signals2::connection	mSSLNoVerifySignal;		// Signal for 'NoVerifySSLCert' setting
 
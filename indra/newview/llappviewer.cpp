@@ -1933,6 +1933,7 @@ bool LLAppViewer::cleanup()
 	//#endif // LL_WINDOWS
 
 	LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+	volume_manager->stopGenerationThreads();
 	if (!volume_manager->cleanup())
 	{
 		LL_WARNS() << "Remaining references in the volume manager!" << LL_ENDL;
@@ -2198,6 +2199,11 @@ void LLAppViewer::initGeneralThread()
     // We don't want anyone, especially the main thread, to have to block
     // due to this ThreadPool being full.
     mGeneralThreadPool = new LL::ThreadPool("General", poolSize, 1024 * 1024);
+    S32 first_core = gSavedSettings.getS32("ThreadPoolFirstCore");
+    if (first_core >= 0)
+    {
+        mGeneralThreadPool->setAffinity(U32(first_core));
+    }
     mGeneralThreadPool->start();
 }
 
@@ -2209,8 +2215,10 @@ bool LLAppViewer::initThreads()
 
 	LLLFSThread::initClass(enable_threads && false);
 
-	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	// Image decoding, 0 workers lets the decode thread size its own pool
+	LLSD decode_pool_size{ gSavedSettings.getLLSD("ThreadPoolSizes")["ImageDecode"] };
+	U32 decode_workers = decode_pool_size.isInteger() ? llmax(0, decode_pool_size.asInteger()) : 0;
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, decode_workers);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(),
 													sImageDecodeThread,
@@ -2225,6 +2233,11 @@ bool LLAppViewer::initThreads()
 		mFastTimerLogThread->start();
 	}
 
+	// Volume generation, 0 threads builds volumes on the thread asking for them
+	LLSD volume_pool_size{ gSavedSettings.getLLSD("ThreadPoolSizes")["VolumeGen"] };
+	S32 volume_workers = volume_pool_size.isInteger() ? volume_pool_size.asInteger() : 2;
+	LLPrimitive::getVolumeManager()->startGenerationThreads(enable_threads ? volume_workers : 0);
+
 	// Mesh streaming and caching
 	gMeshRepo.init();
 
@@ -4322,6 +4335,7 @@ bool LLAppViewer::initCache()
     // total cache size - the 'CacheSize' pref - for all caches. 
     const uintmax_t disk_cache_size = uintmax_t(cache_total_size * disk_cache_percent / 100);
 	const bool enable_cache_debug_info = gSavedSettings.getBOOL("EnableDiskCacheDebugInfo");
+	const bool enable_cache_pack_store = gSavedSettings.getBOOL("DiskCachePackSmallAssets");
 
 	bool texture_cache_mismatch = false;
     bool remove_vfs_files = false;
@@ -4375,7 +4389,7 @@ bool LLAppViewer::initCache()
 	}
 
 	const std::string cache_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, cache_dir_name);
-    LLDiskCache::initParamSingleton(cache_dir, disk_cache_size, enable_cache_debug_info);
+    LLDiskCache::initParamSingleton(cache_dir, disk_cache_size, enable_cache_debug_info, enable_cache_pack_store);
 
 	if (!read_only)
 	{
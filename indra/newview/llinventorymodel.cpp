@@ -2898,18 +2898,10 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 
 	is_cache_obsolete = true; // Obsolete until proven current
 
-	std::string line;
-	LLPointer<LLSDParser> parser = new LLSDNotationParser();
-	while (std::getline(file, line)) 
+	// Each cached category and item is a top level value of its own, read
+	// straight off the file and dropped once it is imported
+	LLSDStreamCollector reader(0, [&](const LLSD&, const LLSD& s_item)
 	{
-		LLSD s_item;
-		std::istringstream iss(line);
-		if (parser->parse(iss, s_item, line.length()) == LLSDParser::PARSE_FAILURE)
-		{
-			LL_WARNS(LOG_INV)<< "Parsing inventory cache failed" << LL_ENDL;
-			break;
-		}
-
 		if (s_item.has("inv_cache_version"))
 		{
 			S32 version = s_item["inv_cache_version"].asInteger();
@@ -2917,18 +2909,18 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 			{
 				// Cache is up to date
 				is_cache_obsolete = false;
-				continue;
+				return true;
 			}
 			else
 			{
 				LL_WARNS(LOG_INV)<< "Inventory cache is out of date" << LL_ENDL;
-				break;
+				return false;
 			}
 		}
 		else if (s_item.has("cat_id"))
 		{
 			if (is_cache_obsolete)
-				break;
+				return false;
 
 			LLPointer<LLViewerInventoryCategory> inv_cat = new LLViewerInventoryCategory(LLUUID::null);
 			if(inv_cat->importLLSD(s_item))
@@ -2939,7 +2931,7 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 		else if (s_item.has("item_id"))
 		{
 			if (is_cache_obsolete)
-				break;
+				return false;
 
 			LLPointer<LLViewerInventoryItem> inv_item = new LLViewerInventoryItem;
 			if( inv_item->fromLLSD(s_item) )
@@ -2962,6 +2954,17 @@ bool LLInventoryModel::loadFromFile(const std::string& filename,
 				}
 			}	
 		}
+		return true;
+	});
+
+	LLPointer<LLSDParser> parser = new LLSDNotationParser();
+	S32 parse_count;
+	while ((parse_count = parser->parse(file, reader, LLSDSerialize::SIZE_UNLIMITED)) > 0)
+	{
+	}
+	if (parse_count == LLSDParser::PARSE_FAILURE && !reader.isStopped())
+	{
+		LL_WARNS(LOG_INV)<< "Parsing inventory cache failed" << LL_ENDL;
 	}
 
 	file.close();
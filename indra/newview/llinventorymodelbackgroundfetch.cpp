@@ -41,6 +41,7 @@
 #include "bufferarray.h"
 #include "bufferstream.h"
 #include "llcorehttputil.h"
+#include "llsdarena.h"
 
 // History (may be apocryphal)
 //
@@ -164,7 +165,7 @@ public:
 	bool getIsRecursive(const LLUUID & cat_id) const;
 
 private:
-	void processData(LLSD & body, LLCore::HttpResponse * response);
+	void processData(const LLSDArena::Value & body, LLCore::HttpResponse * response);
 	void processFailure(LLCore::HttpStatus status, LLCore::HttpResponse * response);
 	void processFailure(const char * const reason, LLCore::HttpResponse * response);
 
@@ -614,10 +615,12 @@ void BGFolderHttpHandler::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRes
 
 		// Could test 'Content-Type' header but probably unreliable.
 
-		// Convert response to LLSD
+		// Convert response to an arena document.  Folder fetches can run
+		// to many thousands of items and are only read, so this avoids
+		// building and tearing down an LLSD tree of the whole response.
 		// body->write(0, "Garbage Response", 16);		// Dev tool to force error handling
-		LLSD body_llsd;
-		if (! LLCoreHttpUtil::responseToLLSD(response, true, body_llsd))
+		LLPointer<LLSDArena> body_doc;
+		if (! LLCoreHttpUtil::responseToLLSD(response, true, body_doc))
 		{
 			// INFOS-level logging will occur on the parsed failure
 			processFailure("HTTP response contained malformed LLSD", response);
@@ -625,8 +628,8 @@ void BGFolderHttpHandler::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRes
 		}
 
 		// Expect top-level structure to be a map
-		// body_llsd = LLSD::emptyArray();				// Dev tool to force error handling
-		if (! body_llsd.isMap())
+		const LLSDArena::Value & body_sd(body_doc->root());
+		if (! body_sd.isMap())
 		{
 			processFailure("LLSD response not a map", response);
 			break;			// goto common exit
@@ -636,23 +639,20 @@ void BGFolderHttpHandler::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRes
 		//
 		// See comments in llinventorymodel.cpp about this mode of error.
 		//
-		// body_llsd["error"] = LLSD::emptyMap();		// Dev tool to force error handling
-		// body_llsd["error"]["identifier"] = "Development";
-		// body_llsd["error"]["message"] = "You left development code in the viewer";
-		if (body_llsd.has("error"))
+		if (body_sd.has("error"))
 		{
 			processFailure("Inventory application error (200-with-error)", response);
 			break;			// goto common exit
 		}
 
 		// Okay, process data if possible
-		processData(body_llsd, response);
+		processData(body_sd, response);
 	}
 	while (false);
 }
 
 
-void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * response)
+void BGFolderHttpHandler::processData(const LLSDArena::Value & content, LLCore::HttpResponse * response)
 {
 	LLInventoryModelBackgroundFetch * fetcher(LLInventoryModelBackgroundFetch::getInstance());
 
@@ -662,13 +662,13 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 	// Instead, we assume success and attempt to extract information.
 	if (content.has("folders"))	
 	{
-		LLSD folders(content["folders"]);
+		const LLSDArena::Value & folders(content["folders"]);
 		
-		for (LLSD::array_const_iterator folder_it = folders.beginArray();
+		for (LLSDArena::Value::array_const_iterator folder_it = folders.beginArray();
 			folder_it != folders.endArray();
 			++folder_it)
 		{	
-			LLSD folder_sd(*folder_it);
+			const LLSDArena::Value & folder_sd(*folder_it);
 
 			//LLUUID agent_id = folder_sd["agent_id"];
 
@@ -687,10 +687,10 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 
             if (parent_id.isNull())
             {
-				LLSD items(folder_sd["items"]);
+				const LLSDArena::Value & items(folder_sd["items"]);
 			    LLPointer<LLViewerInventoryItem> titem = new LLViewerInventoryItem;
 				
-			    for (LLSD::array_const_iterator item_it = items.beginArray();
+			    for (LLSDArena::Value::array_const_iterator item_it = items.beginArray();
 				    item_it != items.endArray();
 				    ++item_it)
 			    {	
@@ -698,9 +698,7 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 
                     if (lost_uuid.notNull())
                     {
-				        LLSD item(*item_it);
-
-				        titem->unpackMessage(item);
+				        titem->unpackMessage(item_it->toLLSD());
 				
                         LLInventoryModel::update_list_t update;
                         LLInventoryModel::LLCategoryUpdate new_folder(lost_uuid, 1);
@@ -720,13 +718,12 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 				continue;
 			}
 
-			LLSD categories(folder_sd["categories"]);
-			for (LLSD::array_const_iterator category_it = categories.beginArray();
+			const LLSDArena::Value & categories(folder_sd["categories"]);
+			for (LLSDArena::Value::array_const_iterator category_it = categories.beginArray();
 				category_it != categories.endArray();
 				++category_it)
 			{	
-				LLSD category(*category_it);
-				tcategory->fromLLSD(category); 
+				tcategory->fromLLSD(category_it->toLLSD()); 
 				
 				const bool recursive(getIsRecursive(tcategory->getUUID()));
 				if (recursive)
@@ -739,14 +736,14 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 				}
 			}
 
-			LLSD items(folder_sd["items"]);
+			const LLSDArena::Value & items(folder_sd["items"]);
 			LLPointer<LLViewerInventoryItem> titem = new LLViewerInventoryItem;
-			for (LLSD::array_const_iterator item_it = items.beginArray();
+			for (LLSDArena::Value::array_const_iterator item_it = items.beginArray();
 				 item_it != items.endArray();
 				 ++item_it)
 			{	
-				LLSD item(*item_it);
-				titem->unpackMessage(item);
+				// Items are small, only one at a time is copied out
+				titem->unpackMessage(item_it->toLLSD());
 				
 				gInventory.updateItem(titem);
 			}
@@ -764,13 +761,12 @@ void BGFolderHttpHandler::processData(LLSD & content, LLCore::HttpResponse * res
 		
 	if (content.has("bad_folders"))
 	{
-		LLSD bad_folders(content["bad_folders"]);
-		for (LLSD::array_const_iterator folder_it = bad_folders.beginArray();
+		const LLSDArena::Value & bad_folders(content["bad_folders"]);
+		for (LLSDArena::Value::array_const_iterator folder_it = bad_folders.beginArray();
 			 folder_it != bad_folders.endArray();
 			 ++folder_it)
 		{
-			// *TODO: Stop copying data [ed:  this isn't copying data]
-			LLSD folder_sd(*folder_it);
+			const LLSDArena::Value & folder_sd(*folder_it);
 			
 			// These folders failed on the dataserver.  We probably don't want to retry them.
 			LL_WARNS(LOG_INV) << "Folder " << folder_sd["folder_id"].asString() 
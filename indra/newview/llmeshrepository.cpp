@@ -50,6 +50,7 @@
 #include "llsdserialize.h"
 #include "llthread.h"
 #include "llfilesystem.h"
+#include "threadpool.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
 #include "llviewermenufile.h"
@@ -109,6 +110,8 @@
 //   main     Main rendering thread, very sensitive to locking and other stalls
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
 //   decom    Worker thread for mesh decomposition requests
+//   decode   0-N "MeshDecode" pool threads unpacking received mesh data
+//            (with none, decode work runs on repo)
 //   core     HTTP worker thread:  does the work but doesn't intrude here
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
 //
@@ -147,10 +150,14 @@
 //                               issue Byte-Range GET for LOD
 //                             ...
 //                             onCompleted() invoked for GET
-//                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               body referenced
+//                               decode() posts to decode pool
+//                             ...
+//                                                  decode thread
+//                                                  lodReceived() invoked
+//                                                    unpack data into LLVolume
+//                                                    append LoadedMesh to mLoadedQ
+//                                                  LOD written to cache
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -221,9 +228,9 @@
 //     sLODPending                     mMeshMutex [4]  rw.main.mMeshMutex
 //     sLODProcessing                  Repo::mMutex    rw.any.Repo::mMutex
 //     sCacheBytesRead                 none            rw.repo.none, ro.main.none [1]
-//     sCacheBytesWritten              "
-//     sCacheReads                     "
-//     sCacheWrites                    "
+//     sCacheBytesWritten              atomic          rw.repo.none, rw.decode.none, ro.main.none
+//     sCacheReads                     none            rw.repo.none, ro.main.none [1]
+//     sCacheWrites                    atomic          rw.repo.none, rw.decode.none, ro.main.none
 //     mLoadingMeshes                  mMeshMutex [4]  rw.main.none, rw.any.mMeshMutex
 //     mSkinMap                        none            rw.main.none
 //     mDecompositionMap               none            rw.main.none
@@ -248,19 +255,21 @@
 //     mMeshHeader              mHeaderMutex  rw.repo.mHeaderMutex, ro.main.mHeaderMutex, ro.main.none [0]
 //     mMeshHeaderSize          mHeaderMutex  rw.repo.mHeaderMutex
 //     mSkinRequests            mMutex        rw.repo.mMutex, ro.repo.none [5]
-//     mSkinInfoQ               mMutex        rw.repo.mMutex, rw.main.mMutex [5] (was:  [0])
+//     mSkinInfoQ               mMutex        rw.decode.mMutex, rw.main.mMutex [5] (was:  [0])
 //     mDecompositionRequests   mMutex        rw.repo.mMutex, ro.repo.none [5]
 //     mPhysicsShapeRequests    mMutex        rw.repo.mMutex, ro.repo.none [5]
-//     mDecompositionQ          mMutex        rw.repo.mMutex, rw.main.mMutex [5] (was:  [0])
+//     mDecompositionQ          mMutex        rw.decode.mMutex, rw.main.mMutex [5] (was:  [0])
 //     mHeaderReqQ              mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
 //     mLODReqQ                 mMutex        ro.repo.none [5], rw.repo.mMutex, rw.any.mMutex
-//     mUnavailableQ            mMutex        rw.repo.none [0], ro.main.none [5], rw.main.mMutex
-//     mLoadedQ                 mMutex        rw.repo.mMutex, ro.main.none [5], rw.main.mMutex
+//     mUnavailableQ            mMutex        rw.repo.mMutex, rw.decode.mMutex, ro.main.none [5], rw.main.mMutex
+//     mLoadedQ                 mMutex        rw.decode.mMutex, ro.main.none [5], rw.main.mMutex
 //     mPendingLOD              mMutex        rw.repo.mMutex, rw.any.mMutex
 //     mGetMeshCapability       mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMesh2Capability      mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMeshVersion          mMutex        rw.main.mMutex, ro.repo.mMutex
 //     mHttp*                   none          rw.repo.none
+//     mDecodePool              none          wo.main.none, ro.repo.none
+//     (mesh cache writes)      mCacheMutex   rw.repo.mCacheMutex, rw.decode.mCacheMutex
 //
 //   LLMeshUploadThread:
 //
@@ -382,12 +391,12 @@ U32 LLMeshRepository::sLODProcessing = 0;
 U32 LLMeshRepository::sLODPending = 0;
 
 U32 LLMeshRepository::sCacheBytesRead = 0;
-U32 LLMeshRepository::sCacheBytesWritten = 0;
+LLAtomicU32 LLMeshRepository::sCacheBytesWritten(0);
 U32 LLMeshRepository::sCacheBytesHeaders = 0;
 U32 LLMeshRepository::sCacheBytesSkins = 0;
 U32 LLMeshRepository::sCacheBytesDecomps = 0;
 U32 LLMeshRepository::sCacheReads = 0;
-U32 LLMeshRepository::sCacheWrites = 0;
+LLAtomicU32 LLMeshRepository::sCacheWrites(0);
 U32 LLMeshRepository::sMaxLockHoldoffs = 0;
 	
 LLDeadmanTimer LLMeshRepository::sQuiescentTimer(15.0, false);	// true -> gather cpu metrics
@@ -833,6 +842,7 @@ LLMeshRepoThread::LLMeshRepoThread()
 
 	mMutex = new LLMutex();
 	mHeaderMutex = new LLMutex();
+	mCacheMutex = new LLMutex();
 	mSignal = new LLCondition();
 	mHttpRequest = new LLCore::HttpRequest;
 	mHttpOptions = LLCore::HttpOptions::ptr_t(new LLCore::HttpOptions);
@@ -845,6 +855,16 @@ LLMeshRepoThread::LLMeshRepoThread()
 	mHttpHeaders->append(HTTP_OUT_HEADER_ACCEPT, HTTP_CONTENT_VND_LL_MESH);
 	mHttpPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH2);
 	mHttpLargePolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_LARGE_MESH);
+
+	// Decoding, 0 threads decodes on the repo thread
+	LLSD decode_pool_size{ gSavedSettings.getLLSD("ThreadPoolSizes")["MeshDecode"] };
+	S32 decode_threads = decode_pool_size.isInteger() ? decode_pool_size.asInteger() : 2;
+	if (decode_threads > 0)
+	{
+		LL_INFOS(LOG_MESH) << "Decoding meshes on " << decode_threads << " threads" << LL_ENDL;
+		mDecodePool.reset(new LL::ThreadPool("MeshDecode", decode_threads));
+		mDecodePool->start();
+	}
 }
 
 
@@ -855,6 +875,13 @@ LLMeshRepoThread::~LLMeshRepoThread()
 					   << ", Max Lock Holdoffs:  " << LLMeshRepository::sMaxLockHoldoffs
 					   << LL_ENDL;
 
+	// Queued decodes still run, they need the queues below
+	if (mDecodePool)
+	{
+		mDecodePool->close();
+		mDecodePool.reset();
+	}
+
 	mHttpRequestSet.clear();
     mHttpHeaders.reset();
 
@@ -870,6 +897,8 @@ LLMeshRepoThread::~LLMeshRepoThread()
 	mMutex = NULL;
 	delete mHeaderMutex;
 	mHeaderMutex = NULL;
+	delete mCacheMutex;
+	mCacheMutex = NULL;
 	delete mSignal;
 	mSignal = NULL;
 }
@@ -936,7 +965,7 @@ void LLMeshRepoThread::run()
                     // failed to load before, wait a bit
                     incomplete.push_front(req);
                 }
-                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry()))
+                else if (!fetchMeshLOD(req.mMeshParams, req.mLOD, req.canRetry(), !req.mSkipCache))
                 {
                     if (req.canRetry())
                     {
@@ -947,6 +976,7 @@ void LLMeshRepoThread::run()
                     else
                     {
                         // too many fails
+                        LLMutexLock locker(mMutex);
                         mUnavailableQ.push(req);
                         LL_WARNS() << "Failed to load " << req.mMeshParams << " , skip" << LL_ENDL;
                     }
@@ -1035,7 +1065,7 @@ void LLMeshRepoThread::run()
                     {
                         incomplete.insert(req);
                     }
-                    else if (!fetchMeshSkinInfo(req.mId))
+                    else if (!fetchMeshSkinInfo(req.mId, !req.mSkipCache))
                     {
                         if (req.canRetry())
                         {
@@ -1074,7 +1104,7 @@ void LLMeshRepoThread::run()
                     {
                         incomplete.insert(req);
                     }
-                    else if (!fetchMeshDecomposition(req.mId))
+                    else if (!fetchMeshDecomposition(req.mId, !req.mSkipCache))
                     {
                         if (req.canRetry())
                         {
@@ -1110,7 +1140,7 @@ void LLMeshRepoThread::run()
                     {
                         incomplete.insert(req);
                     }
-                    else if (!fetchMeshPhysicsShape(req.mId))
+                    else if (!fetchMeshPhysicsShape(req.mId, !req.mSkipCache))
                     {
                         if (req.canRetry())
                         {
@@ -1149,6 +1179,75 @@ void LLMeshRepoThread::run()
 	}
 }
 
+// Keep mesh data valid for a decode on another thread.  Data that
+// lies in a response body takes another reference to the body.
+// Anything else - a temporary onCompleted() frees on return or a
+// mapped cache file that may be truncated or replaced before the
+// decode runs - is copied and data pointed at the copy.
+static std::shared_ptr<const void> hold_mesh_data(LLCore::BufferArray * body, S32 body_offset,
+												  const U8 *& data, S32 data_size)
+{
+	if (! data || data_size <= 0)
+	{
+		return std::shared_ptr<const void>();
+	}
+	if (body && (const U8 *) body->getContiguous(body_offset, data_size) == data)
+	{
+		body->addRef();
+		return std::shared_ptr<const void>(body, [](LLCore::BufferArray * held) { held->release(); });
+	}
+	std::shared_ptr<std::vector<U8> > copy(std::make_shared<std::vector<U8> >(data, data + data_size));
+	data = copy->data();
+	return copy;
+}
+
+void LLMeshRepoThread::decode(const std::function<void()>& work)
+{
+	if (! mDecodePool || ! mDecodePool->post(work))
+	{
+		work();
+	}
+}
+
+void LLMeshRepoThread::decodeMeshData(const LLUUID& mesh_id, S32 cache_offset, S32 cache_size,
+									  const U8* data, S32 data_size, const std::shared_ptr<const void>& owner,
+									  const std::function<bool(const U8*, S32)>& decode_fn,
+									  const std::function<void()>& on_failure)
+{
+	LLMutex * cache_mutex(mCacheMutex);
+	decode([mesh_id, cache_offset, cache_size, data, data_size, owner, decode_fn, on_failure, cache_mutex]()
+		{
+			if (! decode_fn(data, data_size))
+			{
+				on_failure();
+			}
+			else if (cache_offset >= 0)
+			{
+				// good fetch from sim, write to cache
+				LLMutexLock lock(cache_mutex);
+				// <FS:Ansariel> Fix asset caching
+				//LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
+				LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
+
+				if (file.getSize() >= cache_offset+cache_size)
+				{
+					LLMeshRepository::sCacheBytesWritten += cache_size;
+					++LLMeshRepository::sCacheWrites;
+					file.seek(cache_offset);
+					file.write(data, cache_size);
+				}
+			}
+		});
+}
+
+void LLMeshRepoThread::requeueUncached(std::set<UUIDBasedRequest>& requests, const LLUUID& mesh_id)
+{
+	UUIDBasedRequest req(mesh_id);
+	req.mSkipCache = true;
+	LLMutexLock lock(mMutex);
+	requests.insert(req);
+}
+
 // Mutex:  LLMeshRepoThread::mMutex must be held on entry
 void LLMeshRepoThread::loadMeshSkinInfo(const LLUUID& mesh_id)
 {
@@ -1307,7 +1406,7 @@ LLCore::HttpHandle LLMeshRepoThread::getByteRange(const std::string & url,
 }
 
 
-bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool use_cache)
 {
 	
 	if (!mHeaderMutex)
@@ -1339,18 +1438,16 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 		{
 			//check cache for mesh skin info
 			LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			LLFileSystemView::ptr_t view;
+			if (use_cache)
 			{
-				U8* buffer = new(std::nothrow) U8[size];
-				if (!buffer)
-				{
-					LL_WARNS_ONCE(LOG_MESH) << "Failed to allocate memory for skin info, size: " << size << LL_ENDL;
-					return false;
-				}
+				view = file.mapView();
+			}
+			if (view.notNull() && view->getSize() >= offset+size)
+			{
+				const U8* buffer = view->getData() + offset;
 				LLMeshRepository::sCacheBytesRead += size;
 				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				file.read(buffer, size);
 
 				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
 				bool zero = true;
@@ -1360,15 +1457,13 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{						
-						delete[] buffer;
-						return true;
-					}
+				{ //attempt to parse, going to the sim if that fails
+					std::shared_ptr<const void> owner(hold_mesh_data(NULL, 0, buffer, size));
+					decodeMeshData(mesh_id, -1, 0, buffer, size, owner,
+						[this, mesh_id](const U8* data, S32 data_size) { return skinInfoReceived(mesh_id, data, data_size); },
+						[this, mesh_id]() { requeueUncached(mSkinRequests, mesh_id); });
+					return true;
 				}
-
-				delete[] buffer;
 			}
 
 			//reading from cache failed for whatever reason, fetch from sim
@@ -1404,7 +1499,7 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 	return ret;
 }
 
-bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id, bool use_cache)
 {
 	if (!mHeaderMutex)
 	{
@@ -1435,20 +1530,17 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 		{
 			//check cache for mesh skin info
 			LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			LLFileSystemView::ptr_t view;
+			if (use_cache)
 			{
-				U8* buffer = new(std::nothrow) U8[size];
-				if (!buffer)
-				{
-					LL_WARNS_ONCE(LOG_MESH) << "Failed to allocate memory for mesh decomposition, size: " << size << LL_ENDL;
-					return false;
-				}
+				view = file.mapView();
+			}
+			if (view.notNull() && view->getSize() >= offset+size)
+			{
+				const U8* buffer = view->getData() + offset;
 				LLMeshRepository::sCacheBytesRead += size;
 				++LLMeshRepository::sCacheReads;
 
-				file.seek(offset);
-				file.read(buffer, size);
-
 				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
 				bool zero = true;
 				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
@@ -1457,15 +1549,13 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (decompositionReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //attempt to parse, going to the sim if that fails
+					std::shared_ptr<const void> owner(hold_mesh_data(NULL, 0, buffer, size));
+					decodeMeshData(mesh_id, -1, 0, buffer, size, owner,
+						[this, mesh_id](const U8* data, S32 data_size) { return decompositionReceived(mesh_id, data, data_size); },
+						[this, mesh_id]() { requeueUncached(mDecompositionRequests, mesh_id); });
+					return true;
 				}
-
-				delete[] buffer;
 			}
 
 			//reading from cache failed for whatever reason, fetch from sim
@@ -1501,7 +1591,7 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 	return ret;
 }
 
-bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id, bool use_cache)
 {
 	if (!mHeaderMutex)
 	{
@@ -1532,18 +1622,16 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 		{
 			//check cache for mesh physics shape info
 			LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			LLFileSystemView::ptr_t view;
+			if (use_cache)
 			{
+				view = file.mapView();
+			}
+			if (view.notNull() && view->getSize() >= offset+size)
+			{
+				const U8* buffer = view->getData() + offset;
 				LLMeshRepository::sCacheBytesRead += size;
 				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				U8* buffer = new(std::nothrow) U8[size];
-				if (!buffer)
-				{
-					LL_WARNS_ONCE(LOG_MESH) << "Failed to allocate memory for physics shape, size: " << size << LL_ENDL;
-					return false;
-				}
-				file.read(buffer, size);
 
 				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
 				bool zero = true;
@@ -1553,15 +1641,13 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (physicsShapeReceived(mesh_id, buffer, size) == MESH_OK)
-					{
-						delete[] buffer;
-						return true;
-					}
+				{ //attempt to parse, going to the sim if that fails
+					std::shared_ptr<const void> owner(hold_mesh_data(NULL, 0, buffer, size));
+					decodeMeshData(mesh_id, -1, 0, buffer, size, owner,
+						[this, mesh_id](const U8* data, S32 data_size) { return physicsShapeReceived(mesh_id, data, data_size) == MESH_OK; },
+						[this, mesh_id]() { requeueUncached(mPhysicsShapeRequests, mesh_id); });
+					return true;
 				}
-
-				delete[] buffer;
 			}
 
 			//reading from cache failed for whatever reason, fetch from sim
@@ -1697,7 +1783,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params, bool c
 }
 
 //return false if failed to get mesh lod.
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry, bool use_cache)
 {
 	if (!mHeaderMutex)
 	{
@@ -1725,20 +1811,17 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 
 			//check cache for mesh asset
 			LLFileSystem file(mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			LLFileSystemView::ptr_t view;
+			if (use_cache)
 			{
-				U8* buffer = new(std::nothrow) U8[size];
-				if (!buffer)
-				{
-					LL_WARNS_ONCE(LOG_MESH) << "Can't allocate memory for mesh " << mesh_id << " LOD " << lod << ", size: " << size << LL_ENDL;
-					// todo: for now it will result in indefinite constant retries, should result in timeout
-					// or in retry-count and disabling mesh. (but usually viewer is beyond saving at this point)
-					return false;
-				}
+				view = file.mapView();
+			}
+			if (view.notNull() && view->getSize() >= offset+size)
+			{
+				// check straight out of the mapped cache file, the decode gets a copy
+				const U8* buffer = view->getData() + offset;
 				LLMeshRepository::sCacheBytesRead += size;
 				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				file.read(buffer, size);
 
 				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
 				bool zero = true;
@@ -1748,20 +1831,28 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 				}
 
 				if (!zero)
-				{ //attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size) == MESH_OK)
-					{
-						delete[] buffer;
-
-						std::string mid;
-						mesh_id.toString(mid);
-						LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mid << " - was retrieved from the cache." << LL_ENDL;
-
-						return true;
-					}
+				{ //attempt to parse, going to the sim if that fails
+					std::shared_ptr<const void> owner(hold_mesh_data(NULL, 0, buffer, size));
+					decodeMeshData(mesh_id, -1, 0, buffer, size, owner,
+						[this, mesh_params, lod](const U8* data, S32 data_size)
+						{
+							if (lodReceived(mesh_params, lod, data, data_size) != MESH_OK)
+							{
+								return false;
+							}
+							LL_DEBUGS(LOG_MESH) << "Mesh/Cache: Mesh body for ID " << mesh_params.getSculptID() << " - was retrieved from the cache." << LL_ENDL;
+							return true;
+						},
+						[this, mesh_params, lod]()
+						{
+							LODRequest req(mesh_params, lod);
+							req.mSkipCache = true;
+							LLMutexLock lock(mMutex);
+							mLODReqQ.push(req);
+							++LLMeshRepository::sLODProcessing;
+						});
+					return true;
 				}
-
-				delete[] buffer;
 			}
 
 			//reading from cache failed for whatever reason, fetch from sim
@@ -1792,16 +1883,19 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 				}
 				else
 				{
+					LLMutexLock lock(mMutex);
 					mUnavailableQ.push(LODRequest(mesh_params, lod));
 				}
 			}
 			else
 			{
+				LLMutexLock lock(mMutex);
 				mUnavailableQ.push(LODRequest(mesh_params, lod));
 			}
 		}
 		else
 		{
+			LLMutexLock lock(mMutex);
 			mUnavailableQ.push(LODRequest(mesh_params, lod));
 		}
 	}
@@ -1903,7 +1997,7 @@ EMeshProcessingResult LLMeshRepoThread::headerReceived(const LLVolumeParams& mes
 	return MESH_OK;
 }
 
-EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
+EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, const U8* data, S32 data_size)
 {
 	if (data == NULL || data_size == 0)
 	{
@@ -1911,19 +2005,9 @@ EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_p
 	}
 
 	LLPointer<LLVolume> volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
-	std::istringstream stream;
-	try
-	{
-		std::string mesh_string((char*)data, data_size);
-		stream.str(mesh_string);
-	}
-	catch (std::bad_alloc&)
-	{
-		// out of memory, we won't be able to process this mesh
-		return MESH_OUT_OF_MEMORY;
-	}
 
-	if (volume->unpackVolumeFaces(stream, data_size))
+	// decompress straight out of data, no further copy
+	if (volume->unpackVolumeFaces(data, data_size))
 	{
 		if (volume->getNumFaces() > 0)
 		{
@@ -1945,7 +2029,7 @@ EMeshProcessingResult LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_p
 	return MESH_UNKNOWN;
 }
 
-bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size)
+bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, const U8* data, S32 data_size)
 {
 	LLSD skin;
 
@@ -1953,10 +2037,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 	{
         try
         {
-            std::string res_str((char*)data, data_size);
-            std::istringstream stream(res_str);
-
-            U32 uzip_result = LLUZipHelper::unzip_llsd(skin, stream, data_size);
+            U32 uzip_result = LLUZipHelper::unzip_llsd(skin, data, data_size);
             if (uzip_result != LLUZipHelper::ZR_OK)
             {
                 LL_WARNS(LOG_MESH) << "Mesh skin info parse error.  Not a valid mesh asset!  ID:  " << mesh_id
@@ -1986,7 +2067,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 	return true;
 }
 
-bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size)
+bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, const U8* data, S32 data_size)
 {
 	LLSD decomp;
 
@@ -1994,10 +2075,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
     {
         try
         {
-            std::string res_str((char*)data, data_size);
-            std::istringstream stream(res_str);
-
-            U32 uzip_result = LLUZipHelper::unzip_llsd(decomp, stream, data_size);
+            U32 uzip_result = LLUZipHelper::unzip_llsd(decomp, data, data_size);
             if (uzip_result != LLUZipHelper::ZR_OK)
             {
                 LL_WARNS(LOG_MESH) << "Mesh decomposition parse error.  Not a valid mesh asset!  ID:  " << mesh_id
@@ -2025,7 +2103,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
 	return true;
 }
 
-EMeshProcessingResult LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size)
+EMeshProcessingResult LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, const U8* data, S32 data_size)
 {
 	LLSD physics_shape;
 
@@ -2043,20 +2121,7 @@ EMeshProcessingResult LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_
 		volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
 		LLPointer<LLVolume> volume = new LLVolume(volume_params,0);
 
-        std::istringstream stream;
-        try
-        {
-            std::string mesh_string((char*)data, data_size);
-            stream.str(mesh_string);
-        }
-        catch (std::bad_alloc&)
-        {
-            // out of memory, we won't be able to process this mesh
-            delete d;
-            return MESH_OUT_OF_MEMORY;
-        }
-
-		if (volume->unpackVolumeFaces(stream, data_size))
+		if (volume->unpackVolumeFaces(data, data_size))
 		{
 			d->mPhysicsShapeMesh.clear();
 
@@ -3054,6 +3119,7 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 		LLCore::BufferArray * body(response->getBody());
 		S32 body_offset(0);
 		U8 * data(NULL);
+		bool data_copied(false);
 		S32 data_size(body ? body->size() : 0);
 
 		if (data_size > 0)
@@ -3106,15 +3172,22 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 				goto common_exit;
 			}
 			
-			// *TODO: Try to get rid of data copying and add interfaces
-			// that support BufferArray directly.  Introduce a two-phase
-			// handler, optional first that takes a body, fallback second
-			// that requires a temporary allocation and data copy.
+			// Bodies sized from Content-Length arrive in one block and
+			// the handlers only read the data, so hand it over in place.
+			// Anything else is copied out into a temporary.
 			body_offset = mOffset - offset;
-			data = new(std::nothrow) U8[data_size - body_offset];
+			data = (U8 *) body->getContiguous(body_offset, data_size - body_offset);
+			if (! data)
+			{
+				data = new(std::nothrow) U8[data_size - body_offset];
+				if (data)
+				{
+					body->read(body_offset, (char *) data, data_size - body_offset);
+					data_copied = true;
+				}
+			}
 			if (data)
 			{
-				body->read(body_offset, (char *) data, data_size - body_offset);
 				LLMeshRepository::sBytesReceived += data_size;
 			}
 			else
@@ -3126,7 +3199,10 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 
 		processData(body, body_offset, data, data_size - body_offset);
 
-		delete [] data;
+		if (data_copied)
+		{
+			delete [] data;
+		}
 	}
 
 	// Release handler
@@ -3238,6 +3314,7 @@ void LLMeshHeaderHandler::processData(LLCore::BufferArray * /* body */, S32 /* b
 			// only allocate as much space in the cache as is needed for the local cache
 			data_size = llmin(data_size, bytes);
 
+			LLMutexLock lock(gMeshRepo.mThread->mCacheMutex);
 			// <FS:Ansariel> Fix asset caching
 			//LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::WRITE);
 			LLFileSystem file(mesh_id, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
@@ -3303,52 +3380,38 @@ void LLMeshLODHandler::processFailure(LLCore::HttpStatus status)
 	gMeshRepo.mThread->mUnavailableQ.push(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
 }
 
-void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
+void LLMeshLODHandler::processData(LLCore::BufferArray * body, S32 body_offset,
 								   U8 * data, S32 data_size)
 {
-	if ((!MESH_LOD_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
-	{
-		EMeshProcessingResult result = gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size);
-		if (result == MESH_OK)
-		{
-			// good fetch from sim, write to cache
-			// <FS:Ansariel> Fix asset caching
-			//LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::WRITE);
-			LLFileSystem file(mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-			S32 offset = mOffset;
-			S32 size = mRequestedBytes;
-
-			if (file.getSize() >= offset+size)
-			{
-				file.seek(offset);
-				file.write(data, size);
-				LLMeshRepository::sCacheBytesWritten += size;
-				++LLMeshRepository::sCacheWrites;
-			}
-		}
-		else
+	const LLVolumeParams mesh_params(mMeshParams);
+	const S32 lod(mLOD);
+	auto on_failure = [mesh_params, lod, data_size]()
 		{
-			LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-							   << ", Reason: " << result
-							   << " LOD: " << mLOD
+			LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mesh_params.getSculptID()
+							   << ", Unknown reason.  Not retrying."
+							   << " LOD: " << lod
 							   << " Data size: " << data_size
-							   << " Not retrying."
 							   << LL_ENDL;
 			LLMutexLock lock(gMeshRepo.mThread->mMutex);
-			gMeshRepo.mThread->mUnavailableQ.push(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
-		}
+			gMeshRepo.mThread->mUnavailableQ.push(LLMeshRepoThread::LODRequest(mesh_params, lod));
+		};
+
+	if ((!MESH_LOD_PROCESS_FAILED)
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
+	{
+		// Unpack and cache on the decode pool, this handler is gone by then
+		const U8 * held(data);
+		std::shared_ptr<const void> owner(hold_mesh_data(body, body_offset, held, data_size));
+		gMeshRepo.mThread->decodeMeshData(mesh_params.getSculptID(), mOffset, mRequestedBytes, held, data_size, owner,
+			[mesh_params, lod](const U8* buffer, S32 buffer_size)
+			{
+				return gMeshRepo.mThread->lodReceived(mesh_params, lod, buffer, buffer_size) == MESH_OK;
+			},
+			on_failure);
 	}
 	else
 	{
-		LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << mMeshParams.getSculptID()
-						   << ", Unknown reason.  Not retrying."
-						   << " LOD: " << mLOD
-						   << " Data size: " << data_size
-						   << LL_ENDL;
-		LLMutexLock lock(gMeshRepo.mThread->mMutex);
-		gMeshRepo.mThread->mUnavailableQ.push(LLMeshRepoThread::LODRequest(mMeshParams, mLOD));
+		on_failure();
 	}
 }
 
@@ -3371,35 +3434,34 @@ void LLMeshSkinInfoHandler::processFailure(LLCore::HttpStatus status)
 	// request unfulfilled rather than retry forever.
 }
 
-void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
+void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * body, S32 body_offset,
 										U8 * data, S32 data_size)
 {
+	const LLUUID mesh_id(mMeshID);
+	auto on_failure = [mesh_id]()
+		{
+			LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mesh_id
+							   << ", Unknown reason.  Not retrying."
+							   << LL_ENDL;
+			// *TODO:  Mark mesh unavailable on error
+		};
+
 	if ((!MESH_SKIN_INFO_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-		&& gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		// good fetch from sim, write to cache
-		// <FS:Ansariel> Fix asset caching
-		//LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-		LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// Parse and cache on the decode pool, this handler is gone by then
+		const U8 * held(data);
+		std::shared_ptr<const void> owner(hold_mesh_data(body, body_offset, held, data_size));
+		gMeshRepo.mThread->decodeMeshData(mesh_id, mOffset, mRequestedBytes, held, data_size, owner,
+			[mesh_id](const U8* buffer, S32 buffer_size)
+			{
+				return gMeshRepo.mThread->skinInfoReceived(mesh_id, buffer, buffer_size);
+			},
+			on_failure);
 	}
 	else
 	{
-		LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << mMeshID
-						   << ", Unknown reason.  Not retrying."
-						   << LL_ENDL;
-		// *TODO:  Mark mesh unavailable on error
+		on_failure();
 	}
 }
 
@@ -3421,35 +3483,34 @@ void LLMeshDecompositionHandler::processFailure(LLCore::HttpStatus status)
 	// request unfulfilled rather than retry forever.
 }
 
-void LLMeshDecompositionHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
+void LLMeshDecompositionHandler::processData(LLCore::BufferArray * body, S32 body_offset,
 											 U8 * data, S32 data_size)
 {
+	const LLUUID mesh_id(mMeshID);
+	auto on_failure = [mesh_id]()
+		{
+			LL_WARNS(LOG_MESH) << "Error during mesh decomposition processing.  ID:  " << mesh_id
+							   << ", Unknown reason.  Not retrying."
+							   << LL_ENDL;
+			// *TODO:  Mark mesh unavailable on error
+		};
+
 	if ((!MESH_DECOMP_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-		&& gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size))
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		// good fetch from sim, write to cache
-		// <FS:Ansariel> Fix asset caching
-		//LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-		LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// Parse and cache on the decode pool, this handler is gone by then
+		const U8 * held(data);
+		std::shared_ptr<const void> owner(hold_mesh_data(body, body_offset, held, data_size));
+		gMeshRepo.mThread->decodeMeshData(mesh_id, mOffset, mRequestedBytes, held, data_size, owner,
+			[mesh_id](const U8* buffer, S32 buffer_size)
+			{
+				return gMeshRepo.mThread->decompositionReceived(mesh_id, buffer, buffer_size);
+			},
+			on_failure);
 	}
 	else
 	{
-		LL_WARNS(LOG_MESH) << "Error during mesh decomposition processing.  ID:  " << mMeshID
-						   << ", Unknown reason.  Not retrying."
-						   << LL_ENDL;
-		// *TODO:  Mark mesh unavailable on error
+		on_failure();
 	}
 }
 
@@ -3470,35 +3531,34 @@ void LLMeshPhysicsShapeHandler::processFailure(LLCore::HttpStatus status)
 	// *TODO:  Mark mesh unavailable on error
 }
 
-void LLMeshPhysicsShapeHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
+void LLMeshPhysicsShapeHandler::processData(LLCore::BufferArray * body, S32 body_offset,
 											U8 * data, S32 data_size)
 {
+	const LLUUID mesh_id(mMeshID);
+	auto on_failure = [mesh_id]()
+		{
+			LL_WARNS(LOG_MESH) << "Error during mesh physics shape processing.  ID:  " << mesh_id
+							   << ", Unknown reason.  Not retrying."
+							   << LL_ENDL;
+			// *TODO:  Mark mesh unavailable on error
+		};
+
 	if ((!MESH_PHYS_SHAPE_PROCESS_FAILED)
-		&& ((data != NULL) == (data_size > 0)) // if we have data but no size or have size but no data, something is wrong
-		&& gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size) == MESH_OK)
+		&& ((data != NULL) == (data_size > 0))) // if we have data but no size or have size but no data, something is wrong
 	{
-		// good fetch from sim, write to cache for caching
-		// <FS:Ansariel> Fix asset caching
-		//LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::WRITE);
-		LLFileSystem file(mMeshID, LLAssetType::AT_MESH, LLFileSystem::READ_WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// Parse and cache on the decode pool, this handler is gone by then
+		const U8 * held(data);
+		std::shared_ptr<const void> owner(hold_mesh_data(body, body_offset, held, data_size));
+		gMeshRepo.mThread->decodeMeshData(mesh_id, mOffset, mRequestedBytes, held, data_size, owner,
+			[mesh_id](const U8* buffer, S32 buffer_size)
+			{
+				return gMeshRepo.mThread->physicsShapeReceived(mesh_id, buffer, buffer_size) == MESH_OK;
+			},
+			on_failure);
 	}
 	else
 	{
-		LL_WARNS(LOG_MESH) << "Error during mesh physics shape processing.  ID:  " << mMeshID
-						   << ", Unknown reason.  Not retrying."
-						   << LL_ENDL;
-		// *TODO:  Mark mesh unavailable on error
+		on_failure();
 	}
 }
 
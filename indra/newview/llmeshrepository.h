@@ -27,7 +27,10 @@
 #ifndef LL_MESH_REPOSITORY_H
 #define LL_MESH_REPOSITORY_H
 
+#include <functional>
+#include <memory>
 #include <unordered_map>
+#include "llatomic.h"
 #include "llassettype.h"
 #include "llmodel.h"
 #include "lluuid.h"
@@ -51,6 +54,11 @@ class LLMutex;
 class LLCondition;
 class LLMeshRepository;
 
+namespace LL
+{
+    class ThreadPool;
+}
+
 typedef enum e_mesh_processing_result_enum
 {
     MESH_OK = 0,
@@ -207,6 +215,10 @@ public:
 
 	LLMutex*	mMutex;
 	LLMutex*	mHeaderMutex;
+	// Held for each write to the mesh cache.  A partial write to a mesh
+	// small enough to be packed rewrites the whole asset, so two LODs of
+	// one mesh decoded at once would otherwise lose one of the writes.
+	LLMutex*	mCacheMutex;
 	LLCondition* mSignal;
 
 	//map of known mesh headers
@@ -237,9 +249,10 @@ public:
 		LLVolumeParams  mMeshParams;
 		S32 mLOD;
 		F32 mScore;
+		bool mSkipCache;	// cached copy failed to decode, go to the sim
 
 		LODRequest(const LLVolumeParams&  mesh_params, S32 lod)
-			: RequestStats(), mMeshParams(mesh_params), mLOD(lod), mScore(0.f)
+			: RequestStats(), mMeshParams(mesh_params), mLOD(lod), mScore(0.f), mSkipCache(false)
 		{
 		}
 	};
@@ -256,9 +269,10 @@ public:
 	{
 	public:
 		LLUUID mId;
+		bool mSkipCache;	// cached copy failed to decode, go to the sim
 
 		UUIDBasedRequest(const LLUUID& id)
-			: RequestStats(), mId(id)
+			: RequestStats(), mId(id), mSkipCache(false)
 		{
         }
 
@@ -328,6 +342,12 @@ public:
 
 	std::string mGetMeshCapability;
 
+	// Decompressing and unpacking received LODs, skin info and physics
+	// data runs on this pool so the repo thread can keep requests going.
+	// Empty when ThreadPoolSizes["MeshDecode"] is 0, decoding is then
+	// done inline.
+	std::unique_ptr<LL::ThreadPool> mDecodePool;
+
 	LLMeshRepoThread();
 	~LLMeshRepoThread();
 
@@ -337,14 +357,41 @@ public:
 	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params, bool can_retry = true);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_retry = true, bool use_cache = true);
 	EMeshProcessingResult headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
-	EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
-	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
-	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
-	EMeshProcessingResult physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
+	EMeshProcessingResult lodReceived(const LLVolumeParams& mesh_params, S32 lod, const U8* data, S32 data_size);
+	bool skinInfoReceived(const LLUUID& mesh_id, const U8* data, S32 data_size);
+	bool decompositionReceived(const LLUUID& mesh_id, const U8* data, S32 data_size);
+	EMeshProcessingResult physicsShapeReceived(const LLUUID& mesh_id, const U8* data, S32 data_size);
 	bool hasPhysicsShapeInHeader(const LLUUID& mesh_id);
 
+	// Run work on the decode pool, or right away if there is no pool or
+	// it has closed.  Work is one of the *Received() calls above plus
+	// whatever hangs off its result, it must not need the repo thread.
+	// Blocks when the pool's queue is full, which keeps received data
+	// from piling up faster than it can be decoded.
+	//
+	// Threads:  repo
+	void decode(const std::function<void()>& work);
+
+	// Decode data with decode_fn, one of the *Received() calls above,
+	// through decode().  Data fetched from the sim is written back to
+	// the cache at cache_offset once it decodes, pass -1 for data that
+	// came from the cache.  on_failure runs on the decode thread when
+	// decode_fn fails.  owner keeps data valid until the job is done.
+	//
+	// Threads:  repo
+	void decodeMeshData(const LLUUID& mesh_id, S32 cache_offset, S32 cache_size,
+						const U8* data, S32 data_size, const std::shared_ptr<const void>& owner,
+						const std::function<bool(const U8*, S32)>& decode_fn,
+						const std::function<void()>& on_failure);
+
+	// Ask the sim again for a skin info, decomposition or physics shape
+	// whose cached copy failed to decode.
+	//
+	// Threads:  decode
+	void requeueUncached(std::set<UUIDBasedRequest>& requests, const LLUUID& mesh_id);
+
 	void notifyLoadedMeshes();
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 	
@@ -354,15 +401,15 @@ public:
 
 	//send request for skin info, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshSkinInfo(const LLUUID& mesh_id);
+	bool fetchMeshSkinInfo(const LLUUID& mesh_id, bool use_cache = true);
 
 	//send request for decomposition, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshDecomposition(const LLUUID& mesh_id);
+	bool fetchMeshDecomposition(const LLUUID& mesh_id, bool use_cache = true);
 
 	//send request for PhysicsShape, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshPhysicsShape(const LLUUID& mesh_id);
+	bool fetchMeshPhysicsShape(const LLUUID& mesh_id, bool use_cache = true);
 
 	static void incActiveLODRequests();
 	static void decActiveLODRequests();
@@ -553,12 +600,12 @@ public:
 	static U32 sLODPending;
 	static U32 sLODProcessing;
 	static U32 sCacheBytesRead;
-	static U32 sCacheBytesWritten;
+	static LLAtomicU32 sCacheBytesWritten;		// Written from decode threads too
     static U32 sCacheBytesHeaders;
     static U32 sCacheBytesSkins;
     static U32 sCacheBytesDecomps;
 	static U32 sCacheReads;						
-	static U32 sCacheWrites;
+	static LLAtomicU32 sCacheWrites;
 	static U32 sMaxLockHoldoffs;				// Maximum sequential locking failures
 	
 	static LLDeadmanTimer sQuiescentTimer;		// Time-to-complete-mesh-downloads after significant events
@@ -53,12 +53,10 @@ bool LLSearchHistory::load()
 
 	// add each line in the file to the list
 	std::string line;
-	LLPointer<LLSDParser> parser = new LLSDNotationParser();
 	while (std::getline(file, line)) 
 	{
 		LLSD s_item;
-		std::istringstream iss(line);
-		if (parser->parse(iss, s_item, line.length()) == LLSDParser::PARSE_FAILURE)
+		if (LLSDSerialize::fromNotation(s_item, line.data(), line.size()) == LLSDParser::PARSE_FAILURE)
 		{
 			break;
 		}
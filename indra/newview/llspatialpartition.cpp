@@ -412,6 +412,10 @@ void LLSpatialGroup::shift(const LLVector4a &offset)
 	mOctreeNode->setCenter(t);
 	mOctreeNode->updateMinMax();
 	mBounds[0].add(offset);
+	if (mFlatOctree)
+	{
+		mFlatOctree->setBounds(mFlatIndex, mOctreeNode, mBounds[0], mBounds[1]);
+	}
 	mExtents[0].add(offset);
 	mExtents[1].add(offset);
 	mObjectBounds[0].add(offset);
@@ -997,6 +1001,19 @@ public:
 		return res;
 	}
 
+	virtual bool frustumCheck4(const LLVector4a* center, const LLVector4a* size, const LLViewerOctreeGroup* const* groups, S32* results)
+	{
+		mCamera->AABBInFrustum4(center, size, results, true);
+		for (U32 i = 0; i < OctreeFlat::LANES; i++)
+		{
+			if (groups[i] && results[i] != 0)
+			{
+				results[i] = llmin(results[i], AABBSphereIntersectGroupExtents(groups[i]));
+			}
+		}
+		return true;
+	}
+
 	virtual S32 frustumCheckObjects(const LLViewerOctreeGroup* group)
 	{
 		S32 res = AABBInFrustumNoFarClipObjectBounds(group);
@@ -1030,6 +1047,12 @@ public:
 		return AABBInFrustumNoFarClipGroupBounds(group);
 	}
 
+	virtual bool frustumCheck4(const LLVector4a* center, const LLVector4a* size, const LLViewerOctreeGroup* const* groups, S32* results)
+	{
+		mCamera->AABBInFrustum4(center, size, results, true);
+		return true;
+	}
+
 	virtual S32 frustumCheckObjects(const LLViewerOctreeGroup* group)
 	{
 		S32 res = AABBInFrustumNoFarClipObjectBounds(group);
@@ -1048,6 +1071,12 @@ public:
 		return AABBInFrustumGroupBounds(group);
 	}
 
+	virtual bool frustumCheck4(const LLVector4a* center, const LLVector4a* size, const LLViewerOctreeGroup* const* groups, S32* results)
+	{
+		mCamera->AABBInFrustum4(center, size, results, false);
+		return true;
+	}
+
 	virtual S32 frustumCheckObjects(const LLViewerOctreeGroup* group)
 	{
 		return AABBInFrustumObjectBounds(group);
@@ -1374,6 +1403,7 @@ BOOL LLSpatialPartition::getVisibleExtents(LLCamera& camera, LLVector3& visMin,
 
 BOOL LLSpatialPartition::visibleObjectsInFrustum(LLCamera& camera)
 {
+	getFlatOctree();
 	LLOctreeCullDetectVisible vis(&camera);
 	vis.traverse(mOctree);
 	return vis.mResult;
@@ -1389,6 +1419,7 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 		LLSpatialGroup* group = (LLSpatialGroup*) mOctree->getListener(0);
 		group->rebound();
 	}
+	getFlatOctree();
 
 #if LL_OCTREE_PARANOIA_CHECK
 	((LLSpatialGroup*)mOctree->getListener(0))->validate();
@@ -1408,6 +1439,7 @@ S32 LLSpatialPartition::cull(LLCamera &camera, bool do_occlusion)
 #endif
 	LLSpatialGroup* group = (LLSpatialGroup*) mOctree->getListener(0);
 	group->rebound();
+	getFlatOctree();
 
 #if LL_OCTREE_PARANOIA_CHECK
 	((LLSpatialGroup*)mOctree->getListener(0))->validate();
@@ -64,7 +64,6 @@
 
 #include "llloginflags.h"
 #include "llmd5.h"
-#include "llmemorystream.h"
 #include "llmessageconfig.h"
 #include "llmoveview.h"
 #include "llfloaterimcontainer.h"
@@ -606,7 +605,7 @@ bool idle_startup()
 
 			F32 dropPercent = gSavedSettings.getF32("PacketDropPercentage");
 			msg->mPacketRing.setDropPercentage(dropPercent);
-
+			msg->mPacketRing.setUseBatchedIO(gSavedSettings.getBOOL("PacketBatchedIO"));
             F32 inBandwidth = gSavedSettings.getF32("InBandwidth"); 
             F32 outBandwidth = gSavedSettings.getF32("OutBandwidth"); 
 			if (inBandwidth != 0.f)
@@ -621,6 +620,12 @@ bool idle_startup()
 				msg->mPacketRing.setUseOutThrottle(TRUE);
 				msg->mPacketRing.setOutBandwidth(outBandwidth);
 			}
+
+			// After the packet ring is configured, the thread reads from it
+			if (gSavedSettings.getBOOL("MessageNetworkThread"))
+			{
+				msg->startNetworkThread();
+			}
 		}
 
 		LL_INFOS("AppInit") << "Message System Initialized." << LL_ENDL;
@@ -3530,9 +3535,8 @@ bool process_login_success_response()
 	const std::string look_at_str = response["look_at"];
 	if (!look_at_str.empty())
 	{
-		size_t len = look_at_str.size();
-		LLMemoryStream mstr((U8*)look_at_str.c_str(), len);
-		LLSD sd = LLSDSerialize::fromNotation(mstr, len);
+		LLSD sd;
+		LLSDSerialize::fromNotation(sd, look_at_str.data(), look_at_str.size());
 		gAgentStartLookAt = ll_vector3_from_sd(sd);
 	}
 
@@ -3568,9 +3572,8 @@ bool process_login_success_response()
 	std::string home_location = response["home"];
 	if(!home_location.empty())
 	{
-		size_t len = home_location.size();
-		LLMemoryStream mstr((U8*)home_location.c_str(), len);
-		LLSD sd = LLSDSerialize::fromNotation(mstr, len);
+		LLSD sd;
+		LLSDSerialize::fromNotation(sd, home_location.data(), home_location.size());
 		S32 region_x = sd["region_handle"][0].asInteger();
 		S32 region_y = sd["region_handle"][1].asInteger();
 		U64 region_handle = to_region_handle(region_x, region_y);
@@ -198,8 +198,6 @@ void LLTeleportHistoryStorage::load()
 	// remove current entries before we load over them
 	mItems.clear();
 
-	// the parser's destructor is protected so we cannot create in the stack.
-	LLPointer<LLSDParser> parser = new LLSDNotationParser();
 	std::string line;
 	while (std::getline(file, line))
 	{
@@ -210,8 +208,7 @@ void LLTeleportHistoryStorage::load()
 		}
 		
 		LLSD s_item;
-		std::istringstream iss(line);
-		if (parser->parse(iss, s_item, line.length()) == LLSDParser::PARSE_FAILURE)
+		if (LLSDSerialize::fromNotation(s_item, line.data(), line.size()) == LLSDParser::PARSE_FAILURE)
 		{
 			LL_INFOS() << "Parsing saved teleport history failed" << LL_ENDL;
 			break;
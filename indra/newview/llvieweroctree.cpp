@@ -460,7 +460,9 @@ LLViewerOctreeGroup::~LLViewerOctreeGroup()
 LLViewerOctreeGroup::LLViewerOctreeGroup(OctreeNode* node)
 :	mOctreeNode(node),
 	mAnyVisible(0),
-	mState(CLEAN)
+	mState(CLEAN),
+	mFlatOctree(NULL),
+	mFlatIndex(0)
 {
 	LLVector4a tmp;
 	tmp.splat(0.f);
@@ -601,12 +603,27 @@ void LLViewerOctreeGroup::rebound()
 		mBounds[1].setSub(newMax, newMin);
 		mBounds[1].mul(0.5f);
 	}
+
+	if (mFlatOctree)
+	{
+		mFlatOctree->setBounds(mFlatIndex, mOctreeNode, mBounds[0], mBounds[1]);
+	}
 	
 	clearState(DIRTY);
 
 	return;
 }
 
+void LLViewerOctreeGroup::setFlatOctree(OctreeFlat* flat, U32 index)
+{
+	mFlatOctree = flat;
+	mFlatIndex = index;
+	if (mFlatOctree)
+	{
+		mFlatOctree->setBounds(mFlatIndex, mOctreeNode, mBounds[0], mBounds[1]);
+	}
+}
+
 //virtual 
 void LLViewerOctreeGroup::handleInsertion(const TreeNode* node, LLViewerOctreeEntry* obj)
 {
@@ -1343,6 +1360,20 @@ BOOL LLViewerOctreePartition::isOcclusionEnabled()
 	return mOcclusionEnabled || LLPipeline::sUseOcclusion > 2;
 }
 
+OctreeFlat* LLViewerOctreePartition::getFlatOctree()
+{
+	LL_PROFILE_ZONE_SCOPED_CATEGORY_OCTREE;
+	mFlatOctree.update(mOctree, [this](const OctreeNode* node, U32 index)
+		{
+			LLViewerOctreeGroup* group = (LLViewerOctreeGroup*) node->getListener(0);
+			if (group)
+			{
+				group->setFlatOctree(&mFlatOctree, index);
+			}
+		});
+	return &mFlatOctree;
+}
+
 
 //-----------------------------------------------------------------------------------
 //class LLViewerOctreeCull definitions
@@ -1359,6 +1390,9 @@ void LLViewerOctreeCull::traverse(const OctreeNode* n)
 {
 	LLViewerOctreeGroup* group = (LLViewerOctreeGroup*) n->getListener(0);
 
+	S32 res = mChildRes;
+	mChildRes = -1;
+
 	if (earlyFail(group))
 	{
 		return;
@@ -1367,20 +1401,90 @@ void LLViewerOctreeCull::traverse(const OctreeNode* n)
 	if (mRes == 2 || 
 		(mRes && group->hasState(LLViewerOctreeGroup::SKIP_FRUSTUM_CHECK)))
 	{	//fully in, just add everything
-		OctreeTraveler::traverse(n);
+		traverseChildren(n);
 	}
 	else
 	{
-		mRes = frustumCheck(group);
+		mRes = res >= 0 ? res : frustumCheck(group);
 				
 		if (mRes)
 		{ //at least partially in, run on down
-			OctreeTraveler::traverse(n);
+			traverseChildren(n);
 		}
 
 		mRes = 0;
 	}
 }
+
+void LLViewerOctreeCull::traverseChildren(const OctreeNode* n)
+{
+	n->accept(this);
+
+	S32 results[8];
+	if (mRes == 2 || !frustumCheckChildren(n, results))
+	{
+		for (U32 i = 0; i < n->getChildCount(); i++)
+		{
+			traverse(n->getChild(i));
+		}
+		return;
+	}
+
+	for (U32 i = 0; i < n->getChildCount(); i++)
+	{
+		mChildRes = results[i];
+		traverse(n->getChild(i));
+	}
+	mChildRes = -1;
+}
+
+bool LLViewerOctreeCull::frustumCheckChildren(const OctreeNode* n, S32* results)
+{
+	const U32 child_count = n->getChildCount();
+	if (child_count < 2)
+	{
+		return false;
+	}
+
+	const LLViewerOctreeGroup* group = (const LLViewerOctreeGroup*) n->getListener(0);
+	const OctreeFlat* flat = group->getFlatOctree();
+	if (!flat || group->getFlatIndex() >= flat->getNodeCount())
+	{
+		return false;
+	}
+
+	const OctreeFlat::Node& node = flat->getNode(group->getFlatIndex());
+	if (node.mNode != n || node.mChildCount != child_count)
+	{
+		return false;
+	}
+
+	for (U32 first = 0; first < child_count; first += OctreeFlat::LANES)
+	{
+		const LLViewerOctreeGroup* groups[OctreeFlat::LANES];
+		for (U32 lane = 0; lane < OctreeFlat::LANES; lane++)
+		{
+			groups[lane] = NULL;
+			if (first + lane < child_count)
+			{
+				const OctreeNode* child = n->getChild(first + lane);
+				if (flat->getNode(node.mFirstChild + first + lane).mNode != child)
+				{ //the tree changed since the flat copy was made
+					return false;
+				}
+				groups[lane] = (const LLViewerOctreeGroup*) child->getListener(0);
+			}
+		}
+
+		const LLVector4a* bounds = flat->getGroupBounds(node.mFirstChild + first);
+		if (!frustumCheck4(bounds, bounds + 3, groups, results + first))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
 	
 //------------------------------------------
 //agent space group culling
@@ -50,6 +50,7 @@ typedef LLTreeNode<LLViewerOctreeEntry> TreeNode;
 typedef LLOctreeNode<LLViewerOctreeEntry, LLPointer<LLViewerOctreeEntry>> OctreeNode;
 typedef LLOctreeRoot<LLViewerOctreeEntry, LLPointer<LLViewerOctreeEntry>> OctreeRoot;
 typedef LLOctreeTraveler<LLViewerOctreeEntry, LLPointer<LLViewerOctreeEntry>> OctreeTraveler;
+typedef LLOctreeFlat<LLViewerOctreeEntry, LLPointer<LLViewerOctreeEntry>> OctreeFlat;
 
 #if LL_OCTREE_PARANOIA_CHECK
 #define assert_octree_valid(x) x->validate()
@@ -244,6 +245,11 @@ public:
 	const LLVector4a* getObjectBounds() const  {return mObjectBounds;}
 	const LLVector4a* getObjectExtents() const {return mObjectExtents;}
 
+	// Where this group's bounds are mirrored for batched culling, if anywhere
+	const OctreeFlat* getFlatOctree() const    {return mFlatOctree;}
+	U32 getFlatIndex() const                   {return mFlatIndex;}
+	void setFlatOctree(OctreeFlat* flat, U32 index);
+
 	//octree wrappers to make code more readable
 	element_iter getDataBegin() { return mOctreeNode->getDataBegin(); }
 	element_iter getDataEnd() { return mOctreeNode->getDataEnd(); }
@@ -267,6 +273,9 @@ protected:
 	S32         mAnyVisible; //latest visible to any camera
 	S32         mVisible[LLViewerCamera::NUM_CAMERAS];	
 
+	OctreeFlat* mFlatOctree;
+	U32         mFlatIndex;
+
 };//LL_ALIGN_POSTFIX(16);
 
 //octree group which has capability to support occlusion culling
@@ -351,6 +360,9 @@ public:
 	virtual S32 cull(LLCamera &camera, bool do_occlusion) = 0;
 	BOOL isOcclusionEnabled();
 
+	// Flat copy of mOctree, rebuilt if its shape changed since last time
+	OctreeFlat* getFlatOctree();
+
 protected:
     // MUST call from destructor of any derived classes (SL-17276)
     void cleanup();
@@ -363,13 +375,16 @@ public:
 	BOOL             mOcclusionEnabled; // if TRUE, occlusion culling is performed
 	U32              mLODSeed;
 	U32              mLODPeriod;	//number of frames between LOD updates for a given spatial group (staggered by mLODSeed)
+
+protected:
+	OctreeFlat       mFlatOctree;
 };
 
 class LLViewerOctreeCull : public OctreeTraveler
 {
 public:
 	LLViewerOctreeCull(LLCamera* camera)
-		: mCamera(camera), mRes(0) { }
+		: mCamera(camera), mRes(0), mChildRes(-1) { }
 	
 	virtual void traverse(const OctreeNode* n);
 
@@ -399,6 +414,18 @@ protected:
 	virtual S32 frustumCheck(const LLViewerOctreeGroup* group) = 0;
 	virtual S32 frustumCheckObjects(const LLViewerOctreeGroup* group) = 0;
 
+	// Cullers whose frustumCheck() is an agent space frustum test of the
+	// group bounds can also check four groups at once from the bounds kept
+	// in the partition's flat octree. center and size are the structure of
+	// arrays bounds of the four groups, groups[] is NULL for unused lanes.
+	// Return false to have each group checked with frustumCheck().
+	virtual bool frustumCheck4(const LLVector4a* center, const LLVector4a* size, const LLViewerOctreeGroup* const* groups, S32* results) { return false; }
+
+	// Fills results with the frustumCheck() of each child of n in one pass
+	// over the flat octree, returns false if that is not possible
+	bool frustumCheckChildren(const OctreeNode* n, S32* results);
+	void traverseChildren(const OctreeNode* n);
+
 	bool checkProjectionArea(const LLVector4a& center, const LLVector4a& size, const LLVector3& shift, F32 pixel_threshold, F32 near_radius);
 	virtual bool checkObjects(const OctreeNode* branch, const LLViewerOctreeGroup* group);
 	virtual void preprocess(LLViewerOctreeGroup* group);
@@ -408,6 +435,7 @@ protected:
 protected:
 	LLCamera *mCamera;
 	S32 mRes;
+	S32 mChildRes;	// frustum check of the node about to be traversed, -1 if not done yet
 };
 
 //scan the octree, output the info of each node for debug use.
@@ -88,6 +88,9 @@
 #include "llcallstack.h"
 #include "llsculptidsize.h"
 #include "llavatarappearancedefines.h"
+#include "llfilesystem.h"
+#include "llvolumefacecache.h"
+#include "workqueue.h"
 
 const F32 FORCE_SIMPLE_RENDER_AREA = 512.f;
 const F32 FORCE_CULL_AREA = 8.f;
@@ -292,10 +295,39 @@ void LLVOVolume::markDead()
 	LLViewerObject::markDead();
 }
 
+// Keeps generated prim geometry in the asset disk cache between sessions
+class LLVolumeFaceDiskStore : public LLVolumeFaceCache::Store
+{
+public:
+	bool read(const LLUUID& key, const std::function<bool(const U8* data, S32 size)>& unpack) override
+	{
+		LLFileSystem file(key, LLAssetType::AT_UNKNOWN);
+		LLFileSystemView::ptr_t view = file.mapView();
+		return view.notNull() && unpack(view->getData(), view->getSize());
+	}
+
+	void write(const LLUUID& key, const std::vector<U8>& data) override
+	{
+		// The entry only matters to a later session, keep the file write
+		// off the thread that generated the volume
+		LL::WorkQueue::postMaybe(LL::WorkQueue::getInstance("General"),
+			[key, data]()
+			{
+				LLFileSystem file(key, LLAssetType::AT_UNKNOWN, LLFileSystem::WRITE);
+				file.write(data.data(), (S32)data.size());
+			});
+	}
+};
 
 // static
 void LLVOVolume::initClass()
 {
+	const U32 face_cache_mb = gSavedSettings.getU32("VolumeFaceCacheMemoryMB");
+	if (face_cache_mb > 0)
+	{
+		LLPrimitive::getVolumeManager()->useFaceCache(face_cache_mb * 1024 * 1024, new LLVolumeFaceDiskStore());
+	}
+
 	// gSavedSettings better be around
 	if (gSavedSettings.getBOOL("PrimMediaMasterEnabled"))
 	{
@@ -1558,6 +1590,14 @@ BOOL LLVOVolume::updateLOD()
             }
         }
 
+		// Start generating the new LOD now so the rebuild later in the frame
+		// finds it ready rather than generating it on the main thread
+		const LLVolumeParams& volume_params = getVolume()->getParams();
+		if (volume_params.getSculptType() == LL_SCULPT_TYPE_NONE && !isFlexible())
+		{
+			LLPrimitive::getVolumeManager()->prefetchVolume(volume_params, getLOD());
+		}
+
 		gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
 		mLODChanged = TRUE;
 	}